@@ -0,0 +1,607 @@
+#include "benchmark/benchmark.h"
+
+#include "iex_decoder.h"
+#include "iex_histogram.h"
+#include "iex_microstructure.h"
+#include "iex_messages.h"
+#include "iex_order_book.h"
+#include "iex_packet_builder.h"
+#include "iex_pipeline.h"
+#include "iex_protocol.h"
+#include "iex_replay.h"
+#include "perf_counters.h"
+
+#include "Packet.h"
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+const std::string tops_pcap_filename = "20180127_IEXTP1_TOPS1.6.pcap";
+const std::string deep_pcap_filename = "20180127_IEXTP1_DEEP1.0.pcap";
+
+// Number of raw packets kept in memory for the packet level benchmarks.
+constexpr size_t num_sample_packets = 20000;
+
+/// \brief Locate a bundled data file, using the same search paths as the unit tests.
+std::string FindDataFile(const std::string& filename) {
+  std::vector<std::string> common_paths = {"", "data/", "../data/", "data\\", "..\\data\\"};
+  for (const auto& test_path : common_paths) {
+    std::ifstream f((test_path + filename).c_str());
+    if (f.good()) {
+      return test_path + filename;
+    }
+  }
+  std::cout << "The data file " << filename << " was not found. "
+            << "Please run the benchmarks from the project root directory." << std::endl;
+  return "";
+}
+
+/// \brief Raw data loaded once from the bundled files, shared by all benchmarks.
+struct SampleData {
+  /// \brief The first raw packets of the DEEP file.
+  std::vector<pcpp::RawPacket> packets;
+
+  /// \brief Raw message blocks of both files, in stream order.
+  std::vector<std::vector<uint8_t>> blocks;
+
+  /// \brief Number of blocks from the DEEP file, the first ones of blocks.
+  size_t num_deep_blocks = 0;
+
+  /// \brief Raw message blocks grouped by message type.
+  std::map<MessageType, std::vector<std::vector<uint8_t>>> blocks_by_type;
+};
+
+void LoadBlocks(const std::string& filename, SampleData& sample, const bool keep_packets) {
+  IEXDecoder decoder;
+  if (!decoder.OpenFileForReading(filename)) {
+    return;
+  }
+  pcpp::RawPacket raw_packet;
+  while (decoder.ReadNextPacket(raw_packet) == ReturnCode::Success) {
+    if (keep_packets && sample.packets.size() < num_sample_packets) {
+      sample.packets.push_back(raw_packet);
+    }
+    pcpp::Packet packet(&raw_packet);
+    const uint8_t* payload_ptr = nullptr;
+    size_t payload_len = 0;
+    if (IEXDecoder::ExtractPayload(packet, payload_ptr, payload_len) != ReturnCode::Success) {
+      continue;
+    }
+    size_t block_offset = IEXDecoder::first_block_start;
+    while (block_offset < payload_len) {
+      const uint8_t* block_ptr = payload_ptr + block_offset;
+      const uint16_t block_len = IEXDecoder::GetBlockSize(block_ptr);
+      const uint8_t* msg_data_ptr = IEXDecoder::GetBlockData(block_ptr);
+      std::vector<uint8_t> block(msg_data_ptr, msg_data_ptr + block_len);
+      sample.blocks_by_type[static_cast<MessageType>(block[0])].push_back(block);
+      sample.blocks.emplace_back(std::move(block));
+      block_offset += block_len + 2;
+    }
+  }
+}
+
+SampleData& GetSampleData() {
+  static SampleData sample;
+  static bool loaded = false;
+  if (!loaded) {
+    LoadBlocks(FindDataFile(deep_pcap_filename), sample, true);
+    sample.num_deep_blocks = sample.blocks.size();
+    LoadBlocks(FindDataFile(tops_pcap_filename), sample, false);
+    loaded = true;
+  }
+  return sample;
+}
+
+/// \brief The raw blocks of a single message type. Skips the benchmark if there are none.
+const std::vector<std::vector<uint8_t>>* GetBlocks(benchmark::State& state,
+                                                   const MessageType msg_type) {
+  const auto& blocks_by_type = GetSampleData().blocks_by_type;
+  auto it = blocks_by_type.find(msg_type);
+  if (it == blocks_by_type.end() || it->second.empty()) {
+    state.SkipWithError("No sample messages of this type.");
+    return nullptr;
+  }
+  return &it->second;
+}
+
+////////////////////////////////////////////////////////////
+/// Field readers
+
+static void BM_GetNumeric(benchmark::State& state) {
+  const auto* blocks = GetBlocks(state, MessageType::QuoteUpdate);
+  if (!blocks) {
+    return;
+  }
+  size_t idx = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    const uint8_t* data_ptr = (*blocks)[idx++ % blocks->size()].data();
+    benchmark::DoNotOptimize(GetNumeric<uint64_t>(data_ptr, 2));
+    benchmark::DoNotOptimize(GetNumeric<uint32_t>(data_ptr, 18));
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_GetNumeric);
+
+static void BM_GetPrice(benchmark::State& state) {
+  const auto* blocks = GetBlocks(state, MessageType::QuoteUpdate);
+  if (!blocks) {
+    return;
+  }
+  size_t idx = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    const uint8_t* data_ptr = (*blocks)[idx++ % blocks->size()].data();
+    benchmark::DoNotOptimize(GetPrice(data_ptr, 22));
+    benchmark::DoNotOptimize(GetPrice(data_ptr, 30));
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_GetPrice);
+
+static void BM_GetString(benchmark::State& state) {
+  const auto* blocks = GetBlocks(state, MessageType::QuoteUpdate);
+  if (!blocks) {
+    return;
+  }
+  size_t idx = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    const uint8_t* data_ptr = (*blocks)[idx++ % blocks->size()].data();
+    benchmark::DoNotOptimize(GetString(data_ptr, 10, 8));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetString);
+
+////////////////////////////////////////////////////////////
+/// Decode methods, one benchmark per message struct.
+
+template <typename Message>
+static void BM_Decode(benchmark::State& state, const MessageType msg_type, Message msg) {
+  const auto* blocks = GetBlocks(state, msg_type);
+  if (!blocks) {
+    return;
+  }
+  size_t idx = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    const uint8_t* data_ptr = (*blocks)[idx++ % blocks->size()].data();
+    benchmark::DoNotOptimize(msg.Decode(data_ptr));
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_Decode, SystemEvent, MessageType::SystemEvent, SystemEventMessage());
+BENCHMARK_CAPTURE(BM_Decode, SecurityDirectory, MessageType::SecurityDirectory,
+                  SecurityDirectoryMessage());
+BENCHMARK_CAPTURE(BM_Decode, TradingStatus, MessageType::TradingStatus, TradingStatusMessage());
+BENCHMARK_CAPTURE(BM_Decode, OperationalHaltStatus, MessageType::OperationalHaltStatus,
+                  OperationalHaltStatusMessage());
+BENCHMARK_CAPTURE(BM_Decode, ShortSalePriceTestStatus, MessageType::ShortSalePriceTestStatus,
+                  ShortSalePriceTestStatusMessage());
+BENCHMARK_CAPTURE(BM_Decode, QuoteUpdate, MessageType::QuoteUpdate, QuoteUpdateMessage());
+BENCHMARK_CAPTURE(BM_Decode, TradeReport, MessageType::TradeReport, TradeReportMessage());
+BENCHMARK_CAPTURE(BM_Decode, TradeBreak, MessageType::TradeBreak,
+                  TradeReportMessage(MessageType::TradeBreak));
+BENCHMARK_CAPTURE(BM_Decode, OfficialPrice, MessageType::OfficialPrice, OfficialPriceMessage());
+BENCHMARK_CAPTURE(BM_Decode, AuctionInformation, MessageType::AuctionInformation,
+                  AuctionInformationMessage());
+BENCHMARK_CAPTURE(BM_Decode, PriceLevelUpdateBuy, MessageType::PriceLevelUpdateBuy,
+                  PriceLevelUpdateMessage(MessageType::PriceLevelUpdateBuy));
+BENCHMARK_CAPTURE(BM_Decode, PriceLevelUpdateSell, MessageType::PriceLevelUpdateSell,
+                  PriceLevelUpdateMessage(MessageType::PriceLevelUpdateSell));
+BENCHMARK_CAPTURE(BM_Decode, SecurityEvent, MessageType::SecurityEvent,
+                  SecurityEventMessage(MessageType::SecurityEvent));
+
+// Recording a latency, over a spread of values like the internal latencies of a real stream.
+static void BM_HistogramRecord(benchmark::State& state) {
+  std::vector<int64_t> values(4096);
+  uint64_t x = 88172645463325252ull;
+  for (auto& value : values) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    value = static_cast<int64_t>(x % 10000000);
+  }
+  LatencyHistogram histogram;
+  size_t idx = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    histogram.Record(values[idx++ % values.size()]);
+  }
+  benchmark::DoNotOptimize(histogram.GetCount());
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HistogramRecord);
+
+////////////////////////////////////////////////////////////
+/// Factory and packet handling.
+
+// Allocation and type dispatch only, over the real mixed stream of both files.
+static void BM_IEXMessageFactory(benchmark::State& state) {
+  const auto& blocks = GetSampleData().blocks;
+  size_t idx = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(IEXMessageFactory(blocks[idx++ % blocks.size()].data()));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IEXMessageFactory);
+
+// The same with a single message type, where the type dispatch is perfectly predictable. Compare
+// the branch misses with BM_IEXMessageFactory.
+static void BM_IEXMessageFactorySingleType(benchmark::State& state) {
+  const auto* blocks = GetBlocks(state, MessageType::QuoteUpdate);
+  if (!blocks) {
+    return;
+  }
+  size_t idx = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(IEXMessageFactory((*blocks)[idx++ % blocks->size()].data()));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IEXMessageFactorySingleType);
+
+// Factory plus Decode, i.e. the per message work of GetNextMessage.
+static void BM_FactoryAndDecode(benchmark::State& state) {
+  const auto& blocks = GetSampleData().blocks;
+  size_t idx = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    const uint8_t* data_ptr = blocks[idx++ % blocks.size()].data();
+    auto msg_ptr = IEXMessageFactory(data_ptr);
+    if (msg_ptr) {
+      benchmark::DoNotOptimize(msg_ptr->Decode(data_ptr));
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FactoryAndDecode);
+
+// Sums the timestamps of the messages, so every dispatch path reads the decoded struct.
+struct TimestampSumHandler {
+  inline void operator()(const IEXMessageBase& msg) { sum += msg.timestamp; }
+  uint64_t sum = 0;
+};
+
+enum class DispatchKind { FactoryAndDecode, Switch, Table };
+
+// Type dispatch and decode over the real mixed DEEP stream, where the type byte is hard to
+// predict. FactoryAndDecode is the path of GetNextMessage, Switch and Table the two dispatches of
+// ProtocolDecoder. Compare the branch misses of the three.
+static void BM_DeepDispatch(benchmark::State& state, const DispatchKind kind) {
+  const auto& sample = GetSampleData();
+  if (sample.num_deep_blocks == 0) {
+    state.SkipWithError("No sample messages.");
+    return;
+  }
+  std::vector<const uint8_t*> messages;
+  for (size_t i = 0; i < sample.num_deep_blocks; ++i) {
+    messages.push_back(sample.blocks[i].data());
+  }
+  ProtocolDecoder<Deep10Protocol> protocol_decoder;
+  TimestampSumHandler handler;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    switch (kind) {
+      case DispatchKind::FactoryAndDecode:
+        for (const uint8_t* msg_data_ptr : messages) {
+          auto msg_ptr = IEXMessageFactory(msg_data_ptr);
+          if (msg_ptr && msg_ptr->Decode(msg_data_ptr)) {
+            handler(*msg_ptr);
+          }
+        }
+        break;
+      case DispatchKind::Switch:
+        for (const uint8_t* msg_data_ptr : messages) {
+          benchmark::DoNotOptimize(protocol_decoder.DispatchSwitch(msg_data_ptr, handler));
+        }
+        break;
+      case DispatchKind::Table:
+        for (const uint8_t* msg_data_ptr : messages) {
+          benchmark::DoNotOptimize(protocol_decoder.Dispatch(msg_data_ptr, handler));
+        }
+        break;
+    }
+  }
+  benchmark::DoNotOptimize(handler.sum);
+  state.SetItemsProcessed(state.iterations() * messages.size());
+}
+BENCHMARK_CAPTURE(BM_DeepDispatch, FactoryAndDecode, DispatchKind::FactoryAndDecode);
+BENCHMARK_CAPTURE(BM_DeepDispatch, Switch, DispatchKind::Switch);
+BENCHMARK_CAPTURE(BM_DeepDispatch, Table, DispatchKind::Table);
+
+// The inverse: encode the real mixed stream into IEX-TP packets of the usual size.
+static void BM_EncodeIntoPackets(benchmark::State& state) {
+  const auto& blocks = GetSampleData().blocks;
+  std::vector<std::unique_ptr<IEXMessageBase>> msgs;
+  for (const auto& block : blocks) {
+    auto msg_ptr = IEXMessageFactory(block.data());
+    if (msg_ptr && msg_ptr->Decode(block.data())) {
+      msgs.emplace_back(std::move(msg_ptr));
+    }
+  }
+  IEXTPPacketBuilder builder(static_cast<uint16_t>(ProtocolId::TOPS), 1, 1);
+  size_t idx = 0;
+  size_t num_bytes = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    const auto& msg = *msgs[idx++ % msgs.size()];
+    if (!builder.AddMessage(msg)) {
+      num_bytes += builder.Finish(0);
+      benchmark::DoNotOptimize(builder.GetData());
+      builder.StartNextPacket();
+      benchmark::DoNotOptimize(builder.AddMessage(msg));
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(num_bytes);
+}
+BENCHMARK(BM_EncodeIntoPackets);
+
+// The packet to payload path of ParseNextPacket: layer parsing, payload extraction and the
+// IEX-TP header decode.
+static void BM_PacketToPayload(benchmark::State& state) {
+  auto& packets = GetSampleData().packets;
+  if (packets.empty()) {
+    state.SkipWithError("No sample packets.");
+    return;
+  }
+  size_t idx = 0;
+  int64_t num_bytes = 0;
+  IEXTPHeader header;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    auto& raw_packet = packets[idx++ % packets.size()];
+    pcpp::Packet packet(&raw_packet);
+    const uint8_t* payload_ptr = nullptr;
+    size_t payload_len = 0;
+    if (IEXDecoder::ExtractPayload(packet, payload_ptr, payload_len) == ReturnCode::Success) {
+      benchmark::DoNotOptimize(header.Decode(payload_ptr));
+    }
+    num_bytes += raw_packet.getRawDataLen();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(num_bytes);
+}
+BENCHMARK(BM_PacketToPayload);
+
+////////////////////////////////////////////////////////////
+/// End to end, over the bundled files. items_per_second is messages/sec, bytes_per_second is
+/// pcap file bytes/sec.
+
+int64_t FileSize(const std::string& filename) {
+  std::ifstream in_stream(filename, std::ios::binary | std::ios::ate);
+  return in_stream.good() ? static_cast<int64_t>(in_stream.tellg()) : 0;
+}
+
+static void BM_DecodeFile(benchmark::State& state, const std::string& filename) {
+  const std::string filepath = FindDataFile(filename);
+  int64_t num_messages = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    IEXDecoder decoder;
+    if (!decoder.OpenFileForDecoding(filepath)) {
+      state.SkipWithError("Failed to open file.");
+      return;
+    }
+    std::unique_ptr<IEXMessageBase> msg_ptr;
+    while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+      ++num_messages;
+    }
+  }
+  state.SetItemsProcessed(num_messages);
+  state.SetBytesProcessed(state.iterations() * FileSize(filepath));
+}
+BENCHMARK_CAPTURE(BM_DecodeFile, TOPS, tops_pcap_filename)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_DecodeFile, DEEP, deep_pcap_filename)->Unit(benchmark::kMillisecond);
+
+// Counts the messages a ProtocolDecoder hands out.
+struct CountingHandler {
+  template <typename Message>
+  inline void operator()(const Message&) {
+    ++num_messages;
+  }
+  int64_t num_messages = 0;
+};
+
+// The decode loop specialized for the protocol of the file, compare with BM_DecodeFile.
+static void BM_ProtocolDecodeFile(benchmark::State& state, const std::string& filename) {
+  const std::string filepath = FindDataFile(filename);
+  CountingHandler handler;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    if (DecodeProtocolFile(filepath, handler) != ReturnCode::Success) {
+      state.SkipWithError("Failed to decode file.");
+      return;
+    }
+  }
+  state.SetItemsProcessed(handler.num_messages);
+  state.SetBytesProcessed(state.iterations() * FileSize(filepath));
+}
+BENCHMARK_CAPTURE(BM_ProtocolDecodeFile, TOPS, tops_pcap_filename)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_ProtocolDecodeFile, DEEP, deep_pcap_filename)->Unit(benchmark::kMillisecond);
+
+static void BM_PipelinedDecodeFile(benchmark::State& state, const std::string& filename) {
+  const std::string filepath = FindDataFile(filename);
+  int64_t num_messages = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    PipelinedDecoder pipeline;
+    if (!pipeline.OpenFileForDecoding(filepath)) {
+      state.SkipWithError("Failed to open file.");
+      return;
+    }
+    if (pipeline.Run() != ReturnCode::Success) {
+      state.SkipWithError("Pipeline failed.");
+      return;
+    }
+    num_messages += pipeline.GetMessageCount();
+  }
+  state.SetItemsProcessed(num_messages);
+  state.SetBytesProcessed(state.iterations() * FileSize(filepath));
+}
+BENCHMARK_CAPTURE(BM_PipelinedDecodeFile, TOPS, tops_pcap_filename)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_PipelinedDecodeFile, DEEP, deep_pcap_filename)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Decoding with the statistics engine attached, compare with BM_DecodeFile.
+static void BM_MicrostructureStatsFile(benchmark::State& state, const std::string& filename) {
+  const std::string filepath = FindDataFile(filename);
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    MicrostructureStats stats;
+    if (stats.AddFile(filepath) != ReturnCode::Success) {
+      state.SkipWithError("Failed to decode file.");
+      return;
+    }
+    benchmark::DoNotOptimize(stats.GetSummary());
+  }
+  state.SetBytesProcessed(state.iterations() * FileSize(filepath));
+}
+BENCHMARK_CAPTURE(BM_MicrostructureStatsFile, TOPS, tops_pcap_filename)
+    ->Unit(benchmark::kMillisecond);
+
+// The engine alone: quote updates spread over 8000 symbols, without decoding.
+static void BM_MicrostructureQuotes(benchmark::State& state) {
+  constexpr size_t num_symbols = 8000;
+  constexpr size_t num_quotes = 1 << 20;
+  MicrostructureStats stats;
+  std::vector<uint32_t> ids;
+  for (size_t i = 0; i < num_symbols; ++i) {
+    ids.push_back(stats.GetSymbolId("S" + std::to_string(i)));
+  }
+  std::mt19937_64 rng(42);
+  std::vector<uint32_t> quote_ids(num_quotes);
+  std::vector<double> bids(num_quotes);
+  for (size_t i = 0; i < num_quotes; ++i) {
+    quote_ids[i] = ids[rng() % num_symbols];
+    bids[i] = 10 + (rng() % 100) * 0.01;
+  }
+  int64_t timestamp = 1517065200000000000;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    for (size_t i = 0; i < num_quotes; ++i) {
+      timestamp += 1000;
+      stats.OnQuote(quote_ids[i], timestamp, bids[i], bids[i] + 0.01);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_quotes);
+}
+BENCHMARK(BM_MicrostructureQuotes)->Unit(benchmark::kMillisecond);
+
+// The order book alone: order by order flow over 1000 symbols, about 100000 resting orders.
+// Each iteration replays the events from empty books, so the pools are warm after the first.
+static void BM_OrderBookEvents(benchmark::State& state) {
+  constexpr size_t num_symbols = 1000;
+  constexpr size_t num_events = 1 << 20;
+  constexpr size_t max_resting = 100000;
+  struct Event {
+    int op;
+    uint64_t order_id;
+    uint32_t symbol_id;
+    int64_t price;
+    uint32_t size;
+  };
+  std::mt19937_64 rng(42);
+  std::vector<Event> events;
+  std::vector<Event> resting;
+  uint64_t next_order_id = 1;
+  while (events.size() < num_events) {
+    const uint64_t r = rng() % 10;
+    if (resting.size() < max_resting && (r < 4 || resting.empty())) {
+      Event event{0, next_order_id++, static_cast<uint32_t>(rng() % num_symbols),
+                  100000 + static_cast<int64_t>(rng() % 20) * 100,
+                  static_cast<uint32_t>(100 * (1 + rng() % 5))};
+      resting.push_back(event);
+      events.push_back(event);
+      continue;
+    }
+    const size_t idx = rng() % resting.size();
+    Event event = resting[idx];
+    event.op = 1 + static_cast<int>(r % 3);
+    if (event.op == 1) {
+      event.price = 100000 + static_cast<int64_t>(rng() % 20) * 100;
+    } else if (event.op == 2) {
+      event.size = 100;
+    }
+    events.push_back(event);
+    if (event.op == 3 || (event.op == 2 && resting[idx].size <= event.size)) {
+      resting[idx] = resting.back();
+      resting.pop_back();
+    } else {
+      resting[idx] = event;
+    }
+  }
+  OrderBook book(max_resting, num_symbols);
+  for (size_t i = 0; i < num_symbols; ++i) {
+    book.GetSymbolId("S" + std::to_string(i));
+  }
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    for (const Event& event : events) {
+      switch (event.op) {
+        case 0:
+          book.AddOrder(event.order_id, event.symbol_id, OrderBook::Side::Buy, event.price,
+                        event.size);
+          break;
+        case 1:
+          book.ModifyOrder(event.order_id, event.price, event.size, false);
+          break;
+        case 2:
+          book.ExecuteOrder(event.order_id, event.size);
+          break;
+        default:
+          book.DeleteOrder(event.order_id);
+          break;
+      }
+    }
+    benchmark::DoNotOptimize(book.GetNumOrders());
+    for (uint32_t symbol_id = 0; symbol_id < num_symbols; ++symbol_id) {
+      book.ClearBook(symbol_id);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_events);
+}
+BENCHMARK(BM_OrderBookEvents)->Unit(benchmark::kMillisecond);
+
+// Replay of a whole file into a strategy reading the top of book, items are dispatched events.
+struct TopOfBookStrategy : public ReplayStrategy {
+  void OnPriceLevelUpdate(ReplayState& state, const uint32_t id, const PriceLevelUpdateMessage&) {
+    if (id != ReplayState::npos) {
+      sum += state.GetTopOfBook(id).bid_price;
+    }
+  }
+  double sum = 0;
+};
+
+static void BM_ReplayFile(benchmark::State& state, const std::string& filename) {
+  const std::string filepath = FindDataFile(filename);
+  uint64_t num_events = 0;
+  ScopedPerfCounters perf_counters(state);
+  for (auto _ : state) {
+    TopOfBookStrategy strategy;
+    ReplayEngine<TopOfBookStrategy> engine(strategy);
+    if (engine.Run(filepath) != ReturnCode::Success) {
+      state.SkipWithError("Failed to replay file.");
+      return;
+    }
+    benchmark::DoNotOptimize(strategy.sum);
+    num_events += engine.GetNumEvents();
+  }
+  state.SetItemsProcessed(num_events);
+}
+BENCHMARK_CAPTURE(BM_ReplayFile, DEEP, deep_pcap_filename)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "benchmark/benchmark.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/// \class PerfCounters
+/// \brief A minimal perf_event_open wrapper counting hardware events.
+/// \note  Every event is opened on its own, so events the CPU (or a virtual machine) does not
+///        support are simply missing from the results. If the kernel refuses all of them, e.g.
+///        because of /proc/sys/kernel/perf_event_paranoid or a container, nothing is reported.
+///        Only user space is counted, of the calling thread and the threads it starts. When the
+///        kernel multiplexes counters, the counts are scaled by the fraction of time each one was
+///        running.
+class PerfCounters {
+ public:
+  enum Event { Cycles, Instructions, CacheMisses, BranchMisses, L1DMisses, NumEvents };
+
+  typedef std::array<double, NumEvents> Values;
+
+  PerfCounters() {
+    fds_.fill(-1);
+#ifdef __linux__
+    Open(Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    Open(Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    Open(CacheMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    Open(BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    Open(L1DMisses, PERF_TYPE_HW_CACHE,
+         PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (const int fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  /// \brief Whether an event could be opened.
+  inline bool IsAvailable(const Event event) const { return fds_[event] >= 0; }
+
+  /// \brief Whether any event could be opened.
+  bool IsAnyAvailable() const {
+    for (const int fd : fds_) {
+      if (fd >= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// \brief Reset all counts to zero and start counting.
+  void Start() {
+#ifdef __linux__
+    for (const int fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  /// \brief Stop counting and return the counts since Start. Unavailable events are zero.
+  Values Stop() {
+    Values values;
+    values.fill(0.0);
+#ifdef __linux__
+    for (size_t i = 0; i < NumEvents; ++i) {
+      if (fds_[i] >= 0) {
+        ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+    for (size_t i = 0; i < NumEvents; ++i) {
+      // Value, time enabled, time running.
+      uint64_t data[3] = {0, 0, 0};
+      if (fds_[i] < 0 || read(fds_[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+        continue;
+      }
+      values[i] = static_cast<double>(data[0]) * data[1] / data[2];
+    }
+#endif
+    return values;
+  }
+
+ private:
+#ifdef __linux__
+  void Open(const Event event, const uint32_t type, const uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // Also count threads started while counting, e.g. by PipelinedDecoder.
+    attr.inherit = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds_[event] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+#endif
+
+  std::array<int, NumEvents> fds_;
+};
+
+/// \brief The counters shared by all benchmarks, opened on first use.
+inline PerfCounters& GetPerfCounters() {
+  static PerfCounters counters;
+  static bool reported = false;
+  if (!reported && !counters.IsAnyAvailable()) {
+    std::cerr << "Hardware performance counters are not available (check "
+              << "/proc/sys/kernel/perf_event_paranoid), reporting timings only." << std::endl;
+  }
+  reported = true;
+  return counters;
+}
+
+/// \class ScopedPerfCounters
+/// \brief Counts hardware events for the lifetime of the object and adds them to the benchmark
+///        results as per iteration averages: cycles, instructions, IPC, cache misses (last level),
+///        L1 data cache read misses and branch misses.
+/// \note  Construct it directly before the benchmark loop, so setup work is not counted.
+class ScopedPerfCounters {
+ public:
+  explicit ScopedPerfCounters(benchmark::State& state)
+      : state_(state), counters_(GetPerfCounters()) {
+    counters_.Start();
+  }
+
+  ~ScopedPerfCounters() {
+    const PerfCounters::Values values = counters_.Stop();
+    if (state_.iterations() == 0) {
+      return;
+    }
+    AddCounter("cycles", PerfCounters::Cycles, values);
+    AddCounter("instructions", PerfCounters::Instructions, values);
+    AddCounter("cache_misses", PerfCounters::CacheMisses, values);
+    AddCounter("L1d_misses", PerfCounters::L1DMisses, values);
+    AddCounter("branch_misses", PerfCounters::BranchMisses, values);
+    if (counters_.IsAvailable(PerfCounters::Cycles) &&
+        counters_.IsAvailable(PerfCounters::Instructions) && values[PerfCounters::Cycles] > 0) {
+      state_.counters["IPC"] = values[PerfCounters::Instructions] / values[PerfCounters::Cycles];
+    }
+  }
+
+ private:
+  void AddCounter(const std::string& name, const PerfCounters::Event event,
+                  const PerfCounters::Values& values) {
+    if (counters_.IsAvailable(event)) {
+      state_.counters[name] =
+          benchmark::Counter(values[event], benchmark::Counter::kAvgIterations);
+    }
+  }
+
+  benchmark::State& state_;
+  PerfCounters& counters_;
+};
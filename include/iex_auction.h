@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+#include "iex_symbol_table.h"
+
+/// \struct AuctionSeries
+/// \brief Every auction information update, one array per field, in stream order.
+struct AuctionSeries {
+  std::vector<int64_t> timestamps;
+  std::vector<uint32_t> symbol_ids;
+
+  /// \brief AuctionInformationMessage::AuctionType and ImbalanceSide, as their wire bytes.
+  std::vector<uint8_t> auction_types;
+  std::vector<uint8_t> imbalance_sides;
+
+  std::vector<uint32_t> paired_shares;
+  std::vector<uint32_t> imbalance_shares;
+  std::vector<double> reference_prices;
+  std::vector<double> indicative_clearing_prices;
+  std::vector<double> auction_book_clearing_prices;
+  std::vector<double> lower_auction_collars;
+  std::vector<double> upper_auction_collars;
+
+  inline size_t GetSize() const { return timestamps.size(); }
+};
+
+/// \struct AuctionOutcome
+/// \brief The final state of one auction of one symbol, and the official prices it set.
+struct AuctionOutcome {
+  uint32_t symbol_id = 0;
+  AuctionInformationMessage::AuctionType auction_type =
+      AuctionInformationMessage::AuctionType::OpeningAuction;
+
+  /// \brief Number of auction information updates, and the first and last of their timestamps.
+  uint32_t num_updates = 0;
+  int64_t first_timestamp = 0;
+  int64_t last_timestamp = 0;
+
+  /// \brief Fields of the last update.
+  uint32_t scheduled_auction_time = 0;
+  uint32_t paired_shares = 0;
+  uint32_t imbalance_shares = 0;
+  AuctionInformationMessage::ImbalanceSide imbalance_side =
+      AuctionInformationMessage::ImbalanceSide::NoImbalance;
+  double indicative_clearing_price = 0;
+  double auction_book_clearing_price = 0;
+
+  /// \brief Official prices set by this auction, NaN if none. Usually the opening auction sets the
+  ///        opening price and the closing auction the closing price, but a symbol without them
+  ///        opens or closes at the end of the IPO, halt or volatility auction running at the time.
+  double official_opening_price = std::numeric_limits<double>::quiet_NaN();
+  int64_t official_opening_timestamp = 0;
+  double official_closing_price = std::numeric_limits<double>::quiet_NaN();
+  int64_t official_closing_timestamp = 0;
+};
+
+/// \class AuctionTracker
+/// \brief Follows the auctions of every symbol in a single pass: records each auction information
+///        update as a time series, keeps the latest state per symbol and auction type, and joins
+///        official opening and closing prices to the auctions that set them.
+class AuctionTracker {
+ public:
+  /// \brief Update with a decoded message. Only auction information and official price messages
+  ///        are used. Auction information of an unknown auction type is skipped and counted, see
+  ///        GetNumUnknownAuctions.
+  void OnMessage(const IEXMessageBase& msg);
+
+  /// \brief Decode a file and update with all its messages.
+  ///
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode AddFile(const std::string& filename) WARN_UNUSED;
+
+  /// \brief All auction information updates so far.
+  inline const AuctionSeries& GetSeries() const { return series_; }
+
+  /// \brief The outcome of every auction seen, by symbol id and then auction type.
+  std::vector<AuctionOutcome> GetOutcomes() const;
+
+  inline const SymbolTable& GetSymbolTable() const { return symbol_table_; }
+
+  /// \brief Number of auction information updates skipped for an unknown auction type.
+  inline uint64_t GetNumUnknownAuctions() const { return num_unknown_auctions_; }
+
+  /// \brief Write the time series, or the outcomes, as CSV with symbols and enums spelled out.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool WriteSeriesCsv(const std::string& filename) const WARN_UNUSED;
+  bool WriteOutcomesCsv(const std::string& filename) const WARN_UNUSED;
+
+  /// \brief Write the time series as one binary file to memory map: a header (magic "IEXAUC01",
+  ///        uint64 updates, uint64 symbols), the packed symbols by id as uint64, then the columns
+  ///        timestamp (int64), reference_price, indicative_clearing_price,
+  ///        auction_book_clearing_price, lower_auction_collar, upper_auction_collar (double),
+  ///        symbol_id, paired_shares, imbalance_shares (uint32), auction_type and imbalance_side
+  ///        (uint8, as on the wire), each with one element per update.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool WriteSeriesColumns(const std::string& filename) const WARN_UNUSED;
+
+ private:
+  /// \brief Number of auction types, see GetAuctionIndex.
+  constexpr static size_t num_auction_types = 5;
+
+  /// \brief A dense index for an auction type, num_auction_types if the type is unknown.
+  static size_t GetAuctionIndex(const AuctionInformationMessage::AuctionType auction_type);
+
+  /// \brief The outcome of an auction of a symbol, created if it is new.
+  ///
+  /// \param auction_index  Index of the auction type, see GetAuctionIndex. Must be known.
+  AuctionOutcome& GetOutcome(const std::string& symbol, const size_t auction_index);
+
+  void OnAuctionInformation(const AuctionInformationMessage& msg);
+  void OnOfficialPrice(const OfficialPriceMessage& msg);
+
+  SymbolTable symbol_table_;
+  AuctionSeries series_;
+
+  /// \brief Outcomes indexed by symbol id * num_auction_types + auction index. Auctions that never
+  ///        happened have no updates and no official price.
+  std::vector<AuctionOutcome> outcomes_;
+
+  uint64_t num_unknown_auctions_ = 0;
+};
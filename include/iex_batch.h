@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_work_stealing_pool.h"
+
+/// \struct FileChunk
+/// \brief A contiguous range of packets within a single pcap file, the unit of work of the
+///        BatchProcessor.
+/// \note  Chunks start at a record boundary, so the decoder can seek straight to their byte
+///        offset. See IEXDecoder::SeekToOffset.
+struct FileChunk {
+  /// \brief Path of the pcap file.
+  std::string filename;
+
+  /// \brief Size of the whole file in bytes.
+  uint64_t file_size = 0;
+
+  /// \brief Index of the file within the batch.
+  size_t file_index = 0;
+
+  /// \brief Index of this chunk within the file, and the number of chunks the file was split into.
+  size_t chunk_index = 0;
+  size_t num_chunks = 1;
+
+  /// \brief First packet of the chunk, and one past the last packet. The last chunk of a file
+  ///        always extends to the end of the file.
+  uint64_t first_packet = 0;
+  uint64_t end_packet = std::numeric_limits<uint64_t>::max();
+
+  /// \brief Byte offset of the pcap record of first_packet within the file.
+  uint64_t first_offset = 0;
+
+  /// \brief Approximate number of file bytes covered by this chunk, used for progress reporting.
+  uint64_t approx_bytes = 0;
+};
+
+/// \struct BatchProgress
+/// \brief A snapshot of the progress of a batch run.
+/// \note  chunks_total grows during the run, as large files are only split once a worker picks
+///        them up. Use the byte counts for a stable completion fraction.
+struct BatchProgress {
+  size_t files_done = 0;
+  size_t files_total = 0;
+  size_t chunks_done = 0;
+  size_t chunks_total = 0;
+  size_t chunks_failed = 0;
+  uint64_t bytes_done = 0;
+  uint64_t bytes_total = 0;
+  double elapsed_seconds = 0;
+};
+
+/// \struct BatchConfig
+/// \brief Parameters for the BatchProcessor.
+struct BatchConfig {
+  /// \brief Number of worker threads. Zero uses one per hardware thread.
+  size_t num_threads = 0;
+
+  /// \brief Files larger than this are split into chunks of roughly this size.
+  uint64_t chunk_size_bytes = 256ull << 20;
+};
+
+/// \brief List the pcap files given either a directory or a glob pattern.
+///
+/// \param path_or_pattern  A directory (all *.pcap and *.pcapng files within it are returned) or a
+///                         shell glob pattern such as "data/2018*_TOPS*.pcap".
+/// \return The matching files, sorted by name.
+std::vector<std::string> ListPcapFiles(const std::string& path_or_pattern);
+
+/// \brief Get the size of a file in bytes, or zero if it cannot be read.
+uint64_t GetFileSize(const std::string& filename);
+
+/// \brief Split a file into chunks of approximately equal size, cut at the first record at or
+///        after each multiple of the chunk size.
+/// \note  Finding the cuts walks the record headers of the mapped file once, without parsing any
+///        packets. A file that cannot be read is returned as a single chunk.
+std::vector<FileChunk> SplitFileIntoChunks(const std::string& filename, const size_t file_index,
+                                           const BatchConfig& config);
+
+/// \brief Open a chunk for decoding. The decoder is positioned at the first packet of the chunk
+///        and returns EndOfStream after its last packet.
+///
+/// \return ReturnCode enum describing success or a specific error code.
+ReturnCode OpenChunkForDecoding(const FileChunk& chunk, IEXDecoder& decoder) WARN_UNUSED;
+
+/// \class BatchProcessor
+/// \brief Runs a user job over many pcap files on a work stealing thread pool.
+/// \note  Each file is a task. Large files are split into several chunk tasks by the worker that
+///        picks them up, so one big file does not dominate the total run time. Files are queued
+///        smallest first, so with the pool's LIFO scheduling the largest files start first.
+///
+/// \tparam Result  Type returned by the job for each chunk and passed to the merge hook.
+template <typename Result>
+class BatchProcessor {
+ public:
+  /// \brief Job run for every chunk. The decoder is already opened and positioned on the chunk.
+  ///        An exception thrown by the job or the merge hook fails the chunk.
+  typedef std::function<Result(const FileChunk& chunk, IEXDecoder& decoder)> Job;
+
+  /// \brief Called once per finished chunk. Calls are serialized, so no locking is needed.
+  typedef std::function<void(const FileChunk& chunk, Result&& result)> MergeHook;
+
+  /// \brief Called after every finished chunk. Calls are serialized.
+  typedef std::function<void(const BatchProgress& progress)> ProgressHook;
+
+  explicit BatchProcessor(const BatchConfig& config = BatchConfig()) : config_(config) {}
+
+  inline void SetMergeHook(const MergeHook& merge_hook) { merge_hook_ = merge_hook; }
+
+  inline void SetProgressHook(const ProgressHook& progress_hook) { progress_hook_ = progress_hook; }
+
+  /// \brief Run the job over every chunk of every matching file. Blocks until done.
+  ///
+  /// \param path_or_pattern  A directory or a glob pattern, see ListPcapFiles.
+  /// \param job              The job to run for each chunk.
+  /// \return True if every chunk could be opened and run, false otherwise.
+  bool Run(const std::string& path_or_pattern, const Job& job) WARN_UNUSED;
+
+  /// \brief Run the job over every chunk of the given files. Blocks until done.
+  ///
+  /// \return True if every chunk could be opened and run, false otherwise.
+  bool Run(const std::vector<std::string>& filenames, const Job& job) WARN_UNUSED;
+
+ private:
+  /// \brief Split a file and run its chunks, the first one on the calling worker.
+  void RunFile(WorkStealingPool& pool, const std::string& filename, const size_t file_index,
+               const Job& job, std::vector<size_t>& chunks_left);
+
+  /// \brief Open and run a single chunk, then merge its result and report progress.
+  void RunChunk(const FileChunk& chunk, const Job& job, std::vector<size_t>& chunks_left);
+
+  /// \brief Count a chunk as done, and report progress.
+  void FinishChunk(const FileChunk& chunk, const bool failed, std::vector<size_t>& chunks_left);
+
+  BatchConfig config_;
+  MergeHook merge_hook_;
+  ProgressHook progress_hook_;
+
+  /// \brief Guards the progress and serializes the hooks.
+  std::mutex mutex_;
+  BatchProgress progress_;
+  std::chrono::steady_clock::time_point start_time_;
+};
+
+template <typename Result>
+bool BatchProcessor<Result>::Run(const std::string& path_or_pattern, const Job& job) {
+  return Run(ListPcapFiles(path_or_pattern), job);
+}
+
+template <typename Result>
+bool BatchProcessor<Result>::Run(const std::vector<std::string>& filenames, const Job& job) {
+  start_time_ = std::chrono::steady_clock::now();
+  progress_ = BatchProgress();
+  progress_.files_total = filenames.size();
+
+  std::vector<std::pair<uint64_t, size_t>> files_by_size;
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    const uint64_t file_size = GetFileSize(filenames[i]);
+    progress_.bytes_total += file_size;
+    files_by_size.emplace_back(file_size, i);
+  }
+  std::sort(files_by_size.begin(), files_by_size.end());
+
+  WorkStealingPool pool(config_.num_threads);
+  std::vector<size_t> chunks_left(filenames.size(), 0);
+  for (const auto& file : files_by_size) {
+    const size_t file_index = file.second;
+    const std::string& filename = filenames[file_index];
+    pool.Submit([this, &pool, &job, &chunks_left, filename, file_index] {
+      RunFile(pool, filename, file_index, job, chunks_left);
+    });
+  }
+  pool.Wait();
+  return progress_.chunks_failed == 0;
+}
+
+template <typename Result>
+void BatchProcessor<Result>::RunFile(WorkStealingPool& pool, const std::string& filename,
+                                     const size_t file_index, const Job& job,
+                                     std::vector<size_t>& chunks_left) {
+  // Splitting happens on the worker, as finding the record boundaries reads the file.
+  std::vector<FileChunk> chunks;
+  try {
+    chunks = SplitFileIntoChunks(filename, file_index, config_);
+  } catch (const std::exception& e) {
+    IEX_LOG("Failed to split " << filename << ", decoding it as one chunk: " << e.what());
+    chunks.assign(1, FileChunk());
+    chunks[0].filename = filename;
+    chunks[0].file_index = file_index;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    chunks_left[file_index] = chunks.size();
+    progress_.chunks_total += chunks.size();
+  }
+  for (size_t i = 1; i < chunks.size(); ++i) {
+    const FileChunk chunk = chunks[i];
+    pool.Submit([this, &job, &chunks_left, chunk] { RunChunk(chunk, job, chunks_left); });
+  }
+  RunChunk(chunks.front(), job, chunks_left);
+}
+
+template <typename Result>
+void BatchProcessor<Result>::RunChunk(const FileChunk& chunk, const Job& job,
+                                      std::vector<size_t>& chunks_left) {
+  // Exceptions must not escape into the pool, whose workers would terminate.
+  bool failed = true;
+  try {
+    IEXDecoder decoder;
+    const auto ret_code = OpenChunkForDecoding(chunk, decoder);
+    if (ret_code == ReturnCode::Success) {
+      Result result = job(chunk, decoder);
+      if (merge_hook_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        merge_hook_(chunk, std::move(result));
+      }
+      failed = false;
+    } else {
+      IEX_LOG("Failed to open chunk " << chunk.chunk_index << " of " << chunk.filename << ": "
+                                      << ReturnCodeToString(ret_code));
+    }
+  } catch (const std::exception& e) {
+    IEX_LOG("Chunk " << chunk.chunk_index << " of " << chunk.filename << " failed: " << e.what());
+  } catch (...) {
+    IEX_LOG("Chunk " << chunk.chunk_index << " of " << chunk.filename << " failed.");
+  }
+
+  FinishChunk(chunk, failed, chunks_left);
+}
+
+template <typename Result>
+void BatchProcessor<Result>::FinishChunk(const FileChunk& chunk, const bool failed,
+                                         std::vector<size_t>& chunks_left) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (failed) {
+    ++progress_.chunks_failed;
+  }
+  ++progress_.chunks_done;
+  progress_.bytes_done += chunk.approx_bytes;
+  if (--chunks_left[chunk.file_index] == 0) {
+    ++progress_.files_done;
+  }
+  progress_.elapsed_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+  if (progress_hook_) {
+    progress_hook_(progress_);
+  }
+}
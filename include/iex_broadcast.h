@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "iex_broadcast_ring.h"
+#include "iex_decoder.h"
+#include "iex_messages.h"
+
+/// \struct BroadcastConfig
+/// \brief Tuning parameters for the BroadcastDecoder.
+struct BroadcastConfig {
+  /// \brief Number of decoded messages the ring can hold. The producer blocks on the slowest
+  ///        consumer once this many messages are in flight.
+  size_t ring_capacity = 4096;
+
+  /// \brief Number of messages the producer decodes before making them visible to consumers.
+  ///        0 is taken as 1.
+  size_t publish_batch_size = 64;
+
+  /// \brief Core to pin the decoding thread to. A negative value leaves it unpinned.
+  int producer_core = -1;
+};
+
+/// \class BroadcastDecoder
+/// \brief Decodes an IEX pcap file once and fans every message out to several consumers, each
+///        running on its own thread.
+/// \note  Consumers progress independently. The ring between the decoder and the consumers is
+///        bounded, so the slowest consumer determines the overall throughput.
+class BroadcastDecoder {
+ public:
+  typedef std::function<void(const IEXMessageBase&)> Consumer;
+
+  explicit BroadcastDecoder(const BroadcastConfig& config = BroadcastConfig());
+
+  /// \brief Open a file for decoding.
+  ///
+  /// \param filename A string to the relative or full path of the file.
+  /// \return True if succeeds, false otherwise.
+  bool OpenFileForDecoding(const std::string& filename) WARN_UNUSED;
+
+  /// \brief Register a consumer, which will get its own thread.
+  ///
+  /// \param consumer  Callback run on every message, in stream order.
+  /// \param core      Core to pin the consumer thread to. A negative value leaves it unpinned.
+  void AddConsumer(const Consumer& consumer, const int core = -1);
+
+  /// \brief Decode the whole file and wait for all consumers to finish.
+  ///
+  /// \return Success if the whole file was decoded, otherwise the error encountered.
+  ReturnCode Run() WARN_UNUSED;
+
+  /// \brief Get the first header of the file.
+  ///
+  /// \return A struct populated with the header information.
+  inline const IEXTPHeader& GetFirstHeader() { return decoder_.GetFirstHeader(); }
+
+  /// \brief Number of messages decoded by the last Run.
+  inline uint64_t GetMessageCount() const { return message_count_; }
+
+ private:
+  struct ConsumerEntry {
+    Consumer consumer;
+    int core;
+  };
+
+  void ProduceLoop();
+  void ConsumeLoop(const size_t consumer_idx);
+
+  BroadcastConfig config_;
+
+  IEXDecoder decoder_;
+
+  std::vector<ConsumerEntry> consumers_;
+
+  std::unique_ptr<BroadcastRing<std::unique_ptr<IEXMessageBase>>> ring_ptr_;
+
+  /// \brief Set by the producer once its last message has been published.
+  std::atomic<bool> produce_done_{false};
+
+  ReturnCode result_ = ReturnCode::Success;
+
+  uint64_t message_count_ = 0;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/// \class BroadcastRing
+/// \brief A bounded, lock-free ring with one producer and a fixed number of consumers, where every
+///        consumer sees every item (disruptor style).
+/// \note  Items are addressed by a monotonically increasing sequence number. The producer may only
+///        overwrite a slot once all consumers have released it, so the slowest consumer applies
+///        backpressure. Consumers read items in place and never copy them.
+template <typename T>
+class BroadcastRing {
+ public:
+  BroadcastRing(size_t capacity, size_t num_consumers)
+      : capacity_(RoundUpToPowerOfTwo(capacity)),
+        mask_(capacity_ - 1),
+        slots_(new T[capacity_]),
+        num_consumers_(num_consumers),
+        consumer_sequences_(new PaddedSequence[num_consumers]) {}
+
+  BroadcastRing(const BroadcastRing&) = delete;
+  BroadcastRing& operator=(const BroadcastRing&) = delete;
+
+  /// \brief Move an item into the next slot. Producer thread only.
+  /// \note  The item is not visible to consumers until Publish is called. When the ring is full
+  ///        all pending items are published automatically, so the consumers can make progress.
+  ///
+  /// \param item  The item to push. Only moved from if the push succeeds.
+  /// \return True if succeeds, false if the slowest consumer has not yet released the slot.
+  bool TryPush(T&& item) {
+    if (next_ - gating_cache_ == capacity_) {
+      gating_cache_ = MinConsumerSequence();
+      if (next_ - gating_cache_ == capacity_) {
+        Publish();
+        return false;
+      }
+    }
+    slots_[next_ & mask_] = std::move(item);
+    ++next_;
+    return true;
+  }
+
+  /// \brief Make all pushed items visible to the consumers. Producer thread only.
+  void Publish() { cursor_.store(next_, std::memory_order_release); }
+
+  /// \brief Get the sequence number one past the last published item.
+  ///        Items in [Consumed(consumer), Published()) can be read by that consumer.
+  size_t Published() const { return cursor_.load(std::memory_order_acquire); }
+
+  /// \brief Get the sequence number of the next item a consumer has not yet released.
+  size_t Consumed(const size_t consumer) const {
+    return consumer_sequences_[consumer].sequence.load(std::memory_order_relaxed);
+  }
+
+  /// \brief Access a published, unreleased item.
+  const T& Get(const size_t sequence) const { return slots_[sequence & mask_]; }
+
+  /// \brief Release all items before the given sequence number for a consumer.
+  void Release(const size_t consumer, const size_t sequence) {
+    consumer_sequences_[consumer].sequence.store(sequence, std::memory_order_release);
+  }
+
+  /// \brief The maximum number of items the ring can hold.
+  size_t Capacity() const { return capacity_; }
+
+ private:
+  constexpr static size_t cache_line_size = 64;
+
+  /// \brief A sequence number on its own cache line, so consumers do not false share.
+  struct PaddedSequence {
+    std::atomic<size_t> sequence{0};
+    char pad[cache_line_size - sizeof(std::atomic<size_t>)];
+  };
+
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  size_t MinConsumerSequence() const {
+    size_t min_sequence = next_;
+    for (size_t i = 0; i < num_consumers_; ++i) {
+      min_sequence =
+          std::min(min_sequence, consumer_sequences_[i].sequence.load(std::memory_order_acquire));
+    }
+    return min_sequence;
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<T[]> slots_;
+  const size_t num_consumers_;
+  std::unique_ptr<PaddedSequence[]> consumer_sequences_;
+
+  /// \brief Producer side: published cursor, next sequence to write and the cached minimum of the
+  ///        consumer sequences.
+  char pad_0_[cache_line_size];
+  std::atomic<size_t> cursor_{0};
+  char pad_1_[cache_line_size];
+  size_t next_ = 0;
+  size_t gating_cache_ = 0;
+  char pad_2_[cache_line_size];
+};
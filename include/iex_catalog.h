@@ -0,0 +1,174 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "iex_batch.h"
+#include "iex_decoder.h"
+#include "iex_messages.h"
+
+/// \class SymbolBloomFilter
+/// \brief A Bloom filter over 8 byte IEX symbols, answering "may this file contain symbol X".
+/// \note  With the defaults (2^17 bits, 7 hashes, 16KB) the false positive rate stays below 1% up
+///        to about 13000 symbols, more than IEX trades in a day.
+class SymbolBloomFilter {
+ public:
+  /// \param num_bits    Size of the filter, rounded up to a multiple of 64.
+  /// \param num_hashes  Number of bits set per symbol.
+  explicit SymbolBloomFilter(const size_t num_bits = 1 << 17, const int num_hashes = 7);
+
+  /// \brief Add a symbol packed from its wire format, see PackSymbol.
+  void Add(const uint64_t packed_symbol);
+
+  /// \brief Add a symbol given as a string.
+  void Add(const std::string& symbol);
+
+  /// \brief False if the symbol was definitely never added, true if it probably was.
+  bool MayContain(const std::string& symbol) const;
+
+  /// \brief Write the filter to, or read it from, a binary stream.
+  void Save(std::ostream& out_stream) const;
+  bool Load(std::istream& in_stream) WARN_UNUSED;
+
+ private:
+  int num_hashes_;
+  std::vector<uint64_t> bits_;
+};
+
+/// \struct CatalogEntry
+/// \brief Everything the catalog knows about a single pcap file.
+struct CatalogEntry {
+  /// \brief One entry of the sparse time index, covering a fixed number of packets.
+  struct TimeIndexEntry {
+    /// \brief First packet covered by this entry.
+    uint64_t first_packet = 0;
+
+    /// \brief Byte offset of the pcap record of first_packet within the file.
+    uint64_t byte_offset = 0;
+
+    /// \brief Range of message timestamps in the covered packets. min > max if there are none.
+    int64_t min_timestamp = std::numeric_limits<int64_t>::max();
+    int64_t max_timestamp = std::numeric_limits<int64_t>::min();
+  };
+
+  std::string filename;
+  uint64_t file_size = 0;
+
+  /// \brief Transport identifiers from the first header. See ProtocolId.
+  uint16_t protocol_id = 0;
+  uint32_t channel_id = 0;
+  uint32_t session_id = 0;
+
+  /// \brief Range of message timestamps, nanoseconds since POSIX time UTC.
+  int64_t first_timestamp = std::numeric_limits<int64_t>::max();
+  int64_t last_timestamp = std::numeric_limits<int64_t>::min();
+
+  uint64_t num_packets = 0;
+  uint64_t num_messages = 0;
+
+  /// \brief Number of messages, indexed by message type byte.
+  std::array<uint64_t, 256> messages_by_type{};
+
+  /// \brief The symbols appearing in any message of the file.
+  SymbolBloomFilter symbols;
+
+  /// \brief Sparse index from packet ranges to time ranges, in packet order.
+  std::vector<TimeIndexEntry> time_index;
+};
+
+/// \struct CatalogConfig
+/// \brief Parameters for building a DatasetCatalog.
+struct CatalogConfig {
+  /// \brief Number of files scanned in parallel. Zero uses one thread per hardware thread.
+  size_t num_threads = 0;
+
+  /// \brief Number of packets per time index entry. Smaller is more precise but larger.
+  uint64_t index_interval_packets = 4096;
+
+  /// \brief Size of the per file symbol filter, see SymbolBloomFilter.
+  size_t bloom_filter_bits = 1 << 17;
+  int bloom_filter_hashes = 7;
+};
+
+/// \struct CatalogQuery
+/// \brief Selects the parts of the dataset a job needs. Empty fields match everything.
+struct CatalogQuery {
+  /// \brief Only files that contain this symbol.
+  std::string symbol;
+
+  /// \brief Only packets with messages in [start_time, end_time], nanoseconds since POSIX time UTC.
+  int64_t start_time = std::numeric_limits<int64_t>::min();
+  int64_t end_time = std::numeric_limits<int64_t>::max();
+
+  /// \brief Only files of this protocol. Zero matches any.
+  uint16_t protocol_id = 0;
+};
+
+/// \class DatasetCatalog
+/// \brief An index over a collection of IEX pcap files, built by scanning each file once, that
+///        answers which files, and which packet ranges within them, a query needs.
+/// \note  Files are scanned in parallel on a WorkStealingPool. The scan reads message blocks
+///        directly, without decoding messages. Query results are FileChunks, so they can be passed
+///        straight to OpenChunkForDecoding or a BatchProcessor job.
+class DatasetCatalog {
+ public:
+  explicit DatasetCatalog(const CatalogConfig& config = CatalogConfig()) : config_(config) {}
+
+  /// \brief Scan all matching files and replace the catalog contents.
+  ///
+  /// \param path_or_pattern  A directory or a glob pattern, see ListPcapFiles.
+  /// \return True if every file could be scanned, false otherwise. Files that could not be scanned
+  ///         are left out of the catalog.
+  bool Build(const std::string& path_or_pattern) WARN_UNUSED;
+
+  /// \brief Scan the given files and replace the catalog contents.
+  ///
+  /// \return True if every file could be scanned, false otherwise.
+  bool Build(const std::vector<std::string>& filenames) WARN_UNUSED;
+
+  /// \brief Scan a single file.
+  ///
+  /// \param filename  Path of the pcap file.
+  /// \param entry     Output parameter, the catalog entry of the file.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode ScanFile(const std::string& filename, CatalogEntry& entry) const WARN_UNUSED;
+
+  /// \brief Find the parts of the dataset matching a query.
+  /// \note  Symbol matches are probabilistic (see SymbolBloomFilter): a returned file may not
+  ///        contain the symbol after all, but no file containing it is missed. Packet ranges are
+  ///        at the resolution of the time index.
+  ///
+  /// \return One chunk per contiguous matching packet range, in file and packet order. The
+  ///         file_index of a chunk is the index of its entry in GetEntries.
+  std::vector<FileChunk> Query(const CatalogQuery& query) const;
+
+  /// \brief Move a decoder to the first time index entry of its file that may hold messages at
+  ///        or after start_time, so the packets before it are never read. Combine it with a
+  ///        MessageFilter starting at start_time to skip the rest of the way.
+  /// \note  The decoder is left where it is if its file is not in the catalog, has changed size
+  ///        since it was scanned, or is already past the entry.
+  ///
+  /// \param decoder     A decoder opened with OpenFileForDecoding.
+  /// \param start_time  Nanoseconds since POSIX time UTC.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode SeekToTime(IEXDecoder& decoder, const int64_t start_time) const WARN_UNUSED;
+
+  /// \brief Get the entry of a file, null if it is not in the catalog.
+  const CatalogEntry* FindEntry(const std::string& filename) const;
+
+  /// \brief Write the catalog to, or read it from, a binary file.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool Save(const std::string& filename) const WARN_UNUSED;
+  bool Load(const std::string& filename) WARN_UNUSED;
+
+  inline const std::vector<CatalogEntry>& GetEntries() const { return entries_; }
+
+ private:
+  CatalogConfig config_;
+  std::vector<CatalogEntry> entries_;
+};
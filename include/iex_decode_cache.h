@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_mapped_file.h"
+#include "iex_message_table.h"
+#include "iex_messages.h"
+
+/// \struct PcapFingerprint
+/// \brief Identifies the content of a pcap file cheaply, without reading all of it.
+/// \note  The hash covers the first and last 64KB of the file, which hold the first and last
+///        packet headers, and evenly spaced samples in between.
+struct PcapFingerprint {
+  uint64_t file_size = 0;
+  uint64_t sampled_hash = 0;
+
+  /// \brief The decoder version the cached output was produced with, see IEXDecoder::version.
+  uint32_t decoder_version = IEXDecoder::version;
+
+  /// \brief Compute the fingerprint of a file.
+  ///
+  /// \return True if succeeds, false if the file cannot be read.
+  bool Compute(const std::string& filename) WARN_UNUSED;
+
+  /// \brief A file name safe hexadecimal representation.
+  std::string ToString() const;
+
+  inline bool operator==(const PcapFingerprint& other) const {
+    return file_size == other.file_size && sampled_hash == other.sampled_hash &&
+           decoder_version == other.decoder_version;
+  }
+};
+
+/// \class MappedTable
+/// \brief The messages of one type as columns, laid out like a MessageTable, mapped from a cache
+///        file.
+class MappedTable {
+ public:
+  inline const MessageSchema& GetSchema() const { return *schema_; }
+  inline size_t GetNumRows() const { return num_rows_; }
+
+  /// \brief The column of the i-th field of the schema, GetNumRows() elements of its size.
+  inline const uint8_t* GetColumn(const size_t i) const { return columns_[i]; }
+
+ private:
+  friend class DecodedColumns;
+
+  const MessageSchema* schema_ = nullptr;
+  size_t num_rows_ = 0;
+  std::vector<const uint8_t*> columns_;
+};
+
+/// \class DecodedColumns
+/// \brief The decoded messages of a pcap file in columnar form, memory mapped from a cache file.
+/// \note  A hit saves reading the pcap, parsing its layers and splitting packets into messages.
+///        The type, timestamp, symbol and capture time of every message, and every field of the
+///        types with a schema (see GetMessageSchema), are stored decoded, so scans over them
+///        never decode. Message structs are not stored: GetNextMessage still runs the message
+///        factory and Decode on the stored wire bytes, while GetNextMessageData hands out the
+///        bytes alone, as IEXDecoder does.
+class DecodedColumns {
+ public:
+  /// \brief Row of messages without a table, see GetRows.
+  constexpr static uint32_t no_row = 0xffffffff;
+
+  /// \brief Map a cache file, and reset the read position and filter.
+  ///
+  /// \return True if succeeds, false if the file cannot be read or is not a cache file.
+  bool Open(const std::string& filename) WARN_UNUSED;
+
+  /// \brief Fingerprint of the pcap file the columns were decoded from.
+  inline const PcapFingerprint& GetFingerprint() const { return fingerprint_; }
+
+  /// \brief Number of messages, the length of every column.
+  inline size_t GetMessageCount() const { return num_messages_; }
+
+  /// \brief Message type bytes, see MessageType.
+  inline const uint8_t* GetTypes() const { return types_; }
+
+  /// \brief Message timestamps, nanoseconds since POSIX time UTC.
+  inline const int64_t* GetTimestamps() const { return timestamps_; }
+
+  /// \brief Packed symbols, see PackSymbol. Messages without a symbol have the packed empty
+  ///        string.
+  inline const uint64_t* GetSymbols() const { return symbols_; }
+
+  /// \brief Capture times of the packets the messages came from, nanoseconds since POSIX time UTC.
+  inline const int64_t* GetCaptureTimes() const { return capture_times_; }
+
+  /// \brief Row of each message within the table of its type, or no_row.
+  inline const uint32_t* GetRows() const { return rows_; }
+
+  /// \brief Get the table of a type, or nullptr if the type has no schema or no messages.
+  inline const MappedTable* GetTable(const MessageType type) const {
+    const uint16_t index = table_index_[static_cast<uint8_t>(type)];
+    return index > 0 ? &tables_[index - 1] : nullptr;
+  }
+
+  /// \brief Decode a single message.
+  ///
+  /// \param msg_index  Index of the message, below GetMessageCount.
+  /// \param msg_ptr    Output parameter, containing the message if successfully decoded.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode DecodeMessage(const size_t msg_index, std::unique_ptr<IEXMessageBase>& msg_ptr) const;
+
+  /// \brief Get the next message passing the filter, in stream order.
+  ///
+  /// \param msg_ptr  Output parameter, containing the message if successfully decoded.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode GetNextMessage(std::unique_ptr<IEXMessageBase>& msg_ptr);
+
+  /// \brief Get the wire data of the next message passing the filter, without decoding it.
+  ///
+  /// \param msg_data_ptr  Output parameter, the message data, valid while the file is open.
+  /// \param msg_len       Output parameter, the length of the message data.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode GetNextMessageData(const uint8_t*& msg_data_ptr, size_t& msg_len);
+
+  /// \brief Only return messages passing a filter, as IEXDecoder::SetFilter.
+  void SetFilter(const MessageFilter& filter);
+
+  /// \brief Get the pcap capture time of the packet the last message came from.
+  inline int64_t GetLastCaptureTime() const {
+    return next_message_ ? capture_times_[next_message_ - 1] : 0;
+  }
+
+ private:
+  /// \brief Advance to the next message passing the filter.
+  ///
+  /// \return The index of the message, or GetMessageCount at the end.
+  size_t FindNextMessage();
+
+  MappedFile file_;
+  PcapFingerprint fingerprint_;
+  size_t num_messages_ = 0;
+  size_t next_message_ = 0;
+
+  MessageFilter filter_;
+  bool filter_active_ = false;
+
+  const uint8_t* types_ = nullptr;
+  const int64_t* timestamps_ = nullptr;
+  const uint64_t* symbols_ = nullptr;
+  const int64_t* capture_times_ = nullptr;
+  const uint32_t* rows_ = nullptr;
+
+  /// \brief Start of each message within the message data, with one extra entry for the end.
+  const uint64_t* msg_offsets_ = nullptr;
+  const uint8_t* msg_data_ = nullptr;
+
+  /// \brief Index into tables_ plus one by type byte, zero for types without a table.
+  uint16_t table_index_[256] = {};
+  std::vector<MappedTable> tables_;
+};
+
+/// \struct DecodeCacheConfig
+/// \brief Parameters for the DecodeCache.
+struct DecodeCacheConfig {
+  /// \brief Directory holding the cache files. Must exist.
+  std::string directory = ".";
+
+  /// \brief Total size of the cache files. The least recently used files are removed to stay
+  ///        below it.
+  uint64_t max_bytes = 16ull << 30;
+};
+
+/// \class DecodeCache
+/// \brief An on-disk cache of decoded pcap files, keyed by the fingerprint of their content.
+/// \note  Cache files are written under a temporary name and renamed, so several processes can
+///        share a cache directory. The modification time of a file records its last use, for
+///        least recently used eviction.
+class DecodeCache {
+ public:
+  explicit DecodeCache(const DecodeCacheConfig& config) : config_(config) {}
+
+  /// \brief Get the decoded columns of a pcap file, decoding the file and caching the result if
+  ///        it is not in the cache yet.
+  ///
+  /// \param pcap_filename  Path of the pcap file.
+  /// \param columns        Output parameter, the decoded columns.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode Open(const std::string& pcap_filename, DecodedColumns& columns) WARN_UNUSED;
+
+  /// \brief Decode a pcap file into a cache file, regardless of the cache contents.
+  ///
+  /// \return ReturnCode enum describing success or a specific error code.
+  static ReturnCode Build(const std::string& pcap_filename, const PcapFingerprint& fingerprint,
+                          const std::string& cache_filename) WARN_UNUSED;
+
+  /// \brief Remove the least recently used files until the cache fits its budget.
+  ///
+  /// \param keep_filename  A file that is never removed, e.g. the one just added.
+  void Evict(const std::string& keep_filename = "");
+
+  /// \brief Total size of the files in the cache.
+  uint64_t GetSize() const;
+
+  inline uint64_t GetHitCount() const { return num_hits_; }
+  inline uint64_t GetMissCount() const { return num_misses_; }
+
+ private:
+  std::string GetCacheFilename(const PcapFingerprint& fingerprint) const;
+
+  DecodeCacheConfig config_;
+  uint64_t num_hits_ = 0;
+  uint64_t num_misses_ = 0;
+};
@@ -1,10 +1,16 @@
 #pragma once
 
 #include "Packet.h"
-#include "PcapFileDevice.h"
+#include "RawPacket.h"
 
+#include <algorithm>
+#include <bitset>
+#include <limits>
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "iex_decoder_stats.h"
 #include "iex_messages.h"
 
 /// \enum class ReturnCode
@@ -37,23 +43,96 @@ inline std::string ReturnCodeToString(const ReturnCode & code) {
   }
 }
 
+/// \struct MessageFilter
+/// \brief Selects messages by type, symbol and timestamp, looking only at the raw message data.
+///        IEXDecoder applies it before decoding, so messages that do not match are never decoded.
+struct MessageFilter {
+  MessageFilter() { types.set(); }
+
+  /// \brief Accept only the given message types.
+  void SetTypes(const std::vector<MessageType>& message_types);
+
+  /// \brief Accept only messages of the given symbols. Messages without a symbol, like system
+  ///        events, no longer match. An empty list accepts any symbol again.
+  void SetSymbols(const std::vector<std::string>& symbol_list);
+
+  /// \brief True if the filter accepts every message.
+  bool AcceptsAll() const;
+
+  /// \brief True if a message, given as raw message data, passes the filter.
+  inline bool Matches(const uint8_t* msg_data_ptr, const size_t msg_len) const {
+    if (msg_len < 1 || !types.test(msg_data_ptr[0])) {
+      return false;
+    }
+    if (!symbols.empty()) {
+      uint64_t packed_symbol = 0;
+      if (!GetPackedSymbol(msg_data_ptr, msg_len, packed_symbol) ||
+          !std::binary_search(symbols.begin(), symbols.end(), packed_symbol)) {
+        return false;
+      }
+    }
+    if (start_time != std::numeric_limits<int64_t>::min() ||
+        end_time != std::numeric_limits<int64_t>::max()) {
+      // Every message has its timestamp at the same offset.
+      if (msg_len < timestamp_offset + sizeof(int64_t)) {
+        return false;
+      }
+      const int64_t timestamp = GetNumeric<int64_t>(msg_data_ptr, timestamp_offset);
+      return timestamp >= start_time && timestamp <= end_time;
+    }
+    return true;
+  }
+
+  /// \brief True if no message of a packet sent at send_time can match. Messages are never
+  ///        timestamped after the packet carrying them was sent.
+  inline bool IsBeforeStart(const int64_t send_time) const { return send_time < start_time; }
+
+  /// \brief True if no message of a packet sent at send_time, or of any later packet, is expected
+  ///        to match, allowing for max_publication_delay.
+  inline bool IsPastEnd(const int64_t send_time) const {
+    return end_time < std::numeric_limits<int64_t>::max() - max_publication_delay &&
+           send_time > end_time + max_publication_delay;
+  }
+
+  /// \brief Offset of the timestamp within the message data.
+  constexpr static int timestamp_offset = 2;
+
+  /// \brief Accepted message types, indexed by message type byte. All are set by default.
+  std::bitset<256> types;
+
+  /// \brief Accepted symbols, packed and sorted, see PackSymbol. Empty accepts any symbol.
+  std::vector<uint64_t> symbols;
+
+  /// \brief Accepted message timestamps, inclusive, nanoseconds since POSIX time UTC.
+  int64_t start_time = std::numeric_limits<int64_t>::min();
+  int64_t end_time = std::numeric_limits<int64_t>::max();
+
+  /// \brief How long after its timestamp a message may still be sent. Once packets are sent later
+  ///        than end_time plus this delay, decoding stops. In recorded data messages were sent up
+  ///        to about 1.2s after their timestamp.
+  int64_t max_publication_delay = 10000000000;
+};
+
+class PcapRecordReader;
+struct PcapRecord;
+
 /// \class IEXDecoder
 /// \brief A class for reading and decoding an IEX file stream.
 /// \note  All technical information for this implementation was taken from
 ///        https://iextrading.com/trading/market-data/
 ///        Use this resource for further information.
 class IEXDecoder {
+ public:
   /// @brief Each packet starts with a header block. This variable describes the length.
   constexpr static size_t first_block_start = 40;
 
- public:
-  IEXDecoder() = default;
+  /// \brief Version of the decoded output. Bump it with any change that alters decoded messages,
+  ///        so cached results (see DecodeCache) are rebuilt.
+  constexpr static uint32_t version = 2;
 
-  virtual ~IEXDecoder() {
-    if (reader_ptr_) {
-      reader_ptr_->close();
-    };
-  }
+  IEXDecoder();
+
+  virtual ~IEXDecoder();
 
   /// \brief Open a file for decoding.
   ///
@@ -61,36 +140,185 @@ class IEXDecoder {
   /// \return True if succeeds, false otherwise.
   bool OpenFileForDecoding(const std::string& filename) WARN_UNUSED;
 
+  /// \brief Open a file for raw packet reading only.
+  /// \note  Unlike OpenFileForDecoding, the first packet is not consumed. Use this together with
+  ///        ReadNextPacket when packets are parsed elsewhere (e.g. on another thread).
+  ///
+  /// \param filename A string to the relative or full path of the file.
+  /// \return True if succeeds, false otherwise.
+  bool OpenFileForReading(const std::string& filename) WARN_UNUSED;
+
+  /// \brief Read the next raw pcap record from the file without parsing any of its layers.
+  ///
+  /// \param raw_packet  Output parameter, containing the raw packet data and capture time. It
+  ///                    takes ownership of a copy of the data, as with the pcpp readers, so it
+  ///                    must not have been constructed with deleteRawDataAtDestructor unset.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode ReadNextPacket(pcpp::RawPacket& raw_packet) WARN_UNUSED;
+
+  /// \brief Extract the IEX-TP payload (header followed by message blocks) from a packet.
+  ///
+  /// \param packet       A parsed packet. The payload points into its raw data.
+  /// \param payload_ptr  Output parameter, pointing to the start of the IEX-TP header.
+  /// \param payload_len  Output parameter, the length of the IEX-TP payload.
+  /// \return ReturnCode enum describing success or a specific error code.
+  static ReturnCode ExtractPayload(const pcpp::Packet& packet, const uint8_t*& payload_ptr,
+                                   size_t& payload_len) WARN_UNUSED;
+
+  /// \brief Find the UDP payload of a raw frame without parsing its layers through pcpp, for
+  ///        callers that cannot afford the allocations of a pcpp::Packet.
+  ///
+  /// \param data_ptr     The raw frame, as captured.
+  /// \param payload_ptr  Output parameter, pointing to the start of the UDP payload.
+  /// \param payload_len  Output parameter, the UDP length less its header, cut at the end of the
+  ///                     captured data.
+  /// \return True if the frame is a plain Ethernet, IPv4 and UDP frame, false otherwise.
+  static bool FindUdpPayload(const uint8_t* data_ptr, const size_t data_len,
+                             const pcpp::LinkLayerType link_type, const uint8_t*& payload_ptr,
+                             size_t& payload_len);
+
+  /// \brief Given a pointer pointing to the start of a block, return the length of the block.
+  ///
+  /// \return The block length, not including the two bytes of the length field itself.
+  static inline uint16_t GetBlockSize(const uint8_t* data_ptr) {
+    return *(reinterpret_cast<const uint16_t*>(data_ptr));
+  }
+
+  /// \brief Given a pointer pointing to the start of a block, return a pointer pointing to the
+  ///        start of the message data.
+  ///
+  /// \return A pointer pointing to the start of the message data.
+  static inline const uint8_t* GetBlockData(const uint8_t* data_ptr) { return data_ptr + 2; }
+
+  /// \brief Step through the message blocks of a payload without decoding them.
+  ///
+  /// \param payload_ptr   Pointer to the IEX-TP payload, see ExtractPayload.
+  /// \param payload_len   Length of the payload.
+  /// \param block_offset  In and output parameter, the offset of the next block. Start at
+  ///                      first_block_start.
+  /// \param msg_data_ptr  Output parameter, pointing to the start of the message data.
+  /// \param msg_len       Output parameter, the length of the message data.
+  /// \return True if a complete block was found, false at the end of the payload.
+  static inline bool GetNextBlock(const uint8_t* payload_ptr, const size_t payload_len,
+                                  size_t& block_offset, const uint8_t*& msg_data_ptr,
+                                  size_t& msg_len) {
+    if (block_offset + 2 > payload_len) {
+      return false;
+    }
+    const uint8_t* block_ptr = payload_ptr + block_offset;
+    msg_len = GetBlockSize(block_ptr);
+    msg_data_ptr = GetBlockData(block_ptr);
+    block_offset += msg_len + 2;
+    return block_offset <= payload_len;
+  }
+
   /// \brief Get the next message from the stream.
   ///
   /// \param msg_ptr  Output parameter, containing the message if successfully decoded.
   /// \return ReturnCode enum describing success or a specific error code.
   ReturnCode GetNextMessage(std::unique_ptr<IEXMessageBase>& msg_ptr);
 
+  /// \brief Get the raw data of the next message from the stream, without decoding it. The same
+  ///        messages as GetNextMessage, for callers that decode into their own message structs.
+  ///
+  /// \param msg_data_ptr  Output parameter, the message data. Valid until the next call.
+  /// \param msg_len       Output parameter, the length of the message data.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode GetNextMessageData(const uint8_t*& msg_data_ptr, size_t& msg_len);
+
+  /// \brief Move the decoder to the start of a packet, given its index within the file.
+  /// \note  Packet offsets are not known up front. Seeking forwards skips raw records without
+  ///        parsing them, seeking backwards reopens the file first. Prefer SeekToOffset where the
+  ///        byte offset is known, e.g. from a FileChunk.
+  ///
+  /// \param packet_index  Zero based index of the pcap record, counting the first header packet.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode SeekToPacket(const uint64_t packet_index) WARN_UNUSED;
+
+  /// \brief Move the decoder straight to the start of a packet, given the byte offset of its pcap
+  ///        record, see PcapRecord::offset. Nothing before it is read.
+  /// \note  For pcapng files, the interface descriptions must have been read before, as
+  ///        OpenFileForDecoding does.
+  ///
+  /// \param record_offset  Byte offset of the pcap record within the file.
+  /// \param packet_index   Zero based index of that packet, GetPacketIndex and SetPacketLimit
+  ///                       count on from it.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode SeekToOffset(const uint64_t record_offset, const uint64_t packet_index) WARN_UNUSED;
+
+  /// \brief Stop decoding at a given packet. Once all messages of the packets before this index
+  ///        have been returned, GetNextMessage returns EndOfStream.
+  ///
+  /// \param end_packet_index  Zero based index of the first packet not to decode.
+  inline void SetPacketLimit(const uint64_t end_packet_index) {
+    end_packet_index_ = end_packet_index;
+  }
+
+  /// \brief Only return messages that pass a filter. The filter is applied to the raw message
+  ///        data before decoding. With a time range, packets sent before the start are skipped
+  ///        without parsing them, and decoding ends once packets are sent well past the end.
+  ///        Opening a file clears the filter.
+  /// \note  Skipping still reads every packet before the start. With a DatasetCatalog of the
+  ///        file, DatasetCatalog::SeekToTime jumps close to the start first.
+  ///
+  /// \param filter  The filter, a default constructed MessageFilter returns all messages again.
+  void SetFilter(const MessageFilter& filter);
+
+  /// \brief Get the index of the next packet that will be read from the file.
+  inline uint64_t GetPacketIndex() const { return packet_index_; }
+
+  /// \brief Get the path of the opened file.
+  inline const std::string& GetFilename() const { return filename_; }
+
+  /// \brief Get the pcap capture time of the packet the last decoded message came from.
+  ///
+  /// \return Nanoseconds since POSIX time UTC, as recorded by the capturing host.
+  inline int64_t GetLastCaptureTime() const { return last_capture_time_; }
+
+  /// \brief Get a snapshot of the decoder statistics: packet, block and message counters and the
+  ///        cycles spent in each stage. Safe to call from any thread at any time.
+  /// \note  Only collected when built with IEX_ENABLE_STATS, otherwise all counters are zero. The
+  ///        counters are kept for the lifetime of the decoder, across files, until ResetStats.
+  DecoderStats GetStats() const;
+
+  /// \brief Set all statistics counters to zero. Call from the decoding thread only.
+  void ResetStats();
+
+  /// \brief Set a hook that is called with a snapshot of the statistics, e.g. to log them.
+  /// \note  The hook runs on the decoding thread, every packet_interval packets read. Without
+  ///        IEX_ENABLE_STATS the hook is never called.
+  ///
+  /// \param hook             The hook, or an empty function to remove it.
+  /// \param packet_interval  Number of packets between two calls.
+  void SetStatsHook(const DecoderStatsHook& hook, const uint64_t packet_interval);
+
   /// \brief Get the first header from the current packet.
   ///
   /// \return A struct populated with the header information.
-  inline const IEXTPHeader& GetFirstHeader() { return first_header_; }
+  inline const IEXTPHeader& GetFirstHeader() const { return first_header_; }
 
   /// \brief Get the last decoded header from the current packet.
   ///
   /// \return A struct populated with the header information.
-  inline const IEXTPHeader& GetLastDecodedHeader() { return last_decoded_header_; }
+  inline const IEXTPHeader& GetLastDecodedHeader() const { return last_decoded_header_; }
 
  private:
   /// \brief Get the last decoded header from the current packet.
   ///
   /// \return A struct populated with the header information.
   ReturnCode ParseNextPacket(IEXTPHeader& header) WARN_UNUSED;
-  inline uint16_t GetBlockSize(const uint8_t* data_ptr) {
-    return *(reinterpret_cast<const uint16_t*>(data_ptr));
-  }
 
-  /// \brief Given a pointer pointing to the start of a block, return a pointer pointing to the
-  ///        start of the message data.
+  /// \brief Read the next pcap record, counting it. Its data is valid until the next read.
+  ReturnCode ReadNextRecord(PcapRecord& record) WARN_UNUSED;
+
+  /// \brief Read the send time of a packet from its raw data, without parsing its layers.
   ///
-  /// \return A pointer pointing to the start of the message data.
-  inline const uint8_t* GetBlockData(const uint8_t* data_ptr) { return data_ptr + 2; }
+  /// \return True if the packet is a plain Ethernet, IPv4 and UDP frame, false otherwise.
+  static bool PeekSendTime(const PcapRecord& record, int64_t& send_time);
+
+  /// \brief Messages to return, see SetFilter.
+  MessageFilter filter_;
+  bool filter_active_ = false;
 
   /// \brief Contains the first header of the current packet being decoded.
   IEXTPHeader first_header_;
@@ -98,14 +326,24 @@ class IEXDecoder {
   /// \brief Contains the last header decoded of the current packet.
   IEXTPHeader last_decoded_header_;
 
+  /// \brief The file currently open, needed to reopen it when seeking backwards.
+  std::string filename_;
+
+  /// \brief Number of pcap records read from the file so far.
+  uint64_t packet_index_ = 0;
+
+  /// \brief Index of the first packet that should not be decoded.
+  uint64_t end_packet_index_ = std::numeric_limits<uint64_t>::max();
+
   /// \brief A pointer of the pcap file reader object.
-  std::unique_ptr<pcpp::IFileReaderDevice> reader_ptr_;
+  std::unique_ptr<PcapRecordReader> reader_ptr_;
 
-  /// \brief The pcpp::Packet needs to stay in context, otherwise the packet memory is deallocated.
+  /// \brief Frames other than plain Ethernet, IPv4 and UDP are parsed by pcpp. The pcpp::Packet
+  ///        needs to stay in context, otherwise the packet memory is deallocated.
   pcpp::Packet parsed_packet_;
 
-  /// \brief A pointer to the start of the current packet. If this is null then there is no packet
-  ///        currently being decoded.
+  /// \brief A pointer to the start of the current packet, in the buffer of the reader or in
+  ///        parsed_packet_. If this is null then there is no packet currently being decoded.
   const uint8_t* packet_ptr_;
 
   /// \brief An offset used to move the message pointer forward through the data.
@@ -113,4 +351,20 @@ class IEXDecoder {
 
   /// \brief Length of the currently open packet.
   size_t packet_len_ = 0;
+
+  /// \brief Capture time of the currently open packet, nanoseconds since POSIX time UTC.
+  int64_t last_capture_time_ = 0;
+
+#ifdef IEX_ENABLE_STATS
+  /// \brief Call the stats hook if packet_interval packets were read since the last call.
+  void MaybeRunStatsHook();
+
+  /// \brief Live statistics counters, see GetStats.
+  DecoderCounters stats_;
+
+  /// \brief The periodic stats hook, its interval and the packets read since it last ran.
+  DecoderStatsHook stats_hook_;
+  uint64_t stats_hook_interval_ = 0;
+  uint64_t packets_since_stats_hook_ = 0;
+#endif
 };
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Instrumentation of IEXDecoder is only compiled in when IEX_ENABLE_STATS is defined (CMake option
+// of the same name). The definition changes the layout of IEXDecoder, so it must be the same for
+// the library and everything including iex_decoder.h. When it is not defined, statements wrapped
+// in IEX_STATS disappear entirely.
+#ifdef IEX_ENABLE_STATS
+#define IEX_STATS(...) __VA_ARGS__
+#else
+#define IEX_STATS(...)
+#endif
+
+/// \brief Read the CPU cycle counter (the TSC on x86). Falls back to a nanosecond clock on other
+///        architectures.
+inline uint64_t ReadCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/// \enum DecoderStage
+/// \brief The timed stages of IEXDecoder, in the order a message passes through them.
+enum class DecoderStage {
+  PacketRead,     // Reading the pcap record from the file.
+  LayerParse,     // Parsing the Ethernet/IP/UDP layers down to the IEX-TP payload.
+  HeaderDecode,   // Decoding the IEX-TP header.
+  Factory,        // Allocating the message struct for the block.
+  MessageDecode,  // The Decode of the message struct.
+  NumStages
+};
+
+constexpr size_t num_decoder_stages = static_cast<size_t>(DecoderStage::NumStages);
+
+/// \brief Get the stage name as a string.
+std::string DecoderStageToString(const DecoderStage stage);
+
+/// \struct DecoderStats
+/// \brief A snapshot of the counters of an IEXDecoder.
+/// \note  Cycles are in units of ReadCycleCounter, which on x86 ticks at a constant rate close to
+///        the nominal CPU frequency.
+struct DecoderStats {
+  /// \brief Number of pcap records read, and their total length in bytes.
+  uint64_t packets = 0;
+  uint64_t bytes = 0;
+
+  /// \brief Number of packets without messages.
+  uint64_t heartbeats = 0;
+
+  /// \brief Number of message blocks taken from packets.
+  uint64_t blocks = 0;
+
+  /// \brief Number of successfully decoded messages, indexed by message type byte.
+  std::array<uint64_t, 256> messages_by_type{};
+
+  /// \brief Cycles spent in each stage, indexed by DecoderStage.
+  std::array<uint64_t, num_decoder_stages> stage_cycles{};
+
+  /// \brief Total number of successfully decoded messages.
+  uint64_t GetMessageCount() const;
+
+  /// \brief Total number of cycles over all stages.
+  uint64_t GetTotalCycles() const;
+
+  /// \brief Print contents of the stats to standard output.
+  void Print() const;
+};
+
+/// \brief Called with a snapshot of the stats, see IEXDecoder::SetStatsHook.
+typedef std::function<void(const DecoderStats& stats)> DecoderStatsHook;
+
+/// \class DecoderCounters
+/// \brief The live counters behind DecoderStats.
+/// \note  The counters have a single writer, the decoding thread, so they are updated with relaxed
+///        loads and stores rather than atomic read-modify-write instructions. Any other thread may
+///        take a Snapshot at any time; it sees each counter at some recent value.
+class DecoderCounters {
+ public:
+  inline void AddPacket(const uint64_t num_bytes) {
+    Increment(packets_, 1);
+    Increment(bytes_, num_bytes);
+  }
+
+  inline void AddHeartbeat() { Increment(heartbeats_, 1); }
+
+  inline void AddBlock() { Increment(blocks_, 1); }
+
+  inline void AddMessage(const uint8_t msg_type) { Increment(messages_by_type_[msg_type], 1); }
+
+  /// \brief Add the cycles since start_cycles to a stage.
+  ///
+  /// \return The current cycle count, the start of the following stage.
+  inline uint64_t AddCycles(const DecoderStage stage, const uint64_t start_cycles) {
+    const uint64_t now = ReadCycleCounter();
+    Increment(stage_cycles_[static_cast<size_t>(stage)], now - start_cycles);
+    return now;
+  }
+
+  /// \brief Take a copy of all counters. Safe to call from any thread.
+  DecoderStats Snapshot() const;
+
+  /// \brief Set all counters to zero. Only call from the decoding thread.
+  void Reset();
+
+ private:
+  static inline void Increment(std::atomic<uint64_t>& counter, const uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> packets_{0};
+  std::atomic<uint64_t> bytes_{0};
+  std::atomic<uint64_t> heartbeats_{0};
+  std::atomic<uint64_t> blocks_{0};
+  std::array<std::atomic<uint64_t>, 256> messages_by_type_{};
+  std::array<std::atomic<uint64_t>, num_decoder_stages> stage_cycles_{};
+};
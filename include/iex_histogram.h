@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "iex_messages.h"
+
+/// \class LatencyHistogram
+/// \brief A streaming histogram of non-negative integer values (e.g. nanoseconds) with log
+///        buckets, in the style of HdrHistogram.
+/// \note  Values are grouped by their highest set bit, and every such power of two range is split
+///        into 2^sub_bucket_bits linear sub-buckets. Percentiles are therefore accurate to a
+///        relative error of 2^-sub_bucket_bits (under 1% by default) over the full 64 bit range,
+///        and recording is a count-leading-zeros, a shift and an increment. Values below
+///        2^(sub_bucket_bits + 1) are recorded exactly.
+///
+///        Histograms are not thread safe. Record into one histogram per thread or per file and
+///        Merge them afterwards.
+class LatencyHistogram {
+ public:
+  /// \param sub_bucket_bits  Precision, the number of linear sub-buckets per power of two is
+  ///                         2^sub_bucket_bits. Limited to 1..16.
+  explicit LatencyHistogram(const int sub_bucket_bits = 7);
+
+  /// \brief Record a value. Negative values (e.g. from unsynchronized clocks) are not recorded in
+  ///        the histogram, only counted, see GetNegativeCount.
+  inline void Record(const int64_t value) {
+    if (value < 0) {
+      ++negative_count_;
+      return;
+    }
+    const uint64_t unsigned_value = static_cast<uint64_t>(value);
+    ++counts_[GetBucketIndex(unsigned_value)];
+    ++total_count_;
+    sum_ += unsigned_value;
+    min_ = unsigned_value < min_ ? unsigned_value : min_;
+    max_ = unsigned_value > max_ ? unsigned_value : max_;
+  }
+
+  /// \brief Add all values recorded in another histogram to this one.
+  ///
+  /// \param other  A histogram with the same precision.
+  /// \return True if succeeds, false if the precisions differ.
+  bool Merge(const LatencyHistogram& other) WARN_UNUSED;
+
+  /// \brief Remove all recorded values.
+  void Reset();
+
+  /// \brief The value at or below which the given percentage of recorded values fall.
+  /// \note  Returns the highest value of the bucket, so the result errs on the high side, but
+  ///        never exceeds the maximum recorded value.
+  ///
+  /// \param percentile  Percentile between 0 and 100.
+  /// \return The value, or 0 if the histogram is empty.
+  uint64_t GetValueAtPercentile(const double percentile) const;
+
+  /// \brief Number of recorded values, not counting negative values.
+  inline uint64_t GetCount() const { return total_count_; }
+
+  /// \brief Number of negative values passed to Record.
+  inline uint64_t GetNegativeCount() const { return negative_count_; }
+
+  /// \brief Minimum, maximum and mean of the recorded values, 0 if the histogram is empty.
+  inline uint64_t GetMin() const { return total_count_ ? min_ : 0; }
+  inline uint64_t GetMax() const { return max_; }
+  double GetMean() const;
+
+  /// \brief Print count, mean and common percentiles to standard output on one line.
+  ///
+  /// \param name  Label to print in front of the values.
+  void Print(const std::string& name) const;
+
+ private:
+  /// \brief Bucket of a value. Values below 2 * sub_bucket_count_ map to themselves.
+  inline size_t GetBucketIndex(const uint64_t value) const {
+    if (value < 2 * sub_bucket_count_) {
+      return static_cast<size_t>(value);
+    }
+    const int shift = 63 - __builtin_clzll(value) - sub_bucket_bits_;
+    return static_cast<size_t>((shift + 1) * sub_bucket_count_ +
+                               ((value >> shift) - sub_bucket_count_));
+  }
+
+  /// \brief The largest value that maps to a bucket.
+  uint64_t GetBucketHighestValue(const size_t bucket_index) const;
+
+  int sub_bucket_bits_;
+  uint64_t sub_bucket_count_;
+  std::vector<uint64_t> counts_;
+
+  uint64_t total_count_ = 0;
+  uint64_t negative_count_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t min_ = UINT64_MAX;
+  uint64_t max_ = 0;
+};
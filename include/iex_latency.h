@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+
+#include "iex_decoder.h"
+#include "iex_histogram.h"
+#include "iex_messages.h"
+
+/// \class LatencyRecorder
+/// \brief Records exchange and network latencies of a decoded stream into LatencyHistograms, all in
+///        nanoseconds:
+///        - Publication latency, per packet: send time of the packet minus the timestamp of its
+///          first message, i.e. how long the packet was being filled inside IEX.
+///        - Wire latency, per packet: pcap capture time minus send time. Only meaningful when the
+///          capturing host's clock is synchronized; negative values are counted separately.
+///        - Internal latency, per message and message type: send time minus message timestamp.
+/// \note  Not thread safe. Use one recorder per thread or file and Merge them.
+class LatencyRecorder {
+ public:
+  LatencyRecorder() = default;
+
+  /// \brief Record a message just returned by a decoder.
+  ///
+  /// \param decoder  The decoder, for the header and capture time of the current packet.
+  /// \param msg      The message.
+  inline void Record(const IEXDecoder& decoder, const IEXMessageBase& msg) {
+    Record(decoder.GetLastDecodedHeader(), decoder.GetLastCaptureTime(), msg);
+  }
+
+  /// \brief Record a message, given the header and capture time of its packet.
+  ///
+  /// \param header        Header of the packet containing the message.
+  /// \param capture_time  Capture time of the packet, nanoseconds since POSIX time UTC.
+  /// \param msg           The message.
+  void Record(const IEXTPHeader& header, const int64_t capture_time, const IEXMessageBase& msg);
+
+  /// \brief Add all latencies recorded by another recorder to this one.
+  void Merge(const LatencyRecorder& other);
+
+  inline const LatencyHistogram& GetPublicationLatency() const { return publication_latency_; }
+  inline const LatencyHistogram& GetWireLatency() const { return wire_latency_; }
+
+  /// \brief Internal latency of a message type, or null if no message of the type was recorded.
+  inline const LatencyHistogram* GetInternalLatency(const MessageType msg_type) const {
+    return internal_latency_[static_cast<uint8_t>(msg_type)].get();
+  }
+
+  /// \brief Print percentiles of all histograms to standard output.
+  void Print() const;
+
+ private:
+  LatencyHistogram publication_latency_;
+  LatencyHistogram wire_latency_;
+  std::array<std::unique_ptr<LatencyHistogram>, 256> internal_latency_;
+
+  /// \brief Sequence number of the first message of the last packet seen, to detect new packets.
+  int64_t last_packet_sequence_number_ = -1;
+};
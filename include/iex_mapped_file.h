@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "iex_messages.h"
+
+/// \class MappedFile
+/// \brief A read only memory mapping of a whole file.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile() { Close(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /// \brief Map a file, unmapping any file mapped before.
+  ///
+  /// \return True if succeeds, false otherwise. Empty files cannot be mapped.
+  bool Open(const std::string& filename) WARN_UNUSED;
+
+  /// \brief Unmap the file. Pointers into it are no longer valid.
+  void Close();
+
+  /// \brief Advise the kernel that a range of the file will be read soon.
+  void WillNeed(const uint8_t* data_ptr, const size_t len) const;
+
+  inline const uint8_t* GetData() const { return data_; }
+  inline size_t GetSize() const { return size_; }
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
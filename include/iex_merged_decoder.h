@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+#include "iex_spsc_ring.h"
+
+/// \class MergedDecoder
+/// \brief Merges several IEX pcap files (e.g. TOPS and DEEP, several days or channels) into a
+///        single stream ordered by message timestamp.
+/// \note  Every source is decoded ahead of time on its own thread. The merge itself keeps the head
+///        message of each source in a binary min-heap keyed on (timestamp, source id), so messages
+///        with equal timestamps are returned in source order and the output is deterministic.
+class MergedDecoder {
+ public:
+  /// \param prefetch_batch_size  Number of messages each source thread decodes per batch.
+  /// \param ring_capacity        Number of batches each source thread may decode ahead.
+  explicit MergedDecoder(const size_t prefetch_batch_size = 256, const size_t ring_capacity = 16)
+      : prefetch_batch_size_(prefetch_batch_size), ring_capacity_(ring_capacity) {}
+
+  /// \brief Stops and joins the source threads.
+  ~MergedDecoder();
+
+  /// \brief Open all files for decoding and start prefetching. The position of a file in the list
+  ///        is its source id.
+  ///
+  /// \param filenames  Relative or full paths of the files.
+  /// \return True if every file could be opened, false otherwise.
+  bool OpenFilesForDecoding(const std::vector<std::string>& filenames) WARN_UNUSED;
+
+  /// \brief Get the next message across all sources, in timestamp order.
+  ///
+  /// \param msg_ptr    Output parameter, containing the message if successfully decoded.
+  /// \param source_id  Output parameter, the index of the file the message came from.
+  /// \return ReturnCode enum describing success or a specific error code. A decoding error in one
+  ///         source is returned once, at the point where that source stops; the other sources
+  ///         continue afterwards.
+  ReturnCode GetNextMessage(std::unique_ptr<IEXMessageBase>& msg_ptr, size_t& source_id);
+
+  /// \brief Get the first header of a source.
+  ///
+  /// \return A struct populated with the header information.
+  inline const IEXTPHeader& GetFirstHeader(const size_t source_id) {
+    return sources_[source_id]->decoder.GetFirstHeader();
+  }
+
+  /// \brief Number of sources being merged.
+  inline size_t NumSources() const { return sources_.size(); }
+
+ private:
+  typedef std::vector<std::unique_ptr<IEXMessageBase>> MessageBatch;
+
+  /// \brief A single input file, decoded on its own thread.
+  struct Source {
+    explicit Source(const size_t ring_capacity) : ring(ring_capacity) {}
+
+    IEXDecoder decoder;
+    SPSCRing<MessageBatch> ring;
+    std::thread thread;
+
+    /// \brief Set by the source thread after pushing its last batch.
+    std::atomic<bool> done{false};
+
+    /// \brief The code the source decoder stopped with. Read after done is set.
+    ReturnCode final_code = ReturnCode::EndOfStream;
+
+    /// \brief The batch currently being merged, and the position within it.
+    MessageBatch batch;
+    size_t batch_idx = 0;
+  };
+
+  /// \brief The head message of a source, as stored in the heap.
+  struct HeapEntry {
+    uint64_t timestamp;
+    size_t source_id;
+    std::unique_ptr<IEXMessageBase> msg_ptr;
+  };
+
+  /// \brief Orders the heap so the smallest (timestamp, source id) is at the front.
+  static bool HeapCompare(const HeapEntry& lhs, const HeapEntry& rhs) {
+    if (lhs.timestamp != rhs.timestamp) {
+      return lhs.timestamp > rhs.timestamp;
+    }
+    return lhs.source_id > rhs.source_id;
+  }
+
+  void PrefetchLoop(Source& source);
+
+  /// \brief Take the next message of a source, waiting for its thread if needed.
+  ///
+  /// \return Success if a message was taken, otherwise the code the source stopped with.
+  ReturnCode TakeNextMessage(Source& source, std::unique_ptr<IEXMessageBase>& msg_ptr);
+
+  /// \brief Take the next message of a source and push it into the heap. Any code other than
+  ///        EndOfStream is kept in pending_error_.
+  void RefillFromSource(const size_t source_id);
+
+  void StopSources();
+
+  const size_t prefetch_batch_size_;
+  const size_t ring_capacity_;
+
+  std::vector<std::unique_ptr<Source>> sources_;
+  std::vector<HeapEntry> heap_;
+  bool heap_initialized_ = false;
+
+  /// \brief A source error, returned by the next call to GetNextMessage.
+  ReturnCode pending_error_ = ReturnCode::Success;
+
+  std::atomic<bool> stop_{false};
+};
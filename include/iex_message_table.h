@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+
+/// \enum class FieldType
+/// \brief How a message field is stored in a column.
+enum class FieldType {
+  UInt8,
+  UInt32,
+  Int64,
+  UInt64,
+  Price,  // Fixed point on the wire, stored as a double in dollars.
+  Bytes   // Fixed length characters padded with spaces, e.g. symbols.
+};
+
+/// \struct FieldSpec
+/// \brief Where a field of a message type is on the wire, and how it is stored.
+struct FieldSpec {
+  const char* name;
+  uint8_t offset;
+  FieldType type;
+
+  /// \brief Bytes per element of the column.
+  uint8_t size;
+};
+
+/// \struct MessageSchema
+/// \brief The fields of a message type, in wire order. Names match the message struct members.
+struct MessageSchema {
+  MessageType type;
+
+  /// \brief Type name as accepted by ParseMessageType.
+  const char* name;
+
+  std::vector<FieldSpec> fields;
+
+  /// \brief Length of the shortest message holding all fields.
+  size_t min_len;
+};
+
+/// \brief Get the schema of a message type.
+///
+/// \return The schema, or nullptr for types without one (e.g. the stream header).
+const MessageSchema* GetMessageSchema(const MessageType type);
+
+/// \class MessageTable
+/// \brief The messages of one type as columns, one contiguous array per field, read straight from
+///        the wire format without building message structs.
+class MessageTable {
+ public:
+  explicit MessageTable(const MessageSchema& schema);
+
+  /// \brief Append a message of the type of the table.
+  ///
+  /// \return True if succeeds, false if the message is too short.
+  bool Append(const uint8_t* msg_data_ptr, const size_t msg_len);
+
+  inline const MessageSchema& GetSchema() const { return *schema_; }
+  inline size_t GetNumRows() const { return num_rows_; }
+
+  /// \brief The column of the i-th field of the schema, GetNumRows() elements of its size.
+  inline const std::vector<uint8_t>& GetColumn(const size_t i) const { return columns_[i]; }
+
+  /// \brief Move the column of the i-th field out, e.g. to hand it to another runtime without a
+  ///        copy. The table should not be appended to afterwards.
+  inline std::vector<uint8_t> TakeColumn(const size_t i) { return std::move(columns_[i]); }
+
+ private:
+  const MessageSchema* schema_;
+  size_t num_rows_ = 0;
+  std::vector<std::vector<uint8_t>> columns_;
+};
+
+/// \class MessageTables
+/// \brief Batch decodes a stream into one MessageTable per message type.
+class MessageTables {
+ public:
+  /// \brief Append a message to the table of its type. Types without a schema are skipped.
+  void Append(const uint8_t* msg_data_ptr, const size_t msg_len);
+
+  /// \brief Decode every message of a file passing a filter.
+  ///
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode AddFile(const std::string& filename,
+                     const MessageFilter& filter = MessageFilter()) WARN_UNUSED;
+
+  /// \brief The tables of the types seen, in order of first appearance.
+  inline std::vector<MessageTable>& GetTables() { return tables_; }
+  inline const std::vector<MessageTable>& GetTables() const { return tables_; }
+
+  /// \brief Get the table of a type, or nullptr if no message of the type was seen.
+  const MessageTable* GetTable(const MessageType type) const;
+
+ private:
+  /// \brief Index into tables_ plus one by type byte, zero for types not seen.
+  uint16_t table_index_[256] = {};
+  std::vector<MessageTable> tables_;
+};
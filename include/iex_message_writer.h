@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "iex_messages.h"
+#include "iex_packet_builder.h"
+#include "iex_symbol_store.h"
+
+/// \class MessageWriter
+/// \brief Writes decoded messages to an output file, the sink of a query.
+class MessageWriter {
+ public:
+  virtual ~MessageWriter() = default;
+
+  /// \brief Write a message.
+  ///
+  /// \param msg           The decoded message.
+  /// \param header        Header of the packet the message came from.
+  /// \param capture_time  Capture time of that packet, nanoseconds since POSIX time UTC.
+  /// \return True if succeeds, false otherwise.
+  virtual bool Write(const IEXMessageBase& msg, const IEXTPHeader& header,
+                     const int64_t capture_time) WARN_UNUSED = 0;
+
+  /// \brief Write anything still buffered and close the output.
+  ///
+  /// \return True if succeeds, false otherwise.
+  virtual bool Close() WARN_UNUSED = 0;
+
+  /// \brief Number of messages written so far.
+  inline uint64_t GetMessageCount() const { return num_messages_; }
+
+ protected:
+  uint64_t num_messages_ = 0;
+};
+
+/// \class CsvMessageWriter
+/// \brief Writes one line per message with the timestamp, type and symbol of every message, and
+///        the price, size, bid and ask columns where the message type has them.
+class CsvMessageWriter : public MessageWriter {
+ public:
+  /// \brief Create the file and write the column names. "-" writes to standard output.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool Open(const std::string& filename) WARN_UNUSED;
+
+  bool Write(const IEXMessageBase& msg, const IEXTPHeader& header,
+             const int64_t capture_time) override WARN_UNUSED;
+  bool Close() override WARN_UNUSED;
+
+ private:
+  std::ofstream file_stream_;
+  std::ostream* out_stream_ = nullptr;
+};
+
+/// \class PcapMessageWriter
+/// \brief Writes messages back into a pcap file that IEXDecoder can read. Messages from the same
+///        source packet share an output packet, sent and captured at the times of the source.
+/// \note  Sequence numbers and stream offsets are renumbered, so the output is a gap free stream
+///        of only the written messages.
+class PcapMessageWriter : public MessageWriter {
+ public:
+  /// \brief Create the file.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool Open(const std::string& filename) WARN_UNUSED;
+
+  bool Write(const IEXMessageBase& msg, const IEXTPHeader& header,
+             const int64_t capture_time) override WARN_UNUSED;
+  bool Close() override WARN_UNUSED;
+
+ private:
+  /// \brief Send the current packet, if it has any messages.
+  bool Flush() WARN_UNUSED;
+
+  IEXTPPcapWriter writer_;
+  std::unique_ptr<IEXTPPacketBuilder> builder_ptr_;
+
+  /// \brief The source packet of the messages in the current packet.
+  int64_t source_sq_num_ = -1;
+  int64_t source_send_time_ = 0;
+  int64_t source_capture_time_ = 0;
+};
+
+/// \class StoreMessageWriter
+/// \brief Writes messages to a symbol store, see SymbolStoreWriter.
+class StoreMessageWriter : public MessageWriter {
+ public:
+  /// \brief Remember the filename. The store is written on Close.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool Open(const std::string& filename) WARN_UNUSED;
+
+  bool Write(const IEXMessageBase& msg, const IEXTPHeader& header,
+             const int64_t capture_time) override WARN_UNUSED;
+  bool Close() override WARN_UNUSED;
+
+ private:
+  std::string filename_;
+  SymbolStoreWriter writer_;
+};
+
+/// \brief Create and open a writer, choosing the format from the file extension: ".pcap" for
+///        PcapMessageWriter, ".store" for StoreMessageWriter and CSV otherwise.
+///
+/// \param filename  The output file, "-" for CSV on standard output.
+/// \return The writer, or null if the file could not be opened.
+std::unique_ptr<MessageWriter> OpenMessageWriter(const std::string& filename);
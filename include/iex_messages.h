@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <sstream>
@@ -30,6 +31,64 @@ inline char PrintChar(const int code) {
   return ret_val;
 }
 
+/// \brief Templated function for dereferencing and casting a uint8_t pointer to a desired type.
+///
+/// \param data_ptr  Pointer to the data.
+/// \param offset    An offset to first apply to the pointer before dereferencing.
+/// \return template type T, the numeric data being requested.
+template <typename T>
+inline T GetNumeric(const uint8_t* data_ptr, const int offset) {
+  return *(reinterpret_cast<const T*>(&data_ptr[offset]));
+}
+
+/// \brief Similar to GetNumeric, however specialized for price data.
+///
+/// \param data_ptr  Pointer to the data.
+/// \param offset    An offset to first apply to the pointer before dereferencing.
+/// \return The price in dollars, returned as a double.
+double GetPrice(const uint8_t* data_ptr, const int offset);
+
+/// \brief Similar to GetNumeric, however specialized for string data.
+///
+/// \param data_ptr  Pointer to the data.
+/// \param offset    An offset to first apply to the pointer before dereferencing.
+/// \param length    Expected length of the string.
+/// \return The string data as an std::string
+std::string GetString(const uint8_t* data_ptr, const int offset, const int length);
+
+/// \brief The inverse of GetNumeric, write a number to a uint8_t pointer.
+///
+/// \param data_ptr  Pointer to the data.
+/// \param offset    An offset to first apply to the pointer before writing.
+/// \param value     The number to write.
+template <typename T>
+inline void PutNumeric(uint8_t* data_ptr, const int offset, const T value) {
+  *(reinterpret_cast<T*>(&data_ptr[offset])) = value;
+}
+
+/// \brief The inverse of GetPrice, write a price in dollars as a fixed point number.
+///
+/// \param data_ptr  Pointer to the data.
+/// \param offset    An offset to first apply to the pointer before writing.
+/// \param price     The price in dollars.
+void PutPrice(uint8_t* data_ptr, const int offset, const double price);
+
+/// \brief The inverse of GetString, write a string padded with spaces to a fixed length.
+/// \note  Strings longer than the field are truncated.
+///
+/// \param data_ptr  Pointer to the data.
+/// \param offset    An offset to first apply to the pointer before writing.
+/// \param length    Length of the field.
+/// \param value     The string to write.
+void PutString(uint8_t* data_ptr, const int offset, const int length, const std::string& value);
+
+/// \brief Validate the timestamp using a sensible range.
+/// \note  Lower limit is 2018-10-25, when IEX opened for trading, upper limit is 2100.
+///
+/// \param timestamp  Input timestamp to validate.
+/// \return bool True if timestamp is valid, false otherwise.
+bool ValidateTimestamp(const int64_t timestamp);
+
 /// \enum MessageType
 /// \brief Enum for IEX message types.
 enum class MessageType {
@@ -47,7 +106,12 @@ enum class MessageType {
   TradeBreak = 0x42,
   AuctionInformation = 0x41,
   PriceLevelUpdateBuy = 0x38,
-  PriceLevelUpdateSell = 0x35
+  PriceLevelUpdateSell = 0x35,
+  AddOrder = 0x61,
+  OrderModify = 0x4d,
+  OrderDelete = 0x52,
+  OrderExecuted = 0x4c,
+  ClearBook = 0x43
 };
 
 /// \brief Convert the message code to a readable string.
@@ -85,11 +149,46 @@ inline std::string MessageTypeToString(const MessageType& msg_enum) {
       return "PriceLevelUpdateSell" + hex_code;
     case MessageType::SecurityEvent:
       return "SecurityEvent" + hex_code;
+    case MessageType::AddOrder:
+      return "AddOrder" + hex_code;
+    case MessageType::OrderModify:
+      return "OrderModify" + hex_code;
+    case MessageType::OrderDelete:
+      return "OrderDelete" + hex_code;
+    case MessageType::OrderExecuted:
+      return "OrderExecuted" + hex_code;
+    case MessageType::ClearBook:
+      return "ClearBook" + hex_code;
     default:
       return "Unknown" + hex_code;
   }
 }
 
+/// \brief Offset and length of the symbol within a raw message. The same for every message type
+///        except the system event, which has no symbol.
+constexpr int symbol_field_offset = 10;
+constexpr int symbol_field_len = 8;
+
+/// \brief Pack a symbol into the number its wire format (8 bytes, padded with spaces) reads as,
+///        so raw messages can be matched and hashed without building strings.
+uint64_t PackSymbol(const std::string& symbol);
+
+/// \brief Get the packed symbol of a raw message, see PackSymbol.
+///
+/// \param msg_data_ptr   Pointer to the start of the message, its type byte.
+/// \param msg_len        Length of the message block.
+/// \param packed_symbol  Output parameter, the packed symbol.
+/// \return True if the message has a symbol, false otherwise.
+inline bool GetPackedSymbol(const uint8_t* msg_data_ptr, const size_t msg_len,
+                            uint64_t& packed_symbol) {
+  if (msg_len < static_cast<size_t>(symbol_field_offset + symbol_field_len) ||
+      msg_data_ptr[0] == static_cast<uint8_t>(MessageType::SystemEvent)) {
+    return false;
+  }
+  packed_symbol = GetNumeric<uint64_t>(msg_data_ptr, symbol_field_offset);
+  return true;
+}
+
 /// \class IEXMessageBase
 /// \brief Base class for all message structs.
 class IEXMessageBase {
@@ -104,6 +203,15 @@ class IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) WARN_UNUSED = 0;
 
+  /// \brief Encode the message struct to the data stream, the inverse of Decode.
+  ///
+  /// \param data_ptr Pointer to the start of the output, at least max_encoded_len bytes long.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const = 0;
+
+  /// \brief Length of the longest message, AuctionInformation.
+  constexpr static size_t max_encoded_len = 80;
+
   /// \brief Output the data to json format.
   std::string OutputToJson() const;
 
@@ -121,6 +229,16 @@ class IEXMessageBase {
   MessageType message_type = MessageType::NoData;
 };
 
+/// \enum ProtocolId
+/// \brief Values of IEXTPHeader::protocol_id, identifying the feed carried by the transport.
+///        TOPS covers versions 1.5 and 1.6, which share the id. DEEP_PLUS is the order by order
+///        feed.
+enum class ProtocolId : uint16_t {
+  TOPS = 0x8003,
+  DEEP = 0x8004,
+  DEEP_PLUS = 0x8005
+};
+
 struct IEXTPHeader : public IEXMessageBase {
   IEXTPHeader() { message_type = MessageType::StreamHeader; }
 
@@ -130,6 +248,12 @@ struct IEXTPHeader : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -180,6 +304,12 @@ struct SystemEventMessage : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -198,6 +328,12 @@ struct SecurityDirectoryMessage : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -233,6 +369,12 @@ struct TradingStatusMessage : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -260,6 +402,12 @@ struct OperationalHaltStatusMessage : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -286,6 +434,12 @@ struct ShortSalePriceTestStatusMessage : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -308,6 +462,12 @@ struct QuoteUpdateMessage : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -341,6 +501,12 @@ struct TradeReportMessage : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -357,7 +523,7 @@ struct TradeReportMessage : public IEXMessageBase {
   double price;
 
   /// \brief IEX Generated Identifier. Trade ID is also referenced in the Trade Break Message.
-  int trade_id;
+  uint64_t trade_id;
 };
 
 struct OfficialPriceMessage : public IEXMessageBase {
@@ -374,6 +540,12 @@ struct OfficialPriceMessage : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -410,6 +582,12 @@ struct AuctionInformationMessage : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -462,6 +640,12 @@ struct PriceLevelUpdateMessage : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -492,6 +676,12 @@ struct SecurityEventMessage : public IEXMessageBase {
   /// \return True if succeeds, false otherwise.
   virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
 
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
   /// \brief Print contents of message to standard output.
   virtual void Print() const override;
 
@@ -502,5 +692,169 @@ struct SecurityEventMessage : public IEXMessageBase {
   std::string symbol;
 };
 
+// The following messages are only carried by the DEEP+ feed, which reports every displayed order
+// instead of aggregated price levels.
+
+struct AddOrderMessage : public IEXMessageBase {
+  enum class Side {
+    Buy = 0x38,  // '8'
+    Sell = 0x35  // '5'
+  };
+
+  AddOrderMessage() { message_type = MessageType::AddOrder; }
+
+  /// \brief Decode the data stream to a message struct.
+  ///
+  /// \param data_ptr Pointer to the start of the relevant data stream.
+  /// \return True if succeeds, false otherwise.
+  virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
+
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
+  /// \brief Print contents of message to standard output.
+  virtual void Print() const override;
+
+  /// \brief Side of the order.
+  Side side;
+
+  /// \brief Security Identifier.
+  std::string symbol;
+
+  /// \brief IEX Generated Identifier, unique for the day and referenced by later order messages.
+  uint64_t order_id;
+
+  /// \brief Displayed size of the order.
+  int size;
+
+  /// \brief Limit price of the order.
+  double price;
+};
+
+struct OrderModifyMessage : public IEXMessageBase {
+  /// \brief Flag set if the order keeps its time priority, otherwise it moves to the back of the
+  ///        queue of its price level.
+  constexpr static uint8_t maintain_priority_flag = 0x80;
+
+  OrderModifyMessage() { message_type = MessageType::OrderModify; }
+
+  /// \brief Decode the data stream to a message struct.
+  ///
+  /// \param data_ptr Pointer to the start of the relevant data stream.
+  /// \return True if succeeds, false otherwise.
+  virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
+
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
+  /// \brief Print contents of message to standard output.
+  virtual void Print() const override;
+
+  /// \brief See maintain_priority_flag.
+  uint8_t flags;
+
+  /// \brief Security Identifier.
+  std::string symbol;
+
+  /// \brief Identifier of the order, as in its AddOrderMessage.
+  uint64_t order_id;
+
+  /// \brief New displayed size of the order.
+  int size;
+
+  /// \brief New limit price of the order.
+  double price;
+};
+
+struct OrderDeleteMessage : public IEXMessageBase {
+  OrderDeleteMessage() { message_type = MessageType::OrderDelete; }
+
+  /// \brief Decode the data stream to a message struct.
+  ///
+  /// \param data_ptr Pointer to the start of the relevant data stream.
+  /// \return True if succeeds, false otherwise.
+  virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
+
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
+  /// \brief Print contents of message to standard output.
+  virtual void Print() const override;
+
+  /// \brief Security Identifier.
+  std::string symbol;
+
+  /// \brief Identifier of the order removed from the book.
+  uint64_t order_id;
+};
+
+struct OrderExecutedMessage : public IEXMessageBase {
+  OrderExecutedMessage() { message_type = MessageType::OrderExecuted; }
+
+  /// \brief Decode the data stream to a message struct.
+  ///
+  /// \param data_ptr Pointer to the start of the relevant data stream.
+  /// \return True if succeeds, false otherwise.
+  virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
+
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
+  /// \brief Print contents of message to standard output.
+  virtual void Print() const override;
+
+  /// \brief Sale condition flags, as the flags of TradeReportMessage.
+  uint8_t flags;
+
+  /// \brief Security Identifier.
+  std::string symbol;
+
+  /// \brief Identifier of the executed order.
+  uint64_t order_id;
+
+  /// \brief Executed shares, the order is removed once all of its shares are executed.
+  int size;
+
+  /// \brief Execution price.
+  double price;
+
+  /// \brief IEX Generated Identifier of the trade, as in trade reports.
+  uint64_t trade_id;
+};
+
+struct ClearBookMessage : public IEXMessageBase {
+  ClearBookMessage() { message_type = MessageType::ClearBook; }
+
+  /// \brief Decode the data stream to a message struct.
+  ///
+  /// \param data_ptr Pointer to the start of the relevant data stream.
+  /// \return True if succeeds, false otherwise.
+  virtual bool Decode(const uint8_t* data_ptr) override WARN_UNUSED;
+
+  /// \brief Encode the message struct to the data stream.
+  ///
+  /// \param data_ptr Pointer to the start of the output.
+  /// \return The number of bytes written.
+  virtual size_t Encode(uint8_t* data_ptr) const override;
+
+  /// \brief Print contents of message to standard output.
+  virtual void Print() const override;
+
+  /// \brief Security Identifier, all of its orders are removed.
+  std::string symbol;
+};
+
 
 std::unique_ptr<IEXMessageBase> IEXMessageFactory(const uint8_t* msg_data_ptr);
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+#include "iex_symbol_table.h"
+
+/// \struct MicrostructureConfig
+/// \brief Parameters of MicrostructureStats.
+struct MicrostructureConfig {
+  /// \brief Interval the mid price is sampled at for realized volatility, nanoseconds.
+  int64_t volatility_interval = 1000000000;
+
+  /// \brief Number of symbols to reserve room for.
+  size_t expected_symbols = 8192;
+};
+
+/// \struct SymbolSummary
+/// \brief Day summary of one symbol, see MicrostructureStats::GetSummary.
+struct SymbolSummary {
+  std::string symbol;
+
+  /// \brief Average spread over the time both sides were quoted, in dollars.
+  double time_weighted_spread = 0;
+
+  /// \brief Time both sides were quoted, seconds.
+  double quoted_time = 0;
+
+  /// \brief Fraction of quoted_time the market was locked or crossed (bid >= ask).
+  double locked_crossed_fraction = 0;
+
+  /// \brief Number of quote updates, and per second over the span of the data.
+  uint64_t quote_updates = 0;
+  double quote_rate = 0;
+
+  uint64_t trade_count = 0;
+  uint64_t volume = 0;
+
+  /// \brief Square root of the sum of squared log returns of the mid, sampled every
+  ///        volatility_interval while both sides are quoted. Not annualized.
+  double realized_volatility = 0;
+};
+
+/// \class MicrostructureStats
+/// \brief Single pass per symbol statistics over quote updates and trade reports: time weighted
+///        spread, quote update rate, trade count and volume, realized volatility of the sampled mid
+///        and the fraction of time the market was locked or crossed.
+/// \note  State is kept as one array per statistic, indexed by a dense symbol id from a
+///        SymbolTable, and a quote update is a handful of multiply-adds with masks instead of
+///        branches. Timestamps of a symbol must not decrease, as in any single feed.
+class MicrostructureStats {
+ public:
+  explicit MicrostructureStats(const MicrostructureConfig& config = MicrostructureConfig());
+
+  /// \brief Update the statistics with a decoded message. Messages other than quote updates and
+  ///        trade reports only extend the time span.
+  void OnMessage(const IEXMessageBase& msg);
+
+  /// \brief Update the statistics with a quote.
+  ///
+  /// \param id         Symbol id, see GetSymbolTable.
+  /// \param timestamp  Nanoseconds since POSIX time UTC.
+  /// \param bid_price  Best bid, zero if there is none.
+  /// \param ask_price  Best ask, zero if there is none.
+  void OnQuote(const uint32_t id, const int64_t timestamp, const double bid_price,
+               const double ask_price);
+
+  /// \brief Update the statistics with a trade.
+  void OnTrade(const uint32_t id, const int64_t timestamp, const uint32_t size);
+
+  /// \brief Decode a file and update the statistics with all its messages.
+  ///
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode AddFile(const std::string& filename) WARN_UNUSED;
+
+  /// \brief Summaries of all symbols seen, in order of first appearance. Quotes still open are
+  ///        counted up to the last timestamp seen.
+  std::vector<SymbolSummary> GetSummary() const;
+
+  /// \brief Get the id of a symbol, adding it if it is new.
+  inline uint32_t GetSymbolId(const std::string& symbol) {
+    const uint32_t id = symbol_table_.GetOrAdd(symbol);
+    if (id >= last_time_.size()) {
+      Resize(id + 1);
+    }
+    return id;
+  }
+
+  inline const SymbolTable& GetSymbolTable() const { return symbol_table_; }
+
+ private:
+  /// \brief Extend all arrays to num_symbols entries.
+  void Resize(const size_t num_symbols);
+
+  /// \brief Update the span of the data with a timestamp.
+  inline void AddTime(const int64_t timestamp) {
+    first_time_ = std::min(first_time_, timestamp);
+    last_time_seen_ = std::max(last_time_seen_, timestamp);
+  }
+
+  MicrostructureConfig config_;
+  SymbolTable symbol_table_;
+
+  /// \brief Current quote, and when it was set.
+  std::vector<int64_t> last_time_;
+  std::vector<double> bid_price_;
+  std::vector<double> ask_price_;
+
+  /// \brief Integrals over time, in nanoseconds, of the spread, of being quoted and of being locked
+  ///        or crossed.
+  std::vector<double> spread_time_;
+  std::vector<double> quoted_time_;
+  std::vector<double> locked_time_;
+
+  std::vector<uint64_t> quote_updates_;
+  std::vector<uint64_t> trade_count_;
+  std::vector<uint64_t> volume_;
+
+  /// \brief Sampling state of the mid: the last sample interval and mid, and the sum of squared
+  ///        log returns between samples.
+  std::vector<int64_t> sample_index_;
+  std::vector<double> sampled_mid_;
+  std::vector<double> sum_squared_returns_;
+
+  int64_t first_time_ = std::numeric_limits<int64_t>::max();
+  int64_t last_time_seen_ = std::numeric_limits<int64_t>::min();
+};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "iex_messages.h"
+#include "iex_symbol_table.h"
+
+/// \class OrderBook
+/// \brief Order level books of every symbol of a DEEP+ feed, built from its order messages.
+///        Usable as a ProtocolDecoder handler, e.g. DecodeProtocolFile(filename, book).
+/// \note  Orders live in a pool of nodes addressed by index and recycled through a free list, are
+///        found by id through an open addressed hash, and queue in time priority in an intrusive
+///        doubly linked list per price level. Once the pools have grown to the peak number of
+///        orders and levels, adding, modifying, executing and deleting orders never allocates.
+class OrderBook {
+ public:
+  enum class Side : uint8_t { Buy = 0, Sell = 1 };
+
+  /// \brief Index of no order or level.
+  constexpr static uint32_t npos = 0xffffffff;
+
+  /// \struct PriceLevel
+  /// \brief A price level of one side of a book, and its queue of orders.
+  struct PriceLevel {
+    /// \brief Price in ten thousandths of a dollar, as on the wire.
+    int64_t price;
+
+    /// \brief Total displayed size of the orders.
+    uint64_t size;
+
+    uint32_t num_orders;
+
+    /// \brief First and last order of the queue, in time priority.
+    uint32_t head;
+    uint32_t tail;
+  };
+
+  /// \param expected_orders   Number of simultaneously resting orders to reserve room for.
+  /// \param expected_symbols  Number of symbols to reserve room for.
+  explicit OrderBook(const size_t expected_orders = 1 << 20, const size_t expected_symbols = 8192);
+
+  /// \brief Get the id of a symbol, creating its book if it is new.
+  uint32_t GetSymbolId(const std::string& symbol);
+
+  /// \brief Add an order at the back of the queue of its price level.
+  ///
+  /// \param symbol_id  Id of the symbol, see GetSymbolId.
+  /// \param price      Price in ten thousandths of a dollar.
+  /// \return True if succeeds, false if an order with the id is already in the book.
+  bool AddOrder(const uint64_t order_id, const uint32_t symbol_id, const Side side,
+                const int64_t price, const uint32_t size);
+
+  /// \brief Change the price and size of an order. It keeps its place in the queue only if
+  ///        keep_priority is set and the price is unchanged.
+  ///
+  /// \return True if succeeds, false if the order is not in the book.
+  bool ModifyOrder(const uint64_t order_id, const int64_t price, const uint32_t size,
+                   const bool keep_priority);
+
+  /// \brief Execute shares of an order, removing it once none are left.
+  ///
+  /// \return True if succeeds, false if the order is not in the book.
+  bool ExecuteOrder(const uint64_t order_id, const uint32_t size);
+
+  /// \brief Remove an order.
+  ///
+  /// \return True if succeeds, false if the order is not in the book.
+  bool DeleteOrder(const uint64_t order_id);
+
+  /// \brief Remove every order of a symbol.
+  void ClearBook(const uint32_t symbol_id);
+
+  /// \brief Handlers of the DEEP+ order messages, other messages are ignored. Messages referring
+  ///        to orders not in the book are counted, see GetNumUnmatched.
+  void operator()(const AddOrderMessage& msg);
+  void operator()(const OrderModifyMessage& msg);
+  void operator()(const OrderDeleteMessage& msg);
+  void operator()(const OrderExecutedMessage& msg);
+  void operator()(const ClearBookMessage& msg);
+  template <typename Message>
+  void operator()(const Message&) {}
+
+  /// \brief Symbols seen so far, their ids index the books.
+  inline const SymbolTable& GetSymbols() const { return symbols_; }
+
+  /// \brief Number of price levels of one side of a book.
+  inline size_t GetNumLevels(const uint32_t symbol_id, const Side side) const {
+    return symbol_id < books_.size() ? GetSide(symbol_id, side).size() : 0;
+  }
+
+  /// \brief A price level of one side of a book, level 0 being the best.
+  inline const PriceLevel& GetLevel(const uint32_t symbol_id, const Side side,
+                                    const size_t level) const {
+    const std::vector<uint32_t>& levels = GetSide(symbol_id, side);
+    return levels_[levels[levels.size() - 1 - level]];
+  }
+
+  /// \brief The best price level of one side of a book, null if the side is empty.
+  inline const PriceLevel* GetBestLevel(const uint32_t symbol_id, const Side side) const {
+    return GetNumLevels(symbol_id, side) > 0 ? &GetLevel(symbol_id, side, 0) : nullptr;
+  }
+
+  /// \brief Call func(order_id, size) for every order of a level, in time priority.
+  template <typename Func>
+  void ForEachOrder(const PriceLevel& level, Func func) const {
+    for (uint32_t node = level.head; node != npos; node = orders_[node].next) {
+      func(orders_[node].order_id, orders_[node].size);
+    }
+  }
+
+  /// \brief Number of orders resting in all books.
+  inline size_t GetNumOrders() const { return num_orders_; }
+
+  /// \brief Number of messages that referred to an order not in the book, or added one that was.
+  inline uint64_t GetNumUnmatched() const { return num_unmatched_; }
+
+ private:
+  /// \brief An order, linked into the queue of its level. Free nodes are linked through next.
+  struct OrderNode {
+    uint64_t order_id;
+    uint32_t size;
+    uint32_t level;
+    uint32_t prev;
+    uint32_t next;
+    uint32_t symbol_id;
+    Side side;
+  };
+
+  /// \brief A slot of the order id hash, empty if node is npos.
+  struct OrderSlot {
+    uint64_t order_id;
+    uint32_t node;
+  };
+
+  /// \brief The levels of both sides of a symbol, as indexes sorted from the worst to the best
+  ///        price, so the levels orders mostly arrive at are inserted and removed near the end.
+  struct SymbolBook {
+    std::vector<uint32_t> sides[2];
+  };
+
+  inline const std::vector<uint32_t>& GetSide(const uint32_t symbol_id, const Side side) const {
+    return books_[symbol_id].sides[static_cast<int>(side)];
+  }
+
+  /// \brief Fibonacci hashing, taking the top bits of the product.
+  inline size_t GetSlot(const uint64_t order_id) const {
+    return static_cast<size_t>((order_id * 0x9e3779b97f4a7c15ull) >> shift_);
+  }
+
+  /// \brief The node of an order, or npos.
+  inline uint32_t FindOrder(const uint64_t order_id) const {
+    for (size_t slot = GetSlot(order_id);; slot = (slot + 1) & mask_) {
+      if (slots_[slot].node == npos) {
+        return npos;
+      }
+      if (slots_[slot].order_id == order_id) {
+        return slots_[slot].node;
+      }
+    }
+  }
+
+  void InsertSlot(const uint64_t order_id, const uint32_t node);
+
+  /// \brief Remove the slot of an order, shifting back the slots probed past it.
+  void EraseSlot(const uint64_t order_id);
+
+  /// \brief Resize the hash to a power of two of at least twice min_orders slots.
+  void Rehash(const size_t min_orders);
+
+  /// \brief Get the level of a price, creating it if the side has none.
+  uint32_t GetOrAddLevel(const uint32_t symbol_id, const Side side, const int64_t price);
+
+  /// \brief Remove an empty level from its side and return it to the pool.
+  void RemoveLevel(const uint32_t symbol_id, const Side side, const uint32_t level);
+
+  /// \brief Link an order at the back of the queue of a level.
+  void PushBack(const uint32_t node, const uint32_t level);
+
+  /// \brief Unlink an order from its level, removing the level once it is empty.
+  void Unlink(const uint32_t node);
+
+  /// \brief Remove an unlinked order from the hash and return its node to the pool.
+  void FreeOrder(const uint32_t node);
+
+  SymbolTable symbols_;
+  std::vector<SymbolBook> books_;
+
+  /// \brief Pool of orders, unused nodes are linked from free_order_.
+  std::vector<OrderNode> orders_;
+  uint32_t free_order_ = npos;
+
+  /// \brief Pool of levels, unused levels are linked through head from free_level_.
+  std::vector<PriceLevel> levels_;
+  uint32_t free_level_ = npos;
+
+  std::vector<OrderSlot> slots_;
+  size_t mask_ = 0;
+  int shift_ = 64;
+
+  size_t num_orders_ = 0;
+  uint64_t num_unmatched_ = 0;
+};
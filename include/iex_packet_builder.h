@@ -0,0 +1,114 @@
+#pragma once
+
+#include "PcapFileDevice.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+
+/// \class IEXTPPacketBuilder
+/// \brief Builds IEX-TP payloads, a header followed by length prefixed message blocks, the inverse
+///        of what IEXDecoder reads. Sequence numbers and stream offsets of consecutive packets are
+///        kept continuous.
+/// \note  Typical use: AddMessage until it returns false or the packet is complete, Finish, send
+///        GetData/GetLength, then StartNextPacket and repeat. Finishing an empty packet gives a
+///        heartbeat.
+class IEXTPPacketBuilder {
+ public:
+  /// \param protocol_id       Protocol written to every header, see ProtocolId.
+  /// \param channel_id        Channel written to every header.
+  /// \param session_id        Session written to every header.
+  /// \param max_payload_len   Maximum length of a packet, header included. Capped to what fits
+  ///                          a UDP datagram, see IEXTPPcapWriter::max_payload_len.
+  /// \param first_msg_sq_num  Sequence number of the first message of the first packet.
+  /// \param stream_offset     Stream offset of the first packet.
+  IEXTPPacketBuilder(const uint16_t protocol_id, const uint32_t channel_id,
+                     const uint32_t session_id, const size_t max_payload_len = 1200,
+                     const int64_t first_msg_sq_num = 1, const int64_t stream_offset = 0);
+
+  /// \brief Encode a message and append it to the current packet as a block.
+  ///
+  /// \param msg  The message to append.
+  /// \return True if the message was added, false if the packet is full.
+  bool AddMessage(const IEXMessageBase& msg) WARN_UNUSED;
+
+  /// \brief Append already encoded message data to the current packet as a block.
+  ///
+  /// \param msg_data  Pointer to the start of the message data.
+  /// \param msg_len   Length of the message data.
+  /// \return True if the block was added, false if the packet is full.
+  bool AddBlock(const uint8_t* msg_data, const size_t msg_len) WARN_UNUSED;
+
+  /// \brief Write the header of the current packet.
+  ///
+  /// \param send_time  Send time of the packet, nanoseconds since POSIX time UTC.
+  /// \return Length of the packet, header included.
+  size_t Finish(const int64_t send_time);
+
+  /// \brief Start a new, empty packet following the current one.
+  void StartNextPacket();
+
+  /// \brief The current packet. Only complete after Finish.
+  inline const uint8_t* GetData() const { return buffer_.data(); }
+
+  /// \brief Length of the current packet, header included.
+  inline size_t GetLength() const { return IEXDecoder::first_block_start + header_.payload_len; }
+
+  /// \brief The header of the current packet, as written by the last Finish.
+  inline const IEXTPHeader& GetHeader() const { return header_; }
+
+  /// \brief Number of messages in the current packet.
+  inline size_t GetMessageCount() const { return header_.message_count; }
+
+  /// \brief Sequence number the next message added will get.
+  inline int64_t GetNextSequenceNumber() const {
+    return header_.first_msg_sq_num + header_.message_count;
+  }
+
+ private:
+  /// \brief Length of the block length field in front of every message.
+  constexpr static size_t block_len_size = 2;
+
+  IEXTPHeader header_;
+  std::vector<uint8_t> buffer_;
+};
+
+/// \class IEXTPPcapWriter
+/// \brief Writes IEX-TP payloads to a pcap file, wrapped in Ethernet, IPv4 and UDP headers as
+///        on the multicast feed, so IEXDecoder reads them back like recorded data.
+class IEXTPPcapWriter {
+ public:
+  /// \brief Largest payload whose UDP datagram fits the 16 bit IPv4 total length.
+  constexpr static size_t max_payload_len = 65535 - 20 - 8;
+
+  /// \brief Create a pcap file with nanosecond timestamps, replacing any existing file.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool Open(const std::string& filename) WARN_UNUSED;
+
+  /// \brief Flush and close the file.
+  void Close();
+
+  /// \brief Write one packet.
+  ///
+  /// \param payload_ptr   The IEX-TP payload, e.g. IEXTPPacketBuilder::GetData.
+  /// \param payload_len   Length of the payload, at most max_payload_len.
+  /// \param capture_time  Capture timestamp of the record, nanoseconds since POSIX time UTC.
+  /// \return True if succeeds, false otherwise.
+  bool WritePacket(const uint8_t* payload_ptr, const size_t payload_len,
+                   const int64_t capture_time) WARN_UNUSED;
+
+  /// \brief Number of packets written since Open.
+  inline uint64_t GetPacketCount() const { return packets_written_; }
+
+ private:
+  void WriteNetworkHeaders(const size_t udp_len);
+
+  std::unique_ptr<pcpp::PcapFileWriterDevice> writer_ptr_;
+  std::vector<uint8_t> frame_;
+  uint64_t packets_written_ = 0;
+};
@@ -0,0 +1,161 @@
+#ifndef IEX_PCAP_C_H
+#define IEX_PCAP_C_H
+
+/* C API of the decoder, for embedding it in other runtimes (e.g. Java via Panama, Rust via FFI).
+ * Built into libiex_pcap.so.
+ *
+ * No C++ exception crosses the API, and no memory allocated by it is handed to the caller, apart
+ * from the opaque decoder handle. Messages are decoded in batches into caller provided fixed size
+ * records or columns, so the cost of a call across the FFI is shared by many messages.
+ *
+ *   iex_decoder_t* decoder = NULL;
+ *   iex_record_t records[1024];
+ *   size_t num_records = 0;
+ *   iex_status_t status = iex_open("20180127_IEXTP1_TOPS1.6.pcap", &decoder);
+ *   while (status == IEX_OK) {
+ *     status = iex_decode_records(decoder, records, 1024, &num_records);
+ *     // Use the first num_records records, also once status is IEX_END_OF_STREAM.
+ *   }
+ *   iex_close(decoder);
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define IEX_C_API __declspec(dllexport)
+#else
+#define IEX_C_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Result of every call. */
+typedef enum iex_status {
+  IEX_OK = 0,
+  IEX_END_OF_STREAM = 1,
+  IEX_ERROR_INVALID_ARGUMENT = 2,
+  IEX_ERROR_OPEN_FAILED = 3,
+  IEX_ERROR_PARSING_PACKET = 4,
+  IEX_ERROR_DECODING_PACKET = 5,
+  IEX_ERROR_UNKNOWN_MESSAGE_TYPE = 6,
+  IEX_ERROR_INTERNAL = 7
+} iex_status_t;
+
+/* Message type bytes, as on the wire. */
+typedef enum iex_message_type {
+  IEX_SYSTEM_EVENT = 0x53,
+  IEX_SECURITY_DIRECTORY = 0x44,
+  IEX_SECURITY_EVENT = 0x45,
+  IEX_TRADING_STATUS = 0x48,
+  IEX_OPERATIONAL_HALT_STATUS = 0x4f,
+  IEX_SHORT_SALE_PRICE_TEST_STATUS = 0x50,
+  IEX_QUOTE_UPDATE = 0x51,
+  IEX_TRADE_REPORT = 0x54,
+  IEX_OFFICIAL_PRICE = 0x58,
+  IEX_TRADE_BREAK = 0x42,
+  IEX_AUCTION_INFORMATION = 0x41,
+  IEX_PRICE_LEVEL_UPDATE_BUY = 0x38,
+  IEX_PRICE_LEVEL_UPDATE_SELL = 0x35,
+  /* DEEP+ order messages, returned as unsupported records. */
+  IEX_ADD_ORDER = 0x61,
+  IEX_ORDER_MODIFY = 0x4d,
+  IEX_ORDER_DELETE = 0x52,
+  IEX_ORDER_EXECUTED = 0x4c,
+  IEX_CLEAR_BOOK = 0x43
+} iex_message_type_t;
+
+/* One decoded message, 64 bytes. The fields a message type does not have are zero.
+ *   price, size:    trade reports and breaks, official prices (price only), price level updates,
+ *                   the bid of quote updates, the reference price and paired shares of auction
+ *                   information, the adjusted POC price and round lot size of security directory.
+ *   price2, size2:  the ask of quote updates, the indicative clearing price and imbalance shares
+ *                   of auction information.
+ *   flags:          the byte following the type: flags, system or security event, trading or
+ *                   halt status, short sale test, price type or auction type.
+ *   detail:         short sale test detail, auction imbalance side, security directory LULD tier.
+ *   unsupported:    1 for types the record has no fields for, e.g. DEEP+ order messages. Only
+ *                   their type, flags, timestamp and capture time are set, the symbol is zero.
+ * Fields not listed, e.g. the auction collars, are only available through the C++ API. */
+typedef struct iex_record {
+  /* Nanoseconds since POSIX time UTC. */
+  int64_t timestamp;
+  /* Pcap capture time of the packet carrying the message, nanoseconds since POSIX time UTC. */
+  int64_t capture_time;
+  uint64_t trade_id;
+  /* Dollars. */
+  double price;
+  double price2;
+  uint32_t size;
+  uint32_t size2;
+  /* Padded with spaces, not null terminated. All spaces for system events. */
+  char symbol[8];
+  /* See iex_message_type_t. */
+  uint8_t type;
+  uint8_t flags;
+  uint8_t detail;
+  uint8_t unsupported;
+  uint8_t reserved[4];
+} iex_record_t;
+
+/* Columns to decode into, one array per field of iex_record_t with room for the number of rows
+ * requested. Null arrays are not written. symbol holds 8 characters per row. */
+typedef struct iex_columns {
+  int64_t* timestamp;
+  int64_t* capture_time;
+  uint64_t* trade_id;
+  double* price;
+  double* price2;
+  uint32_t* size;
+  uint32_t* size2;
+  char* symbol;
+  uint8_t* type;
+  uint8_t* flags;
+  uint8_t* detail;
+  uint8_t* unsupported;
+} iex_columns_t;
+
+/* Opaque decoder handle. */
+typedef struct iex_decoder iex_decoder_t;
+
+/* Describe a status, as a static string. */
+IEX_C_API const char* iex_status_string(iex_status_t status);
+
+/* Open a pcap file for decoding. On success *decoder is a new handle, to be closed with
+ * iex_close, otherwise it is null. */
+IEX_C_API iex_status_t iex_open(const char* filename, iex_decoder_t** decoder);
+
+/* Close a decoder and free its handle. Null is ignored. */
+IEX_C_API void iex_close(iex_decoder_t* decoder);
+
+/* Only decode messages of the given types, see iex_message_type_t. No types selects all types. */
+IEX_C_API iex_status_t iex_set_types(iex_decoder_t* decoder, const uint8_t* types,
+                                     size_t num_types);
+
+/* Only decode messages of the given symbols, null terminated strings. Messages without a symbol,
+ * like system events, no longer match. No symbols selects all symbols again. */
+IEX_C_API iex_status_t iex_set_symbols(iex_decoder_t* decoder, const char* const* symbols,
+                                       size_t num_symbols);
+
+/* Only decode messages timestamped within [start_time, end_time], nanoseconds since POSIX time
+ * UTC. Decoding stops once packets are sent well past the end. */
+IEX_C_API iex_status_t iex_set_time_range(iex_decoder_t* decoder, int64_t start_time,
+                                          int64_t end_time);
+
+/* Decode up to capacity messages into records. *num_decoded is set to the number of records
+ * written. Returns IEX_OK while more messages may follow, IEX_END_OF_STREAM once the file is
+ * done. The records written are valid with either. */
+IEX_C_API iex_status_t iex_decode_records(iex_decoder_t* decoder, iex_record_t* records,
+                                          size_t capacity, size_t* num_decoded);
+
+/* Decode up to capacity messages into columns, as iex_decode_records. */
+IEX_C_API iex_status_t iex_decode_columns(iex_decoder_t* decoder, const iex_columns_t* columns,
+                                          size_t capacity, size_t* num_decoded);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IEX_PCAP_C_H */
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "RawPacket.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_mapped_file.h"
+
+/// \struct PcapRecord
+/// \brief A record returned by PcapRecordReader. The data points into a buffer of the reader, or
+///        into the mapped file, wrap it in a pcpp::RawPacket that does not own it to parse it.
+struct PcapRecord {
+  /// \brief Byte offset of the record within the file, see PcapRecordReader::Seek.
+  uint64_t offset = 0;
+
+  const uint8_t* data = nullptr;
+  uint32_t len = 0;
+  timespec capture_time = timespec();
+  pcpp::LinkLayerType link_type = pcpp::LINKTYPE_ETHERNET;
+};
+
+/// \class PcapRecordReader
+/// \brief A minimal reader of pcap and pcapng files that, unlike the pcpp readers, reports the
+///        byte offset of every record and can seek straight to it.
+/// \note  Files in either byte order are read, the header fields of files written on a host of the
+///        other byte order are swapped. Of the pcapng blocks, enhanced and simple packet blocks
+///        are returned and all others are skipped.
+class PcapRecordReader {
+ public:
+  /// \brief Open a file and read its file header.
+  ///
+  /// \param filename A string to the relative or full path of the file.
+  /// \param map_file If set, the file is memory mapped and records point straight into the
+  ///                 mapping, without being copied. Their data then stays valid until the
+  ///                 reader is opened again or destroyed.
+  /// \return True if succeeds, false otherwise.
+  bool Open(const std::string& filename, const bool map_file = false) WARN_UNUSED;
+
+  /// \brief Continue reading at a record offset previously returned by ReadNextRecord.
+  /// \note  For pcapng files, the interface descriptions must have been read before, i.e. the
+  ///        first record must have been read once since Open.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool Seek(const uint64_t record_offset) WARN_UNUSED;
+
+  /// \brief Read the next record.
+  ///
+  /// \param record  Output parameter. Its data is valid until the next call, see Open for
+  ///                mapped files.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode ReadNextRecord(PcapRecord& record) WARN_UNUSED;
+
+  inline bool IsPcapng() const { return is_pcapng_; }
+
+ private:
+  /// \brief Link type and timestamp resolution of a capture interface.
+  struct CaptureInterface {
+    pcpp::LinkLayerType link_type = pcpp::LINKTYPE_ETHERNET;
+    /// \brief Either a power of ten, or a power of two if the highest bit is set, see pcapng.
+    uint8_t timestamp_resolution = 6;
+  };
+
+  /// \brief Read header fields, in the byte order of the file or of its current pcapng section.
+  inline uint16_t GetUInt16(const uint8_t* data_ptr, const size_t offset) const {
+    const uint16_t value = GetNumeric<uint16_t>(data_ptr, offset);
+    return swapped_ ? __builtin_bswap16(value) : value;
+  }
+  inline uint32_t GetUInt32(const uint8_t* data_ptr, const size_t offset) const {
+    const uint32_t value = GetNumeric<uint32_t>(data_ptr, offset);
+    return swapped_ ? __builtin_bswap32(value) : value;
+  }
+
+  /// \brief Read a pcapng interface description block body.
+  void AddInterface(const uint8_t* body_ptr, const size_t body_len);
+
+  /// \brief Convert a timestamp in the resolution of an interface to a timespec.
+  static timespec ToTimespec(const uint64_t timestamp, const uint8_t resolution);
+
+  /// \brief Read the next len bytes of the file.
+  ///
+  /// \param dest  Where to read them to, or null for buffer_. Unused for mapped files.
+  /// \return A pointer to the bytes, or null past the end of the file.
+  const uint8_t* ReadBytes(const size_t len, uint8_t* dest);
+
+  std::ifstream in_stream_;
+
+  /// \brief The mapped file and the read position within it, if opened with map_file.
+  MappedFile mapped_file_;
+  uint64_t mapped_pos_ = 0;
+
+  bool is_pcapng_ = false;
+
+  /// \brief Whether the file, or the current pcapng section, is in the other byte order.
+  bool swapped_ = false;
+
+  /// \brief Offset of the next record.
+  uint64_t offset_ = 0;
+
+  /// \brief For pcap files, whether timestamps have a nanosecond rather than microsecond part.
+  bool nanosecond_timestamps_ = false;
+
+  /// \brief The interfaces of a pcapng file, or the single link type of a pcap file.
+  std::vector<CaptureInterface> interfaces_;
+
+  std::vector<uint8_t> buffer_;
+};
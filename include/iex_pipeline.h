@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+#include "iex_pcap_reader.h"
+#include "iex_spsc_ring.h"
+
+/// \struct PipelineConfig
+/// \brief Tuning parameters for the PipelinedDecoder.
+struct PipelineConfig {
+  /// \brief Number of batches each ring between two stages can hold.
+  size_t ring_capacity = 64;
+
+  /// \brief Number of pcap records handed from the read stage to the decode stage at once.
+  size_t packet_batch_size = 64;
+
+  /// \brief Number of decoded messages handed from the decode stage to the consume stage at once.
+  size_t message_batch_size = 512;
+
+  /// \brief Cores to pin each stage to. Negative values leave the stage unpinned.
+  int reader_core = -1;
+  int decoder_core = -1;
+  int consumer_core = -1;
+};
+
+/// \class MessageSlot
+/// \brief Storage for one decoded message of any type. The message struct is constructed in
+///        place and only rebuilt when a message of another type is decoded into the slot, so
+///        decoding into a reused slot neither allocates nor calls Decode virtually.
+class MessageSlot {
+ public:
+  MessageSlot() = default;
+  ~MessageSlot() { Reset(); }
+
+  MessageSlot(const MessageSlot&) = delete;
+  MessageSlot& operator=(const MessageSlot&) = delete;
+
+  /// \brief Decode a message into the slot.
+  ///
+  /// \param msg_data_ptr  Pointer to the start of the message, its type byte.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode Decode(const uint8_t* msg_data_ptr) WARN_UNUSED;
+
+  /// \brief The message last decoded successfully.
+  inline const IEXMessageBase& Get() const { return *msg_ptr_; }
+
+ private:
+  /// \brief Construct a message of a type in the slot unless it already holds one, and decode.
+  template <typename Message>
+  ReturnCode DecodeAs(const uint8_t* msg_data_ptr, const MessageType type);
+
+  /// \brief Destroy the message held, if any.
+  void Reset();
+
+  typedef std::aligned_union<
+      0, SystemEventMessage, SecurityDirectoryMessage, TradingStatusMessage,
+      OperationalHaltStatusMessage, ShortSalePriceTestStatusMessage, QuoteUpdateMessage,
+      TradeReportMessage, OfficialPriceMessage, AuctionInformationMessage,
+      PriceLevelUpdateMessage, SecurityEventMessage, AddOrderMessage, OrderModifyMessage,
+      OrderDeleteMessage, OrderExecutedMessage, ClearBookMessage>::type Storage;
+
+  Storage storage_;
+  IEXMessageBase* msg_ptr_ = nullptr;
+  /// \brief Type byte of the message held, -1 if none.
+  int type_ = -1;
+};
+
+/// \class PipelinedDecoder
+/// \brief Decodes an IEX pcap file on three threads, connected by bounded SPSC rings.
+///
+///        Stage 1 frames the raw pcap records of the memory mapped file, without copying them.
+///        Stage 2 extracts the IEX-TP payload and decodes each block into a message slot.
+///        Stage 3 runs the registered consumers on every message, in stream order.
+/// \note  Batches are allocated once, when the decoder is constructed. The rings between the
+///        stages carry batch indexes, and every consumed batch is handed back to its producer
+///        through a ring in the opposite direction, so no stage allocates while running.
+class PipelinedDecoder {
+ public:
+  typedef std::function<void(const IEXMessageBase&)> Consumer;
+
+  explicit PipelinedDecoder(const PipelineConfig& config = PipelineConfig());
+
+  /// \brief Open a file for decoding. The file is memory mapped until the next call or
+  ///        destruction.
+  ///
+  /// \param filename A string to the relative or full path of the file.
+  /// \return True if succeeds, false otherwise.
+  bool OpenFileForDecoding(const std::string& filename) WARN_UNUSED;
+
+  /// \brief Register a consumer. Consumers are called on the consume stage thread, in the order
+  ///        they were added.
+  void AddConsumer(const Consumer& consumer) { consumers_.push_back(consumer); }
+
+  /// \brief Run all three stages until the whole file is consumed. Blocks until done.
+  ///
+  /// \return Success if the whole file was decoded, otherwise the first error encountered.
+  ReturnCode Run() WARN_UNUSED;
+
+  /// \brief Get the first header of the file. Valid after Run.
+  ///
+  /// \return A struct populated with the header information.
+  inline const IEXTPHeader& GetFirstHeader() const { return first_header_; }
+
+  /// \brief Number of messages delivered to the consumers by the last Run.
+  inline uint64_t GetMessageCount() const { return message_count_; }
+
+ private:
+  /// \brief Pcap records pointing into the mapped file. Records are preallocated to
+  ///        packet_batch_size, of which the first size are valid.
+  struct PacketBatch {
+    std::vector<PcapRecord> records;
+    size_t size = 0;
+  };
+
+  /// \brief Decoded messages, the first size of the message_batch_size slots are valid.
+  struct MessageBatch {
+    std::unique_ptr<MessageSlot[]> slots;
+    size_t size = 0;
+  };
+
+  void ReadStage();
+  void DecodeStage();
+  void ConsumeStage();
+
+  /// \brief Decode all blocks of a single record into message batches, pushing complete
+  ///        batches downstream and taking free ones.
+  ///
+  /// \param message_batch  In and output parameter, the index of the batch being filled.
+  ReturnCode DecodeRecord(const PcapRecord& record, size_t& message_batch) WARN_UNUSED;
+
+  /// \brief Push an item into a ring, waiting while it is full. Returns false if stopped.
+  template <typename T>
+  bool PushBlocking(SPSCRing<T>& ring, T&& item);
+
+  /// \brief Pop an item from a ring, waiting while it is empty. Returns false if stopped.
+  template <typename T>
+  bool PopBlocking(SPSCRing<T>& ring, T& item);
+
+  /// \brief Record an error from any stage and ask all stages to stop.
+  void Fail(const ReturnCode code);
+
+  PipelineConfig config_;
+
+  PcapRecordReader reader_;
+
+  std::vector<Consumer> consumers_;
+
+  /// \brief The batches, addressed by index by the rings.
+  std::vector<PacketBatch> packet_batches_;
+  std::vector<MessageBatch> message_batches_;
+
+  /// \brief Full batches, from the read to the decode stage and from the decode to the consume
+  ///        stage.
+  SPSCRing<size_t> packet_ring_;
+  SPSCRing<size_t> message_ring_;
+
+  /// \brief Empty batches, handed back upstream.
+  SPSCRing<size_t> free_packet_ring_;
+  SPSCRing<size_t> free_message_ring_;
+
+  /// \brief Set by the upstream stage once it has pushed its last batch.
+  std::atomic<bool> read_done_{false};
+  std::atomic<bool> decode_done_{false};
+
+  /// \brief Set on error to make all stages exit early.
+  std::atomic<bool> stop_{false};
+  std::atomic<int> error_{static_cast<int>(ReturnCode::Success)};
+
+  /// \brief Only written by the decode stage, read after the threads are joined.
+  IEXTPHeader first_header_;
+  bool have_first_header_ = false;
+
+  /// \brief Only written by the consume stage, read after the threads are joined.
+  uint64_t message_count_ = 0;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+
+/// \enum class MessageField
+/// \brief Numeric message fields a query can compare against.
+enum class MessageField { Price, Size, BidPrice, BidSize, AskPrice, AskSize };
+
+/// \enum class Comparison
+/// \brief Comparison operators of a query, in the order of their symbols: < <= = != >= >.
+enum class Comparison { Less, LessEqual, Equal, NotEqual, GreaterEqual, Greater };
+
+/// \struct FieldCondition
+/// \brief A comparison of a message field against a constant, e.g. price>100.
+struct FieldCondition {
+  MessageField field;
+  Comparison comparison;
+  double value;
+
+  /// \brief True if the message has the field and the comparison holds, see GetFieldValue.
+  bool Matches(const IEXMessageBase& msg) const;
+};
+
+/// \brief Get a numeric field of a message. Price and size are those of trades, official prices
+///        and price levels, quotes have bid and ask fields instead.
+///
+/// \return True if the message type has the field, false otherwise.
+bool GetFieldValue(const IEXMessageBase& msg, const MessageField field, double& value) WARN_UNUSED;
+
+/// \brief Convert a message type name, as in the MessageType enum, to its type. Case insensitive.
+///
+/// \return True if the name is known, false otherwise.
+bool ParseMessageType(const std::string& name, MessageType& message_type) WARN_UNUSED;
+
+/// \brief Get the start of the US/Eastern day a timestamp falls on, taking daylight saving time
+///        into account. IEX timestamps are UTC, while the trading day is defined in New York time.
+///
+/// \param timestamp  Nanoseconds since POSIX time UTC.
+/// \return Local midnight, nanoseconds since POSIX time UTC.
+int64_t GetEasternMidnight(const int64_t timestamp);
+
+/// \class MessageQuery
+/// \brief A parsed query expression selecting messages, such as
+///        "type=TradeReport symbol in (AAPL,AMD) time 09:30-10:00 price>100".
+/// \note  All terms must hold. The terms are:
+///        - type=NAME or type in (NAME,...) with the names of the MessageType enum.
+///        - symbol=SYM or symbol in (SYM,...).
+///        - time START-END, either times of day HH:MM[:SS[.fff]] in US/Eastern time, inclusive,
+///          or nanoseconds since POSIX time UTC. 24:00 is the end of the day, and END must not
+///          be before START.
+///        - FIELD OP NUMBER with FIELD one of price, size, bid_price, bid_size, ask_price,
+///          ask_size and OP one of < <= = != >= >.
+///        Types, symbols and time are pushed down into the decoder as a MessageFilter, so only
+///        messages passing them are decoded. Field conditions are checked on decoded messages.
+class MessageQuery {
+ public:
+  /// \brief Parse a query expression, replacing the current query.
+  ///
+  /// \return True if succeeds, false otherwise. The error is logged.
+  bool Parse(const std::string& expression) WARN_UNUSED;
+
+  /// \brief Get the decoder filter for the types, symbols and time range of the query.
+  ///
+  /// \param reference_time  Any timestamp on the trading day that times of day refer to, e.g. the
+  ///                        send time of the first header of a file.
+  MessageFilter GetFilter(const int64_t reference_time) const;
+
+  /// \brief True if a decoded message passes all field conditions.
+  inline bool Matches(const IEXMessageBase& msg) const {
+    for (const auto& condition : conditions_) {
+      if (!condition.Matches(msg)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  inline const std::vector<MessageType>& GetTypes() const { return types_; }
+  inline const std::vector<std::string>& GetSymbols() const { return symbols_; }
+  inline const std::vector<FieldCondition>& GetConditions() const { return conditions_; }
+
+ private:
+  std::vector<MessageType> types_;
+  std::vector<std::string> symbols_;
+  std::vector<FieldCondition> conditions_;
+
+  /// \brief The time range, either nanoseconds since midnight US/Eastern or since POSIX time UTC.
+  bool time_of_day_ = false;
+  int64_t start_time_ = std::numeric_limits<int64_t>::min();
+  int64_t end_time_ = std::numeric_limits<int64_t>::max();
+};
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+
+/// \brief Get a readable name of a protocol, e.g. "TOPS 1.6".
+///
+/// \param protocol_id  IEXTPHeader::protocol_id, see ProtocolId.
+/// \return The name, or "Unknown" for protocols without a policy below.
+std::string GetProtocolName(const uint16_t protocol_id);
+
+/// \struct Tops16Protocol
+/// \brief Compile time policy of the TOPS 1.6 feed: its message types and how each is decoded.
+///        ProtocolDecoder instantiates one decode loop per policy, so the types a feed never
+///        carries compile away and every Decode is a direct call.
+/// \note  TOPS 1.5 files share the protocol id and message layouts of 1.6, so they are decoded
+///        by this policy too.
+struct Tops16Protocol {
+  constexpr static ProtocolId id = ProtocolId::TOPS;
+
+  /// \brief True if the feed carries a message type.
+  constexpr static bool HasType(const MessageType type) {
+    return type == MessageType::SystemEvent || type == MessageType::SecurityDirectory ||
+           type == MessageType::TradingStatus || type == MessageType::OperationalHaltStatus ||
+           type == MessageType::ShortSalePriceTestStatus || type == MessageType::QuoteUpdate ||
+           type == MessageType::TradeReport || type == MessageType::TradeBreak ||
+           type == MessageType::OfficialPrice || type == MessageType::AuctionInformation;
+  }
+
+  /// \brief Decode a message of the feed into its struct, calling Decode non virtually.
+  template <typename Message>
+  static inline bool Decode(const uint8_t* data_ptr, Message& msg) {
+    return msg.Message::Decode(data_ptr);
+  }
+};
+
+/// \struct Deep10Protocol
+/// \brief Policy of the DEEP 1.0 feed: price level updates and security events instead of quote
+///        updates.
+struct Deep10Protocol {
+  constexpr static ProtocolId id = ProtocolId::DEEP;
+
+  constexpr static bool HasType(const MessageType type) {
+    return type == MessageType::SystemEvent || type == MessageType::SecurityDirectory ||
+           type == MessageType::TradingStatus || type == MessageType::OperationalHaltStatus ||
+           type == MessageType::ShortSalePriceTestStatus || type == MessageType::SecurityEvent ||
+           type == MessageType::PriceLevelUpdateBuy || type == MessageType::PriceLevelUpdateSell ||
+           type == MessageType::TradeReport || type == MessageType::TradeBreak ||
+           type == MessageType::OfficialPrice || type == MessageType::AuctionInformation;
+  }
+
+  template <typename Message>
+  static inline bool Decode(const uint8_t* data_ptr, Message& msg) {
+    return msg.Message::Decode(data_ptr);
+  }
+};
+
+/// \struct DeepPlus10Protocol
+/// \brief Policy of the DEEP+ 1.0 feed: the administrative and trade messages of DEEP, with
+///        every displayed order reported by order messages instead of price level updates.
+struct DeepPlus10Protocol {
+  constexpr static ProtocolId id = ProtocolId::DEEP_PLUS;
+
+  constexpr static bool HasType(const MessageType type) {
+    return type == MessageType::SystemEvent || type == MessageType::SecurityDirectory ||
+           type == MessageType::TradingStatus || type == MessageType::OperationalHaltStatus ||
+           type == MessageType::ShortSalePriceTestStatus || type == MessageType::SecurityEvent ||
+           type == MessageType::AddOrder || type == MessageType::OrderModify ||
+           type == MessageType::OrderDelete || type == MessageType::OrderExecuted ||
+           type == MessageType::ClearBook || type == MessageType::TradeReport ||
+           type == MessageType::TradeBreak || type == MessageType::OfficialPrice ||
+           type == MessageType::AuctionInformation;
+  }
+
+  template <typename Message>
+  static inline bool Decode(const uint8_t* data_ptr, Message& msg) {
+    return msg.Message::Decode(data_ptr);
+  }
+};
+
+/// \class ProtocolDecoder
+/// \brief A decode loop specialized for one protocol policy. Messages are decoded into structs
+///        owned by the decoder and reused, and handed to a handler by their concrete type, e.g.
+///
+///        struct Handler {
+///          void operator()(const QuoteUpdateMessage& msg) { ... }
+///          template <typename Message> void operator()(const Message&) {}
+///        };
+///
+///        A handler taking const IEXMessageBase& receives every message.
+/// \note  A message type the protocol does not carry ends decoding with UnknownMessageType, as
+///        GetNextMessage does for unknown types.
+/// \note  Messages are dispatched through a table of 256 functions per handler type, indexed by
+///        the type byte. Each entry decodes one type into its struct and calls the handler, so the
+///        per message dispatch is a single indirect call instead of a switch, a factory allocation
+///        and a virtual Decode.
+template <typename Protocol>
+class ProtocolDecoder {
+ public:
+  ProtocolDecoder()
+      : trade_report_(MessageType::TradeReport),
+        trade_break_(MessageType::TradeBreak),
+        price_level_buy_(MessageType::PriceLevelUpdateBuy),
+        price_level_sell_(MessageType::PriceLevelUpdateSell),
+        security_event_(MessageType::SecurityEvent) {}
+
+  /// \brief Decode every remaining message of a decoder into a handler.
+  ///
+  /// \return ReturnCode enum describing success or a specific error code.
+  template <typename Handler>
+  ReturnCode Run(IEXDecoder& decoder, Handler& handler) {
+    const uint8_t* msg_data_ptr = nullptr;
+    size_t msg_len = 0;
+    auto ret_code = ReturnCode::Success;
+    while ((ret_code = decoder.GetNextMessageData(msg_data_ptr, msg_len)) == ReturnCode::Success) {
+      ret_code = Dispatch(msg_data_ptr, handler);
+      if (ret_code != ReturnCode::Success) {
+        return ret_code;
+      }
+    }
+    return ret_code == ReturnCode::EndOfStream ? ReturnCode::Success : ret_code;
+  }
+
+  /// \brief Decode one raw message and hand it to a handler, through the dispatch table.
+  ///
+  /// \param msg_data_ptr  Pointer to the start of the message, its type byte.
+  /// \return ReturnCode enum describing success or a specific error code.
+  template <typename Handler>
+  inline ReturnCode Dispatch(const uint8_t* msg_data_ptr, Handler& handler) {
+    return GetDispatchTable<Handler>(typename MakeIndexList<256>::type())[*msg_data_ptr](
+        *this, msg_data_ptr, handler);
+  }
+
+  /// \brief The same as Dispatch, with a switch on the type byte. Kept as the reference for tests
+  ///        and benchmarks of the dispatch table.
+  template <typename Handler>
+  ReturnCode DispatchSwitch(const uint8_t* msg_data_ptr, Handler& handler) {
+    switch (static_cast<MessageType>(*msg_data_ptr)) {
+      case MessageType::QuoteUpdate:
+        return Deliver<MessageType::QuoteUpdate>(msg_data_ptr, quote_update_, handler);
+      case MessageType::PriceLevelUpdateBuy:
+        return Deliver<MessageType::PriceLevelUpdateBuy>(msg_data_ptr, price_level_buy_, handler);
+      case MessageType::PriceLevelUpdateSell:
+        return Deliver<MessageType::PriceLevelUpdateSell>(msg_data_ptr, price_level_sell_,
+                                                          handler);
+      case MessageType::TradeReport:
+        return Deliver<MessageType::TradeReport>(msg_data_ptr, trade_report_, handler);
+      case MessageType::TradeBreak:
+        return Deliver<MessageType::TradeBreak>(msg_data_ptr, trade_break_, handler);
+      case MessageType::TradingStatus:
+        return Deliver<MessageType::TradingStatus>(msg_data_ptr, trading_status_, handler);
+      case MessageType::OperationalHaltStatus:
+        return Deliver<MessageType::OperationalHaltStatus>(msg_data_ptr, operational_halt_status_,
+                                                           handler);
+      case MessageType::ShortSalePriceTestStatus:
+        return Deliver<MessageType::ShortSalePriceTestStatus>(
+            msg_data_ptr, short_sale_price_test_status_, handler);
+      case MessageType::SecurityEvent:
+        return Deliver<MessageType::SecurityEvent>(msg_data_ptr, security_event_, handler);
+      case MessageType::AuctionInformation:
+        return Deliver<MessageType::AuctionInformation>(msg_data_ptr, auction_information_,
+                                                        handler);
+      case MessageType::OfficialPrice:
+        return Deliver<MessageType::OfficialPrice>(msg_data_ptr, official_price_, handler);
+      case MessageType::SecurityDirectory:
+        return Deliver<MessageType::SecurityDirectory>(msg_data_ptr, security_directory_, handler);
+      case MessageType::SystemEvent:
+        return Deliver<MessageType::SystemEvent>(msg_data_ptr, system_event_, handler);
+      case MessageType::AddOrder:
+        return Deliver<MessageType::AddOrder>(msg_data_ptr, add_order_, handler);
+      case MessageType::OrderModify:
+        return Deliver<MessageType::OrderModify>(msg_data_ptr, order_modify_, handler);
+      case MessageType::OrderDelete:
+        return Deliver<MessageType::OrderDelete>(msg_data_ptr, order_delete_, handler);
+      case MessageType::OrderExecuted:
+        return Deliver<MessageType::OrderExecuted>(msg_data_ptr, order_executed_, handler);
+      case MessageType::ClearBook:
+        return Deliver<MessageType::ClearBook>(msg_data_ptr, clear_book_, handler);
+      default:
+        IEX_LOG("Unknown message type " << PRINTHEX(*msg_data_ptr));
+        return ReturnCode::UnknownMessageType;
+    }
+  }
+
+ private:
+  template <MessageType type, typename Message, typename Handler>
+  inline ReturnCode Deliver(const uint8_t* msg_data_ptr, Message& msg, Handler& handler) {
+    if (!Protocol::HasType(type)) {
+      IEX_LOG("Unexpected message type " << PRINTHEX(type) << " for protocol "
+                                         << GetProtocolName(static_cast<uint16_t>(Protocol::id)));
+      return ReturnCode::UnknownMessageType;
+    }
+    if (!Protocol::Decode(msg_data_ptr, msg)) {
+      return ReturnCode::FailedDecodingPacket;
+    }
+    handler(static_cast<const Message&>(msg));
+    return ReturnCode::Success;
+  }
+
+  template <size_t... I>
+  struct IndexList {};
+
+  /// \brief IndexList<0, 1, ..., N - 1>, to expand the dispatch table from.
+  template <size_t N, size_t... I>
+  struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+
+  template <size_t... I>
+  struct MakeIndexList<0, I...> {
+    typedef IndexList<I...> type;
+  };
+
+  template <typename Handler>
+  using DispatchEntry = ReturnCode (*)(ProtocolDecoder&, const uint8_t*, Handler&);
+
+  template <MessageType type>
+  using TypeTag = std::integral_constant<MessageType, type>;
+
+  /// \brief Entry of the dispatch table for a type byte the protocol does not carry.
+  template <size_t type, typename Handler,
+            bool carried = Protocol::HasType(static_cast<MessageType>(type))>
+  struct TableEntry {
+    static ReturnCode Call(ProtocolDecoder&, const uint8_t*, Handler&) {
+      IEX_LOG("Unknown message type " << PRINTHEX(type) << " for protocol "
+                                      << GetProtocolName(static_cast<uint16_t>(Protocol::id)));
+      return ReturnCode::UnknownMessageType;
+    }
+  };
+
+  /// \brief Entry of the dispatch table for a type byte of the protocol.
+  template <size_t type, typename Handler>
+  struct TableEntry<type, Handler, true> {
+    static ReturnCode Call(ProtocolDecoder& self, const uint8_t* msg_data_ptr, Handler& handler) {
+      return self.template Deliver<static_cast<MessageType>(type)>(
+          msg_data_ptr, self.MessageFor(TypeTag<static_cast<MessageType>(type)>()), handler);
+    }
+  };
+
+  /// \brief The dispatch table of a handler type, built at compile time.
+  template <typename Handler, size_t... I>
+  static inline const DispatchEntry<Handler>* GetDispatchTable(IndexList<I...>) {
+    static constexpr DispatchEntry<Handler> table[sizeof...(I)] = {
+        &TableEntry<I, Handler>::Call...};
+    return table;
+  }
+
+  /// \brief The reused struct of each message type.
+  SystemEventMessage& MessageFor(TypeTag<MessageType::SystemEvent>) { return system_event_; }
+  SecurityDirectoryMessage& MessageFor(TypeTag<MessageType::SecurityDirectory>) {
+    return security_directory_;
+  }
+  TradingStatusMessage& MessageFor(TypeTag<MessageType::TradingStatus>) {
+    return trading_status_;
+  }
+  OperationalHaltStatusMessage& MessageFor(TypeTag<MessageType::OperationalHaltStatus>) {
+    return operational_halt_status_;
+  }
+  ShortSalePriceTestStatusMessage& MessageFor(TypeTag<MessageType::ShortSalePriceTestStatus>) {
+    return short_sale_price_test_status_;
+  }
+  QuoteUpdateMessage& MessageFor(TypeTag<MessageType::QuoteUpdate>) { return quote_update_; }
+  TradeReportMessage& MessageFor(TypeTag<MessageType::TradeReport>) { return trade_report_; }
+  TradeReportMessage& MessageFor(TypeTag<MessageType::TradeBreak>) { return trade_break_; }
+  OfficialPriceMessage& MessageFor(TypeTag<MessageType::OfficialPrice>) {
+    return official_price_;
+  }
+  AuctionInformationMessage& MessageFor(TypeTag<MessageType::AuctionInformation>) {
+    return auction_information_;
+  }
+  PriceLevelUpdateMessage& MessageFor(TypeTag<MessageType::PriceLevelUpdateBuy>) {
+    return price_level_buy_;
+  }
+  PriceLevelUpdateMessage& MessageFor(TypeTag<MessageType::PriceLevelUpdateSell>) {
+    return price_level_sell_;
+  }
+  SecurityEventMessage& MessageFor(TypeTag<MessageType::SecurityEvent>) {
+    return security_event_;
+  }
+  AddOrderMessage& MessageFor(TypeTag<MessageType::AddOrder>) { return add_order_; }
+  OrderModifyMessage& MessageFor(TypeTag<MessageType::OrderModify>) { return order_modify_; }
+  OrderDeleteMessage& MessageFor(TypeTag<MessageType::OrderDelete>) { return order_delete_; }
+  OrderExecutedMessage& MessageFor(TypeTag<MessageType::OrderExecuted>) {
+    return order_executed_;
+  }
+  ClearBookMessage& MessageFor(TypeTag<MessageType::ClearBook>) { return clear_book_; }
+
+  SystemEventMessage system_event_;
+  SecurityDirectoryMessage security_directory_;
+  TradingStatusMessage trading_status_;
+  OperationalHaltStatusMessage operational_halt_status_;
+  ShortSalePriceTestStatusMessage short_sale_price_test_status_;
+  QuoteUpdateMessage quote_update_;
+  TradeReportMessage trade_report_;
+  TradeReportMessage trade_break_;
+  OfficialPriceMessage official_price_;
+  AuctionInformationMessage auction_information_;
+  PriceLevelUpdateMessage price_level_buy_;
+  PriceLevelUpdateMessage price_level_sell_;
+  SecurityEventMessage security_event_;
+  AddOrderMessage add_order_;
+  OrderModifyMessage order_modify_;
+  OrderDeleteMessage order_delete_;
+  OrderExecutedMessage order_executed_;
+  ClearBookMessage clear_book_;
+};
+
+/// \brief Decode every remaining message of a decoder with the ProtocolDecoder of its protocol,
+///        selected from the protocol id of the first header.
+///
+/// \return ReturnCode enum describing success or a specific error code. FailedParsingPacket if
+///         the protocol is not supported.
+template <typename Handler>
+ReturnCode DecodeProtocol(IEXDecoder& decoder, Handler& handler) WARN_UNUSED;
+
+template <typename Handler>
+ReturnCode DecodeProtocol(IEXDecoder& decoder, Handler& handler) {
+  const uint16_t protocol_id = decoder.GetFirstHeader().protocol_id;
+  switch (static_cast<ProtocolId>(protocol_id)) {
+    case ProtocolId::TOPS: {
+      ProtocolDecoder<Tops16Protocol> protocol_decoder;
+      return protocol_decoder.Run(decoder, handler);
+    }
+    case ProtocolId::DEEP: {
+      ProtocolDecoder<Deep10Protocol> protocol_decoder;
+      return protocol_decoder.Run(decoder, handler);
+    }
+    case ProtocolId::DEEP_PLUS: {
+      ProtocolDecoder<DeepPlus10Protocol> protocol_decoder;
+      return protocol_decoder.Run(decoder, handler);
+    }
+  }
+  IEX_LOG("Unsupported protocol id " << PRINTHEX(protocol_id));
+  return ReturnCode::FailedParsingPacket;
+}
+
+/// \brief Decode a file with the ProtocolDecoder of its protocol, see DecodeProtocol.
+///
+/// \return ReturnCode enum describing success or a specific error code.
+template <typename Handler>
+ReturnCode DecodeProtocolFile(const std::string& filename, Handler& handler) WARN_UNUSED;
+
+template <typename Handler>
+ReturnCode DecodeProtocolFile(const std::string& filename, Handler& handler) {
+  IEXDecoder decoder;
+  if (!decoder.OpenFileForDecoding(filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+  return DecodeProtocol(decoder, handler);
+}
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+#include "iex_symbol_table.h"
+
+/// \struct ReplayConfig
+/// \brief Capacities of a ReplayEngine. Everything is allocated up front, so a replay never
+///        allocates once it runs.
+struct ReplayConfig {
+  /// \brief Number of symbols with L1 and L2 state. Symbols seen after the first max_symbols are
+  ///        still dispatched, with ReplayState::npos as their id and without state.
+  size_t max_symbols = 16384;
+
+  /// \brief Number of price levels kept per side of each book. Levels pushed out by better ones
+  ///        are forgotten, see ReplayState::GetNumDroppedLevels.
+  size_t max_book_levels = 32;
+
+  /// \brief Number of timers that can be pending at once.
+  size_t max_timers = 4096;
+};
+
+/// \struct TopOfBook
+/// \brief L1 state of a symbol: the best bid and ask, and the last trade.
+struct TopOfBook {
+  /// \brief Timestamp of the last change, nanoseconds since POSIX time UTC.
+  int64_t timestamp = 0;
+
+  /// \brief Best bid and ask, zero if there is none.
+  double bid_price = 0;
+  uint32_t bid_size = 0;
+  double ask_price = 0;
+  uint32_t ask_size = 0;
+
+  double last_trade_price = 0;
+  uint32_t last_trade_size = 0;
+};
+
+/// \struct PriceLevel
+/// \brief One price level of a book side.
+struct PriceLevel {
+  double price;
+  uint32_t size;
+};
+
+/// \struct BookLevels
+/// \brief A read only view of one side of a book, best price first.
+struct BookLevels {
+  const PriceLevel* levels;
+  size_t num_levels;
+
+  inline size_t size() const { return num_levels; }
+  inline bool empty() const { return num_levels == 0; }
+  inline const PriceLevel& operator[](const size_t i) const { return levels[i]; }
+};
+
+/// \class ReplayState
+/// \brief The simulated market seen by a strategy during a replay: the clock, timers, and the L1
+///        and L2 state of every symbol. Strategies read it and schedule timers, the ReplayEngine
+///        updates it.
+/// \note  L1 comes from TOPS quote updates, or from the top of the book for DEEP. L2 books are
+///        only built from DEEP price level updates.
+class ReplayState {
+ public:
+  /// \brief Id of symbols without state, see ReplayConfig::max_symbols.
+  constexpr static uint32_t npos = SymbolTable::npos;
+
+  explicit ReplayState(const ReplayConfig& config = ReplayConfig());
+
+  /// \brief The simulated clock: the timestamp of the message or timer being dispatched,
+  ///        nanoseconds since POSIX time UTC. It never goes backwards.
+  inline int64_t GetTime() const { return time_; }
+
+  /// \brief Schedule a timer in exchange time. It fires before any message with a timestamp at or
+  ///        after its time, timers due at the same time fire in the order they were scheduled.
+  ///        A time in the past fires before the next message.
+  ///
+  /// \param time      Nanoseconds since POSIX time UTC.
+  /// \param timer_id  Passed back to the strategy when the timer fires.
+  /// \return True if succeeds, false if max_timers timers are already pending.
+  bool ScheduleTimer(const int64_t time, const uint64_t timer_id) WARN_UNUSED;
+
+  inline size_t GetNumPendingTimers() const { return timers_.size(); }
+
+  /// \brief Get the id of a symbol, or npos if it has not been seen.
+  inline uint32_t FindSymbol(const std::string& symbol) const {
+    return symbol_table_.Find(PackSymbol(symbol));
+  }
+
+  inline const SymbolTable& GetSymbolTable() const { return symbol_table_; }
+
+  inline const TopOfBook& GetTopOfBook(const uint32_t id) const { return tops_[id]; }
+
+  /// \brief The bid and ask sides of the book of a symbol, best price first.
+  inline BookLevels GetBids(const uint32_t id) const { return GetLevels(id, buy_side); }
+  inline BookLevels GetAsks(const uint32_t id) const { return GetLevels(id, sell_side); }
+
+  /// \brief Number of messages of symbols beyond max_symbols.
+  inline uint64_t GetNumDroppedSymbols() const { return num_dropped_symbols_; }
+
+  /// \brief Number of price levels forgotten because a book side had max_book_levels levels.
+  inline uint64_t GetNumDroppedLevels() const { return num_dropped_levels_; }
+
+ private:
+  template <typename Strategy>
+  friend class ReplayEngine;
+
+  constexpr static size_t buy_side = 0;
+  constexpr static size_t sell_side = 1;
+
+  struct Timer {
+    int64_t time;
+    uint64_t sequence;
+    uint64_t timer_id;
+  };
+
+  /// \brief Orders the timer heap by time, then by the order timers were scheduled.
+  struct TimerLater {
+    inline bool operator()(const Timer& a, const Timer& b) const {
+      return a.time > b.time || (a.time == b.time && a.sequence > b.sequence);
+    }
+  };
+
+  inline BookLevels GetLevels(const uint32_t id, const size_t side) const {
+    const size_t book = 2 * id + side;
+    return BookLevels{&levels_[book * config_.max_book_levels], level_counts_[book]};
+  }
+
+  /// \brief Get the id of the symbol of a message, adding it if it is new and there is room.
+  uint32_t GetSymbolId(const uint8_t* msg_data_ptr, const size_t msg_len);
+
+  void ApplyQuoteUpdate(const uint32_t id, const QuoteUpdateMessage& msg);
+  void ApplyTradeReport(const uint32_t id, const TradeReportMessage& msg);
+  void ApplyPriceLevelUpdate(const uint32_t id, const PriceLevelUpdateMessage& msg);
+
+  inline bool IsTimerDue(const int64_t time) const {
+    return !timers_.empty() && timers_.front().time <= time;
+  }
+
+  /// \brief Remove the earliest timer and move the clock to it.
+  Timer PopTimer();
+
+  /// \brief Move the clock forward to a time, never backwards.
+  inline void AdvanceTime(const int64_t time) { time_ = std::max(time_, time); }
+
+  ReplayConfig config_;
+  int64_t time_ = 0;
+  SymbolTable symbol_table_;
+  std::vector<TopOfBook> tops_;
+
+  /// \brief Book sides, max_book_levels levels each, indexed by 2 * symbol id + side.
+  std::vector<PriceLevel> levels_;
+  std::vector<size_t> level_counts_;
+
+  /// \brief Pending timers as a binary min-heap, see TimerLater. Capacity is reserved up front.
+  std::vector<Timer> timers_;
+  uint64_t timer_sequence_ = 0;
+
+  uint64_t num_dropped_symbols_ = 0;
+  uint64_t num_dropped_levels_ = 0;
+};
+
+/// \struct ReplayStrategy
+/// \brief Base of replay strategies with a no-op handler for every event. Derive from it and
+///        define handlers with the same signatures for the events of interest; ReplayEngine calls
+///        them statically, so there is no virtual call and unused events compile away.
+/// \note  Handlers with a symbol id receive ReplayState::npos for symbols without state. L1 and
+///        L2 state is updated before the handler of a quote, trade or price level update runs.
+struct ReplayStrategy {
+  inline void OnSystemEvent(ReplayState&, const SystemEventMessage&) {}
+  inline void OnSecurityDirectory(ReplayState&, const uint32_t, const SecurityDirectoryMessage&) {}
+  inline void OnTradingStatus(ReplayState&, const uint32_t, const TradingStatusMessage&) {}
+  inline void OnOperationalHaltStatus(ReplayState&, const uint32_t,
+                                      const OperationalHaltStatusMessage&) {}
+  inline void OnShortSalePriceTestStatus(ReplayState&, const uint32_t,
+                                         const ShortSalePriceTestStatusMessage&) {}
+  inline void OnSecurityEvent(ReplayState&, const uint32_t, const SecurityEventMessage&) {}
+  inline void OnQuoteUpdate(ReplayState&, const uint32_t, const QuoteUpdateMessage&) {}
+  inline void OnTradeReport(ReplayState&, const uint32_t, const TradeReportMessage&) {}
+  inline void OnTradeBreak(ReplayState&, const uint32_t, const TradeReportMessage&) {}
+  inline void OnOfficialPrice(ReplayState&, const uint32_t, const OfficialPriceMessage&) {}
+  inline void OnAuctionInformation(ReplayState&, const uint32_t, const AuctionInformationMessage&) {
+  }
+  inline void OnPriceLevelUpdate(ReplayState&, const uint32_t, const PriceLevelUpdateMessage&) {}
+
+  /// \brief A timer scheduled with ReplayState::ScheduleTimer fired. The clock is at its time.
+  inline void OnTimer(ReplayState&, const uint64_t) {}
+};
+
+/// \class ReplayEngine
+/// \brief Deterministic event driven replay of a decoder stream into a strategy. The clock follows
+///        the message timestamps, timers fire in exchange time between messages, and the L1 and
+///        L2 state is kept up to date for the strategy to read.
+/// \note  Messages are decoded into message structs owned by the engine and reused, and all
+///        state is allocated up front, so the event loop does not allocate. Dispatch is a switch
+///        on the message type calling the strategy directly. Runs are single threaded and depend
+///        on nothing but the input, so they are reproducible bit for bit.
+template <typename Strategy>
+class ReplayEngine {
+ public:
+  /// \param strategy  The strategy receiving events, must outlive the engine.
+  explicit ReplayEngine(Strategy& strategy, const ReplayConfig& config = ReplayConfig())
+      : strategy_(strategy),
+        state_(config),
+        trade_report_(MessageType::TradeReport),
+        trade_break_(MessageType::TradeBreak),
+        price_level_buy_(MessageType::PriceLevelUpdateBuy),
+        price_level_sell_(MessageType::PriceLevelUpdateSell),
+        security_event_(MessageType::SecurityEvent) {}
+
+  /// \brief Replay every remaining message of a decoder. May be called again with further
+  ///        decoders, e.g. the next day, continuing with the same state and clock.
+  ///
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode Run(IEXDecoder& decoder) WARN_UNUSED {
+    const uint8_t* msg_data_ptr = nullptr;
+    size_t msg_len = 0;
+    auto ret_code = ReturnCode::Success;
+    while ((ret_code = decoder.GetNextMessageData(msg_data_ptr, msg_len)) == ReturnCode::Success) {
+      ret_code = Dispatch(msg_data_ptr, msg_len);
+      if (ret_code != ReturnCode::Success) {
+        return ret_code;
+      }
+    }
+    return ret_code == ReturnCode::EndOfStream ? ReturnCode::Success : ret_code;
+  }
+
+  /// \brief Replay a file.
+  ///
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode Run(const std::string& filename) WARN_UNUSED {
+    IEXDecoder decoder;
+    if (!decoder.OpenFileForDecoding(filename)) {
+      return ReturnCode::ClassNotInitialized;
+    }
+    return Run(decoder);
+  }
+
+  /// \brief Fire the timers due at or before a time and move the clock to it, e.g. to run the
+  ///        timers left at the end of a session.
+  void RunTimersUntil(const int64_t time) {
+    while (state_.IsTimerDue(time)) {
+      const ReplayState::Timer timer = state_.PopTimer();
+      strategy_.OnTimer(state_, timer.timer_id);
+      ++num_events_;
+    }
+    state_.AdvanceTime(time);
+  }
+
+  inline const ReplayState& GetState() const { return state_; }
+
+  /// \brief Number of messages and timers dispatched.
+  inline uint64_t GetNumEvents() const { return num_events_; }
+
+ private:
+  /// \brief Decode a message into its reused struct, then run the timers due before it.
+  /// \note  Message::Decode is called non virtually, the type is known here.
+  template <typename Message>
+  inline bool Decode(Message& msg, const uint8_t* msg_data_ptr) {
+    if (!msg.Message::Decode(msg_data_ptr)) {
+      return false;
+    }
+    RunTimersUntil(static_cast<int64_t>(msg.timestamp));
+    ++num_events_;
+    return true;
+  }
+
+  ReturnCode Dispatch(const uint8_t* msg_data_ptr, const size_t msg_len) {
+    const auto msg_type = static_cast<MessageType>(*msg_data_ptr);
+    if (msg_type == MessageType::SystemEvent) {
+      if (!Decode(system_event_, msg_data_ptr)) {
+        return ReturnCode::FailedDecodingPacket;
+      }
+      strategy_.OnSystemEvent(state_, system_event_);
+      return ReturnCode::Success;
+    }
+
+    const uint32_t id = state_.GetSymbolId(msg_data_ptr, msg_len);
+    switch (msg_type) {
+      case MessageType::QuoteUpdate:
+        if (!Decode(quote_update_, msg_data_ptr)) {
+          break;
+        }
+        if (id != ReplayState::npos) {
+          state_.ApplyQuoteUpdate(id, quote_update_);
+        }
+        strategy_.OnQuoteUpdate(state_, id, quote_update_);
+        return ReturnCode::Success;
+      case MessageType::TradeReport:
+        if (!Decode(trade_report_, msg_data_ptr)) {
+          break;
+        }
+        if (id != ReplayState::npos) {
+          state_.ApplyTradeReport(id, trade_report_);
+        }
+        strategy_.OnTradeReport(state_, id, trade_report_);
+        return ReturnCode::Success;
+      case MessageType::PriceLevelUpdateBuy:
+      case MessageType::PriceLevelUpdateSell: {
+        PriceLevelUpdateMessage& msg =
+            msg_type == MessageType::PriceLevelUpdateBuy ? price_level_buy_ : price_level_sell_;
+        if (!Decode(msg, msg_data_ptr)) {
+          break;
+        }
+        if (id != ReplayState::npos) {
+          state_.ApplyPriceLevelUpdate(id, msg);
+        }
+        strategy_.OnPriceLevelUpdate(state_, id, msg);
+        return ReturnCode::Success;
+      }
+      case MessageType::TradeBreak:
+        if (!Decode(trade_break_, msg_data_ptr)) {
+          break;
+        }
+        strategy_.OnTradeBreak(state_, id, trade_break_);
+        return ReturnCode::Success;
+      case MessageType::SecurityDirectory:
+        if (!Decode(security_directory_, msg_data_ptr)) {
+          break;
+        }
+        strategy_.OnSecurityDirectory(state_, id, security_directory_);
+        return ReturnCode::Success;
+      case MessageType::TradingStatus:
+        if (!Decode(trading_status_, msg_data_ptr)) {
+          break;
+        }
+        strategy_.OnTradingStatus(state_, id, trading_status_);
+        return ReturnCode::Success;
+      case MessageType::OperationalHaltStatus:
+        if (!Decode(operational_halt_status_, msg_data_ptr)) {
+          break;
+        }
+        strategy_.OnOperationalHaltStatus(state_, id, operational_halt_status_);
+        return ReturnCode::Success;
+      case MessageType::ShortSalePriceTestStatus:
+        if (!Decode(short_sale_price_test_status_, msg_data_ptr)) {
+          break;
+        }
+        strategy_.OnShortSalePriceTestStatus(state_, id, short_sale_price_test_status_);
+        return ReturnCode::Success;
+      case MessageType::SecurityEvent:
+        if (!Decode(security_event_, msg_data_ptr)) {
+          break;
+        }
+        strategy_.OnSecurityEvent(state_, id, security_event_);
+        return ReturnCode::Success;
+      case MessageType::OfficialPrice:
+        if (!Decode(official_price_, msg_data_ptr)) {
+          break;
+        }
+        strategy_.OnOfficialPrice(state_, id, official_price_);
+        return ReturnCode::Success;
+      case MessageType::AuctionInformation:
+        if (!Decode(auction_information_, msg_data_ptr)) {
+          break;
+        }
+        strategy_.OnAuctionInformation(state_, id, auction_information_);
+        return ReturnCode::Success;
+      default:
+        IEX_LOG("Unknown message type " << PRINTHEX(*msg_data_ptr));
+        return ReturnCode::UnknownMessageType;
+    }
+    return ReturnCode::FailedDecodingPacket;
+  }
+
+  Strategy& strategy_;
+  ReplayState state_;
+  uint64_t num_events_ = 0;
+
+  /// \brief One struct per message type, decoded into again for every message.
+  SystemEventMessage system_event_;
+  SecurityDirectoryMessage security_directory_;
+  TradingStatusMessage trading_status_;
+  OperationalHaltStatusMessage operational_halt_status_;
+  ShortSalePriceTestStatusMessage short_sale_price_test_status_;
+  QuoteUpdateMessage quote_update_;
+  TradeReportMessage trade_report_;
+  TradeReportMessage trade_break_;
+  OfficialPriceMessage official_price_;
+  AuctionInformationMessage auction_information_;
+  PriceLevelUpdateMessage price_level_buy_;
+  PriceLevelUpdateMessage price_level_sell_;
+  SecurityEventMessage security_event_;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+#include "iex_symbol_table.h"
+
+/// \struct GridConfig
+/// \brief The grid of a GridResampler.
+struct GridConfig {
+  /// \brief Time range of the grid, [start_time, end_time), nanoseconds since POSIX time UTC.
+  int64_t start_time = 0;
+  int64_t end_time = 0;
+
+  /// \brief Width of a time bucket, nanoseconds.
+  int64_t interval = 1000000000;
+
+  /// \brief Symbols of the rows, in this order. Empty takes every symbol, in order of first
+  ///        appearance.
+  std::vector<std::string> symbols;
+};
+
+/// \class GridResampler
+/// \brief Resamples L1 quotes and trades onto a fixed grid of symbols by time buckets, as one
+///        [symbol x bucket] matrix per field, stored row major.
+/// \note  Bucket b covers [start_time + b * interval, start_time + (b + 1) * interval). Quote
+///        fields and the last trade price hold the state at the end of the bucket, forward filled
+///        from earlier buckets and from before start_time. Volume, notional and trade count are
+///        summed over the bucket. Matrices are filled as the stream goes, nothing is kept per
+///        message. Quotes come from TOPS quote updates.
+class GridResampler {
+ public:
+  explicit GridResampler(const GridConfig& config);
+
+  /// \brief Update with a decoded message. Only quote updates and trade reports are used.
+  void OnMessage(const IEXMessageBase& msg);
+
+  /// \brief Update a row with a quote, or a trade. Timestamps of a row must not decrease.
+  void OnQuote(const uint32_t row, const int64_t timestamp, const double bid_price,
+               const uint32_t bid_size, const double ask_price, const uint32_t ask_size);
+  void OnTrade(const uint32_t row, const int64_t timestamp, const double price,
+               const uint32_t size);
+
+  /// \brief Forward fill every row to the end of the grid. Call after the last message.
+  void Finish();
+
+  /// \brief Decode a file, then Finish.
+  ///
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode AddFile(const std::string& filename) WARN_UNUSED;
+
+  /// \brief Get the row of a symbol, or SymbolTable::npos if it has none.
+  inline uint32_t FindRow(const std::string& symbol) const {
+    return symbol_table_.Find(PackSymbol(symbol));
+  }
+
+  /// \brief Get the row of a packed symbol, adding it if the grid takes every symbol.
+  uint32_t GetRow(const uint64_t packed_symbol);
+
+  inline size_t GetNumRows() const { return symbol_table_.GetSize(); }
+  inline size_t GetNumBuckets() const { return num_buckets_; }
+  inline int64_t GetBucketStart(const size_t bucket) const {
+    return config_.start_time + static_cast<int64_t>(bucket) * config_.interval;
+  }
+  inline const SymbolTable& GetSymbolTable() const { return symbol_table_; }
+
+  /// \brief The matrices, element [row * GetNumBuckets() + bucket].
+  inline const std::vector<double>& GetBidPrices() const { return bid_prices_; }
+  inline const std::vector<double>& GetAskPrices() const { return ask_prices_; }
+  inline const std::vector<uint32_t>& GetBidSizes() const { return bid_sizes_; }
+  inline const std::vector<uint32_t>& GetAskSizes() const { return ask_sizes_; }
+  inline const std::vector<double>& GetLastPrices() const { return last_prices_; }
+  inline const std::vector<uint64_t>& GetVolumes() const { return volumes_; }
+  inline const std::vector<double>& GetNotionals() const { return notionals_; }
+  inline const std::vector<uint32_t>& GetTradeCounts() const { return trade_counts_; }
+
+  /// \brief Write the grid as one binary file to memory map: a header (magic "IEXGRD01",
+  ///        int64 start_time, int64 interval, uint64 rows, uint64 buckets), the packed symbols
+  ///        as uint64, then the matrices bid_price, ask_price, last_price, notional (double),
+  ///        volume (uint64), bid_size, ask_size, trade_count (uint32), each rows x buckets.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool Save(const std::string& filename) const WARN_UNUSED;
+
+  /// \brief Write the grid as NumPy .npy files, named prefix followed by the field name:
+  ///        symbols.npy (bytes), bucket_start.npy (int64) and one rows x buckets matrix per field.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool SaveNpy(const std::string& prefix) const WARN_UNUSED;
+
+ private:
+  /// \brief Index of the bucket of a timestamp, clamped to [0, num_buckets_].
+  inline size_t GetBucket(const int64_t timestamp) const {
+    if (timestamp < config_.start_time) {
+      return 0;
+    }
+    const uint64_t bucket = static_cast<uint64_t>(timestamp - config_.start_time) /
+                            static_cast<uint64_t>(config_.interval);
+    return bucket < num_buckets_ ? static_cast<size_t>(bucket) : num_buckets_;
+  }
+
+  /// \brief Add a row for a symbol not in the grid yet.
+  uint32_t AddRow(const uint64_t packed_symbol);
+
+  /// \brief Fill the buckets of a row before end_bucket with its current state.
+  void FillUntil(const uint32_t row, const size_t end_bucket);
+
+  GridConfig config_;
+  size_t num_buckets_ = 0;
+
+  /// \brief Whether rows are added for every new symbol.
+  bool all_symbols_ = false;
+  SymbolTable symbol_table_;
+
+  /// \brief Current state of every row, and the first bucket not yet filled.
+  std::vector<double> bid_price_;
+  std::vector<uint32_t> bid_size_;
+  std::vector<double> ask_price_;
+  std::vector<uint32_t> ask_size_;
+  std::vector<double> last_price_;
+  std::vector<size_t> filled_until_;
+
+  std::vector<double> bid_prices_;
+  std::vector<double> ask_prices_;
+  std::vector<uint32_t> bid_sizes_;
+  std::vector<uint32_t> ask_sizes_;
+  std::vector<double> last_prices_;
+  std::vector<uint64_t> volumes_;
+  std::vector<double> notionals_;
+  std::vector<uint32_t> trade_counts_;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/// \class SPSCRing
+/// \brief A bounded, lock-free ring buffer for exactly one producer thread and one consumer thread.
+/// \note  The capacity is rounded up to a power of two. Each side keeps a private copy of the
+///        other side's index and only reloads the shared atomic when the ring looks full/empty,
+///        so in steady state a push or pop touches a single shared cache line.
+template <typename T>
+class SPSCRing {
+ public:
+  explicit SPSCRing(size_t capacity)
+      : capacity_(RoundUpToPowerOfTwo(capacity)), mask_(capacity_ - 1), slots_(new T[capacity_]) {}
+
+  SPSCRing(const SPSCRing&) = delete;
+  SPSCRing& operator=(const SPSCRing&) = delete;
+
+  /// \brief Move an item into the ring. Producer thread only.
+  ///
+  /// \param item  The item to push. Only moved from if the push succeeds.
+  /// \return True if succeeds, false if the ring is full.
+  bool TryPush(T&& item) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ == capacity_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ == capacity_) {
+        return false;
+      }
+    }
+    slots_[tail & mask_] = std::move(item);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief Move the oldest item out of the ring. Consumer thread only.
+  ///
+  /// \param item  Output parameter, containing the item if the pop succeeds.
+  /// \return True if succeeds, false if the ring is empty.
+  bool TryPop(T& item) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) {
+        return false;
+      }
+    }
+    item = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief Approximate number of items in the ring. Exact when called from either endpoint
+  ///        while the other side is idle.
+  size_t Size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+
+  /// \brief The maximum number of items the ring can hold.
+  size_t Capacity() const { return capacity_; }
+
+ private:
+  constexpr static size_t cache_line_size = 64;
+
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<T[]> slots_;
+
+  /// \brief Consumer side: read index and the consumer's cached copy of the write index.
+  /// \note  Manual padding rather than alignas, as over-aligned new is not available in C++11.
+  char pad_0_[cache_line_size];
+  std::atomic<size_t> head_{0};
+  size_t tail_cache_ = 0;
+
+  /// \brief Producer side: write index and the producer's cached copy of the read index.
+  char pad_1_[cache_line_size];
+  std::atomic<size_t> tail_{0};
+  size_t head_cache_ = 0;
+  char pad_2_[cache_line_size];
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+#include "iex_pcap_reader.h"
+
+/// \class SymbolPacketIndex
+/// \brief Maps every symbol in a pcap file to the packets containing its messages, so a single
+///        symbol can be extracted without reading the rest of the file.
+/// \note  Packets are identified by the byte offsets of their pcap records, stored per symbol in
+///        ascending order as delta encoded varints (LEB128). The index is built in a single pass
+///        that reads message blocks in place, and is usually saved next to the pcap file.
+class SymbolPacketIndex {
+ public:
+  /// \brief Scan a pcap file and replace the index contents.
+  ///
+  /// \param pcap_filename  Path of the pcap file.
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode Build(const std::string& pcap_filename) WARN_UNUSED;
+
+  /// \brief Write the index to, or read it from, a binary file.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool Save(const std::string& filename) const WARN_UNUSED;
+  bool Load(const std::string& filename) WARN_UNUSED;
+
+  /// \brief The conventional index file name for a pcap file.
+  static std::string GetIndexFilename(const std::string& pcap_filename) {
+    return pcap_filename + ".symidx";
+  }
+
+  /// \brief Get the packets containing messages of a symbol.
+  ///
+  /// \return Byte offsets of the pcap records in ascending order, see PcapRecordReader::Seek.
+  ///         Empty if the symbol never appears.
+  std::vector<uint64_t> GetRecordOffsets(const std::string& symbol) const;
+
+  /// \brief Get all symbols in the index, sorted.
+  std::vector<std::string> GetSymbols() const;
+
+  /// \brief Size of the pcap file the index was built from, to detect stale indices.
+  inline uint64_t GetFileSize() const { return file_size_; }
+
+  /// \brief Number of packets in the pcap file.
+  inline uint64_t GetPacketCount() const { return num_packets_; }
+
+  /// \brief Total size of the encoded offset lists in bytes.
+  uint64_t GetEncodedSize() const;
+
+ private:
+  /// \brief The packets of one symbol.
+  struct RecordList {
+    /// \brief Delta encoded varints. The first value is the offset itself.
+    std::vector<uint8_t> data;
+    uint64_t last_offset = 0;
+    uint64_t num_records = 0;
+  };
+
+  /// \brief Append a record offset, ignoring repeats of the last one.
+  static void AddRecord(RecordList& record_list, const uint64_t record_offset);
+
+  uint64_t file_size_ = 0;
+  uint64_t num_packets_ = 0;
+  std::unordered_map<uint64_t, RecordList> record_lists_;
+};
+
+/// \class SymbolExtractor
+/// \brief Returns the messages of a single symbol from a pcap file, reading only the packets a
+///        SymbolPacketIndex lists for it, so the cost follows the activity of the symbol rather
+///        than the size of the file.
+/// \note  Messages of other symbols within a listed packet are skipped by comparing their raw
+///        symbol bytes, before decoding.
+class SymbolExtractor {
+ public:
+  /// \brief Open a pcap file for extracting a symbol.
+  ///
+  /// \param pcap_filename  Path of the pcap file.
+  /// \param index          Index built from the same file.
+  /// \param symbol         The symbol to extract.
+  /// \return ReturnCode enum describing success or a specific error code. ClassNotInitialized if
+  ///         the file cannot be opened or the index was built from a different file.
+  ReturnCode Open(const std::string& pcap_filename, const SymbolPacketIndex& index,
+                  const std::string& symbol) WARN_UNUSED;
+
+  /// \brief Get the next message of the symbol.
+  ///
+  /// \param msg_ptr  Output parameter, containing the message if successfully decoded.
+  /// \return ReturnCode enum describing success or a specific error code. EndOfStream after the
+  ///         last message of the symbol.
+  ReturnCode GetNextMessage(std::unique_ptr<IEXMessageBase>& msg_ptr);
+
+  /// \brief Number of packets the extraction reads.
+  inline size_t GetPacketCount() const { return record_offsets_.size(); }
+
+  /// \brief Capture time of the packet the last returned message came from.
+  ///
+  /// \return Nanoseconds since POSIX time UTC, as recorded by the capturing host.
+  inline int64_t GetLastCaptureTime() const { return last_capture_time_; }
+
+ private:
+  /// \brief Seek to, read and parse the next listed packet.
+  ReturnCode ParseNextPacket() WARN_UNUSED;
+
+  PcapRecordReader reader_;
+  std::vector<uint64_t> record_offsets_;
+  size_t next_record_ = 0;
+  uint64_t packed_symbol_ = 0;
+  int64_t last_capture_time_ = 0;
+
+  /// \brief Payload of the current packet, within the buffer of the reader, and the offset of
+  ///        the next block.
+  const uint8_t* payload_ptr_ = nullptr;
+  size_t payload_len_ = 0;
+  size_t block_offset_ = 0;
+};
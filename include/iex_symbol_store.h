@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_mapped_file.h"
+#include "iex_messages.h"
+
+/// \struct SymbolStoreEntry
+/// \brief Directory entry of one symbol in a symbol store file, as laid out on disk.
+struct SymbolStoreEntry {
+  /// \brief The symbol in wire format, 8 bytes padded with spaces. All spaces for the messages
+  ///        without a symbol, i.e. system events.
+  char symbol[symbol_field_len];
+
+  /// \brief Location of the symbol's message blocks within the file.
+  uint64_t data_offset;
+  uint64_t data_len;
+
+  uint64_t num_messages;
+
+  /// \brief Timestamps of the first and last message, nanoseconds since POSIX time UTC.
+  int64_t first_timestamp;
+  int64_t last_timestamp;
+};
+
+/// \struct SymbolSpan
+/// \brief The messages of one symbol in a symbol store: IEX-TP message blocks (a two byte length
+///        followed by the message in wire format), sorted by timestamp.
+struct SymbolSpan {
+  const uint8_t* data = nullptr;
+  size_t len = 0;
+  uint64_t num_messages = 0;
+  int64_t first_timestamp = 0;
+  int64_t last_timestamp = 0;
+
+  inline bool IsEmpty() const { return num_messages == 0; }
+};
+
+/// \class SymbolSpanDecoder
+/// \brief Decodes the messages of a SymbolSpan one by one.
+class SymbolSpanDecoder {
+ public:
+  explicit SymbolSpanDecoder(const SymbolSpan& span) : span_(span) {}
+
+  /// \brief Get the next message of the span.
+  ///
+  /// \param msg_ptr  Output parameter, containing the message if successfully decoded.
+  /// \return ReturnCode enum describing success or a specific error code. EndOfStream after the
+  ///         last message.
+  ReturnCode GetNextMessage(std::unique_ptr<IEXMessageBase>& msg_ptr);
+
+ private:
+  SymbolSpan span_;
+  size_t block_offset_ = 0;
+};
+
+/// \class SymbolStoreWriter
+/// \brief Converts pcap files from stream order into a symbol store: one file with the messages
+///        of each symbol contiguous and sorted by timestamp, preceded by a symbol directory.
+/// \note  Messages are kept in memory until Write, taking about as much as the output file. Add
+///        the files of as many days as should share one store, e.g. a month.
+class SymbolStoreWriter {
+ public:
+  /// \brief Add all messages of a pcap file.
+  ///
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode AddFile(const std::string& pcap_filename) WARN_UNUSED;
+
+  /// \brief Add a single message in wire format.
+  ///
+  /// \param msg_data_ptr  Pointer to the start of the message, its type byte.
+  /// \param msg_len       Length of the message.
+  void AddMessage(const uint8_t* msg_data_ptr, const size_t msg_len);
+
+  /// \brief Sort the messages and write the store.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool Write(const std::string& filename) const WARN_UNUSED;
+
+  inline uint64_t GetMessageCount() const { return num_messages_; }
+
+ private:
+  /// \brief Where a message starts within the blocks of its symbol.
+  struct MessageRef {
+    int64_t timestamp;
+    uint64_t block_offset;
+  };
+
+  /// \brief The messages of one symbol, in the order they were added.
+  struct SymbolMessages {
+    std::vector<uint8_t> blocks;
+    std::vector<MessageRef> refs;
+  };
+
+  std::unordered_map<uint64_t, SymbolMessages> symbols_;
+  uint64_t num_messages_ = 0;
+};
+
+/// \class SymbolStoreReader
+/// \brief Memory maps a symbol store and returns the messages of a symbol as a single span, so a
+///        query for one symbol is one sequential read per store.
+class SymbolStoreReader {
+ public:
+  /// \brief Map a symbol store file.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool Open(const std::string& filename) WARN_UNUSED;
+
+  /// \brief Unmap the file. Spans returned before are no longer valid.
+  void Close();
+
+  /// \brief Get the messages of a symbol, valid until Close. The kernel is advised to read the
+  ///        span ahead.
+  ///
+  /// \param symbol  The symbol, or an empty string for the messages without a symbol.
+  /// \return The span, empty if the symbol is not in the store.
+  SymbolSpan GetSymbol(const std::string& symbol) const;
+
+  /// \brief Get all symbols in the store, sorted.
+  std::vector<std::string> GetSymbols() const;
+
+  /// \brief Get the directory of the store, sorted by symbol.
+  inline const SymbolStoreEntry* GetEntries() const { return entries_; }
+  inline size_t GetEntryCount() const { return num_entries_; }
+
+ private:
+  MappedFile file_;
+  const SymbolStoreEntry* entries_ = nullptr;
+  size_t num_entries_ = 0;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "iex_messages.h"
+
+/// \class SymbolTable
+/// \brief Maps symbols to dense ids 0, 1, 2, ... in order of first appearance, so per symbol state
+///        can live in plain arrays indexed by id instead of a map of structs.
+/// \note  Open addressing with linear probing over packed symbols (see PackSymbol), kept at most
+///        half full. Lookups never allocate, adding a symbol may grow the table.
+class SymbolTable {
+ public:
+  /// \brief Returned by Find for symbols not in the table.
+  constexpr static uint32_t npos = 0xffffffff;
+
+  /// \param expected_symbols  Number of symbols to reserve room for.
+  explicit SymbolTable(const size_t expected_symbols = 8192);
+
+  /// \brief Get the id of a packed symbol, or npos if it was never added.
+  inline uint32_t Find(const uint64_t packed_symbol) const {
+    for (size_t slot = GetSlot(packed_symbol);; slot = (slot + 1) & mask_) {
+      if (keys_[slot] == packed_symbol) {
+        return ids_[slot];
+      }
+      if (keys_[slot] == 0) {
+        return npos;
+      }
+    }
+  }
+
+  /// \brief Get the id of a packed symbol, adding it if it is new.
+  inline uint32_t GetOrAdd(const uint64_t packed_symbol) {
+    size_t slot = GetSlot(packed_symbol);
+    for (; keys_[slot] != 0; slot = (slot + 1) & mask_) {
+      if (keys_[slot] == packed_symbol) {
+        return ids_[slot];
+      }
+    }
+    return Add(slot, packed_symbol);
+  }
+
+  /// \brief Get the id of a symbol given as a string, adding it if it is new.
+  inline uint32_t GetOrAdd(const std::string& symbol) { return GetOrAdd(PackSymbol(symbol)); }
+
+  /// \brief The symbol of an id, without padding.
+  std::string GetSymbol(const uint32_t id) const;
+
+  /// \brief The packed symbol of an id.
+  inline uint64_t GetPacked(const uint32_t id) const { return symbols_[id]; }
+
+  /// \brief Number of symbols, all ids are below this.
+  inline size_t GetSize() const { return symbols_.size(); }
+
+ private:
+  /// \brief Fibonacci hashing, taking the top bits of the product.
+  inline size_t GetSlot(const uint64_t packed_symbol) const {
+    return static_cast<size_t>((packed_symbol * 0x9e3779b97f4a7c15ull) >> shift_);
+  }
+
+  /// \brief Insert a new symbol at a free slot, growing the table when it gets half full.
+  uint32_t Add(const size_t slot, const uint64_t packed_symbol);
+
+  /// \brief Resize the table to a power of two of at least twice min_symbols slots.
+  void Rehash(const size_t min_symbols);
+
+  /// \brief Packed symbols, zero for empty slots. Packed symbols are never zero, as they are
+  ///        padded with spaces.
+  std::vector<uint64_t> keys_;
+  std::vector<uint32_t> ids_;
+  size_t mask_ = 0;
+  int shift_ = 64;
+
+  /// \brief Packed symbols by id.
+  std::vector<uint64_t> symbols_;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "iex_messages.h"
+
+/// \struct SyntheticConfig
+/// \brief Parameters of a synthetic IEX feed.
+struct SyntheticConfig {
+  /// \brief The feed to generate, TOPS or DEEP.
+  ProtocolId protocol = ProtocolId::TOPS;
+
+  /// \brief Total number of messages to write, including the start and end of day messages.
+  uint64_t num_messages = 1000000;
+
+  /// \brief Number of distinct symbols.
+  size_t num_symbols = 500;
+
+  /// \brief DEEP only: probability that a price level update adds or removes a level, rather than
+  ///        changing the size of an existing one. Within [0, 1].
+  double price_level_churn = 0.3;
+
+  /// \brief DEEP only: maximum number of price levels kept per side of each book, at least 1.
+  size_t max_price_levels = 10;
+
+  /// \brief Maximum length of the IEX-TP payload (header and blocks) of a single packet.
+  size_t max_payload_len = 1200;
+
+  /// \brief Seed of the random number generator. The same seed always produces the same file.
+  uint64_t seed = 1;
+
+  /// \brief Send time of the first packet, nanoseconds since POSIX time UTC.
+  int64_t start_time = 1517058000000000000;
+
+  /// \brief Time between the first and last message, in nanoseconds.
+  int64_t session_duration = 23400000000000;
+
+  /// \brief Transport identifiers written to every header.
+  uint32_t channel_id = 1;
+  uint32_t session_id = 1150681088;
+};
+
+/// \class SyntheticFeedGenerator
+/// \brief Writes pcap files containing a valid IEX-TP stream of synthetic TOPS or DEEP messages.
+/// \note  The message mix roughly follows a real trading day: start of day administrative messages,
+///        then a stream dominated by quote updates (TOPS) or price level updates (DEEP) with
+///        trades and auction information mixed in, then end of day messages. Sequence numbers and
+///        stream offsets are continuous, so the files decode exactly like the real ones.
+class SyntheticFeedGenerator {
+ public:
+  explicit SyntheticFeedGenerator(const SyntheticConfig& config);
+
+  /// \brief Generate the feed and write it to a pcap file.
+  ///
+  /// \param filename Path of the pcap file to create.
+  /// \return True if succeeds, false otherwise.
+  bool WriteToFile(const std::string& filename) WARN_UNUSED;
+
+  /// \brief Number of messages and packets written by the last WriteToFile.
+  inline uint64_t GetMessageCount() const { return messages_written_; }
+  inline uint64_t GetPacketCount() const { return packets_written_; }
+
+ private:
+  /// \brief The synthetic state of a single symbol.
+  struct SymbolState {
+    std::string symbol;
+
+    /// \brief Mid price, in 1/10000 of a dollar.
+    int64_t mid_price;
+
+    /// \brief DEEP only: price (1/10000 of a dollar) and size of the resting levels of each side.
+    std::vector<std::pair<int64_t, int>> bids;
+    std::vector<std::pair<int64_t, int>> asks;
+  };
+
+  /// \brief Generate the message following the current one.
+  ///
+  /// \return The message, valid until the next message of the same type is generated.
+  const IEXMessageBase& GenerateBodyMessage(const int64_t timestamp);
+  const IEXMessageBase& GenerateQuote(SymbolState& state, const int64_t timestamp);
+  const IEXMessageBase& GenerateTrade(SymbolState& state, const int64_t timestamp);
+  const IEXMessageBase& GenerateAuction(SymbolState& state, const int64_t timestamp);
+  const IEXMessageBase& GeneratePriceLevelUpdate(SymbolState& state, const int64_t timestamp);
+
+  /// \brief Random walk of the mid price by a few ticks.
+  void MoveMidPrice(SymbolState& state);
+
+  /// \brief Random size in round lots.
+  int RandomSize();
+
+  SyntheticConfig config_;
+  std::mt19937_64 rng_;
+  std::vector<SymbolState> symbols_;
+  uint64_t next_trade_id_ = 1;
+
+  /// \brief Reused for every generated message, so the trading day does not allocate.
+  QuoteUpdateMessage quote_;
+  TradeReportMessage trade_;
+  AuctionInformationMessage auction_;
+  PriceLevelUpdateMessage buy_level_update_{MessageType::PriceLevelUpdateBuy};
+  PriceLevelUpdateMessage sell_level_update_{MessageType::PriceLevelUpdateSell};
+
+  uint64_t messages_written_ = 0;
+  uint64_t packets_written_ = 0;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/// \brief Pin the calling thread to a single CPU core.
+/// \note  Only supported on Linux, elsewhere this is a no-op that reports failure.
+///
+/// \param core  Index of the core. A negative value leaves the thread unpinned.
+/// \return True if the thread was pinned, false otherwise.
+inline bool PinCurrentThreadToCore(const int core) {
+  if (core < 0) {
+    return false;
+  }
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(core, &cpu_set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) == 0;
+#else
+  return false;
+#endif
+}
+
+/// \brief Back off while waiting on another thread.
+/// \note  Yielding rather than pure spinning keeps the pipelines usable when there are fewer
+///        cores than threads.
+inline void WaitForOtherThread() { std::this_thread::yield(); }
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_messages.h"
+#include "iex_symbol_table.h"
+
+/// \class TickLadder
+/// \brief A dense array of values indexed by price tick, growing in either direction as new ticks
+///        are touched. Ticks outside the array read as zero.
+template <typename T>
+class TickLadder {
+ public:
+  /// \brief Get the value at a tick for writing, growing the array if needed.
+  inline T& At(const int64_t tick) {
+    if (tick < first_tick_ || tick >= GetEndTick()) {
+      Grow(tick);
+    }
+    return values_[tick - first_tick_];
+  }
+
+  /// \brief Get the value at a tick, zero outside the array.
+  inline T Get(const int64_t tick) const {
+    return tick >= first_tick_ && tick < GetEndTick() ? values_[tick - first_tick_] : T();
+  }
+
+  /// \brief Add the values of another ladder.
+  void Add(const TickLadder& other) {
+    if (other.values_.empty()) {
+      return;
+    }
+    At(other.first_tick_);
+    At(other.GetEndTick() - 1);
+    for (size_t i = 0; i < other.values_.size(); ++i) {
+      values_[other.first_tick_ - first_tick_ + i] += other.values_[i];
+    }
+  }
+
+  /// \brief Replace the contents.
+  void Assign(const int64_t first_tick, std::vector<T> values) {
+    first_tick_ = first_tick;
+    values_ = std::move(values);
+  }
+
+  /// \brief Narrow the range [first_tick, end_tick) to the ticks with a non zero value. Gives an
+  ///        empty range if there are none.
+  void GetUsedRange(int64_t& first_tick, int64_t& end_tick) const {
+    size_t begin = 0;
+    size_t end = values_.size();
+    while (begin < end && values_[begin] == T()) {
+      ++begin;
+    }
+    while (end > begin && values_[end - 1] == T()) {
+      --end;
+    }
+    first_tick = first_tick_ + static_cast<int64_t>(begin);
+    end_tick = first_tick_ + static_cast<int64_t>(end);
+  }
+
+  /// \brief Number of ticks the array would span to include a tick.
+  inline int64_t GetSpanWith(const int64_t tick) const {
+    return values_.empty() ? 1 : std::max(tick + 1, GetEndTick()) - std::min(tick, first_tick_);
+  }
+
+  inline int64_t GetFirstTick() const { return first_tick_; }
+  inline int64_t GetEndTick() const { return first_tick_ + static_cast<int64_t>(values_.size()); }
+  inline const std::vector<T>& GetValues() const { return values_; }
+
+ private:
+  /// \brief Extend the array to include a tick, at least doubling it to keep growth amortized.
+  void Grow(const int64_t tick) {
+    if (values_.empty()) {
+      first_tick_ = tick;
+      values_.assign(1, T());
+      return;
+    }
+    const int64_t size = static_cast<int64_t>(values_.size());
+    const int64_t new_first = tick < first_tick_ ? std::min(tick, first_tick_ - size) : first_tick_;
+    const int64_t new_end = tick >= GetEndTick() ? std::max(tick + 1, GetEndTick() + size)
+                                                 : GetEndTick();
+    std::vector<T> values(static_cast<size_t>(new_end - new_first), T());
+    std::copy(values_.begin(), values_.end(), values.begin() + (first_tick_ - new_first));
+    values_.swap(values);
+    first_tick_ = new_first;
+  }
+
+  int64_t first_tick_ = 0;
+  std::vector<T> values_;
+};
+
+/// \struct VolumeProfileConfig
+/// \brief Parameters of a VolumeProfile.
+struct VolumeProfileConfig {
+  /// \brief Width of a price bin in 1/10000 of a dollar, the resolution of IEX prices. Prices are
+  ///        binned to the nearest tick, so the default of one cent puts sub-penny trades into the
+  ///        nearest cent. Use 1 for exact prices. Must be positive, AddFile fails otherwise.
+  int64_t tick_size = 100;
+
+  /// \brief Number of files processed in parallel by AddFiles. Zero uses one thread per hardware
+  ///        thread.
+  size_t num_threads = 0;
+
+  /// \brief Widest range of ticks the arrays of a symbol may span. Prices far from the rest,
+  ///        such as stub quotes, would otherwise blow up the dense arrays; messages that do not
+  ///        fit are counted in GetNumDroppedMessages and left out.
+  int64_t max_ticks = 1 << 20;
+};
+
+/// \struct SymbolProfile
+/// \brief The volume at price profile of one symbol.
+struct SymbolProfile {
+  /// \brief Traded shares per tick.
+  TickLadder<uint64_t> volume;
+
+  /// \brief Displayed shares resting on the book per tick, integrated over time, both sides
+  ///        together. In share seconds, from DEEP price level updates.
+  TickLadder<double> resting_depth;
+
+  /// \brief Current book of the session being read, and when each level last changed.
+  TickLadder<uint32_t> bid_sizes;
+  TickLadder<uint32_t> ask_sizes;
+  TickLadder<int64_t> bid_times;
+  TickLadder<int64_t> ask_times;
+};
+
+/// \class VolumeProfile
+/// \brief Volume at price histograms of all symbols, from trade reports and, for DEEP, the time
+///        shares rest on the book at each price. Bins are dense arrays per symbol, indexed by tick.
+/// \note  Profiles of different sessions add up, AddFiles builds one profile per file in parallel
+///        and merges them pairwise in parallel.
+class VolumeProfile {
+ public:
+  explicit VolumeProfile(const VolumeProfileConfig& config = VolumeProfileConfig())
+      : config_(config) {}
+
+  /// \brief Update with a decoded message. Only trade reports and price level updates are used.
+  void OnMessage(const IEXMessageBase& msg);
+
+  /// \brief End the current session: count resting depth up to end_time and clear the books.
+  void CloseSession(const int64_t end_time);
+
+  /// \brief Decode a file as one session.
+  ///
+  /// \return ReturnCode enum describing success or a specific error code.
+  ReturnCode AddFile(const std::string& filename) WARN_UNUSED;
+
+  /// \brief Add files in parallel, each as one session.
+  ///
+  /// \return True if every file could be read, false otherwise. Files that failed are left out.
+  bool AddFiles(const std::vector<std::string>& filenames) WARN_UNUSED;
+
+  /// \brief Add the profiles of another VolumeProfile with the same tick size.
+  void Merge(const VolumeProfile& other);
+
+  /// \brief Write the profiles to, or read them from, a binary file. The file is columnar: a
+  ///        symbol directory followed by one array of volumes and one of resting depths, with
+  ///        the ticks of each symbol contiguous, so it can be memory mapped and read directly.
+  ///
+  /// \return True if succeeds, false otherwise.
+  bool Save(const std::string& filename) const WARN_UNUSED;
+  bool Load(const std::string& filename) WARN_UNUSED;
+
+  /// \brief The tick of a price.
+  inline int64_t GetTick(const double price) const {
+    return static_cast<int64_t>(std::llround(price * 10000 / config_.tick_size));
+  }
+
+  /// \brief The price of a tick, the inverse of GetTick.
+  inline double GetPrice(const int64_t tick) const { return tick * config_.tick_size / 10000.0; }
+
+  inline const SymbolProfile& GetProfile(const uint32_t id) const { return profiles_[id]; }
+  inline const SymbolTable& GetSymbolTable() const { return symbol_table_; }
+
+  /// \brief Number of messages left out, see VolumeProfileConfig::max_ticks.
+  inline uint64_t GetNumDroppedMessages() const { return num_dropped_messages_; }
+
+ private:
+  /// \brief Get the profile of a symbol, adding it if it is new.
+  SymbolProfile& GetOrAddProfile(const uint64_t packed_symbol);
+
+  void OnPriceLevelUpdate(const PriceLevelUpdateMessage& msg);
+
+  VolumeProfileConfig config_;
+  SymbolTable symbol_table_;
+  std::vector<SymbolProfile> profiles_;
+  uint64_t num_dropped_messages_ = 0;
+};
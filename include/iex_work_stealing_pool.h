@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// \class WorkStealingPool
+/// \brief A fixed size thread pool where every worker owns a task queue and idle workers steal
+///        from the others.
+/// \note  Owners take tasks from the back of their own queue (most recently submitted first),
+///        thieves take from the front. Tasks submitted from inside a worker go to that worker's
+///        own queue, so tasks can cheaply spawn further tasks.
+class WorkStealingPool {
+ public:
+  typedef std::function<void()> Task;
+
+  /// \param num_threads  Number of worker threads. Zero uses one per hardware thread.
+  explicit WorkStealingPool(size_t num_threads = 0);
+
+  /// \brief Waits for all submitted tasks to finish, then stops the workers.
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  /// \brief Queue a task. Can be called from any thread, including from inside a task.
+  void Submit(Task task);
+
+  /// \brief Block until every submitted task has finished.
+  void Wait();
+
+  /// \brief Number of worker threads.
+  inline size_t NumThreads() const { return workers_.size(); }
+
+ private:
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void WorkerLoop(const size_t worker_idx);
+
+  /// \brief Take a task from the own queue, or steal one from another worker.
+  bool TryGetTask(const size_t worker_idx, Task& task);
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> workers_;
+
+  /// \brief Round robin index for tasks submitted from outside the pool.
+  std::atomic<size_t> next_queue_{0};
+
+  /// \brief Number of tasks submitted but not yet finished.
+  std::atomic<size_t> pending_{0};
+
+  /// \brief Used to put idle workers to sleep and to wake up Wait.
+  std::mutex idle_mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable all_done_;
+  bool stop_ = false;
+};
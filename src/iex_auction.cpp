@@ -0,0 +1,273 @@
+#include "iex_auction.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace {
+constexpr char series_magic[8] = {'I', 'E', 'X', 'A', 'U', 'C', '0', '1'};
+
+struct SeriesHeader {
+  char magic[sizeof(series_magic)];
+  uint64_t num_updates;
+  uint64_t num_symbols;
+};
+
+/// \brief Auction types in the order of AuctionTracker::GetAuctionIndex.
+constexpr AuctionInformationMessage::AuctionType auction_types[] = {
+    AuctionInformationMessage::AuctionType::OpeningAuction,
+    AuctionInformationMessage::AuctionType::ClosingAuction,
+    AuctionInformationMessage::AuctionType::IPOAuction,
+    AuctionInformationMessage::AuctionType::HaltAuction,
+    AuctionInformationMessage::AuctionType::VolatilityAuction};
+
+const char* GetAuctionName(const uint8_t auction_type) {
+  switch (static_cast<AuctionInformationMessage::AuctionType>(auction_type)) {
+    case AuctionInformationMessage::AuctionType::OpeningAuction:
+      return "Opening";
+    case AuctionInformationMessage::AuctionType::ClosingAuction:
+      return "Closing";
+    case AuctionInformationMessage::AuctionType::IPOAuction:
+      return "IPO";
+    case AuctionInformationMessage::AuctionType::HaltAuction:
+      return "Halt";
+    case AuctionInformationMessage::AuctionType::VolatilityAuction:
+      return "Volatility";
+  }
+  return "Unknown";
+}
+
+const char* GetSideName(const uint8_t imbalance_side) {
+  switch (static_cast<AuctionInformationMessage::ImbalanceSide>(imbalance_side)) {
+    case AuctionInformationMessage::ImbalanceSide::BuySideImbalance:
+      return "Buy";
+    case AuctionInformationMessage::ImbalanceSide::SellSideImbalance:
+      return "Sell";
+    case AuctionInformationMessage::ImbalanceSide::NoImbalance:
+      return "None";
+  }
+  return "Unknown";
+}
+
+template <typename T>
+void WriteColumn(std::ofstream& out_stream, const std::vector<T>& column) {
+  out_stream.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(T));
+}
+
+/// \brief Write a price and its timestamp as two columns, both empty if there is no price.
+void WriteOptionalPrice(std::ostream& out_stream, const double price, const int64_t timestamp) {
+  if (!std::isnan(price)) {
+    out_stream << price << ',' << timestamp;
+  } else {
+    out_stream << ',';
+  }
+}
+}  // namespace
+
+constexpr size_t AuctionTracker::num_auction_types;
+
+size_t AuctionTracker::GetAuctionIndex(const AuctionInformationMessage::AuctionType auction_type) {
+  for (size_t i = 0; i < num_auction_types; ++i) {
+    if (auction_types[i] == auction_type) {
+      return i;
+    }
+  }
+  return num_auction_types;
+}
+
+AuctionOutcome& AuctionTracker::GetOutcome(const std::string& symbol, const size_t auction_index) {
+  const uint32_t symbol_id = symbol_table_.GetOrAdd(symbol);
+  if (outcomes_.size() <= symbol_id * num_auction_types) {
+    const size_t old_size = outcomes_.size();
+    outcomes_.resize(symbol_table_.GetSize() * num_auction_types);
+    for (size_t i = old_size; i < outcomes_.size(); ++i) {
+      outcomes_[i].symbol_id = static_cast<uint32_t>(i / num_auction_types);
+      outcomes_[i].auction_type = auction_types[i % num_auction_types];
+    }
+  }
+  return outcomes_[symbol_id * num_auction_types + auction_index];
+}
+
+void AuctionTracker::OnAuctionInformation(const AuctionInformationMessage& msg) {
+  const size_t auction_index = GetAuctionIndex(msg.auction_type);
+  if (auction_index == num_auction_types) {
+    ++num_unknown_auctions_;
+    return;
+  }
+  AuctionOutcome& outcome = GetOutcome(msg.symbol, auction_index);
+  if (outcome.num_updates++ == 0) {
+    outcome.first_timestamp = msg.timestamp;
+  }
+  outcome.last_timestamp = msg.timestamp;
+  outcome.scheduled_auction_time = static_cast<uint32_t>(msg.scheduled_auction_time);
+  outcome.paired_shares = static_cast<uint32_t>(msg.paired_shares);
+  outcome.imbalance_shares = static_cast<uint32_t>(msg.imbalance_shares);
+  outcome.imbalance_side = msg.imbalance_side;
+  outcome.indicative_clearing_price = msg.indicative_clearing_price;
+  outcome.auction_book_clearing_price = msg.auction_book_clearing_price;
+
+  series_.timestamps.push_back(msg.timestamp);
+  series_.symbol_ids.push_back(outcome.symbol_id);
+  series_.auction_types.push_back(static_cast<uint8_t>(msg.auction_type));
+  series_.imbalance_sides.push_back(static_cast<uint8_t>(msg.imbalance_side));
+  series_.paired_shares.push_back(outcome.paired_shares);
+  series_.imbalance_shares.push_back(outcome.imbalance_shares);
+  series_.reference_prices.push_back(msg.reference_price);
+  series_.indicative_clearing_prices.push_back(msg.indicative_clearing_price);
+  series_.auction_book_clearing_prices.push_back(msg.auction_book_clearing_price);
+  series_.lower_auction_collars.push_back(msg.lower_auction_collar);
+  series_.upper_auction_collars.push_back(msg.upper_auction_collar);
+}
+
+void AuctionTracker::OnOfficialPrice(const OfficialPriceMessage& msg) {
+  const bool is_opening = msg.price_type == OfficialPriceMessage::PriceType::OpeningPrice;
+  const auto auction_type = is_opening ? AuctionInformationMessage::AuctionType::OpeningAuction
+                                       : AuctionInformationMessage::AuctionType::ClosingAuction;
+  AuctionOutcome* outcome_ptr = &GetOutcome(msg.symbol, GetAuctionIndex(auction_type));
+
+  // Without an opening or closing auction, the price comes from the auction that last updated.
+  if (outcome_ptr->num_updates == 0) {
+    AuctionOutcome* symbol_outcomes = &outcomes_[outcome_ptr->symbol_id * num_auction_types];
+    for (size_t i = 0; i < num_auction_types; ++i) {
+      const AuctionOutcome& outcome = symbol_outcomes[i];
+      if (outcome.num_updates > 0 &&
+          static_cast<uint64_t>(outcome.last_timestamp) <= msg.timestamp &&
+          (outcome_ptr->num_updates == 0 ||
+           outcome.last_timestamp > outcome_ptr->last_timestamp)) {
+        outcome_ptr = &symbol_outcomes[i];
+      }
+    }
+  }
+  if (is_opening) {
+    outcome_ptr->official_opening_price = msg.price;
+    outcome_ptr->official_opening_timestamp = msg.timestamp;
+  } else {
+    outcome_ptr->official_closing_price = msg.price;
+    outcome_ptr->official_closing_timestamp = msg.timestamp;
+  }
+}
+
+void AuctionTracker::OnMessage(const IEXMessageBase& msg) {
+  switch (msg.GetMessageType()) {
+    case MessageType::AuctionInformation:
+      OnAuctionInformation(static_cast<const AuctionInformationMessage&>(msg));
+      break;
+    case MessageType::OfficialPrice:
+      OnOfficialPrice(static_cast<const OfficialPriceMessage&>(msg));
+      break;
+    default:
+      break;
+  }
+}
+
+ReturnCode AuctionTracker::AddFile(const std::string& filename) {
+  IEXDecoder decoder;
+  if (!decoder.OpenFileForDecoding(filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+  // Only two message types are of interest, skip everything else before decoding.
+  MessageFilter filter;
+  filter.SetTypes({MessageType::AuctionInformation, MessageType::OfficialPrice});
+  decoder.SetFilter(filter);
+
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  auto ret_code = ReturnCode::Success;
+  while ((ret_code = decoder.GetNextMessage(msg_ptr)) == ReturnCode::Success) {
+    OnMessage(*msg_ptr);
+  }
+  return ret_code == ReturnCode::EndOfStream ? ReturnCode::Success : ret_code;
+}
+
+std::vector<AuctionOutcome> AuctionTracker::GetOutcomes() const {
+  std::vector<AuctionOutcome> outcomes;
+  for (const auto& outcome : outcomes_) {
+    if (outcome.num_updates > 0 || !std::isnan(outcome.official_opening_price) ||
+        !std::isnan(outcome.official_closing_price)) {
+      outcomes.push_back(outcome);
+    }
+  }
+  return outcomes;
+}
+
+bool AuctionTracker::WriteSeriesCsv(const std::string& filename) const {
+  std::ofstream out_stream(filename);
+  if (!out_stream) {
+    IEX_LOG("Cannot open " << filename << " for writing.");
+    return false;
+  }
+  out_stream.precision(15);
+  out_stream << "Timestamp,Symbol,Auction,PairedShares,ImbalanceShares,ImbalanceSide,"
+                "ReferencePrice,IndicativeClearingPrice,AuctionBookClearingPrice,"
+                "LowerAuctionCollar,UpperAuctionCollar\n";
+  for (size_t i = 0; i < series_.GetSize(); ++i) {
+    out_stream << series_.timestamps[i] << ',' << symbol_table_.GetSymbol(series_.symbol_ids[i])
+               << ',' << GetAuctionName(series_.auction_types[i]) << ','
+               << series_.paired_shares[i] << ',' << series_.imbalance_shares[i] << ','
+               << GetSideName(series_.imbalance_sides[i]) << ',' << series_.reference_prices[i]
+               << ',' << series_.indicative_clearing_prices[i] << ','
+               << series_.auction_book_clearing_prices[i] << ','
+               << series_.lower_auction_collars[i] << ',' << series_.upper_auction_collars[i]
+               << '\n';
+  }
+  return static_cast<bool>(out_stream);
+}
+
+bool AuctionTracker::WriteSeriesColumns(const std::string& filename) const {
+  std::ofstream out_stream(filename, std::ios::binary);
+  if (!out_stream) {
+    IEX_LOG("Cannot open " << filename << " for writing.");
+    return false;
+  }
+  SeriesHeader header;
+  std::memcpy(header.magic, series_magic, sizeof(header.magic));
+  header.num_updates = series_.GetSize();
+  header.num_symbols = symbol_table_.GetSize();
+  out_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (uint32_t id = 0; id < symbol_table_.GetSize(); ++id) {
+    const uint64_t packed_symbol = symbol_table_.GetPacked(id);
+    out_stream.write(reinterpret_cast<const char*>(&packed_symbol), sizeof(packed_symbol));
+  }
+  // Wider columns first, so every column is aligned to its element size.
+  WriteColumn(out_stream, series_.timestamps);
+  WriteColumn(out_stream, series_.reference_prices);
+  WriteColumn(out_stream, series_.indicative_clearing_prices);
+  WriteColumn(out_stream, series_.auction_book_clearing_prices);
+  WriteColumn(out_stream, series_.lower_auction_collars);
+  WriteColumn(out_stream, series_.upper_auction_collars);
+  WriteColumn(out_stream, series_.symbol_ids);
+  WriteColumn(out_stream, series_.paired_shares);
+  WriteColumn(out_stream, series_.imbalance_shares);
+  WriteColumn(out_stream, series_.auction_types);
+  WriteColumn(out_stream, series_.imbalance_sides);
+  return static_cast<bool>(out_stream);
+}
+
+bool AuctionTracker::WriteOutcomesCsv(const std::string& filename) const {
+  std::ofstream out_stream(filename);
+  if (!out_stream) {
+    IEX_LOG("Cannot open " << filename << " for writing.");
+    return false;
+  }
+  out_stream.precision(15);
+  out_stream << "Symbol,Auction,Updates,FirstTimestamp,LastTimestamp,ScheduledAuctionTime,"
+                "PairedShares,ImbalanceShares,ImbalanceSide,IndicativeClearingPrice,"
+                "AuctionBookClearingPrice,OfficialOpeningPrice,OfficialOpeningTimestamp,"
+                "OfficialClosingPrice,OfficialClosingTimestamp\n";
+  for (const auto& outcome : GetOutcomes()) {
+    out_stream << symbol_table_.GetSymbol(outcome.symbol_id) << ','
+               << GetAuctionName(static_cast<uint8_t>(outcome.auction_type)) << ','
+               << outcome.num_updates << ',' << outcome.first_timestamp << ','
+               << outcome.last_timestamp << ',' << outcome.scheduled_auction_time << ','
+               << outcome.paired_shares << ',' << outcome.imbalance_shares << ','
+               << GetSideName(static_cast<uint8_t>(outcome.imbalance_side)) << ','
+               << outcome.indicative_clearing_price << ','
+               << outcome.auction_book_clearing_price << ',';
+    WriteOptionalPrice(out_stream, outcome.official_opening_price,
+                       outcome.official_opening_timestamp);
+    out_stream << ',';
+    WriteOptionalPrice(out_stream, outcome.official_closing_price,
+                       outcome.official_closing_timestamp);
+    out_stream << '\n';
+  }
+  return static_cast<bool>(out_stream);
+}
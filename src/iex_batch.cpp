@@ -0,0 +1,131 @@
+#include "iex_batch.h"
+
+#include <dirent.h>
+#include <glob.h>
+#include <sys/stat.h>
+
+#include "iex_pcap_reader.h"
+
+namespace {
+bool HasPcapExtension(const std::string& filename) {
+  for (const std::string extension : {".pcap", ".pcapng"}) {
+    if (filename.size() >= extension.size() &&
+        filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool IsDirectory(const std::string& path) {
+  struct stat path_stat;
+  return stat(path.c_str(), &path_stat) == 0 && S_ISDIR(path_stat.st_mode);
+}
+}  // namespace
+
+std::vector<std::string> ListPcapFiles(const std::string& path_or_pattern) {
+  std::vector<std::string> filenames;
+  if (IsDirectory(path_or_pattern)) {
+    DIR* dir = opendir(path_or_pattern.c_str());
+    if (dir == NULL) {
+      IEX_LOG("Cannot open directory " << path_or_pattern);
+      return filenames;
+    }
+    std::string prefix = path_or_pattern;
+    if (prefix.back() != '/') {
+      prefix += '/';
+    }
+    while (struct dirent* entry = readdir(dir)) {
+      const std::string name(entry->d_name);
+      if (HasPcapExtension(name)) {
+        filenames.push_back(prefix + name);
+      }
+    }
+    closedir(dir);
+  } else {
+    glob_t glob_result;
+    if (glob(path_or_pattern.c_str(), 0, NULL, &glob_result) == 0) {
+      for (size_t i = 0; i < glob_result.gl_pathc; ++i) {
+        filenames.push_back(glob_result.gl_pathv[i]);
+      }
+    }
+    globfree(&glob_result);
+  }
+  std::sort(filenames.begin(), filenames.end());
+  return filenames;
+}
+
+uint64_t GetFileSize(const std::string& filename) {
+  struct stat file_stat;
+  if (stat(filename.c_str(), &file_stat) != 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(file_stat.st_size);
+}
+
+std::vector<FileChunk> SplitFileIntoChunks(const std::string& filename, const size_t file_index,
+                                           const BatchConfig& config) {
+  FileChunk whole_file;
+  whole_file.filename = filename;
+  whole_file.file_size = GetFileSize(filename);
+  whole_file.file_index = file_index;
+  whole_file.approx_bytes = whole_file.file_size;
+
+  std::vector<FileChunk> chunks;
+  PcapRecordReader reader;
+  if (config.chunk_size_bytes == 0 || whole_file.file_size <= config.chunk_size_bytes ||
+      !reader.Open(filename, true)) {
+    chunks.push_back(whole_file);
+    return chunks;
+  }
+
+  // Cut before the first record at or after each multiple of the chunk size. The first chunk
+  // always starts at packet 0, which OpenFileForDecoding reads.
+  const uint64_t target_chunks =
+      (whole_file.file_size + config.chunk_size_bytes - 1) / config.chunk_size_bytes;
+  uint64_t next_cut = 1;
+  chunks.push_back(whole_file);
+  PcapRecord record;
+  for (uint64_t packet_index = 0; reader.ReadNextRecord(record) == ReturnCode::Success;
+       ++packet_index) {
+    if (packet_index == 0 || record.offset < whole_file.file_size * next_cut / target_chunks) {
+      continue;
+    }
+    chunks.back().end_packet = packet_index;
+    FileChunk chunk = whole_file;
+    chunk.first_packet = packet_index;
+    chunk.first_offset = record.offset;
+    chunks.push_back(chunk);
+    while (next_cut < target_chunks &&
+           whole_file.file_size * next_cut / target_chunks <= record.offset) {
+      ++next_cut;
+    }
+    if (next_cut == target_chunks) {
+      break;
+    }
+  }
+
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    chunks[i].chunk_index = i;
+    chunks[i].num_chunks = chunks.size();
+    const uint64_t end_offset =
+        i + 1 < chunks.size() ? chunks[i + 1].first_offset : whole_file.file_size;
+    chunks[i].approx_bytes = end_offset - (i == 0 ? 0 : chunks[i].first_offset);
+  }
+  return chunks;
+}
+
+ReturnCode OpenChunkForDecoding(const FileChunk& chunk, IEXDecoder& decoder) {
+  if (!decoder.OpenFileForDecoding(chunk.filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+  // Opening consumes the first packet, which belongs to the first chunk.
+  if (chunk.first_packet > decoder.GetPacketIndex()) {
+    auto ret_code = decoder.SeekToOffset(chunk.first_offset, chunk.first_packet);
+    if (ret_code != ReturnCode::Success) {
+      return ret_code;
+    }
+  }
+  decoder.SetPacketLimit(chunk.end_packet);
+  return ReturnCode::Success;
+}
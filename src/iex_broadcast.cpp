@@ -0,0 +1,89 @@
+#include "iex_broadcast.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "iex_thread_utils.h"
+
+BroadcastDecoder::BroadcastDecoder(const BroadcastConfig& config) : config_(config) {
+  config_.publish_batch_size = std::max<size_t>(config_.publish_batch_size, 1);
+}
+
+bool BroadcastDecoder::OpenFileForDecoding(const std::string& filename) {
+  message_count_ = 0;
+  result_ = ReturnCode::Success;
+  return decoder_.OpenFileForDecoding(filename);
+}
+
+void BroadcastDecoder::AddConsumer(const Consumer& consumer, const int core) {
+  ConsumerEntry entry;
+  entry.consumer = consumer;
+  entry.core = core;
+  consumers_.push_back(entry);
+}
+
+ReturnCode BroadcastDecoder::Run() {
+  ring_ptr_.reset(new BroadcastRing<std::unique_ptr<IEXMessageBase>>(config_.ring_capacity,
+                                                                     consumers_.size()));
+  produce_done_ = false;
+
+  std::vector<std::thread> consumer_threads;
+  for (size_t i = 0; i < consumers_.size(); ++i) {
+    consumer_threads.emplace_back(&BroadcastDecoder::ConsumeLoop, this, i);
+  }
+  std::thread producer_thread(&BroadcastDecoder::ProduceLoop, this);
+
+  producer_thread.join();
+  for (auto& thread : consumer_threads) {
+    thread.join();
+  }
+  ring_ptr_.reset();
+  return result_;
+}
+
+void BroadcastDecoder::ProduceLoop() {
+  PinCurrentThreadToCore(config_.producer_core);
+
+  auto& ring = *ring_ptr_;
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  auto ret_code = decoder_.GetNextMessage(msg_ptr);
+  for (; ret_code == ReturnCode::Success; ret_code = decoder_.GetNextMessage(msg_ptr)) {
+    // Each message is decoded exactly once and then shared read-only by all consumers.
+    while (!ring.TryPush(std::move(msg_ptr))) {
+      WaitForOtherThread();
+    }
+    if (++message_count_ % config_.publish_batch_size == 0) {
+      ring.Publish();
+    }
+  }
+  ring.Publish();
+
+  result_ = (ret_code == ReturnCode::EndOfStream) ? ReturnCode::Success : ret_code;
+  produce_done_.store(true, std::memory_order_release);
+}
+
+void BroadcastDecoder::ConsumeLoop(const size_t consumer_idx) {
+  PinCurrentThreadToCore(consumers_[consumer_idx].core);
+
+  auto& ring = *ring_ptr_;
+  const auto& consumer = consumers_[consumer_idx].consumer;
+  size_t sequence = 0;
+  while (true) {
+    // Check the done flag before reading the cursor, so the final publish is not missed.
+    const bool done = produce_done_.load(std::memory_order_acquire);
+    const size_t published = ring.Published();
+    if (sequence == published) {
+      if (done) {
+        break;
+      }
+      WaitForOtherThread();
+      continue;
+    }
+
+    // Process everything that is available, then release it all at once.
+    for (; sequence < published; ++sequence) {
+      consumer(*ring.Get(sequence));
+    }
+    ring.Release(consumer_idx, sequence);
+  }
+}
@@ -0,0 +1,359 @@
+#include "iex_catalog.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "Packet.h"
+#include "iex_pcap_reader.h"
+#include "iex_work_stealing_pool.h"
+
+namespace {
+/// \brief Identifies catalog files, and their format version.
+constexpr char catalog_magic[8] = {'I', 'E', 'X', 'C', 'A', 'T', '0', '2'};
+
+/// \brief Offset of the timestamp, the same in every message type.
+constexpr size_t timestamp_offset = 2;
+
+/// \brief The finalizer of SplitMix64, spreading the symbol bytes over all 64 bits.
+inline uint64_t MixBits(uint64_t value) {
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+  return value ^ (value >> 31);
+}
+
+template <typename T>
+void WriteValue(std::ostream& out_stream, const T& value) {
+  out_stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool ReadValue(std::istream& in_stream, T& value) {
+  in_stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+  return static_cast<bool>(in_stream);
+}
+
+void WriteString(std::ostream& out_stream, const std::string& value) {
+  WriteValue<uint64_t>(out_stream, value.size());
+  out_stream.write(value.data(), value.size());
+}
+
+/// \brief Number of bytes left in a stream, to check sizes read from it before allocating.
+uint64_t GetRemainingSize(std::istream& in_stream) {
+  const std::streampos pos = in_stream.tellg();
+  in_stream.seekg(0, std::ios::end);
+  const std::streampos end = in_stream.tellg();
+  in_stream.seekg(pos);
+  return (pos < 0 || end < pos) ? 0 : static_cast<uint64_t>(end - pos);
+}
+
+bool ReadString(std::istream& in_stream, std::string& value) {
+  uint64_t len = 0;
+  if (!ReadValue(in_stream, len) || len > (1 << 16)) {
+    return false;
+  }
+  value.resize(len);
+  in_stream.read(&value[0], len);
+  return static_cast<bool>(in_stream);
+}
+}  // namespace
+
+SymbolBloomFilter::SymbolBloomFilter(const size_t num_bits, const int num_hashes)
+    : num_hashes_(std::max(num_hashes, 1)), bits_(std::max<size_t>((num_bits + 63) / 64, 1), 0) {}
+
+void SymbolBloomFilter::Add(const std::string& symbol) { Add(PackSymbol(symbol)); }
+
+void SymbolBloomFilter::Add(const uint64_t packed_symbol) {
+  // Double hashing: the k bit positions are h1 + i * h2.
+  const uint64_t hash = MixBits(packed_symbol);
+  const uint64_t num_bits = bits_.size() * 64;
+  const uint64_t h1 = hash & 0xffffffff;
+  const uint64_t h2 = (hash >> 32) | 1;
+  for (int i = 0; i < num_hashes_; ++i) {
+    const uint64_t bit = (h1 + i * h2) % num_bits;
+    bits_[bit / 64] |= uint64_t(1) << (bit % 64);
+  }
+}
+
+bool SymbolBloomFilter::MayContain(const std::string& symbol) const {
+  const uint64_t hash = MixBits(PackSymbol(symbol));
+  const uint64_t num_bits = bits_.size() * 64;
+  const uint64_t h1 = hash & 0xffffffff;
+  const uint64_t h2 = (hash >> 32) | 1;
+  for (int i = 0; i < num_hashes_; ++i) {
+    const uint64_t bit = (h1 + i * h2) % num_bits;
+    if (!(bits_[bit / 64] & (uint64_t(1) << (bit % 64)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SymbolBloomFilter::Save(std::ostream& out_stream) const {
+  WriteValue<int32_t>(out_stream, num_hashes_);
+  WriteValue<uint64_t>(out_stream, bits_.size());
+  out_stream.write(reinterpret_cast<const char*>(bits_.data()), bits_.size() * sizeof(uint64_t));
+}
+
+bool SymbolBloomFilter::Load(std::istream& in_stream) {
+  int32_t num_hashes = 0;
+  uint64_t num_words = 0;
+  if (!ReadValue(in_stream, num_hashes) || !ReadValue(in_stream, num_words) || num_hashes < 1 ||
+      num_words == 0 || num_words > GetRemainingSize(in_stream) / sizeof(uint64_t)) {
+    return false;
+  }
+  num_hashes_ = num_hashes;
+  bits_.assign(num_words, 0);
+  in_stream.read(reinterpret_cast<char*>(bits_.data()), num_words * sizeof(uint64_t));
+  return static_cast<bool>(in_stream);
+}
+
+ReturnCode DatasetCatalog::ScanFile(const std::string& filename, CatalogEntry& entry) const {
+  entry = CatalogEntry();
+  entry.filename = filename;
+  entry.file_size = GetFileSize(filename);
+  entry.symbols = SymbolBloomFilter(config_.bloom_filter_bits, config_.bloom_filter_hashes);
+  const uint64_t index_interval = std::max<uint64_t>(config_.index_interval_packets, 1);
+
+  PcapRecordReader reader;
+  if (!reader.Open(filename, true)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+
+  PcapRecord record;
+  pcpp::Packet packet;
+  uint64_t packet_index = 0;
+  for (; reader.ReadNextRecord(record) == ReturnCode::Success; ++packet_index) {
+    if (packet_index % index_interval == 0) {
+      entry.time_index.emplace_back();
+      entry.time_index.back().first_packet = packet_index;
+      entry.time_index.back().byte_offset = record.offset;
+    }
+
+    const uint8_t* payload_ptr = nullptr;
+    size_t payload_len = 0;
+    if (!IEXDecoder::FindUdpPayload(record.data, record.len, record.link_type, payload_ptr,
+                                    payload_len)) {
+      pcpp::RawPacket raw_packet(record.data, static_cast<int>(record.len), record.capture_time,
+                                 false, record.link_type);
+      packet = pcpp::Packet(&raw_packet);
+      auto ret_code = IEXDecoder::ExtractPayload(packet, payload_ptr, payload_len);
+      if (ret_code != ReturnCode::Success) {
+        return ret_code;
+      }
+    }
+    if (payload_len < IEXDecoder::first_block_start) {
+      IEX_LOG("Packet " << packet_index << " of " << filename << " is too short.");
+      return ReturnCode::FailedParsingPacket;
+    }
+    if (packet_index == 0) {
+      IEXTPHeader header;
+      if (!header.Decode(payload_ptr)) {
+        return ReturnCode::FailedDecodingPacket;
+      }
+      entry.protocol_id = header.protocol_id;
+      entry.channel_id = header.channel_id;
+      entry.session_id = header.session_id;
+    }
+
+    // Only the type, timestamp and symbol of each message are needed, so read them in place.
+    auto& index_entry = entry.time_index.back();
+    size_t block_offset = IEXDecoder::first_block_start;
+    const uint8_t* msg_data_ptr = nullptr;
+    size_t msg_len = 0;
+    while (IEXDecoder::GetNextBlock(payload_ptr, payload_len, block_offset, msg_data_ptr,
+                                    msg_len)) {
+      if (msg_len < timestamp_offset + sizeof(int64_t)) {
+        continue;
+      }
+      const uint8_t msg_type = msg_data_ptr[0];
+      const int64_t timestamp = GetNumeric<int64_t>(msg_data_ptr, timestamp_offset);
+
+      ++entry.messages_by_type[msg_type];
+      ++entry.num_messages;
+      entry.first_timestamp = std::min(entry.first_timestamp, timestamp);
+      entry.last_timestamp = std::max(entry.last_timestamp, timestamp);
+      index_entry.min_timestamp = std::min(index_entry.min_timestamp, timestamp);
+      index_entry.max_timestamp = std::max(index_entry.max_timestamp, timestamp);
+      uint64_t packed_symbol = 0;
+      if (GetPackedSymbol(msg_data_ptr, msg_len, packed_symbol)) {
+        entry.symbols.Add(packed_symbol);
+      }
+    }
+  }
+  entry.num_packets = packet_index;
+  return ReturnCode::Success;
+}
+
+bool DatasetCatalog::Build(const std::string& path_or_pattern) {
+  return Build(ListPcapFiles(path_or_pattern));
+}
+
+bool DatasetCatalog::Build(const std::vector<std::string>& filenames) {
+  std::vector<CatalogEntry> entries(filenames.size());
+  std::vector<ReturnCode> ret_codes(filenames.size(), ReturnCode::Success);
+  {
+    WorkStealingPool pool(config_.num_threads);
+    for (size_t i = 0; i < filenames.size(); ++i) {
+      pool.Submit([this, i, &filenames, &entries, &ret_codes]() {
+        ret_codes[i] = ScanFile(filenames[i], entries[i]);
+      });
+    }
+    pool.Wait();
+  }
+
+  entries_.clear();
+  bool success = true;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (ret_codes[i] != ReturnCode::Success) {
+      IEX_LOG("Failed to scan " << filenames[i] << ": " << ReturnCodeToString(ret_codes[i]));
+      success = false;
+      continue;
+    }
+    entries_.emplace_back(std::move(entries[i]));
+  }
+  return success;
+}
+
+std::vector<FileChunk> DatasetCatalog::Query(const CatalogQuery& query) const {
+  std::vector<FileChunk> chunks;
+  for (size_t file_index = 0; file_index < entries_.size(); ++file_index) {
+    const auto& entry = entries_[file_index];
+    if ((query.protocol_id != 0 && query.protocol_id != entry.protocol_id) ||
+        entry.first_timestamp > query.end_time || entry.last_timestamp < query.start_time ||
+        (!query.symbol.empty() && !entry.symbols.MayContain(query.symbol))) {
+      continue;
+    }
+
+    // Merge consecutive matching index entries into one chunk.
+    const size_t first_chunk = chunks.size();
+    bool extend_last = false;
+    for (size_t i = 0; i < entry.time_index.size(); ++i) {
+      const auto& index_entry = entry.time_index[i];
+      if (index_entry.min_timestamp > query.end_time ||
+          index_entry.max_timestamp < query.start_time) {
+        extend_last = false;
+        continue;
+      }
+      const bool is_last = (i + 1 == entry.time_index.size());
+      const uint64_t end_packet = is_last ? std::numeric_limits<uint64_t>::max()
+                                          : entry.time_index[i + 1].first_packet;
+      const uint64_t end_offset = is_last ? entry.file_size : entry.time_index[i + 1].byte_offset;
+      if (extend_last) {
+        chunks.back().end_packet = end_packet;
+        chunks.back().approx_bytes = end_offset - chunks.back().first_offset;
+        continue;
+      }
+      FileChunk chunk;
+      chunk.filename = entry.filename;
+      chunk.file_size = entry.file_size;
+      chunk.file_index = file_index;
+      chunk.first_packet = index_entry.first_packet;
+      chunk.end_packet = end_packet;
+      chunk.first_offset = index_entry.byte_offset;
+      chunk.approx_bytes = end_offset - index_entry.byte_offset;
+      chunks.push_back(chunk);
+      extend_last = true;
+    }
+    for (size_t i = first_chunk; i < chunks.size(); ++i) {
+      chunks[i].chunk_index = i - first_chunk;
+      chunks[i].num_chunks = chunks.size() - first_chunk;
+    }
+  }
+  return chunks;
+}
+
+const CatalogEntry* DatasetCatalog::FindEntry(const std::string& filename) const {
+  for (const auto& entry : entries_) {
+    if (entry.filename == filename) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+ReturnCode DatasetCatalog::SeekToTime(IEXDecoder& decoder, const int64_t start_time) const {
+  const CatalogEntry* entry = FindEntry(decoder.GetFilename());
+  if (entry == nullptr || entry->file_size != GetFileSize(entry->filename)) {
+    return ReturnCode::Success;
+  }
+  // Timestamps are not strictly ordered, so stop at the first entry with any message at or after
+  // the start, rather than searching on the minimum timestamps.
+  for (const auto& index_entry : entry->time_index) {
+    if (index_entry.max_timestamp < start_time) {
+      continue;
+    }
+    if (index_entry.first_packet <= decoder.GetPacketIndex()) {
+      return ReturnCode::Success;
+    }
+    return decoder.SeekToOffset(index_entry.byte_offset, index_entry.first_packet);
+  }
+  return ReturnCode::Success;
+}
+
+bool DatasetCatalog::Save(const std::string& filename) const {
+  std::ofstream out_stream(filename, std::ios::binary);
+  if (!out_stream) {
+    IEX_LOG("Cannot open " << filename << " for writing.");
+    return false;
+  }
+  out_stream.write(catalog_magic, sizeof(catalog_magic));
+  WriteValue<uint64_t>(out_stream, entries_.size());
+  for (const auto& entry : entries_) {
+    WriteString(out_stream, entry.filename);
+    WriteValue(out_stream, entry.file_size);
+    WriteValue(out_stream, entry.protocol_id);
+    WriteValue(out_stream, entry.channel_id);
+    WriteValue(out_stream, entry.session_id);
+    WriteValue(out_stream, entry.first_timestamp);
+    WriteValue(out_stream, entry.last_timestamp);
+    WriteValue(out_stream, entry.num_packets);
+    WriteValue(out_stream, entry.num_messages);
+    WriteValue(out_stream, entry.messages_by_type);
+    entry.symbols.Save(out_stream);
+    WriteValue<uint64_t>(out_stream, entry.time_index.size());
+    for (const auto& index_entry : entry.time_index) {
+      WriteValue(out_stream, index_entry);
+    }
+  }
+  return static_cast<bool>(out_stream);
+}
+
+bool DatasetCatalog::Load(const std::string& filename) {
+  std::ifstream in_stream(filename, std::ios::binary);
+  char magic[sizeof(catalog_magic)];
+  in_stream.read(magic, sizeof(magic));
+  if (!in_stream || std::memcmp(magic, catalog_magic, sizeof(magic)) != 0) {
+    IEX_LOG(filename << " is not a catalog file.");
+    return false;
+  }
+
+  uint64_t num_entries = 0;
+  bool success = ReadValue(in_stream, num_entries);
+  std::vector<CatalogEntry> entries;
+  for (uint64_t i = 0; success && i < num_entries; ++i) {
+    CatalogEntry entry;
+    uint64_t index_size = 0;
+    success = ReadString(in_stream, entry.filename) && ReadValue(in_stream, entry.file_size) &&
+              ReadValue(in_stream, entry.protocol_id) && ReadValue(in_stream, entry.channel_id) &&
+              ReadValue(in_stream, entry.session_id) &&
+              ReadValue(in_stream, entry.first_timestamp) &&
+              ReadValue(in_stream, entry.last_timestamp) &&
+              ReadValue(in_stream, entry.num_packets) &&
+              ReadValue(in_stream, entry.num_messages) &&
+              ReadValue(in_stream, entry.messages_by_type) && entry.symbols.Load(in_stream) &&
+              ReadValue(in_stream, index_size) &&
+              index_size <= GetRemainingSize(in_stream) / sizeof(CatalogEntry::TimeIndexEntry);
+    entry.time_index.resize(success ? index_size : 0);
+    for (auto& index_entry : entry.time_index) {
+      success = success && ReadValue(in_stream, index_entry);
+    }
+    entries.emplace_back(std::move(entry));
+  }
+  if (!success) {
+    IEX_LOG("Failed to read catalog " << filename << ".");
+    return false;
+  }
+  entries_ = std::move(entries);
+  return true;
+}
@@ -0,0 +1,97 @@
+#include "iex_catalog.h"
+
+#include <iostream>
+#include <string>
+
+namespace {
+void PrintUsage() {
+  std::cout << "Usage: iex_catalog build <catalog_file> <directory_or_pattern> [num_threads]\n"
+               "       iex_catalog list <catalog_file>\n"
+               "       iex_catalog query <catalog_file> <symbol|-> [start_ns] [end_ns]"
+            << std::endl;
+}
+
+int BuildCatalog(int argc, char* argv[]) {
+  CatalogConfig config;
+  if (argc > 4) {
+    try {
+      config.num_threads = std::stoull(argv[4]);
+    } catch (...) {
+      std::cout << "Invalid number of threads." << std::endl;
+      return 1;
+    }
+  }
+  DatasetCatalog catalog(config);
+  const bool complete = catalog.Build(argv[3]);
+  if (!catalog.Save(argv[2])) {
+    std::cout << "Failed to write '" << argv[2] << "'." << std::endl;
+    return 1;
+  }
+  std::cout << "Cataloged " << catalog.GetEntries().size() << " files into '" << argv[2] << "'."
+            << std::endl;
+  return complete ? 0 : 1;
+}
+
+int ListCatalog(const DatasetCatalog& catalog) {
+  std::cout << "filename,protocol_id,channel_id,session_id,first_timestamp,last_timestamp,"
+               "num_packets,num_messages"
+            << std::endl;
+  for (const auto& entry : catalog.GetEntries()) {
+    std::cout << entry.filename << "," << entry.protocol_id << "," << entry.channel_id << ","
+              << entry.session_id << "," << entry.first_timestamp << "," << entry.last_timestamp
+              << "," << entry.num_packets << "," << entry.num_messages << std::endl;
+  }
+  return 0;
+}
+
+int QueryCatalog(const DatasetCatalog& catalog, int argc, char* argv[]) {
+  CatalogQuery query;
+  if (std::string(argv[3]) != "-") {
+    query.symbol = argv[3];
+  }
+  try {
+    if (argc > 4) {
+      query.start_time = std::stoll(argv[4]);
+    }
+    if (argc > 5) {
+      query.end_time = std::stoll(argv[5]);
+    }
+  } catch (...) {
+    std::cout << "Invalid timestamp." << std::endl;
+    return 1;
+  }
+
+  std::cout << "filename,first_packet,end_packet,approx_bytes" << std::endl;
+  for (const auto& chunk : catalog.Query(query)) {
+    std::cout << chunk.filename << "," << chunk.first_packet << ",";
+    if (chunk.end_packet != std::numeric_limits<uint64_t>::max()) {
+      std::cout << chunk.end_packet;
+    }
+    std::cout << "," << chunk.approx_bytes << std::endl;
+  }
+  return 0;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    PrintUsage();
+    return 1;
+  }
+
+  const std::string command(argv[1]);
+  if (command == "build" && argc > 3) {
+    return BuildCatalog(argc, argv);
+  }
+
+  DatasetCatalog catalog;
+  if (command != "list" && !(command == "query" && argc > 3)) {
+    PrintUsage();
+    return 1;
+  }
+  if (!catalog.Load(argv[2])) {
+    std::cout << "Failed to read '" << argv[2] << "'." << std::endl;
+    return 1;
+  }
+  return command == "list" ? ListCatalog(catalog) : QueryCatalog(catalog, argc, argv);
+}
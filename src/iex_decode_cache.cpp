@@ -0,0 +1,418 @@
+#include "iex_decode_cache.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+namespace {
+/// \brief Identifies cache files, and their format version.
+constexpr char columns_magic[8] = {'I', 'E', 'X', 'C', 'O', 'L', '0', '2'};
+const std::string cache_extension = ".iexcol";
+
+/// \brief Bytes hashed at the start and end of the file, and at each sample in between.
+constexpr uint64_t edge_len = 64 << 10;
+constexpr uint64_t sample_len = 4 << 10;
+constexpr int num_samples = 14;
+
+/// \brief The file header, followed by the 8 byte columns, the table headers, the table columns,
+///        the rows, the types and the message data.
+struct ColumnsHeader {
+  char magic[sizeof(columns_magic)];
+  uint64_t file_size;
+  uint64_t sampled_hash;
+  uint32_t decoder_version;
+  uint32_t num_tables;
+  uint64_t num_messages;
+  uint64_t msg_data_len;
+};
+
+/// \brief A per type table, followed by the columns of its schema fields.
+struct TableHeader {
+  uint8_t type;
+  uint8_t reserved[7];
+  uint64_t num_rows;
+};
+
+/// \brief Table columns are padded to 8 bytes, so every column is aligned.
+inline uint64_t GetPaddedSize(const uint64_t len) { return (len + 7) & ~uint64_t(7); }
+
+/// \brief 64 bit FNV-1a.
+uint64_t HashBytes(const char* data_ptr, const size_t len, uint64_t hash) {
+  for (size_t i = 0; i < len; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data_ptr[i])) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+/// \brief A file in the cache directory, with the time it was last used.
+struct CacheFile {
+  std::string filename;
+  uint64_t size;
+  time_t last_used;
+};
+
+std::vector<CacheFile> ListCacheFiles(const std::string& directory) {
+  std::vector<CacheFile> cache_files;
+  DIR* dir = opendir(directory.c_str());
+  if (dir == NULL) {
+    IEX_LOG("Cannot open directory " << directory);
+    return cache_files;
+  }
+  while (struct dirent* entry = readdir(dir)) {
+    const std::string name(entry->d_name);
+    struct stat file_stat;
+    if (name.size() <= cache_extension.size() ||
+        name.compare(name.size() - cache_extension.size(), cache_extension.size(),
+                     cache_extension) != 0 ||
+        stat((directory + "/" + name).c_str(), &file_stat) != 0) {
+      continue;
+    }
+    cache_files.push_back({directory + "/" + name, static_cast<uint64_t>(file_stat.st_size),
+                           file_stat.st_mtime});
+  }
+  closedir(dir);
+  return cache_files;
+}
+
+template <typename T>
+void WriteColumn(std::ostream& out_stream, const std::vector<T>& column) {
+  out_stream.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(T));
+}
+}  // namespace
+
+constexpr uint32_t DecodedColumns::no_row;
+
+bool PcapFingerprint::Compute(const std::string& filename) {
+  std::ifstream in_stream(filename, std::ios::binary | std::ios::ate);
+  if (!in_stream) {
+    IEX_LOG("Cannot open " << filename << ".");
+    return false;
+  }
+  file_size = static_cast<uint64_t>(in_stream.tellg());
+  decoder_version = IEXDecoder::version;
+
+  // Offsets and lengths of the hashed ranges. Overlapping ranges in small files do not matter.
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  ranges.emplace_back(0, std::min(edge_len, file_size));
+  for (int i = 1; i <= num_samples; ++i) {
+    const uint64_t offset = file_size / (num_samples + 1) * i;
+    ranges.emplace_back(offset, std::min(sample_len, file_size - offset));
+  }
+  ranges.emplace_back(file_size - std::min(edge_len, file_size), std::min(edge_len, file_size));
+
+  sampled_hash = HashBytes(reinterpret_cast<const char*>(&file_size), sizeof(file_size),
+                           0xcbf29ce484222325ull);
+  std::vector<char> buffer(edge_len);
+  for (const auto& range : ranges) {
+    in_stream.seekg(range.first);
+    if (!in_stream.read(buffer.data(), range.second)) {
+      IEX_LOG("Cannot read " << filename << ".");
+      return false;
+    }
+    sampled_hash = HashBytes(buffer.data(), range.second, sampled_hash);
+  }
+  return true;
+}
+
+std::string PcapFingerprint::ToString() const {
+  std::stringstream string_stream;
+  string_stream << std::hex << file_size << "-" << sampled_hash << "-v" << std::dec
+                << decoder_version;
+  return string_stream.str();
+}
+
+bool DecodedColumns::Open(const std::string& filename) {
+  num_messages_ = 0;
+  next_message_ = 0;
+  filter_ = MessageFilter();
+  filter_active_ = false;
+  std::fill(std::begin(table_index_), std::end(table_index_), 0);
+  tables_.clear();
+  if (!file_.Open(filename)) {
+    return false;
+  }
+
+  // Hands out the next len bytes of the file, or nullptr if it is too short.
+  uint64_t offset = 0;
+  const auto take = [this, &offset](const uint64_t len) -> const uint8_t* {
+    if (len > file_.GetSize() - offset) {
+      return nullptr;
+    }
+    offset += len;
+    return file_.GetData() + offset - len;
+  };
+  const auto* header = reinterpret_cast<const ColumnsHeader*>(take(sizeof(ColumnsHeader)));
+  bool valid = header && std::memcmp(header->magic, columns_magic, sizeof(columns_magic)) == 0 &&
+               header->num_messages < file_.GetSize();
+  if (valid) {
+    num_messages_ = header->num_messages;
+    timestamps_ = reinterpret_cast<const int64_t*>(take(num_messages_ * sizeof(int64_t)));
+    symbols_ = reinterpret_cast<const uint64_t*>(take(num_messages_ * sizeof(uint64_t)));
+    capture_times_ = reinterpret_cast<const int64_t*>(take(num_messages_ * sizeof(int64_t)));
+    msg_offsets_ = reinterpret_cast<const uint64_t*>(take((num_messages_ + 1) * sizeof(uint64_t)));
+    const auto* table_headers = reinterpret_cast<const TableHeader*>(
+        take(static_cast<uint64_t>(header->num_tables) * sizeof(TableHeader)));
+    valid = msg_offsets_ && table_headers;
+    for (uint32_t i = 0; valid && i < header->num_tables; ++i) {
+      const TableHeader& table_header = table_headers[i];
+      const MessageSchema* schema = GetMessageSchema(static_cast<MessageType>(table_header.type));
+      if (!schema || table_index_[table_header.type] != 0 ||
+          table_header.num_rows > num_messages_) {
+        valid = false;
+        break;
+      }
+      tables_.emplace_back();
+      MappedTable& table = tables_.back();
+      table.schema_ = schema;
+      table.num_rows_ = table_header.num_rows;
+      for (const auto& field : schema->fields) {
+        table.columns_.push_back(take(GetPaddedSize(table_header.num_rows * field.size)));
+        valid = valid && table.columns_.back();
+      }
+      table_index_[table_header.type] = static_cast<uint16_t>(tables_.size());
+    }
+    if (valid) {
+      rows_ = reinterpret_cast<const uint32_t*>(take(num_messages_ * sizeof(uint32_t)));
+      types_ = take(num_messages_);
+      msg_data_ = take(header->msg_data_len);
+      valid = rows_ && types_ && msg_data_ && offset == file_.GetSize() &&
+              msg_offsets_[num_messages_] == header->msg_data_len;
+    }
+  }
+  if (!valid) {
+    IEX_LOG(filename << " is not a decode cache file.");
+    num_messages_ = 0;
+    std::fill(std::begin(table_index_), std::end(table_index_), 0);
+    tables_.clear();
+    file_.Close();
+    return false;
+  }
+
+  fingerprint_.file_size = header->file_size;
+  fingerprint_.sampled_hash = header->sampled_hash;
+  fingerprint_.decoder_version = header->decoder_version;
+  return true;
+}
+
+ReturnCode DecodedColumns::DecodeMessage(const size_t msg_index,
+                                         std::unique_ptr<IEXMessageBase>& msg_ptr) const {
+  if (msg_index >= num_messages_) {
+    return ReturnCode::EndOfStream;
+  }
+  const uint8_t* msg_data_ptr = msg_data_ + msg_offsets_[msg_index];
+  msg_ptr = IEXMessageFactory(msg_data_ptr);
+  if (!msg_ptr) {
+    IEX_LOG("Unknown message type " << PRINTHEX(*msg_data_ptr));
+    return ReturnCode::UnknownMessageType;
+  }
+  if (!msg_ptr->Decode(msg_data_ptr)) {
+    return ReturnCode::FailedDecodingPacket;
+  }
+  return ReturnCode::Success;
+}
+
+size_t DecodedColumns::FindNextMessage() {
+  while (filter_active_ && next_message_ < num_messages_) {
+    const uint64_t msg_offset = msg_offsets_[next_message_];
+    if (filter_.Matches(msg_data_ + msg_offset, msg_offsets_[next_message_ + 1] - msg_offset)) {
+      break;
+    }
+    ++next_message_;
+  }
+  return next_message_;
+}
+
+ReturnCode DecodedColumns::GetNextMessage(std::unique_ptr<IEXMessageBase>& msg_ptr) {
+  if (!file_.GetData()) {
+    IEX_LOG("The class has not opened a file yet, call Open first.");
+    return ReturnCode::ClassNotInitialized;
+  }
+  const auto ret_code = DecodeMessage(FindNextMessage(), msg_ptr);
+  if (ret_code == ReturnCode::Success) {
+    ++next_message_;
+  }
+  return ret_code;
+}
+
+ReturnCode DecodedColumns::GetNextMessageData(const uint8_t*& msg_data_ptr, size_t& msg_len) {
+  if (!file_.GetData()) {
+    IEX_LOG("The class has not opened a file yet, call Open first.");
+    return ReturnCode::ClassNotInitialized;
+  }
+  const size_t msg_index = FindNextMessage();
+  if (msg_index >= num_messages_) {
+    return ReturnCode::EndOfStream;
+  }
+  msg_data_ptr = msg_data_ + msg_offsets_[msg_index];
+  msg_len = msg_offsets_[msg_index + 1] - msg_offsets_[msg_index];
+  ++next_message_;
+  return ReturnCode::Success;
+}
+
+void DecodedColumns::SetFilter(const MessageFilter& filter) {
+  filter_ = filter;
+  filter_active_ = !filter.AcceptsAll();
+}
+
+std::string DecodeCache::GetCacheFilename(const PcapFingerprint& fingerprint) const {
+  return config_.directory + "/" + fingerprint.ToString() + cache_extension;
+}
+
+ReturnCode DecodeCache::Build(const std::string& pcap_filename,
+                              const PcapFingerprint& fingerprint,
+                              const std::string& cache_filename) {
+  IEXDecoder decoder;
+  if (!decoder.OpenFileForDecoding(pcap_filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+
+  std::vector<int64_t> timestamps;
+  std::vector<uint64_t> symbols;
+  std::vector<int64_t> capture_times;
+  std::vector<uint64_t> msg_offsets;
+  std::vector<uint32_t> rows;
+  std::vector<uint8_t> types;
+  std::vector<uint8_t> msg_data;
+  MessageTables tables;
+  const uint64_t no_symbol = PackSymbol("");
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  auto ret_code = ReturnCode::Success;
+  while ((ret_code = decoder.GetNextMessage(msg_ptr)) == ReturnCode::Success) {
+    // Store what the decoder produced, so the cache follows the decoder version.
+    const size_t msg_offset = msg_data.size();
+    msg_data.resize(msg_offset + IEXMessageBase::max_encoded_len);
+    const size_t msg_len = msg_ptr->Encode(&msg_data[msg_offset]);
+    msg_data.resize(msg_offset + msg_len);
+
+    uint64_t packed_symbol = no_symbol;
+    GetPackedSymbol(&msg_data[msg_offset], msg_len, packed_symbol);
+    timestamps.push_back(static_cast<int64_t>(msg_ptr->timestamp));
+    symbols.push_back(packed_symbol);
+    capture_times.push_back(decoder.GetLastCaptureTime());
+    msg_offsets.push_back(msg_offset);
+
+    // Appending fails for types without a schema and for short messages, leaving no row.
+    const MessageTable* table = tables.GetTable(msg_ptr->GetMessageType());
+    const size_t num_rows = table ? table->GetNumRows() : 0;
+    tables.Append(&msg_data[msg_offset], msg_len);
+    table = tables.GetTable(msg_ptr->GetMessageType());
+    rows.push_back(table && table->GetNumRows() > num_rows ? static_cast<uint32_t>(num_rows)
+                                                           : DecodedColumns::no_row);
+    types.push_back(static_cast<uint8_t>(msg_ptr->GetMessageType()));
+  }
+  if (ret_code != ReturnCode::EndOfStream) {
+    return ret_code;
+  }
+  msg_offsets.push_back(msg_data.size());
+
+  static std::atomic<uint64_t> temp_counter(0);
+  const std::string temp_filename =
+      cache_filename + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(temp_counter++);
+  {
+    std::ofstream out_stream(temp_filename, std::ios::binary);
+    ColumnsHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, columns_magic, sizeof(header.magic));
+    header.file_size = fingerprint.file_size;
+    header.sampled_hash = fingerprint.sampled_hash;
+    header.decoder_version = fingerprint.decoder_version;
+    header.num_tables = static_cast<uint32_t>(tables.GetTables().size());
+    header.num_messages = timestamps.size();
+    header.msg_data_len = msg_data.size();
+    out_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    WriteColumn(out_stream, timestamps);
+    WriteColumn(out_stream, symbols);
+    WriteColumn(out_stream, capture_times);
+    WriteColumn(out_stream, msg_offsets);
+    for (const auto& table : tables.GetTables()) {
+      TableHeader table_header;
+      std::memset(&table_header, 0, sizeof(table_header));
+      table_header.type = static_cast<uint8_t>(table.GetSchema().type);
+      table_header.num_rows = table.GetNumRows();
+      out_stream.write(reinterpret_cast<const char*>(&table_header), sizeof(table_header));
+    }
+    for (const auto& table : tables.GetTables()) {
+      for (size_t i = 0; i < table.GetSchema().fields.size(); ++i) {
+        const std::vector<uint8_t>& column = table.GetColumn(i);
+        const char padding[8] = {};
+        WriteColumn(out_stream, column);
+        out_stream.write(padding, GetPaddedSize(column.size()) - column.size());
+      }
+    }
+    WriteColumn(out_stream, rows);
+    WriteColumn(out_stream, types);
+    WriteColumn(out_stream, msg_data);
+    if (!out_stream) {
+      IEX_LOG("Failed to write " << temp_filename << ".");
+      std::remove(temp_filename.c_str());
+      return ReturnCode::ClassNotInitialized;
+    }
+  }
+  if (std::rename(temp_filename.c_str(), cache_filename.c_str()) != 0) {
+    IEX_LOG("Failed to rename " << temp_filename << " to " << cache_filename << ".");
+    std::remove(temp_filename.c_str());
+    return ReturnCode::ClassNotInitialized;
+  }
+  return ReturnCode::Success;
+}
+
+ReturnCode DecodeCache::Open(const std::string& pcap_filename, DecodedColumns& columns) {
+  PcapFingerprint fingerprint;
+  if (!fingerprint.Compute(pcap_filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+  const std::string cache_filename = GetCacheFilename(fingerprint);
+
+  if (access(cache_filename.c_str(), R_OK) == 0 && columns.Open(cache_filename) &&
+      columns.GetFingerprint() == fingerprint) {
+    // Mark the file as recently used.
+    utime(cache_filename.c_str(), nullptr);
+    ++num_hits_;
+    return ReturnCode::Success;
+  }
+
+  ++num_misses_;
+  const auto ret_code = Build(pcap_filename, fingerprint, cache_filename);
+  if (ret_code != ReturnCode::Success) {
+    return ret_code;
+  }
+  Evict(cache_filename);
+  return columns.Open(cache_filename) ? ReturnCode::Success : ReturnCode::ClassNotInitialized;
+}
+
+void DecodeCache::Evict(const std::string& keep_filename) {
+  auto cache_files = ListCacheFiles(config_.directory);
+  std::sort(
+      cache_files.begin(), cache_files.end(),
+      [](const CacheFile& lhs, const CacheFile& rhs) { return lhs.last_used < rhs.last_used; });
+  uint64_t total_size = 0;
+  for (const auto& cache_file : cache_files) {
+    total_size += cache_file.size;
+  }
+  for (const auto& cache_file : cache_files) {
+    if (total_size <= config_.max_bytes) {
+      break;
+    }
+    if (cache_file.filename != keep_filename && std::remove(cache_file.filename.c_str()) == 0) {
+      total_size -= cache_file.size;
+    }
+  }
+}
+
+uint64_t DecodeCache::GetSize() const {
+  uint64_t total_size = 0;
+  for (const auto& cache_file : ListCacheFiles(config_.directory)) {
+    total_size += cache_file.size;
+  }
+  return total_size;
+}
@@ -2,20 +2,37 @@
 
 #include "Packet.h"
 #include "PayloadLayer.h"
-#include "PcapFileDevice.h"
 
-bool IEXDecoder::OpenFileForDecoding(const std::string& filename) {
-  reader_ptr_.reset(pcpp::IFileReaderDevice::getReader(filename.c_str()));
+#include <cstring>
 
-  // Check the reader was successfully created.
-  if (reader_ptr_ == NULL) {
-    IEX_LOG("Cannot determine reader for file type\n");
-    return false;
+#include "iex_pcap_reader.h"
+
+constexpr uint32_t IEXDecoder::version;
+constexpr int MessageFilter::timestamp_offset;
+
+void MessageFilter::SetTypes(const std::vector<MessageType>& message_types) {
+  types.reset();
+  for (const auto message_type : message_types) {
+    types.set(static_cast<uint8_t>(message_type));
   }
+}
 
-  // Open the reader for reading.
-  if (!reader_ptr_->open()) {
-    IEX_LOG("Cannot open " + filename + " for reading.");
+void MessageFilter::SetSymbols(const std::vector<std::string>& symbol_list) {
+  symbols.clear();
+  for (const auto& symbol : symbol_list) {
+    symbols.push_back(PackSymbol(symbol));
+  }
+  std::sort(symbols.begin(), symbols.end());
+  symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+}
+
+bool MessageFilter::AcceptsAll() const {
+  return types.all() && symbols.empty() && start_time == std::numeric_limits<int64_t>::min() &&
+         end_time == std::numeric_limits<int64_t>::max();
+}
+
+bool IEXDecoder::OpenFileForDecoding(const std::string& filename) {
+  if (!OpenFileForReading(filename)) {
     return false;
   }
 
@@ -37,29 +54,212 @@ bool IEXDecoder::OpenFileForDecoding(const std::string& filename) {
   return true;
 }
 
-ReturnCode IEXDecoder::ParseNextPacket(IEXTPHeader& header) {
+IEXDecoder::IEXDecoder() = default;
+
+IEXDecoder::~IEXDecoder() = default;
+
+bool IEXDecoder::OpenFileForReading(const std::string& filename) {
+  if (!reader_ptr_) {
+    reader_ptr_.reset(new PcapRecordReader());
+  }
+
+  // Map the file, so packets are decoded in place rather than copied out of the file first.
+  if (!reader_ptr_->Open(filename, true)) {
+    IEX_LOG("Cannot open " + filename + " for reading.");
+    reader_ptr_.reset();
+    return false;
+  }
+
+  filename_ = filename;
+  packet_index_ = 0;
+  end_packet_index_ = std::numeric_limits<uint64_t>::max();
+  packet_ptr_ = nullptr;
+  filter_ = MessageFilter();
+  filter_active_ = false;
+  return true;
+}
+
+ReturnCode IEXDecoder::ReadNextRecord(PcapRecord& record) {
+  IEX_STATS(const uint64_t start_cycles = ReadCycleCounter());
+  const auto ret_code = reader_ptr_->ReadNextRecord(record);
+  if (ret_code != ReturnCode::Success) {
+    return ret_code;
+  }
+  ++packet_index_;
+  IEX_STATS(stats_.AddCycles(DecoderStage::PacketRead, start_cycles));
+  IEX_STATS(stats_.AddPacket(record.len));
+  IEX_STATS(MaybeRunStatsHook());
+  return ReturnCode::Success;
+}
+
+ReturnCode IEXDecoder::ReadNextPacket(pcpp::RawPacket& raw_packet) {
   if (!reader_ptr_) {
     IEX_LOG("The class has not opened a file for reading yet, call OpenFileForDecoding first.");
     return ReturnCode::ClassNotInitialized;
   }
 
-  // Parse the packet.
-  pcpp::RawPacket raw_packet;
-  if (!reader_ptr_->getNextPacket(raw_packet)) {
-    // IEX_LOG("Packet reader returned no more packets to decode.");
-    return ReturnCode::EndOfStream;
-  };
-  parsed_packet_ = pcpp::Packet(&raw_packet);
+  PcapRecord record;
+  const auto ret_code = ReadNextRecord(record);
+  if (ret_code != ReturnCode::Success) {
+    return ret_code;
+  }
+  // The record data belongs to the reader, so hand the raw packet a copy it owns.
+  uint8_t* data_ptr = new uint8_t[record.len];
+  std::memcpy(data_ptr, record.data, record.len);
+  raw_packet.setRawData(data_ptr, static_cast<int>(record.len), record.capture_time,
+                        record.link_type);
+  return ReturnCode::Success;
+}
+
+ReturnCode IEXDecoder::SeekToPacket(const uint64_t packet_index) {
+  if (!reader_ptr_) {
+    IEX_LOG("The class has not opened a file for reading yet, call OpenFileForDecoding first.");
+    return ReturnCode::ClassNotInitialized;
+  }
+
+  // Packet offsets are not known, so start from the beginning of the file again.
+  if (packet_index < packet_index_) {
+    const std::string filename = filename_;
+    const uint64_t end_packet_index = end_packet_index_;
+    if (!OpenFileForReading(filename)) {
+      return ReturnCode::ClassNotInitialized;
+    }
+    end_packet_index_ = end_packet_index;
+  }
+
+  PcapRecord record;
+  while (packet_index_ < packet_index) {
+    auto ret_code = ReadNextRecord(record);
+    if (ret_code != ReturnCode::Success) {
+      return ret_code;
+    }
+  }
+
+  // Drop whatever is left of the current packet.
+  packet_ptr_ = nullptr;
+  return ReturnCode::Success;
+}
+
+ReturnCode IEXDecoder::SeekToOffset(const uint64_t record_offset, const uint64_t packet_index) {
+  if (!reader_ptr_) {
+    IEX_LOG("The class has not opened a file for reading yet, call OpenFileForDecoding first.");
+    return ReturnCode::ClassNotInitialized;
+  }
+  if (!reader_ptr_->Seek(record_offset)) {
+    IEX_LOG("Cannot seek to offset " << record_offset << " of " << filename_ << ".");
+    return ReturnCode::FailedParsingPacket;
+  }
+  packet_index_ = packet_index;
 
+  // Drop whatever is left of the current packet.
+  packet_ptr_ = nullptr;
+  return ReturnCode::Success;
+}
+
+ReturnCode IEXDecoder::ExtractPayload(const pcpp::Packet& packet, const uint8_t*& payload_ptr,
+                                      size_t& payload_len) {
   // Extract the payload layer. This is used by IEX for message data.
-  pcpp::PayloadLayer* payload_layer = parsed_packet_.getLayerOfType<pcpp::PayloadLayer>();
+  pcpp::PayloadLayer* payload_layer = packet.getLayerOfType<pcpp::PayloadLayer>();
   if (payload_layer == NULL) {
     printf("Couldn't find a generic payload layer for IEX message data.");
     return ReturnCode::FailedParsingPacket;
   }
-  packet_ptr_ = payload_layer->getData();
-  packet_len_ = payload_layer->getDataLen();
+  payload_ptr = payload_layer->getData();
+  payload_len = payload_layer->getDataLen();
+  return ReturnCode::Success;
+}
+
+void IEXDecoder::SetFilter(const MessageFilter& filter) {
+  filter_ = filter;
+  filter_active_ = !filter.AcceptsAll();
+}
+
+bool IEXDecoder::FindUdpPayload(const uint8_t* data_ptr, const size_t data_len,
+                                const pcpp::LinkLayerType link_type, const uint8_t*& payload_ptr,
+                                size_t& payload_len) {
+  constexpr size_t eth_header_len = 14;
+  constexpr size_t udp_header_len = 8;
+  if (link_type != pcpp::LINKTYPE_ETHERNET || data_len < eth_header_len + 20 ||
+      data_ptr[12] != 0x08 || data_ptr[13] != 0x00) {
+    return false;
+  }
+  const uint8_t* ip_ptr = data_ptr + eth_header_len;
+  const size_t ip_header_len = (ip_ptr[0] & 0x0f) * 4;
+  const size_t udp_start = eth_header_len + ip_header_len;
+  if ((ip_ptr[0] >> 4) != 4 || ip_ptr[9] != 17 || ip_header_len < 20 ||
+      data_len < udp_start + udp_header_len) {
+    return false;
+  }
+  // The UDP length is big endian, and excludes any Ethernet padding after the datagram.
+  const size_t udp_len = (static_cast<size_t>(data_ptr[udp_start + 4]) << 8) |
+                         data_ptr[udp_start + 5];
+  payload_ptr = data_ptr + udp_start + udp_header_len;
+  payload_len = data_len - udp_start - udp_header_len;
+  if (udp_len >= udp_header_len && udp_len - udp_header_len < payload_len) {
+    payload_len = udp_len - udp_header_len;
+  }
+  return true;
+}
+
+bool IEXDecoder::PeekSendTime(const PcapRecord& record, int64_t& send_time) {
+  constexpr int send_time_offset = 32;
+  const uint8_t* payload_ptr = nullptr;
+  size_t payload_len = 0;
+  if (!FindUdpPayload(record.data, record.len, record.link_type, payload_ptr, payload_len) ||
+      payload_len < first_block_start) {
+    return false;
+  }
+  send_time = GetNumeric<int64_t>(payload_ptr, send_time_offset);
+  return true;
+}
+
+ReturnCode IEXDecoder::ParseNextPacket(IEXTPHeader& header) {
+  // Parse the packet.
+  PcapRecord record;
+  auto ret_code = ReadNextRecord(record);
+  if (ret_code != ReturnCode::Success) {
+    return ret_code;
+  }
+
+  // Skip packets outside the filter time range before spending any time on parsing them.
+  int64_t send_time = 0;
+  while (filter_active_ && PeekSendTime(record, send_time)) {
+    if (filter_.IsPastEnd(send_time)) {
+      return ReturnCode::EndOfStream;
+    }
+    if (!filter_.IsBeforeStart(send_time)) {
+      break;
+    }
+    if (packet_index_ >= end_packet_index_) {
+      return ReturnCode::EndOfStream;
+    }
+    ret_code = ReadNextRecord(record);
+    if (ret_code != ReturnCode::Success) {
+      return ret_code;
+    }
+  }
+  last_capture_time_ =
+      static_cast<int64_t>(record.capture_time.tv_sec) * 1000000000 + record.capture_time.tv_nsec;
+
+  IEX_STATS(uint64_t cycles = ReadCycleCounter());
+  // Plain Ethernet, IPv4 and UDP frames are decoded in place, anything else is parsed by pcpp.
+  if (!FindUdpPayload(record.data, record.len, record.link_type, packet_ptr_, packet_len_)) {
+    pcpp::RawPacket raw_packet(record.data, static_cast<int>(record.len), record.capture_time,
+                               false, record.link_type);
+    parsed_packet_ = pcpp::Packet(&raw_packet);
+    ret_code = ExtractPayload(parsed_packet_, packet_ptr_, packet_len_);
+    if (ret_code != ReturnCode::Success) {
+      packet_ptr_ = nullptr;
+      return ret_code;
+    }
+  }
+  if (packet_len_ < first_block_start) {
+    IEX_LOG("Packet " << packet_index_ << " is too short for an IEX-TP header.");
+    packet_ptr_ = nullptr;
+    return ReturnCode::FailedParsingPacket;
+  }
   block_offset_ = first_block_start;
+  IEX_STATS(cycles = stats_.AddCycles(DecoderStage::LayerParse, cycles));
 
   // Handle header packet.
   bool success = header.Decode(packet_ptr_);
@@ -67,56 +267,115 @@ ReturnCode IEXDecoder::ParseNextPacket(IEXTPHeader& header) {
     IEX_LOG("Header decode failed.");
     return ReturnCode::FailedDecodingPacket;
   }
+  IEX_STATS(stats_.AddCycles(DecoderStage::HeaderDecode, cycles));
+  IEX_STATS(if (header.payload_len == 0) { stats_.AddHeartbeat(); })
   return ReturnCode::Success;
 }
 
-ReturnCode IEXDecoder::GetNextMessage(std::unique_ptr<IEXMessageBase>& msg_ptr) {
+ReturnCode IEXDecoder::GetNextMessageData(const uint8_t*& msg_data_ptr, size_t& msg_len) {
   if (!reader_ptr_) {
     IEX_LOG("The class has not opened a file for reading yet, " << "call OpenFileForDecoding first.");
     return ReturnCode::ClassNotInitialized;
   }
 
-  // Check if the packet pointer is valid.  If not, the next packet needs to be parsed.
-  if (!packet_ptr_) {
-    do {
-      // Parse the next packet.  This reset block_offset_, packet_len and packet_ptr.
-      auto ret_code = ParseNextPacket(last_decoded_header_);
-      if (ret_code != ReturnCode::Success) {
-        return ret_code;
-      }
-      // Sometimes the packet is empty. This is a heartbeat from the server every second
-      // when there are no new messages.  There is nothing to decode so this loop will skip them.
-    } while (last_decoded_header_.payload_len == 0);
-  }
+  do {
+    // Check if the packet pointer is valid.  If not, the next packet needs to be parsed.
+    if (!packet_ptr_) {
+      do {
+        if (packet_index_ >= end_packet_index_) {
+          return ReturnCode::EndOfStream;
+        }
+        // Parse the next packet.  This reset block_offset_, packet_len and packet_ptr.
+        auto ret_code = ParseNextPacket(last_decoded_header_);
+        if (ret_code != ReturnCode::Success) {
+          return ret_code;
+        }
+        if (filter_active_ && filter_.IsPastEnd(last_decoded_header_.send_time)) {
+          return ReturnCode::EndOfStream;
+        }
+        // Sometimes the packet is empty. This is a heartbeat from the server every second
+        // when there are no new messages.  There is nothing to decode so this loop will skip them.
+        // Packets sent before the filter start time cannot contain any matching message either.
+      } while (last_decoded_header_.payload_len == 0 ||
+               (filter_active_ && filter_.IsBeforeStart(last_decoded_header_.send_time)));
+    }
+
+    // Get a pointer to the current block.
+    const uint8_t* block_ptr = packet_ptr_ + block_offset_;
 
-  // Get a pointer to the current block.
-  const uint8_t* block_ptr = packet_ptr_ + block_offset_;
+    // Get the length of current block.
+    msg_len = GetBlockSize(block_ptr);
 
-  // Get the length of current block.
-  const int block_len = GetBlockSize(block_ptr);
+    // Get the pointer to the data within this block.
+    msg_data_ptr = GetBlockData(block_ptr);
 
-  // Get the pointer to the data within this block.
-  const uint8_t* msg_data_ptr = GetBlockData(block_ptr);
+    // Move the block offset to the next block.
+    // The +2 is for the two bytes containing the block size not counted in the block length.
+    block_offset_ += msg_len + 2;
 
-  // Move the block offset to the next block.
-  // The +2 is for the two bytes containing the block size not counted in the block length.
-  block_offset_ += block_len + 2;
+    // If we have gone through the whole packet, reset the pointer.
+    if (block_offset_ >= packet_len_) {
+      packet_ptr_ = 0;
+    }
 
-  // If we have gone through the whole packet, reset the pointer.
-  if (block_offset_ >= packet_len_) {
-    packet_ptr_ = 0;
+    IEX_STATS(stats_.AddBlock());
+    // Blocks not passing the filter are dropped here, without ever being decoded.
+  } while (filter_active_ && !filter_.Matches(msg_data_ptr, msg_len));
+  return ReturnCode::Success;
+}
+
+ReturnCode IEXDecoder::GetNextMessage(std::unique_ptr<IEXMessageBase>& msg_ptr) {
+  const uint8_t* msg_data_ptr = nullptr;
+  size_t block_len = 0;
+  auto ret_code = GetNextMessageData(msg_data_ptr, block_len);
+  if (ret_code != ReturnCode::Success) {
+    return ret_code;
   }
 
+  IEX_STATS(uint64_t cycles = ReadCycleCounter());
   msg_ptr = IEXMessageFactory(msg_data_ptr);
   if (!msg_ptr) {
     IEX_LOG("Unknown message type " << PRINTHEX(*msg_data_ptr));
     IEX_LOG("Block len " << block_len);
     return ReturnCode::UnknownMessageType;
   }
+  IEX_STATS(cycles = stats_.AddCycles(DecoderStage::Factory, cycles));
 
   if (!msg_ptr->Decode(msg_data_ptr)) {
     return ReturnCode::FailedDecodingPacket;
   }
+  IEX_STATS(stats_.AddCycles(DecoderStage::MessageDecode, cycles));
+  IEX_STATS(stats_.AddMessage(*msg_data_ptr));
 
   return ReturnCode::Success;
 }
+
+DecoderStats IEXDecoder::GetStats() const {
+#ifdef IEX_ENABLE_STATS
+  return stats_.Snapshot();
+#else
+  return DecoderStats();
+#endif
+}
+
+void IEXDecoder::ResetStats() { IEX_STATS(stats_.Reset()); }
+
+void IEXDecoder::SetStatsHook(const DecoderStatsHook& hook, const uint64_t packet_interval) {
+#ifdef IEX_ENABLE_STATS
+  stats_hook_ = hook;
+  stats_hook_interval_ = packet_interval;
+  packets_since_stats_hook_ = 0;
+#else
+  (void)hook;
+  (void)packet_interval;
+#endif
+}
+
+#ifdef IEX_ENABLE_STATS
+void IEXDecoder::MaybeRunStatsHook() {
+  if (stats_hook_ && ++packets_since_stats_hook_ >= stats_hook_interval_) {
+    packets_since_stats_hook_ = 0;
+    stats_hook_(stats_.Snapshot());
+  }
+}
+#endif
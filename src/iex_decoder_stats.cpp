@@ -0,0 +1,101 @@
+#include "iex_decoder_stats.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "iex_messages.h"
+
+namespace {
+/// \brief Pad a name with spaces, so the values printed after it line up.
+std::string PadRight(std::string name, const size_t width) {
+  name.resize(std::max(name.size(), width), ' ');
+  return name;
+}
+}  // namespace
+
+std::string DecoderStageToString(const DecoderStage stage) {
+  switch (stage) {
+    case DecoderStage::PacketRead:
+      return "Packet read";
+    case DecoderStage::LayerParse:
+      return "Layer parse";
+    case DecoderStage::HeaderDecode:
+      return "Header decode";
+    case DecoderStage::Factory:
+      return "Factory";
+    case DecoderStage::MessageDecode:
+      return "Message decode";
+    default:
+      return "Unknown stage";
+  }
+}
+
+uint64_t DecoderStats::GetMessageCount() const {
+  uint64_t count = 0;
+  for (const auto num_messages : messages_by_type) {
+    count += num_messages;
+  }
+  return count;
+}
+
+uint64_t DecoderStats::GetTotalCycles() const {
+  uint64_t cycles = 0;
+  for (const auto stage_cycle : stage_cycles) {
+    cycles += stage_cycle;
+  }
+  return cycles;
+}
+
+void DecoderStats::Print() const {
+  const uint64_t num_messages = GetMessageCount();
+  const uint64_t total_cycles = GetTotalCycles();
+  IEX_LOG("Packets           : " << packets << " (" << heartbeats << " heartbeats)");
+  IEX_LOG("Bytes             : " << bytes);
+  IEX_LOG("Blocks            : " << blocks);
+  IEX_LOG("Messages          : " << num_messages);
+  for (size_t i = 0; i < messages_by_type.size(); ++i) {
+    if (messages_by_type[i] > 0) {
+      IEX_LOG("  " << PadRight(MessageTypeToString(static_cast<MessageType>(i)), 34) << ": "
+                   << messages_by_type[i]);
+    }
+  }
+  IEX_LOG("Cycles            : " << total_cycles);
+  for (size_t i = 0; i < stage_cycles.size(); ++i) {
+    const double share = total_cycles ? 100.0 * stage_cycles[i] / total_cycles : 0.0;
+    const double per_message = num_messages ? static_cast<double>(stage_cycles[i]) / num_messages
+                                            : 0.0;
+    std::stringstream ss;
+    ss.precision(1);
+    ss << std::fixed << share << "%, " << per_message << " per message";
+    IEX_LOG("  " << PadRight(DecoderStageToString(static_cast<DecoderStage>(i)), 16) << ": "
+                 << ss.str());
+  }
+}
+
+DecoderStats DecoderCounters::Snapshot() const {
+  DecoderStats stats;
+  stats.packets = packets_.load(std::memory_order_relaxed);
+  stats.bytes = bytes_.load(std::memory_order_relaxed);
+  stats.heartbeats = heartbeats_.load(std::memory_order_relaxed);
+  stats.blocks = blocks_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < messages_by_type_.size(); ++i) {
+    stats.messages_by_type[i] = messages_by_type_[i].load(std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < stage_cycles_.size(); ++i) {
+    stats.stage_cycles[i] = stage_cycles_[i].load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+void DecoderCounters::Reset() {
+  packets_.store(0, std::memory_order_relaxed);
+  bytes_.store(0, std::memory_order_relaxed);
+  heartbeats_.store(0, std::memory_order_relaxed);
+  blocks_.store(0, std::memory_order_relaxed);
+  for (auto& counter : messages_by_type_) {
+    counter.store(0, std::memory_order_relaxed);
+  }
+  for (auto& counter : stage_cycles_) {
+    counter.store(0, std::memory_order_relaxed);
+  }
+}
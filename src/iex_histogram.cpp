@@ -0,0 +1,75 @@
+#include "iex_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram(const int sub_bucket_bits)
+    : sub_bucket_bits_(std::min(std::max(sub_bucket_bits, 1), 16)),
+      sub_bucket_count_(uint64_t(1) << sub_bucket_bits_),
+      // Values with the highest bit at position 63 end up in the last group of sub-buckets.
+      counts_((65 - sub_bucket_bits_) * sub_bucket_count_, 0) {}
+
+bool LatencyHistogram::Merge(const LatencyHistogram& other) {
+  if (other.sub_bucket_bits_ != sub_bucket_bits_) {
+    IEX_LOG("Cannot merge histograms of different precision.");
+    return false;
+  }
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  total_count_ += other.total_count_;
+  negative_count_ += other.negative_count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+  return true;
+}
+
+void LatencyHistogram::Reset() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  total_count_ = 0;
+  negative_count_ = 0;
+  sum_ = 0;
+  min_ = UINT64_MAX;
+  max_ = 0;
+}
+
+uint64_t LatencyHistogram::GetBucketHighestValue(const size_t bucket_index) const {
+  if (bucket_index < 2 * sub_bucket_count_) {
+    return bucket_index;
+  }
+  const int shift = static_cast<int>(bucket_index / sub_bucket_count_) - 1;
+  const uint64_t mantissa = bucket_index % sub_bucket_count_ + sub_bucket_count_;
+  // Wraps to the maximum for the very last bucket, which is what we want.
+  return ((mantissa + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::GetValueAtPercentile(const double percentile) const {
+  if (total_count_ == 0) {
+    return 0;
+  }
+  const double clamped = std::min(std::max(percentile, 0.0), 100.0);
+  const uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * total_count_)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return std::min(GetBucketHighestValue(i), max_);
+    }
+  }
+  return max_;
+}
+
+double LatencyHistogram::GetMean() const {
+  return total_count_ ? static_cast<double>(sum_) / total_count_ : 0.0;
+}
+
+void LatencyHistogram::Print(const std::string& name) const {
+  IEX_LOG(name << ": count " << total_count_ << ", mean " << GetMean() << ", min " << GetMin()
+               << ", p50 " << GetValueAtPercentile(50.0) << ", p90 "
+               << GetValueAtPercentile(90.0) << ", p99 " << GetValueAtPercentile(99.0)
+               << ", p99.9 " << GetValueAtPercentile(99.9) << ", p99.99 "
+               << GetValueAtPercentile(99.99) << ", max " << GetMax()
+               << (negative_count_ ? ", negative " + std::to_string(negative_count_) : ""));
+}
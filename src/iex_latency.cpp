@@ -0,0 +1,46 @@
+#include "iex_latency.h"
+
+void LatencyRecorder::Record(const IEXTPHeader& header, const int64_t capture_time,
+                             const IEXMessageBase& msg) {
+  // The first message of a packet records the per packet latencies.
+  if (header.first_msg_sq_num != last_packet_sequence_number_) {
+    last_packet_sequence_number_ = header.first_msg_sq_num;
+    publication_latency_.Record(header.send_time - static_cast<int64_t>(msg.timestamp));
+    wire_latency_.Record(capture_time - header.send_time);
+  }
+
+  auto& histogram = internal_latency_[static_cast<uint8_t>(msg.GetMessageType())];
+  if (!histogram) {
+    histogram.reset(new LatencyHistogram());
+  }
+  histogram->Record(header.send_time - static_cast<int64_t>(msg.timestamp));
+}
+
+void LatencyRecorder::Merge(const LatencyRecorder& other) {
+  // All histograms here use the default precision, so merging cannot fail.
+  bool success = publication_latency_.Merge(other.publication_latency_);
+  success = wire_latency_.Merge(other.wire_latency_) && success;
+  for (size_t i = 0; i < internal_latency_.size(); ++i) {
+    if (!other.internal_latency_[i]) {
+      continue;
+    }
+    if (!internal_latency_[i]) {
+      internal_latency_[i].reset(new LatencyHistogram());
+    }
+    success = internal_latency_[i]->Merge(*other.internal_latency_[i]) && success;
+  }
+  if (!success) {
+    IEX_LOG("Failed to merge latency histograms.");
+  }
+}
+
+void LatencyRecorder::Print() const {
+  publication_latency_.Print("Publication latency (ns)");
+  wire_latency_.Print("Wire latency (ns)");
+  for (size_t i = 0; i < internal_latency_.size(); ++i) {
+    if (internal_latency_[i]) {
+      internal_latency_[i]->Print("Internal latency (ns) " +
+                                  MessageTypeToString(static_cast<MessageType>(i)));
+    }
+  }
+}
@@ -0,0 +1,45 @@
+#include "iex_mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MappedFile::Open(const std::string& filename) {
+  Close();
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    IEX_LOG("Cannot open " << filename << ".");
+    return false;
+  }
+  struct stat file_stat;
+  void* map_ptr = MAP_FAILED;
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+    map_ptr = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  // The mapping stays valid after the file is closed.
+  close(fd);
+  if (map_ptr == MAP_FAILED) {
+    IEX_LOG("Cannot map " << filename << ".");
+    return false;
+  }
+  data_ = static_cast<const uint8_t*>(map_ptr);
+  size_ = file_stat.st_size;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+void MappedFile::WillNeed(const uint8_t* data_ptr, const size_t len) const {
+  // madvise needs a page aligned start.
+  const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t start = reinterpret_cast<uintptr_t>(data_ptr);
+  const uintptr_t aligned_start = start & ~(page_size - 1);
+  madvise(reinterpret_cast<void*>(aligned_start), len + (start - aligned_start), MADV_WILLNEED);
+}
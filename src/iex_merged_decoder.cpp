@@ -0,0 +1,142 @@
+#include "iex_merged_decoder.h"
+
+#include <algorithm>
+
+#include "iex_thread_utils.h"
+
+MergedDecoder::~MergedDecoder() { StopSources(); }
+
+void MergedDecoder::StopSources() {
+  stop_ = true;
+  for (auto& source : sources_) {
+    if (source->thread.joinable()) {
+      source->thread.join();
+    }
+  }
+  sources_.clear();
+  heap_.clear();
+  heap_initialized_ = false;
+  stop_ = false;
+}
+
+bool MergedDecoder::OpenFilesForDecoding(const std::vector<std::string>& filenames) {
+  StopSources();
+  pending_error_ = ReturnCode::Success;
+
+  for (const auto& filename : filenames) {
+    std::unique_ptr<Source> source(new Source(ring_capacity_));
+    if (!source->decoder.OpenFileForDecoding(filename)) {
+      IEX_LOG("Failed to open source '" << filename << "'.");
+      sources_.clear();
+      return false;
+    }
+    sources_.emplace_back(std::move(source));
+  }
+
+  // Only start decoding once every file opened, so a failure leaves no threads running.
+  for (auto& source : sources_) {
+    source->thread = std::thread(&MergedDecoder::PrefetchLoop, this, std::ref(*source));
+  }
+  return true;
+}
+
+void MergedDecoder::PrefetchLoop(Source& source) {
+  MessageBatch batch;
+  batch.reserve(prefetch_batch_size_);
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  auto ret_code = source.decoder.GetNextMessage(msg_ptr);
+  for (; ret_code == ReturnCode::Success; ret_code = source.decoder.GetNextMessage(msg_ptr)) {
+    batch.emplace_back(std::move(msg_ptr));
+    if (batch.size() < prefetch_batch_size_) {
+      continue;
+    }
+    while (!source.ring.TryPush(std::move(batch))) {
+      if (stop_.load(std::memory_order_relaxed)) {
+        return;
+      }
+      WaitForOtherThread();
+    }
+    batch = MessageBatch();
+    batch.reserve(prefetch_batch_size_);
+  }
+
+  while (!batch.empty() && !source.ring.TryPush(std::move(batch))) {
+    if (stop_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    WaitForOtherThread();
+  }
+  source.final_code = ret_code;
+  source.done.store(true, std::memory_order_release);
+}
+
+ReturnCode MergedDecoder::TakeNextMessage(Source& source,
+                                          std::unique_ptr<IEXMessageBase>& msg_ptr) {
+  while (source.batch_idx >= source.batch.size()) {
+    source.batch_idx = 0;
+    if (source.ring.TryPop(source.batch)) {
+      continue;
+    }
+    source.batch.clear();
+    // Check the done flag before the second pop, so the final batch is not missed.
+    if (source.done.load(std::memory_order_acquire)) {
+      if (!source.ring.TryPop(source.batch)) {
+        return source.final_code;
+      }
+    } else {
+      WaitForOtherThread();
+    }
+  }
+  msg_ptr = std::move(source.batch[source.batch_idx++]);
+  return ReturnCode::Success;
+}
+
+void MergedDecoder::RefillFromSource(const size_t source_id) {
+  HeapEntry entry;
+  auto ret_code = TakeNextMessage(*sources_[source_id], entry.msg_ptr);
+  if (ret_code != ReturnCode::Success) {
+    if (ret_code != ReturnCode::EndOfStream && pending_error_ == ReturnCode::Success) {
+      pending_error_ = ret_code;
+    }
+    return;
+  }
+  entry.timestamp = entry.msg_ptr->timestamp;
+  entry.source_id = source_id;
+  heap_.emplace_back(std::move(entry));
+  std::push_heap(heap_.begin(), heap_.end(), HeapCompare);
+}
+
+ReturnCode MergedDecoder::GetNextMessage(std::unique_ptr<IEXMessageBase>& msg_ptr,
+                                         size_t& source_id) {
+  if (sources_.empty()) {
+    IEX_LOG("The class has not opened any files yet, call OpenFilesForDecoding first.");
+    return ReturnCode::ClassNotInitialized;
+  }
+
+  if (!heap_initialized_) {
+    heap_.reserve(sources_.size());
+    for (size_t i = 0; i < sources_.size(); ++i) {
+      RefillFromSource(i);
+    }
+    heap_initialized_ = true;
+  }
+
+  if (pending_error_ != ReturnCode::Success) {
+    auto ret_code = pending_error_;
+    pending_error_ = ReturnCode::Success;
+    return ret_code;
+  }
+
+  if (heap_.empty()) {
+    return ReturnCode::EndOfStream;
+  }
+
+  std::pop_heap(heap_.begin(), heap_.end(), HeapCompare);
+  msg_ptr = std::move(heap_.back().msg_ptr);
+  source_id = heap_.back().source_id;
+  heap_.pop_back();
+
+  // Replace the returned message with the next one from the same source.
+  RefillFromSource(source_id);
+  return ReturnCode::Success;
+}
@@ -0,0 +1,148 @@
+#include "iex_message_table.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace {
+constexpr FieldSpec timestamp_field = {"timestamp", 2, FieldType::Int64, 8};
+constexpr FieldSpec symbol_field = {"symbol", 10, FieldType::Bytes, 8};
+
+/// \brief A field of the first byte after the message type, an enum or flags.
+constexpr FieldSpec ByteField(const char* name) { return FieldSpec{name, 1, FieldType::UInt8, 1}; }
+
+MessageSchema MakeSchema(const MessageType type, const char* name,
+                         const std::vector<FieldSpec>& fields) {
+  // Prices take 8 bytes on the wire and as a double, so the column size is the wire size.
+  size_t min_len = 0;
+  for (const auto& field : fields) {
+    min_len = std::max(min_len, static_cast<size_t>(field.offset + field.size));
+  }
+  return MessageSchema{type, name, fields, min_len};
+}
+
+std::vector<MessageSchema> MakeSchemas() {
+  const FieldSpec trade_fields[] = {
+      ByteField("flags"), timestamp_field, symbol_field,
+      {"size", 18, FieldType::UInt32, 4}, {"price", 22, FieldType::Price, 8},
+      {"trade_id", 30, FieldType::UInt64, 8}};
+  const FieldSpec price_level_fields[] = {
+      ByteField("flags"), timestamp_field, symbol_field,
+      {"size", 18, FieldType::UInt32, 4}, {"price", 22, FieldType::Price, 8}};
+  return {
+      MakeSchema(MessageType::SystemEvent, "SystemEvent",
+                 {ByteField("system_event"), timestamp_field}),
+      MakeSchema(MessageType::SecurityDirectory, "SecurityDirectory",
+                 {ByteField("flags"), timestamp_field, symbol_field,
+                  {"round_lot_size", 18, FieldType::UInt32, 4},
+                  {"adjusted_POC_price", 22, FieldType::Price, 8},
+                  {"LULD_tier", 30, FieldType::UInt8, 1}}),
+      MakeSchema(MessageType::TradingStatus, "TradingStatus",
+                 {ByteField("trading_status"), timestamp_field, symbol_field,
+                  {"reason", 18, FieldType::Bytes, 4}}),
+      MakeSchema(MessageType::OperationalHaltStatus, "OperationalHaltStatus",
+                 {ByteField("operational_halt_status"), timestamp_field, symbol_field}),
+      MakeSchema(MessageType::ShortSalePriceTestStatus, "ShortSalePriceTestStatus",
+                 {ByteField("short_sale_test_in_effect"), timestamp_field, symbol_field,
+                  {"detail", 18, FieldType::UInt8, 1}}),
+      MakeSchema(MessageType::QuoteUpdate, "QuoteUpdate",
+                 {ByteField("flags"), timestamp_field, symbol_field,
+                  {"bid_size", 18, FieldType::UInt32, 4}, {"bid_price", 22, FieldType::Price, 8},
+                  {"ask_price", 30, FieldType::Price, 8}, {"ask_size", 38, FieldType::UInt32, 4}}),
+      MakeSchema(MessageType::TradeReport, "TradeReport",
+                 std::vector<FieldSpec>(std::begin(trade_fields), std::end(trade_fields))),
+      MakeSchema(MessageType::TradeBreak, "TradeBreak",
+                 std::vector<FieldSpec>(std::begin(trade_fields), std::end(trade_fields))),
+      MakeSchema(MessageType::OfficialPrice, "OfficialPrice",
+                 {ByteField("price_type"), timestamp_field, symbol_field,
+                  {"price", 18, FieldType::Price, 8}}),
+      MakeSchema(MessageType::AuctionInformation, "AuctionInformation",
+                 {ByteField("auction_type"), timestamp_field, symbol_field,
+                  {"paired_shares", 18, FieldType::UInt32, 4},
+                  {"reference_price", 22, FieldType::Price, 8},
+                  {"indicative_clearing_price", 30, FieldType::Price, 8},
+                  {"imbalance_shares", 38, FieldType::UInt32, 4},
+                  {"imbalance_side", 42, FieldType::UInt8, 1},
+                  {"extension_number", 43, FieldType::UInt8, 1},
+                  {"scheduled_auction_time", 44, FieldType::UInt32, 4},
+                  {"auction_book_clearing_price", 48, FieldType::Price, 8},
+                  {"collar_reference_price", 56, FieldType::Price, 8},
+                  {"lower_auction_collar", 64, FieldType::Price, 8},
+                  {"upper_auction_collar", 72, FieldType::Price, 8}}),
+      MakeSchema(MessageType::PriceLevelUpdateBuy, "PriceLevelUpdateBuy",
+                 std::vector<FieldSpec>(std::begin(price_level_fields),
+                                        std::end(price_level_fields))),
+      MakeSchema(MessageType::PriceLevelUpdateSell, "PriceLevelUpdateSell",
+                 std::vector<FieldSpec>(std::begin(price_level_fields),
+                                        std::end(price_level_fields))),
+      MakeSchema(MessageType::SecurityEvent, "SecurityEvent",
+                 {ByteField("security_event"), timestamp_field, symbol_field})};
+}
+}  // namespace
+
+const MessageSchema* GetMessageSchema(const MessageType type) {
+  static const std::vector<MessageSchema> schemas = MakeSchemas();
+  for (const auto& schema : schemas) {
+    if (schema.type == type) {
+      return &schema;
+    }
+  }
+  return nullptr;
+}
+
+MessageTable::MessageTable(const MessageSchema& schema)
+    : schema_(&schema), columns_(schema.fields.size()) {}
+
+bool MessageTable::Append(const uint8_t* msg_data_ptr, const size_t msg_len) {
+  if (msg_len < schema_->min_len) {
+    return false;
+  }
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    const FieldSpec& field = schema_->fields[i];
+    std::vector<uint8_t>& column = columns_[i];
+    const size_t end = column.size();
+    column.resize(end + field.size);
+    if (field.type == FieldType::Price) {
+      const double price = GetPrice(msg_data_ptr, field.offset);
+      std::memcpy(&column[end], &price, sizeof(price));
+    } else {
+      // Integers are little endian on the wire, as on the hosts supported.
+      std::memcpy(&column[end], msg_data_ptr + field.offset, field.size);
+    }
+  }
+  ++num_rows_;
+  return true;
+}
+
+void MessageTables::Append(const uint8_t* msg_data_ptr, const size_t msg_len) {
+  uint16_t& index = table_index_[*msg_data_ptr];
+  if (index == 0) {
+    const MessageSchema* schema = GetMessageSchema(static_cast<MessageType>(*msg_data_ptr));
+    if (!schema) {
+      return;
+    }
+    tables_.emplace_back(*schema);
+    index = static_cast<uint16_t>(tables_.size());
+  }
+  tables_[index - 1].Append(msg_data_ptr, msg_len);
+}
+
+ReturnCode MessageTables::AddFile(const std::string& filename, const MessageFilter& filter) {
+  IEXDecoder decoder;
+  if (!decoder.OpenFileForDecoding(filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+  decoder.SetFilter(filter);
+  const uint8_t* msg_data_ptr = nullptr;
+  size_t msg_len = 0;
+  auto ret_code = ReturnCode::Success;
+  while ((ret_code = decoder.GetNextMessageData(msg_data_ptr, msg_len)) == ReturnCode::Success) {
+    Append(msg_data_ptr, msg_len);
+  }
+  return ret_code == ReturnCode::EndOfStream ? ReturnCode::Success : ret_code;
+}
+
+const MessageTable* MessageTables::GetTable(const MessageType type) const {
+  const uint16_t index = table_index_[static_cast<uint8_t>(type)];
+  return index > 0 ? &tables_[index - 1] : nullptr;
+}
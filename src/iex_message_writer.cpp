@@ -0,0 +1,157 @@
+#include "iex_message_writer.h"
+
+#include <iostream>
+
+#include "iex_predicate.h"
+
+namespace {
+/// \brief Columns after timestamp, type and symbol, in the order of MessageField.
+constexpr MessageField csv_fields[] = {MessageField::Price,    MessageField::Size,
+                                       MessageField::BidPrice, MessageField::BidSize,
+                                       MessageField::AskPrice, MessageField::AskSize};
+
+bool EndsWith(const std::string& str, const std::string& suffix) {
+  return str.size() >= suffix.size() &&
+         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}  // namespace
+
+bool CsvMessageWriter::Open(const std::string& filename) {
+  if (filename == "-") {
+    out_stream_ = &std::cout;
+  } else {
+    file_stream_.open(filename);
+    if (!file_stream_) {
+      IEX_LOG("Cannot open " << filename << " for writing.");
+      return false;
+    }
+    out_stream_ = &file_stream_;
+  }
+  // Enough digits for any price, which have four decimals.
+  out_stream_->precision(15);
+  *out_stream_ << "Timestamp,Type,Symbol,Price,Size,BidPrice,BidSize,AskPrice,AskSize\n";
+  return static_cast<bool>(*out_stream_);
+}
+
+bool CsvMessageWriter::Write(const IEXMessageBase& msg, const IEXTPHeader& header,
+                             const int64_t capture_time) {
+  (void)header;
+  (void)capture_time;
+  if (!out_stream_) {
+    return false;
+  }
+  // Every message with a symbol has it at the same offset, so take it from the encoded message.
+  uint8_t msg_data[IEXMessageBase::max_encoded_len];
+  const size_t msg_len = msg.Encode(msg_data);
+  uint64_t packed_symbol = 0;
+  const std::string symbol =
+      GetPackedSymbol(msg_data, msg_len, packed_symbol)
+          ? GetString(msg_data, symbol_field_offset, symbol_field_len)
+          : std::string();
+
+  std::string type_name = MessageTypeToString(msg.GetMessageType());
+  type_name = type_name.substr(0, type_name.find(' '));
+  *out_stream_ << msg.timestamp << ',' << type_name << ',' << symbol;
+  for (const auto field : csv_fields) {
+    double value = 0;
+    *out_stream_ << ',';
+    if (GetFieldValue(msg, field, value)) {
+      *out_stream_ << value;
+    }
+  }
+  *out_stream_ << '\n';
+  ++num_messages_;
+  return static_cast<bool>(*out_stream_);
+}
+
+bool CsvMessageWriter::Close() {
+  if (!out_stream_) {
+    return false;
+  }
+  out_stream_->flush();
+  const bool success = static_cast<bool>(*out_stream_);
+  if (file_stream_.is_open()) {
+    file_stream_.close();
+  }
+  out_stream_ = nullptr;
+  return success;
+}
+
+bool PcapMessageWriter::Open(const std::string& filename) {
+  builder_ptr_.reset();
+  source_sq_num_ = -1;
+  return writer_.Open(filename);
+}
+
+bool PcapMessageWriter::Write(const IEXMessageBase& msg, const IEXTPHeader& header,
+                              const int64_t capture_time) {
+  if (!builder_ptr_) {
+    builder_ptr_.reset(
+        new IEXTPPacketBuilder(header.protocol_id, header.channel_id, header.session_id));
+  }
+  // Keep the packet boundaries of the source.
+  if (header.first_msg_sq_num != source_sq_num_ || header.send_time != source_send_time_) {
+    if (!Flush()) {
+      return false;
+    }
+    source_sq_num_ = header.first_msg_sq_num;
+    source_send_time_ = header.send_time;
+    source_capture_time_ = capture_time;
+  }
+  if (!builder_ptr_->AddMessage(msg)) {
+    if (!Flush() || !builder_ptr_->AddMessage(msg)) {
+      return false;
+    }
+  }
+  ++num_messages_;
+  return true;
+}
+
+bool PcapMessageWriter::Flush() {
+  if (!builder_ptr_ || builder_ptr_->GetHeader().message_count == 0) {
+    return true;
+  }
+  const size_t payload_len = builder_ptr_->Finish(source_send_time_);
+  if (!writer_.WritePacket(builder_ptr_->GetData(), payload_len, source_capture_time_)) {
+    return false;
+  }
+  builder_ptr_->StartNextPacket();
+  return true;
+}
+
+bool PcapMessageWriter::Close() {
+  const bool success = Flush();
+  writer_.Close();
+  return success;
+}
+
+bool StoreMessageWriter::Open(const std::string& filename) {
+  filename_ = filename;
+  writer_ = SymbolStoreWriter();
+  return true;
+}
+
+bool StoreMessageWriter::Write(const IEXMessageBase& msg, const IEXTPHeader& header,
+                               const int64_t capture_time) {
+  (void)header;
+  (void)capture_time;
+  uint8_t msg_data[IEXMessageBase::max_encoded_len];
+  writer_.AddMessage(msg_data, msg.Encode(msg_data));
+  ++num_messages_;
+  return true;
+}
+
+bool StoreMessageWriter::Close() { return writer_.Write(filename_); }
+
+std::unique_ptr<MessageWriter> OpenMessageWriter(const std::string& filename) {
+  if (EndsWith(filename, ".pcap")) {
+    std::unique_ptr<PcapMessageWriter> writer_ptr(new PcapMessageWriter);
+    return writer_ptr->Open(filename) ? std::move(writer_ptr) : nullptr;
+  }
+  if (EndsWith(filename, ".store")) {
+    std::unique_ptr<StoreMessageWriter> writer_ptr(new StoreMessageWriter);
+    return writer_ptr->Open(filename) ? std::move(writer_ptr) : nullptr;
+  }
+  std::unique_ptr<CsvMessageWriter> writer_ptr(new CsvMessageWriter);
+  return writer_ptr->Open(filename) ? std::move(writer_ptr) : nullptr;
+}
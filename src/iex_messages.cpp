@@ -1,31 +1,16 @@
 #include "iex_messages.h"
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
-/// \brief Templated function for dereferencing and casting a uint8_t pointer to a desired type.
-///
-/// \param data_ptr  Pointer to the data.
-/// \param offset    An offset to first apply to the pointer before dereferencing.
-/// \return template type T, the numeric data being requested.
-template <typename T>
-T GetNumeric(const uint8_t* data_ptr, const int offset) {
-  return *(reinterpret_cast<const T*>(&data_ptr[offset]));
-}
-
-/// \brief Similar to GetNumeric, however specialized for price data.
-///
-/// \param data_ptr  Pointer to the data.
-/// \param offset    An offset to first apply to the pointer before dereferencing.
-/// \return The price in dollars, returned as a double.
 double GetPrice(const uint8_t* data_ptr, const int offset) {
   return *(reinterpret_cast<const int64_t*>(&data_ptr[offset])) / 10000.0;
 }
 
-/// \brief Similar to GetNumeric, however specialized for string data.
-///
-/// \param data_ptr  Pointer to the data.
-/// \param offset    An offset to first apply to the pointer before dereferencing.
-/// \param length    Expected length of the string.
-/// \return The string data as an std::string
+void PutPrice(uint8_t* data_ptr, const int offset, const double price) {
+  *(reinterpret_cast<int64_t*>(&data_ptr[offset])) = std::llround(price * 10000.0);
+}
+
 std::string GetString(const uint8_t* data_ptr, const int offset, const int length) {
   std::string ret_val = std::string((reinterpret_cast<const char*>(&data_ptr[offset])), length);
   // Remove whitespace.
@@ -36,15 +21,24 @@ std::string GetString(const uint8_t* data_ptr, const int offset, const int lengt
   return ret_val;
 }
 
-/// \brief Validate the timestamp using a sensible range.
-/// \note  Lower limit is 2018-10-25, when IEX opened for trading, upper limit is 2100.
-///
-/// \param timestamp  Input timestamp to validate.
-/// \return bool True if timestamp is valid, false otherwise.
+void PutString(uint8_t* data_ptr, const int offset, const int length, const std::string& value) {
+  const size_t copy_len = std::min(value.size(), static_cast<size_t>(length));
+  std::memcpy(&data_ptr[offset], value.data(), copy_len);
+  std::memset(&data_ptr[offset + copy_len], ' ', length - copy_len);
+}
+
+uint64_t PackSymbol(const std::string& symbol) {
+  uint8_t symbol_data[symbol_field_len];
+  PutString(symbol_data, 0, symbol_field_len, symbol);
+  return GetNumeric<uint64_t>(symbol_data, 0);
+}
+
 bool ValidateTimestamp(const int64_t timestamp) {
   return (timestamp > 1382659200000000000) && (timestamp < 4102444800000000000);
 }
 
+constexpr size_t IEXMessageBase::max_encoded_len;
+
 std::string IEXMessageBase::OutputToJson() const { return "Not implemented"; }
 
 bool IEXTPHeader::Decode(const uint8_t* data_ptr) {
@@ -66,6 +60,21 @@ bool IEXTPHeader::Decode(const uint8_t* data_ptr) {
   }
 }
 
+size_t IEXTPHeader::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, version);
+  PutNumeric<uint8_t>(data_ptr, 1, 0);
+  PutNumeric<uint16_t>(data_ptr, 2, protocol_id);
+  PutNumeric<uint32_t>(data_ptr, 4, channel_id);
+  PutNumeric<uint32_t>(data_ptr, 8, session_id);
+  PutNumeric<uint16_t>(data_ptr, 12, payload_len);
+  PutNumeric<uint16_t>(data_ptr, 14, message_count);
+  PutNumeric<uint64_t>(data_ptr, 16, stream_offset);
+  PutNumeric<uint64_t>(data_ptr, 24, first_msg_sq_num);
+  PutNumeric<uint64_t>(data_ptr, 32, send_time);
+
+  return 40;
+}
+
 void IEXTPHeader::Print() const {
   IEX_LOG("ver               : " << int(version));
   IEX_LOG("id                : " << protocol_id);
@@ -85,6 +94,14 @@ bool SystemEventMessage::Decode(const uint8_t* data_ptr) {
   return ValidateTimestamp(timestamp);
 }
 
+size_t SystemEventMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, static_cast<uint8_t>(system_event));
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+
+  return 10;
+}
+
 void SystemEventMessage::Print() const {
   IEX_LOG("Message type      : " << MessageTypeToString(message_type));
   IEX_LOG("Timestamp         : " << timestamp);
@@ -102,6 +119,18 @@ bool SecurityDirectoryMessage::Decode(const uint8_t* data_ptr) {
   return ValidateTimestamp(timestamp);
 }
 
+size_t SecurityDirectoryMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, flags);
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutNumeric<uint32_t>(data_ptr, 18, round_lot_size);
+  PutPrice(data_ptr, 22, adjusted_POC_price);
+  PutNumeric<uint8_t>(data_ptr, 30, static_cast<uint8_t>(LULD_tier));
+
+  return 31;
+}
+
 void SecurityDirectoryMessage::Print() const {
   IEX_LOG("Message type      : " << MessageTypeToString(message_type));
   IEX_LOG("Timestamp         : " << timestamp);
@@ -121,6 +150,16 @@ bool TradingStatusMessage::Decode(const uint8_t* data_ptr) {
   return ValidateTimestamp(timestamp);
 }
 
+size_t TradingStatusMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, static_cast<uint8_t>(trading_status));
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutString(data_ptr, 18, 4, reason);
+
+  return 22;
+}
+
 void TradingStatusMessage::Print() const {
   IEX_LOG("Message type      : " << MessageTypeToString(message_type));
   IEX_LOG("Timestamp         : " << timestamp);
@@ -138,6 +177,15 @@ bool OperationalHaltStatusMessage::Decode(const uint8_t* data_ptr) {
   return ValidateTimestamp(timestamp);
 }
 
+size_t OperationalHaltStatusMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, static_cast<uint8_t>(operational_halt_status));
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+
+  return 18;
+}
+
 void OperationalHaltStatusMessage::Print() const {
   IEX_LOG("Message type      : " << MessageTypeToString(message_type));
   IEX_LOG("Timestamp         : " << timestamp);
@@ -154,6 +202,16 @@ bool ShortSalePriceTestStatusMessage::Decode(const uint8_t* data_ptr) {
   return ValidateTimestamp(timestamp);
 }
 
+size_t ShortSalePriceTestStatusMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, static_cast<uint8_t>(short_sale_test_in_effect));
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutNumeric<uint8_t>(data_ptr, 18, static_cast<uint8_t>(detail));
+
+  return 19;
+}
+
 void ShortSalePriceTestStatusMessage::Print() const {
   IEX_LOG("Message type      : " << MessageTypeToString(message_type));
   IEX_LOG("Timestamp         : " << timestamp);
@@ -174,6 +232,19 @@ bool QuoteUpdateMessage::Decode(const uint8_t* data_ptr) {
   return ValidateTimestamp(timestamp);
 }
 
+size_t QuoteUpdateMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, flags);
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutNumeric<uint32_t>(data_ptr, 18, bid_size);
+  PutPrice(data_ptr, 22, bid_price);
+  PutPrice(data_ptr, 30, ask_price);
+  PutNumeric<uint32_t>(data_ptr, 38, ask_size);
+
+  return 42;
+}
+
 void QuoteUpdateMessage::Print() const {
   IEX_LOG("Message type      : " << MessageTypeToString(message_type));
   IEX_LOG("Timestamp         : " << timestamp);
@@ -196,6 +267,18 @@ bool TradeReportMessage::Decode(const uint8_t* data_ptr) {
   return ValidateTimestamp(timestamp);
 }
 
+size_t TradeReportMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, flags);
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutNumeric<uint32_t>(data_ptr, 18, size);
+  PutPrice(data_ptr, 22, price);
+  PutNumeric<uint64_t>(data_ptr, 30, trade_id);
+
+  return 38;
+}
+
 void TradeReportMessage::Print() const {
   IEX_LOG("Message type      : " << MessageTypeToString(message_type));
   IEX_LOG("Timestamp         : " << timestamp);
@@ -215,6 +298,16 @@ bool OfficialPriceMessage::Decode(const uint8_t* data_ptr) {
   return ValidateTimestamp(timestamp);
 }
 
+size_t OfficialPriceMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, static_cast<uint8_t>(price_type));
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutPrice(data_ptr, 18, price);
+
+  return 26;
+}
+
 void OfficialPriceMessage::Print() const {
   IEX_LOG("Message type      : " << MessageTypeToString(message_type));
   IEX_LOG("Timestamp         : " << timestamp);
@@ -243,6 +336,26 @@ bool AuctionInformationMessage::Decode(const uint8_t* data_ptr) {
   return ValidateTimestamp(timestamp);
 }
 
+size_t AuctionInformationMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, static_cast<uint8_t>(auction_type));
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutNumeric<uint32_t>(data_ptr, 18, paired_shares);
+  PutPrice(data_ptr, 22, reference_price);
+  PutPrice(data_ptr, 30, indicative_clearing_price);
+  PutNumeric<uint32_t>(data_ptr, 38, imbalance_shares);
+  PutNumeric<uint8_t>(data_ptr, 42, static_cast<uint8_t>(imbalance_side));
+  PutNumeric<uint8_t>(data_ptr, 43, extension_number);
+  PutNumeric<uint32_t>(data_ptr, 44, scheduled_auction_time);
+  PutPrice(data_ptr, 48, auction_book_clearing_price);
+  PutPrice(data_ptr, 56, collar_reference_price);
+  PutPrice(data_ptr, 64, lower_auction_collar);
+  PutPrice(data_ptr, 72, upper_auction_collar);
+
+  return 80;
+}
+
 void AuctionInformationMessage::Print() const {
   IEX_LOG("Message type      : " << MessageTypeToString(message_type));
   IEX_LOG("Timestamp         : " << timestamp);
@@ -271,6 +384,17 @@ bool PriceLevelUpdateMessage::Decode(const uint8_t* data_ptr) {
   return ValidateTimestamp(timestamp);
 }
 
+size_t PriceLevelUpdateMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, flags);
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutNumeric<uint32_t>(data_ptr, 18, size);
+  PutPrice(data_ptr, 22, price);
+
+  return 30;
+}
+
 void PriceLevelUpdateMessage::Print() const {
   IEX_LOG("Message type      : " << MessageTypeToString(message_type));
   IEX_LOG("Timestamp         : " << timestamp);
@@ -289,6 +413,15 @@ bool SecurityEventMessage::Decode(const uint8_t* data_ptr) {
   return ValidateTimestamp(timestamp);
 }
 
+size_t SecurityEventMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, static_cast<uint8_t>(security_event));
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+
+  return 18;
+}
+
 void SecurityEventMessage::Print() const {
   IEX_LOG("Message type      : " << MessageTypeToString(message_type));
   IEX_LOG("Timestamp         : " << timestamp);
@@ -296,6 +429,155 @@ void SecurityEventMessage::Print() const {
   IEX_LOG("SecurityEvent     : " << static_cast<char>(security_event));
 }
 
+bool AddOrderMessage::Decode(const uint8_t* data_ptr) {
+  side = static_cast<Side>(GetNumeric<uint8_t>(data_ptr, 1));
+  timestamp = GetNumeric<uint64_t>(data_ptr, 2);
+  symbol = GetString(data_ptr, 10, 8);
+  order_id = GetNumeric<uint64_t>(data_ptr, 18);
+  size = GetNumeric<uint32_t>(data_ptr, 26);
+  price = GetPrice(data_ptr, 30);
+
+  return ValidateTimestamp(timestamp);
+}
+
+size_t AddOrderMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, static_cast<uint8_t>(side));
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutNumeric<uint64_t>(data_ptr, 18, order_id);
+  PutNumeric<uint32_t>(data_ptr, 26, size);
+  PutPrice(data_ptr, 30, price);
+
+  return 38;
+}
+
+void AddOrderMessage::Print() const {
+  IEX_LOG("Message type      : " << MessageTypeToString(message_type));
+  IEX_LOG("Timestamp         : " << timestamp);
+  IEX_LOG("Symbol            : " << symbol);
+  IEX_LOG("Side              : " << static_cast<char>(side));
+  IEX_LOG("Order id          : " << order_id);
+  IEX_LOG("Size              : " << size);
+  IEX_LOG("Price             : " << price);
+}
+
+bool OrderModifyMessage::Decode(const uint8_t* data_ptr) {
+  flags = GetNumeric<uint8_t>(data_ptr, 1);
+  timestamp = GetNumeric<uint64_t>(data_ptr, 2);
+  symbol = GetString(data_ptr, 10, 8);
+  order_id = GetNumeric<uint64_t>(data_ptr, 18);
+  size = GetNumeric<uint32_t>(data_ptr, 26);
+  price = GetPrice(data_ptr, 30);
+
+  return ValidateTimestamp(timestamp);
+}
+
+size_t OrderModifyMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, flags);
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutNumeric<uint64_t>(data_ptr, 18, order_id);
+  PutNumeric<uint32_t>(data_ptr, 26, size);
+  PutPrice(data_ptr, 30, price);
+
+  return 38;
+}
+
+void OrderModifyMessage::Print() const {
+  IEX_LOG("Message type      : " << MessageTypeToString(message_type));
+  IEX_LOG("Timestamp         : " << timestamp);
+  IEX_LOG("Symbol            : " << symbol);
+  IEX_LOG("Flag              : " << PRINTHEX(flags));
+  IEX_LOG("Order id          : " << order_id);
+  IEX_LOG("Size              : " << size);
+  IEX_LOG("Price             : " << price);
+}
+
+bool OrderDeleteMessage::Decode(const uint8_t* data_ptr) {
+  timestamp = GetNumeric<uint64_t>(data_ptr, 2);
+  symbol = GetString(data_ptr, 10, 8);
+  order_id = GetNumeric<uint64_t>(data_ptr, 18);
+
+  return ValidateTimestamp(timestamp);
+}
+
+size_t OrderDeleteMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, 0);
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutNumeric<uint64_t>(data_ptr, 18, order_id);
+
+  return 26;
+}
+
+void OrderDeleteMessage::Print() const {
+  IEX_LOG("Message type      : " << MessageTypeToString(message_type));
+  IEX_LOG("Timestamp         : " << timestamp);
+  IEX_LOG("Symbol            : " << symbol);
+  IEX_LOG("Order id          : " << order_id);
+}
+
+bool OrderExecutedMessage::Decode(const uint8_t* data_ptr) {
+  flags = GetNumeric<uint8_t>(data_ptr, 1);
+  timestamp = GetNumeric<uint64_t>(data_ptr, 2);
+  symbol = GetString(data_ptr, 10, 8);
+  order_id = GetNumeric<uint64_t>(data_ptr, 18);
+  size = GetNumeric<uint32_t>(data_ptr, 26);
+  price = GetPrice(data_ptr, 30);
+  trade_id = GetNumeric<uint64_t>(data_ptr, 38);
+
+  return ValidateTimestamp(timestamp);
+}
+
+size_t OrderExecutedMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, flags);
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+  PutNumeric<uint64_t>(data_ptr, 18, order_id);
+  PutNumeric<uint32_t>(data_ptr, 26, size);
+  PutPrice(data_ptr, 30, price);
+  PutNumeric<uint64_t>(data_ptr, 38, trade_id);
+
+  return 46;
+}
+
+void OrderExecutedMessage::Print() const {
+  IEX_LOG("Message type      : " << MessageTypeToString(message_type));
+  IEX_LOG("Timestamp         : " << timestamp);
+  IEX_LOG("Symbol            : " << symbol);
+  IEX_LOG("Flag              : " << PRINTHEX(flags));
+  IEX_LOG("Order id          : " << order_id);
+  IEX_LOG("Size              : " << size);
+  IEX_LOG("Price             : " << price);
+  IEX_LOG("Trade id          : " << trade_id);
+}
+
+bool ClearBookMessage::Decode(const uint8_t* data_ptr) {
+  timestamp = GetNumeric<uint64_t>(data_ptr, 2);
+  symbol = GetString(data_ptr, 10, 8);
+
+  return ValidateTimestamp(timestamp);
+}
+
+size_t ClearBookMessage::Encode(uint8_t* data_ptr) const {
+  PutNumeric<uint8_t>(data_ptr, 0, static_cast<uint8_t>(message_type));
+  PutNumeric<uint8_t>(data_ptr, 1, 0);
+  PutNumeric<uint64_t>(data_ptr, 2, timestamp);
+  PutString(data_ptr, 10, 8, symbol);
+
+  return 18;
+}
+
+void ClearBookMessage::Print() const {
+  IEX_LOG("Message type      : " << MessageTypeToString(message_type));
+  IEX_LOG("Timestamp         : " << timestamp);
+  IEX_LOG("Symbol            : " << symbol);
+}
+
 std::unique_ptr<IEXMessageBase> IEXMessageFactory(const uint8_t* msg_data_ptr) {
   int msg_type = *msg_data_ptr;
   auto msg_enum = static_cast<MessageType>(msg_type);
@@ -324,6 +606,16 @@ std::unique_ptr<IEXMessageBase> IEXMessageFactory(const uint8_t* msg_data_ptr) {
       return std::unique_ptr<IEXMessageBase>(new PriceLevelUpdateMessage(msg_enum));
     case MessageType::SecurityEvent:
       return std::unique_ptr<IEXMessageBase>(new SecurityEventMessage(msg_enum));
+    case MessageType::AddOrder:
+      return std::unique_ptr<IEXMessageBase>(new AddOrderMessage());
+    case MessageType::OrderModify:
+      return std::unique_ptr<IEXMessageBase>(new OrderModifyMessage());
+    case MessageType::OrderDelete:
+      return std::unique_ptr<IEXMessageBase>(new OrderDeleteMessage());
+    case MessageType::OrderExecuted:
+      return std::unique_ptr<IEXMessageBase>(new OrderExecutedMessage());
+    case MessageType::ClearBook:
+      return std::unique_ptr<IEXMessageBase>(new ClearBookMessage());
     default:
       return NULL;
   }
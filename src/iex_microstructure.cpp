@@ -0,0 +1,134 @@
+#include "iex_microstructure.h"
+
+#include <cmath>
+
+MicrostructureStats::MicrostructureStats(const MicrostructureConfig& config)
+    : config_(config), symbol_table_(config.expected_symbols) {}
+
+void MicrostructureStats::Resize(const size_t num_symbols) {
+  // Grow geometrically, so adding symbols one by one stays cheap.
+  const size_t new_size = std::max(num_symbols, 2 * last_time_.size());
+  last_time_.resize(new_size, 0);
+  bid_price_.resize(new_size, 0);
+  ask_price_.resize(new_size, 0);
+  spread_time_.resize(new_size, 0);
+  quoted_time_.resize(new_size, 0);
+  locked_time_.resize(new_size, 0);
+  quote_updates_.resize(new_size, 0);
+  trade_count_.resize(new_size, 0);
+  volume_.resize(new_size, 0);
+  sample_index_.resize(new_size, std::numeric_limits<int64_t>::min());
+  sampled_mid_.resize(new_size, 0);
+  sum_squared_returns_.resize(new_size, 0);
+}
+
+void MicrostructureStats::OnQuote(const uint32_t id, const int64_t timestamp,
+                                  const double bid_price, const double ask_price) {
+  AddTime(timestamp);
+
+  // Close the interval of the previous quote. Masks instead of branches: a one sided or missing
+  // quote contributes nothing.
+  const double bid = bid_price_[id];
+  const double ask = ask_price_[id];
+  const double quoted = static_cast<double>((bid > 0) & (ask > 0));
+  const double locked = quoted * static_cast<double>(bid >= ask);
+  const double duration = static_cast<double>(timestamp - last_time_[id]);
+  spread_time_[id] += quoted * (ask - bid) * duration;
+  quoted_time_[id] += quoted * duration;
+  locked_time_[id] += locked * duration;
+
+  // On entering a new sample interval, the mid in effect at its start is that of the previous
+  // quote. Intervals without quotes have a zero return, so only this one is added.
+  const int64_t sample_index = timestamp / config_.volatility_interval;
+  if (sample_index != sample_index_[id] && quoted > 0) {
+    const double mid = 0.5 * (bid + ask);
+    const double sampled_mid = sampled_mid_[id];
+    const double log_return = sampled_mid > 0 ? std::log(mid / sampled_mid) : 0;
+    sum_squared_returns_[id] += log_return * log_return;
+    sampled_mid_[id] = mid;
+    sample_index_[id] = sample_index;
+  }
+
+  last_time_[id] = timestamp;
+  bid_price_[id] = bid_price;
+  ask_price_[id] = ask_price;
+  ++quote_updates_[id];
+}
+
+void MicrostructureStats::OnTrade(const uint32_t id, const int64_t timestamp,
+                                  const uint32_t size) {
+  AddTime(timestamp);
+  ++trade_count_[id];
+  volume_[id] += size;
+}
+
+void MicrostructureStats::OnMessage(const IEXMessageBase& msg) {
+  switch (msg.GetMessageType()) {
+    case MessageType::QuoteUpdate: {
+      const auto& quote_msg = static_cast<const QuoteUpdateMessage&>(msg);
+      OnQuote(GetSymbolId(quote_msg.symbol), quote_msg.timestamp, quote_msg.bid_price,
+              quote_msg.ask_price);
+      break;
+    }
+    case MessageType::TradeReport: {
+      const auto& trade_msg = static_cast<const TradeReportMessage&>(msg);
+      OnTrade(GetSymbolId(trade_msg.symbol), trade_msg.timestamp,
+              static_cast<uint32_t>(trade_msg.size));
+      break;
+    }
+    default:
+      AddTime(msg.timestamp);
+      break;
+  }
+}
+
+ReturnCode MicrostructureStats::AddFile(const std::string& filename) {
+  IEXDecoder decoder;
+  if (!decoder.OpenFileForDecoding(filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  auto ret_code = ReturnCode::Success;
+  while ((ret_code = decoder.GetNextMessage(msg_ptr)) == ReturnCode::Success) {
+    OnMessage(*msg_ptr);
+  }
+  return ret_code == ReturnCode::EndOfStream ? ReturnCode::Success : ret_code;
+}
+
+std::vector<SymbolSummary> MicrostructureStats::GetSummary() const {
+  const double span = last_time_seen_ > first_time_ ? (last_time_seen_ - first_time_) * 1e-9 : 0;
+  std::vector<SymbolSummary> summaries(symbol_table_.GetSize());
+  for (uint32_t id = 0; id < summaries.size(); ++id) {
+    SymbolSummary& summary = summaries[id];
+    summary.symbol = symbol_table_.GetSymbol(id);
+
+    // Count the current quote up to the end of the data.
+    const double bid = bid_price_[id];
+    const double ask = ask_price_[id];
+    const bool quoted = bid > 0 && ask > 0;
+    const double duration = quoted ? static_cast<double>(last_time_seen_ - last_time_[id]) : 0;
+    const double quoted_time = quoted_time_[id] + duration;
+    const double spread_time = spread_time_[id] + (ask - bid) * duration;
+    const double locked_time = locked_time_[id] + (bid >= ask ? duration : 0);
+    if (quoted_time > 0) {
+      summary.time_weighted_spread = spread_time / quoted_time;
+      summary.locked_crossed_fraction = locked_time / quoted_time;
+    }
+    summary.quoted_time = quoted_time * 1e-9;
+
+    // And the return up to the last sample, if it moved since.
+    double sum_squared_returns = sum_squared_returns_[id];
+    const int64_t last_sample_index = last_time_seen_ / config_.volatility_interval;
+    if (quoted && sampled_mid_[id] > 0 && last_sample_index != sample_index_[id]) {
+      const double log_return = std::log(0.5 * (bid + ask) / sampled_mid_[id]);
+      sum_squared_returns += log_return * log_return;
+    }
+    summary.realized_volatility = std::sqrt(sum_squared_returns);
+
+    summary.quote_updates = quote_updates_[id];
+    summary.quote_rate = span > 0 ? quote_updates_[id] / span : 0;
+    summary.trade_count = trade_count_[id];
+    summary.volume = volume_[id];
+  }
+  return summaries;
+}
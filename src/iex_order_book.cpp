@@ -0,0 +1,276 @@
+#include "iex_order_book.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr uint32_t OrderBook::npos;
+
+namespace {
+/// \brief Convert a decoded price back to ten thousandths of a dollar.
+inline int64_t ToPriceTicks(const double price) { return std::llround(price * 10000); }
+
+/// \brief True if price a is worse than price b on a side, the order levels are sorted in.
+inline bool IsWorse(const OrderBook::Side side, const int64_t a, const int64_t b) {
+  return side == OrderBook::Side::Buy ? a < b : a > b;
+}
+}  // namespace
+
+OrderBook::OrderBook(const size_t expected_orders, const size_t expected_symbols)
+    : symbols_(expected_symbols) {
+  Rehash(expected_orders);
+  orders_.reserve(expected_orders);
+  books_.reserve(expected_symbols);
+}
+
+bool OrderBook::AddOrder(const uint64_t order_id, const uint32_t symbol_id, const Side side,
+                         const int64_t price, const uint32_t size) {
+  if (FindOrder(order_id) != npos) {
+    ++num_unmatched_;
+    return false;
+  }
+  uint32_t node = free_order_;
+  if (node != npos) {
+    free_order_ = orders_[node].next;
+  } else {
+    node = static_cast<uint32_t>(orders_.size());
+    orders_.emplace_back();
+  }
+  OrderNode& order = orders_[node];
+  order.order_id = order_id;
+  order.size = size;
+  order.symbol_id = symbol_id;
+  order.side = side;
+  PushBack(node, GetOrAddLevel(symbol_id, side, price));
+  InsertSlot(order_id, node);
+  ++num_orders_;
+  return true;
+}
+
+bool OrderBook::ModifyOrder(const uint64_t order_id, const int64_t price, const uint32_t size,
+                            const bool keep_priority) {
+  const uint32_t node = FindOrder(order_id);
+  if (node == npos) {
+    ++num_unmatched_;
+    return false;
+  }
+  OrderNode& order = orders_[node];
+  PriceLevel& level = levels_[order.level];
+  if (keep_priority && level.price == price) {
+    level.size = level.size - order.size + size;
+    order.size = size;
+    return true;
+  }
+  // Unlinking first may free the level, so a modify at the same price reuses it.
+  Unlink(node);
+  order.size = size;
+  PushBack(node, GetOrAddLevel(order.symbol_id, order.side, price));
+  return true;
+}
+
+bool OrderBook::ExecuteOrder(const uint64_t order_id, const uint32_t size) {
+  const uint32_t node = FindOrder(order_id);
+  if (node == npos) {
+    ++num_unmatched_;
+    return false;
+  }
+  OrderNode& order = orders_[node];
+  if (size < order.size) {
+    order.size -= size;
+    levels_[order.level].size -= size;
+    return true;
+  }
+  Unlink(node);
+  FreeOrder(node);
+  return true;
+}
+
+bool OrderBook::DeleteOrder(const uint64_t order_id) {
+  const uint32_t node = FindOrder(order_id);
+  if (node == npos) {
+    ++num_unmatched_;
+    return false;
+  }
+  Unlink(node);
+  FreeOrder(node);
+  return true;
+}
+
+void OrderBook::ClearBook(const uint32_t symbol_id) {
+  if (symbol_id >= books_.size()) {
+    return;
+  }
+  for (auto& levels : books_[symbol_id].sides) {
+    for (const uint32_t level : levels) {
+      uint32_t node = levels_[level].head;
+      while (node != npos) {
+        const uint32_t next = orders_[node].next;
+        FreeOrder(node);
+        node = next;
+      }
+      levels_[level].head = free_level_;
+      free_level_ = level;
+    }
+    levels.clear();
+  }
+}
+
+void OrderBook::operator()(const AddOrderMessage& msg) {
+  const Side side = msg.side == AddOrderMessage::Side::Buy ? Side::Buy : Side::Sell;
+  AddOrder(msg.order_id, GetSymbolId(msg.symbol), side, ToPriceTicks(msg.price),
+           static_cast<uint32_t>(msg.size));
+}
+
+void OrderBook::operator()(const OrderModifyMessage& msg) {
+  ModifyOrder(msg.order_id, ToPriceTicks(msg.price), static_cast<uint32_t>(msg.size),
+              (msg.flags & OrderModifyMessage::maintain_priority_flag) != 0);
+}
+
+void OrderBook::operator()(const OrderDeleteMessage& msg) { DeleteOrder(msg.order_id); }
+
+void OrderBook::operator()(const OrderExecutedMessage& msg) {
+  ExecuteOrder(msg.order_id, static_cast<uint32_t>(msg.size));
+}
+
+void OrderBook::operator()(const ClearBookMessage& msg) {
+  const uint32_t symbol_id = symbols_.Find(PackSymbol(msg.symbol));
+  if (symbol_id != SymbolTable::npos) {
+    ClearBook(symbol_id);
+  }
+}
+
+uint32_t OrderBook::GetSymbolId(const std::string& symbol) {
+  const uint32_t symbol_id = symbols_.GetOrAdd(symbol);
+  if (symbol_id >= books_.size()) {
+    books_.resize(symbol_id + 1);
+  }
+  return symbol_id;
+}
+
+void OrderBook::FreeOrder(const uint32_t node) {
+  EraseSlot(orders_[node].order_id);
+  orders_[node].next = free_order_;
+  free_order_ = node;
+  --num_orders_;
+}
+
+void OrderBook::InsertSlot(const uint64_t order_id, const uint32_t node) {
+  if (2 * (num_orders_ + 1) > slots_.size()) {
+    Rehash(2 * (num_orders_ + 1));
+  }
+  size_t slot = GetSlot(order_id);
+  while (slots_[slot].node != npos) {
+    slot = (slot + 1) & mask_;
+  }
+  slots_[slot].order_id = order_id;
+  slots_[slot].node = node;
+}
+
+void OrderBook::EraseSlot(const uint64_t order_id) {
+  size_t hole = GetSlot(order_id);
+  while (slots_[hole].order_id != order_id || slots_[hole].node == npos) {
+    hole = (hole + 1) & mask_;
+  }
+  // Move back every following slot of the run whose home slot is not between the hole and it,
+  // so lookups never stop early at the hole.
+  for (size_t slot = (hole + 1) & mask_; slots_[slot].node != npos; slot = (slot + 1) & mask_) {
+    const size_t home = GetSlot(slots_[slot].order_id);
+    if (((slot - home) & mask_) >= ((slot - hole) & mask_)) {
+      slots_[hole] = slots_[slot];
+      hole = slot;
+    }
+  }
+  slots_[hole].node = npos;
+}
+
+void OrderBook::Rehash(const size_t min_orders) {
+  size_t num_slots = 16;
+  int shift = 60;
+  while (num_slots < 2 * min_orders) {
+    num_slots *= 2;
+    --shift;
+  }
+  std::vector<OrderSlot> old_slots(num_slots, OrderSlot{0, npos});
+  old_slots.swap(slots_);
+  mask_ = num_slots - 1;
+  shift_ = shift;
+  for (const OrderSlot& old_slot : old_slots) {
+    if (old_slot.node == npos) {
+      continue;
+    }
+    size_t slot = GetSlot(old_slot.order_id);
+    while (slots_[slot].node != npos) {
+      slot = (slot + 1) & mask_;
+    }
+    slots_[slot] = old_slot;
+  }
+}
+
+uint32_t OrderBook::GetOrAddLevel(const uint32_t symbol_id, const Side side, const int64_t price) {
+  std::vector<uint32_t>& levels = books_[symbol_id].sides[static_cast<int>(side)];
+  const auto it = std::lower_bound(
+      levels.begin(), levels.end(), price,
+      [this, side](const uint32_t level, const int64_t p) {
+        return IsWorse(side, levels_[level].price, p);
+      });
+  if (it != levels.end() && levels_[*it].price == price) {
+    return *it;
+  }
+  uint32_t level = free_level_;
+  if (level != npos) {
+    free_level_ = levels_[level].head;
+  } else {
+    level = static_cast<uint32_t>(levels_.size());
+    levels_.emplace_back();
+  }
+  levels_[level] = PriceLevel{price, 0, 0, npos, npos};
+  levels.insert(it, level);
+  return level;
+}
+
+void OrderBook::RemoveLevel(const uint32_t symbol_id, const Side side, const uint32_t level) {
+  std::vector<uint32_t>& levels = books_[symbol_id].sides[static_cast<int>(side)];
+  const int64_t price = levels_[level].price;
+  const auto it = std::lower_bound(
+      levels.begin(), levels.end(), price,
+      [this, side](const uint32_t l, const int64_t p) {
+        return IsWorse(side, levels_[l].price, p);
+      });
+  levels.erase(it);
+  levels_[level].head = free_level_;
+  free_level_ = level;
+}
+
+void OrderBook::PushBack(const uint32_t node, const uint32_t level) {
+  OrderNode& order = orders_[node];
+  PriceLevel& price_level = levels_[level];
+  order.level = level;
+  order.prev = price_level.tail;
+  order.next = npos;
+  if (price_level.tail != npos) {
+    orders_[price_level.tail].next = node;
+  } else {
+    price_level.head = node;
+  }
+  price_level.tail = node;
+  price_level.size += order.size;
+  ++price_level.num_orders;
+}
+
+void OrderBook::Unlink(const uint32_t node) {
+  const OrderNode& order = orders_[node];
+  PriceLevel& price_level = levels_[order.level];
+  if (order.prev != npos) {
+    orders_[order.prev].next = order.next;
+  } else {
+    price_level.head = order.next;
+  }
+  if (order.next != npos) {
+    orders_[order.next].prev = order.prev;
+  } else {
+    price_level.tail = order.prev;
+  }
+  price_level.size -= order.size;
+  if (--price_level.num_orders == 0) {
+    RemoveLevel(order.symbol_id, order.side, order.level);
+  }
+}
@@ -0,0 +1,172 @@
+#include "iex_packet_builder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "RawPacket.h"
+
+namespace {
+/// \brief Sizes of the protocol layers in front of the IEX-TP payload.
+constexpr size_t eth_header_len = 14;
+constexpr size_t ip_header_len = 20;
+constexpr size_t udp_header_len = 8;
+constexpr size_t iex_payload_start = eth_header_len + ip_header_len + udp_header_len;
+
+/// \brief IEX publishes on UDP multicast, use a plausible group and port.
+constexpr uint8_t dst_ip[4] = {233, 215, 21, 4};
+constexpr uint8_t src_ip[4] = {10, 0, 0, 1};
+constexpr uint16_t udp_port = 10378;
+
+void PutBigEndian16(uint8_t* data_ptr, const int offset, const uint16_t value) {
+  data_ptr[offset] = static_cast<uint8_t>(value >> 8);
+  data_ptr[offset + 1] = static_cast<uint8_t>(value & 0xff);
+}
+
+timespec MakeTimespec(const int64_t nanoseconds) {
+  timespec ts;
+  ts.tv_sec = nanoseconds / 1000000000;
+  ts.tv_nsec = nanoseconds % 1000000000;
+  return ts;
+}
+}  // namespace
+
+constexpr size_t IEXTPPacketBuilder::block_len_size;
+constexpr size_t IEXTPPcapWriter::max_payload_len;
+
+IEXTPPacketBuilder::IEXTPPacketBuilder(const uint16_t protocol_id, const uint32_t channel_id,
+                                       const uint32_t session_id, const size_t max_payload_len,
+                                       const int64_t first_msg_sq_num,
+                                       const int64_t stream_offset) {
+  header_.version = 1;
+  header_.protocol_id = protocol_id;
+  header_.channel_id = channel_id;
+  header_.session_id = session_id;
+  header_.payload_len = 0;
+  header_.message_count = 0;
+  header_.stream_offset = stream_offset;
+  header_.first_msg_sq_num = first_msg_sq_num;
+  header_.send_time = 0;
+
+  // The packet must fit a UDP datagram, which also keeps the 16 bit payload length field from
+  // overflowing, and must leave room for at least one block.
+  buffer_.resize(std::min(std::max(max_payload_len, IEXDecoder::first_block_start +
+                                                        block_len_size +
+                                                        IEXMessageBase::max_encoded_len),
+                          IEXTPPcapWriter::max_payload_len));
+}
+
+bool IEXTPPacketBuilder::AddMessage(const IEXMessageBase& msg) {
+  uint8_t* block_ptr = &buffer_[IEXDecoder::first_block_start + header_.payload_len];
+  const size_t available = buffer_.size() - IEXDecoder::first_block_start - header_.payload_len;
+  if (available >= block_len_size + IEXMessageBase::max_encoded_len) {
+    // Enough room for any message, encode in place.
+    const size_t msg_len = msg.Encode(block_ptr + block_len_size);
+    PutNumeric<uint16_t>(block_ptr, 0, static_cast<uint16_t>(msg_len));
+    header_.payload_len += static_cast<uint16_t>(block_len_size + msg_len);
+    ++header_.message_count;
+    return true;
+  }
+  uint8_t msg_data[IEXMessageBase::max_encoded_len];
+  return AddBlock(msg_data, msg.Encode(msg_data));
+}
+
+bool IEXTPPacketBuilder::AddBlock(const uint8_t* msg_data, const size_t msg_len) {
+  if (IEXDecoder::first_block_start + header_.payload_len + block_len_size + msg_len > buffer_.size()) {
+    return false;
+  }
+  uint8_t* block_ptr = &buffer_[IEXDecoder::first_block_start + header_.payload_len];
+  PutNumeric<uint16_t>(block_ptr, 0, static_cast<uint16_t>(msg_len));
+  std::memcpy(block_ptr + block_len_size, msg_data, msg_len);
+  header_.payload_len += static_cast<uint16_t>(block_len_size + msg_len);
+  ++header_.message_count;
+  return true;
+}
+
+size_t IEXTPPacketBuilder::Finish(const int64_t send_time) {
+  header_.send_time = send_time;
+  header_.Encode(buffer_.data());
+  return GetLength();
+}
+
+void IEXTPPacketBuilder::StartNextPacket() {
+  header_.stream_offset += header_.payload_len;
+  header_.first_msg_sq_num += header_.message_count;
+  header_.payload_len = 0;
+  header_.message_count = 0;
+}
+
+bool IEXTPPcapWriter::Open(const std::string& filename) {
+  writer_ptr_.reset(new pcpp::PcapFileWriterDevice(filename, pcpp::LINKTYPE_ETHERNET, true));
+  if (!writer_ptr_->open()) {
+    IEX_LOG("Cannot open " << filename << " for writing.");
+    writer_ptr_.reset();
+    return false;
+  }
+  packets_written_ = 0;
+  return true;
+}
+
+void IEXTPPcapWriter::Close() {
+  if (writer_ptr_) {
+    writer_ptr_->close();
+    writer_ptr_.reset();
+  }
+}
+
+bool IEXTPPcapWriter::WritePacket(const uint8_t* payload_ptr, const size_t payload_len,
+                                  const int64_t capture_time) {
+  if (!writer_ptr_) {
+    return false;
+  }
+  if (payload_len > max_payload_len) {
+    IEX_LOG("A payload of " << payload_len << " bytes does not fit a UDP datagram.");
+    return false;
+  }
+  frame_.resize(iex_payload_start + payload_len);
+  WriteNetworkHeaders(udp_header_len + payload_len);
+  std::memcpy(&frame_[iex_payload_start], payload_ptr, payload_len);
+
+  pcpp::RawPacket raw_packet(frame_.data(), static_cast<int>(frame_.size()),
+                             MakeTimespec(capture_time), false);
+  if (!writer_ptr_->writePacket(raw_packet)) {
+    return false;
+  }
+  ++packets_written_;
+  return true;
+}
+
+void IEXTPPcapWriter::WriteNetworkHeaders(const size_t udp_len) {
+  uint8_t* eth_ptr = frame_.data();
+  // Multicast MAC address derived from the group address.
+  const uint8_t dst_mac[6] = {0x01, 0x00, 0x5e, static_cast<uint8_t>(dst_ip[1] & 0x7f),
+                              dst_ip[2], dst_ip[3]};
+  const uint8_t src_mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+  std::memcpy(eth_ptr, dst_mac, 6);
+  std::memcpy(eth_ptr + 6, src_mac, 6);
+  PutBigEndian16(eth_ptr, 12, 0x0800);
+
+  uint8_t* ip_ptr = eth_ptr + eth_header_len;
+  std::memset(ip_ptr, 0, ip_header_len);
+  ip_ptr[0] = 0x45;
+  PutBigEndian16(ip_ptr, 2, static_cast<uint16_t>(ip_header_len + udp_len));
+  PutBigEndian16(ip_ptr, 4, static_cast<uint16_t>(packets_written_));
+  ip_ptr[8] = 64;
+  ip_ptr[9] = 17;
+  std::memcpy(ip_ptr + 12, src_ip, 4);
+  std::memcpy(ip_ptr + 16, dst_ip, 4);
+  uint32_t checksum = 0;
+  for (size_t i = 0; i < ip_header_len; i += 2) {
+    checksum += (ip_ptr[i] << 8) | ip_ptr[i + 1];
+  }
+  while (checksum >> 16) {
+    checksum = (checksum & 0xffff) + (checksum >> 16);
+  }
+  PutBigEndian16(ip_ptr, 10, static_cast<uint16_t>(~checksum));
+
+  // A zero UDP checksum means no checksum for IPv4.
+  uint8_t* udp_ptr = ip_ptr + ip_header_len;
+  PutBigEndian16(udp_ptr, 0, udp_port);
+  PutBigEndian16(udp_ptr, 2, udp_port);
+  PutBigEndian16(udp_ptr, 4, static_cast<uint16_t>(udp_len));
+  PutBigEndian16(udp_ptr, 6, 0);
+}
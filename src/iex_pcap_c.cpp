@@ -0,0 +1,287 @@
+#include "iex_pcap_c.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_message_table.h"
+
+static_assert(sizeof(iex_record_t) == 64, "Records are part of the ABI, keep them at 64 bytes.");
+
+struct iex_decoder {
+  IEXDecoder decoder;
+  MessageFilter filter;
+
+  /// \brief Length of the shortest message holding all fields of a type, by type byte. Zero for
+  ///        types without fields in the record.
+  size_t min_len[256];
+};
+
+namespace {
+iex_status_t ToStatus(const ReturnCode ret_code) {
+  switch (ret_code) {
+    case ReturnCode::Success:
+      return IEX_OK;
+    case ReturnCode::EndOfStream:
+      return IEX_END_OF_STREAM;
+    case ReturnCode::ClassNotInitialized:
+      return IEX_ERROR_OPEN_FAILED;
+    case ReturnCode::FailedParsingPacket:
+      return IEX_ERROR_PARSING_PACKET;
+    case ReturnCode::FailedDecodingPacket:
+      return IEX_ERROR_DECODING_PACKET;
+    case ReturnCode::UnknownMessageType:
+      return IEX_ERROR_UNKNOWN_MESSAGE_TYPE;
+  }
+  return IEX_ERROR_INTERNAL;
+}
+
+/// \brief Length of a message up to its timestamp, which every type has at the same offset.
+constexpr size_t common_len = MessageFilter::timestamp_offset + sizeof(int64_t);
+
+/// \brief Fill a record from raw message data, at least the minimum length of its type long.
+///        Types without fields in the record only get the common ones, and are flagged.
+void FillRecord(const uint8_t* msg_data_ptr, const int64_t capture_time, const bool supported,
+                iex_record_t& record) {
+  std::memset(&record, 0, sizeof(record));
+  record.type = msg_data_ptr[0];
+  record.flags = msg_data_ptr[1];
+  record.timestamp = GetNumeric<int64_t>(msg_data_ptr, MessageFilter::timestamp_offset);
+  record.capture_time = capture_time;
+  if (!supported) {
+    record.unsupported = 1;
+    return;
+  }
+  if (record.type == IEX_SYSTEM_EVENT) {
+    std::memset(record.symbol, ' ', sizeof(record.symbol));
+    return;
+  }
+  std::memcpy(record.symbol, msg_data_ptr + symbol_field_offset, sizeof(record.symbol));
+  switch (record.type) {
+    case IEX_TRADE_REPORT:
+    case IEX_TRADE_BREAK:
+      // The size and price are as in price level updates.
+      record.trade_id = GetNumeric<uint64_t>(msg_data_ptr, 30);
+      // Fall through.
+    case IEX_PRICE_LEVEL_UPDATE_BUY:
+    case IEX_PRICE_LEVEL_UPDATE_SELL:
+      record.size = GetNumeric<uint32_t>(msg_data_ptr, 18);
+      record.price = GetPrice(msg_data_ptr, 22);
+      break;
+    case IEX_QUOTE_UPDATE:
+      record.size = GetNumeric<uint32_t>(msg_data_ptr, 18);
+      record.price = GetPrice(msg_data_ptr, 22);
+      record.price2 = GetPrice(msg_data_ptr, 30);
+      record.size2 = GetNumeric<uint32_t>(msg_data_ptr, 38);
+      break;
+    case IEX_OFFICIAL_PRICE:
+      record.price = GetPrice(msg_data_ptr, 18);
+      break;
+    case IEX_AUCTION_INFORMATION:
+      record.size = GetNumeric<uint32_t>(msg_data_ptr, 18);
+      record.price = GetPrice(msg_data_ptr, 22);
+      record.price2 = GetPrice(msg_data_ptr, 30);
+      record.size2 = GetNumeric<uint32_t>(msg_data_ptr, 38);
+      record.detail = msg_data_ptr[42];
+      break;
+    case IEX_SECURITY_DIRECTORY:
+      record.size = GetNumeric<uint32_t>(msg_data_ptr, 18);
+      record.price = GetPrice(msg_data_ptr, 22);
+      record.detail = msg_data_ptr[30];
+      break;
+    case IEX_SHORT_SALE_PRICE_TEST_STATUS:
+      record.detail = msg_data_ptr[18];
+      break;
+    default:
+      break;
+  }
+}
+
+/// \brief Write a record to row i of the columns.
+inline void ScatterRecord(const iex_record_t& record, const iex_columns_t& columns,
+                          const size_t i) {
+  if (columns.timestamp) {
+    columns.timestamp[i] = record.timestamp;
+  }
+  if (columns.capture_time) {
+    columns.capture_time[i] = record.capture_time;
+  }
+  if (columns.trade_id) {
+    columns.trade_id[i] = record.trade_id;
+  }
+  if (columns.price) {
+    columns.price[i] = record.price;
+  }
+  if (columns.price2) {
+    columns.price2[i] = record.price2;
+  }
+  if (columns.size) {
+    columns.size[i] = record.size;
+  }
+  if (columns.size2) {
+    columns.size2[i] = record.size2;
+  }
+  if (columns.symbol) {
+    std::memcpy(columns.symbol + i * sizeof(record.symbol), record.symbol, sizeof(record.symbol));
+  }
+  if (columns.type) {
+    columns.type[i] = record.type;
+  }
+  if (columns.flags) {
+    columns.flags[i] = record.flags;
+  }
+  if (columns.detail) {
+    columns.detail[i] = record.detail;
+  }
+  if (columns.unsupported) {
+    columns.unsupported[i] = record.unsupported;
+  }
+}
+
+/// \brief Decode up to capacity messages, calling output with each record and its row.
+template <typename Output>
+iex_status_t DecodeBatch(iex_decoder_t* decoder, const size_t capacity, size_t* num_decoded,
+                         const Output& output) {
+  if (!decoder || !num_decoded) {
+    return IEX_ERROR_INVALID_ARGUMENT;
+  }
+  *num_decoded = 0;
+  try {
+    const uint8_t* msg_data_ptr = nullptr;
+    size_t msg_len = 0;
+    iex_record_t record;
+    while (*num_decoded < capacity) {
+      const ReturnCode ret_code = decoder->decoder.GetNextMessageData(msg_data_ptr, msg_len);
+      if (ret_code != ReturnCode::Success) {
+        return ToStatus(ret_code);
+      }
+      // Types without fields in the record are returned flagged, truncated messages are skipped.
+      const size_t min_len = decoder->min_len[*msg_data_ptr];
+      if (msg_len < std::max(min_len, common_len)) {
+        continue;
+      }
+      FillRecord(msg_data_ptr, decoder->decoder.GetLastCaptureTime(), min_len > 0, record);
+      output(record, *num_decoded);
+      ++*num_decoded;
+    }
+    return IEX_OK;
+  } catch (...) {
+    return IEX_ERROR_INTERNAL;
+  }
+}
+}  // namespace
+
+const char* iex_status_string(iex_status_t status) {
+  switch (status) {
+    case IEX_OK:
+      return "Success.";
+    case IEX_END_OF_STREAM:
+      return "End of file stream.";
+    case IEX_ERROR_INVALID_ARGUMENT:
+      return "Invalid argument.";
+    case IEX_ERROR_OPEN_FAILED:
+      return "Failed opening file.";
+    case IEX_ERROR_PARSING_PACKET:
+      return "Failed parsing packet.";
+    case IEX_ERROR_DECODING_PACKET:
+      return "Failed decoding packet.";
+    case IEX_ERROR_UNKNOWN_MESSAGE_TYPE:
+      return "Unknown message type.";
+    case IEX_ERROR_INTERNAL:
+      return "Internal error.";
+  }
+  return "Unknown status.";
+}
+
+iex_status_t iex_open(const char* filename, iex_decoder_t** decoder) {
+  if (!filename || !decoder) {
+    return IEX_ERROR_INVALID_ARGUMENT;
+  }
+  *decoder = nullptr;
+  try {
+    iex_decoder_t* handle = new iex_decoder_t();
+    if (!handle->decoder.OpenFileForDecoding(filename)) {
+      delete handle;
+      return IEX_ERROR_OPEN_FAILED;
+    }
+    for (int type = 0; type < 256; ++type) {
+      const MessageSchema* schema = GetMessageSchema(static_cast<MessageType>(type));
+      handle->min_len[type] = schema ? schema->min_len : 0;
+    }
+    *decoder = handle;
+    return IEX_OK;
+  } catch (...) {
+    return IEX_ERROR_INTERNAL;
+  }
+}
+
+void iex_close(iex_decoder_t* decoder) { delete decoder; }
+
+iex_status_t iex_set_types(iex_decoder_t* decoder, const uint8_t* types, size_t num_types) {
+  if (!decoder || (!types && num_types > 0)) {
+    return IEX_ERROR_INVALID_ARGUMENT;
+  }
+  if (num_types == 0) {
+    decoder->filter.types.set();
+  } else {
+    decoder->filter.types.reset();
+    for (size_t i = 0; i < num_types; ++i) {
+      decoder->filter.types.set(types[i]);
+    }
+  }
+  decoder->decoder.SetFilter(decoder->filter);
+  return IEX_OK;
+}
+
+iex_status_t iex_set_symbols(iex_decoder_t* decoder, const char* const* symbols,
+                             size_t num_symbols) {
+  if (!decoder || (!symbols && num_symbols > 0)) {
+    return IEX_ERROR_INVALID_ARGUMENT;
+  }
+  try {
+    for (size_t i = 0; i < num_symbols; ++i) {
+      if (!symbols[i]) {
+        return IEX_ERROR_INVALID_ARGUMENT;
+      }
+    }
+    decoder->filter.SetSymbols(std::vector<std::string>(symbols, symbols + num_symbols));
+    decoder->decoder.SetFilter(decoder->filter);
+    return IEX_OK;
+  } catch (...) {
+    return IEX_ERROR_INTERNAL;
+  }
+}
+
+iex_status_t iex_set_time_range(iex_decoder_t* decoder, int64_t start_time, int64_t end_time) {
+  if (!decoder || end_time < start_time) {
+    return IEX_ERROR_INVALID_ARGUMENT;
+  }
+  decoder->filter.start_time = start_time;
+  decoder->filter.end_time = end_time;
+  decoder->decoder.SetFilter(decoder->filter);
+  return IEX_OK;
+}
+
+iex_status_t iex_decode_records(iex_decoder_t* decoder, iex_record_t* records, size_t capacity,
+                                size_t* num_decoded) {
+  if (!records && capacity > 0) {
+    return IEX_ERROR_INVALID_ARGUMENT;
+  }
+  return DecodeBatch(decoder, capacity, num_decoded,
+                     [records](const iex_record_t& record, const size_t i) {
+                       records[i] = record;
+                     });
+}
+
+iex_status_t iex_decode_columns(iex_decoder_t* decoder, const iex_columns_t* columns,
+                                size_t capacity, size_t* num_decoded) {
+  if (!columns) {
+    return IEX_ERROR_INVALID_ARGUMENT;
+  }
+  return DecodeBatch(decoder, capacity, num_decoded,
+                     [columns](const iex_record_t& record, const size_t i) {
+                       ScatterRecord(record, *columns, i);
+                     });
+}
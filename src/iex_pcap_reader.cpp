@@ -0,0 +1,245 @@
+#include "iex_pcap_reader.h"
+
+#include <algorithm>
+
+namespace {
+constexpr uint32_t pcap_magic_us = 0xa1b2c3d4;
+constexpr uint32_t pcap_magic_ns = 0xa1b23c4d;
+constexpr size_t pcap_file_header_len = 24;
+constexpr size_t pcap_record_header_len = 16;
+
+constexpr uint32_t pcapng_section_header_block = 0x0A0D0D0A;
+constexpr uint32_t pcapng_interface_block = 1;
+constexpr uint32_t pcapng_simple_packet_block = 3;
+constexpr uint32_t pcapng_enhanced_packet_block = 6;
+constexpr uint32_t pcapng_byte_order_magic = 0x1A2B3C4D;
+constexpr uint16_t pcapng_option_tsresol = 9;
+
+/// \brief Block type and total length, at the start of every pcapng block.
+constexpr size_t pcapng_block_header_len = 8;
+
+/// \brief Upper limit for block lengths, to reject corrupt files before allocating.
+constexpr uint32_t max_block_len = 1 << 24;
+}  // namespace
+
+bool PcapRecordReader::Open(const std::string& filename, const bool map_file) {
+  in_stream_.close();
+  in_stream_.clear();
+  mapped_file_.Close();
+  mapped_pos_ = 0;
+  interfaces_.clear();
+  if (map_file) {
+    if (!mapped_file_.Open(filename)) {
+      return false;
+    }
+  } else {
+    in_stream_.open(filename, std::ios::binary);
+  }
+  uint8_t file_header_buffer[pcap_file_header_len];
+  const uint8_t* file_header = ReadBytes(sizeof(file_header_buffer), file_header_buffer);
+  if (file_header == nullptr) {
+    IEX_LOG("Cannot read " << filename << ".");
+    return false;
+  }
+
+  // A magic number in the other byte order means the file was written on such a host.
+  const uint32_t magic = GetNumeric<uint32_t>(file_header, 0);
+  const uint32_t swapped_magic = __builtin_bswap32(magic);
+  swapped_ = false;
+  if (magic == pcapng_section_header_block) {
+    const uint32_t byte_order_magic = GetNumeric<uint32_t>(file_header, 8);
+    if (byte_order_magic != pcapng_byte_order_magic &&
+        byte_order_magic != __builtin_bswap32(pcapng_byte_order_magic)) {
+      IEX_LOG(filename << " is not a pcapng file.");
+      return false;
+    }
+    is_pcapng_ = true;
+    // Records are read block by block, starting with the section header itself, which sets the
+    // byte order.
+    offset_ = 0;
+  } else if (magic == pcap_magic_us || magic == pcap_magic_ns || swapped_magic == pcap_magic_us ||
+             swapped_magic == pcap_magic_ns) {
+    is_pcapng_ = false;
+    swapped_ = swapped_magic == pcap_magic_us || swapped_magic == pcap_magic_ns;
+    nanosecond_timestamps_ = (swapped_ ? swapped_magic : magic) == pcap_magic_ns;
+    CaptureInterface capture_interface;
+    capture_interface.link_type =
+        static_cast<pcpp::LinkLayerType>(GetUInt32(file_header, 20) & 0xffff);
+    interfaces_.push_back(capture_interface);
+    offset_ = pcap_file_header_len;
+  } else {
+    IEX_LOG(filename << " is not a pcap file.");
+    return false;
+  }
+  return Seek(offset_);
+}
+
+bool PcapRecordReader::Seek(const uint64_t record_offset) {
+  offset_ = record_offset;
+  if (mapped_file_.GetData() != nullptr) {
+    mapped_pos_ = record_offset;
+    return record_offset <= mapped_file_.GetSize();
+  }
+  in_stream_.clear();
+  in_stream_.seekg(record_offset);
+  return static_cast<bool>(in_stream_);
+}
+
+const uint8_t* PcapRecordReader::ReadBytes(const size_t len, uint8_t* dest) {
+  if (mapped_file_.GetData() != nullptr) {
+    if (mapped_pos_ > mapped_file_.GetSize() || len > mapped_file_.GetSize() - mapped_pos_) {
+      return nullptr;
+    }
+    const uint8_t* data_ptr = mapped_file_.GetData() + mapped_pos_;
+    mapped_pos_ += len;
+    return data_ptr;
+  }
+  if (dest == nullptr) {
+    buffer_.resize(len);
+    dest = buffer_.data();
+  }
+  return in_stream_.read(reinterpret_cast<char*>(dest), len) ? dest : nullptr;
+}
+
+void PcapRecordReader::AddInterface(const uint8_t* body_ptr, const size_t body_len) {
+  CaptureInterface capture_interface;
+  if (body_len < 8) {
+    interfaces_.push_back(capture_interface);
+    return;
+  }
+  capture_interface.link_type =
+      static_cast<pcpp::LinkLayerType>(GetUInt16(body_ptr, 0));
+  // Options follow the link type, reserved and snap length fields, each padded to 4 bytes.
+  size_t option_offset = 8;
+  while (option_offset + 4 <= body_len) {
+    const uint16_t code = GetUInt16(body_ptr, option_offset);
+    const uint16_t len = GetUInt16(body_ptr, option_offset + 2);
+    if (code == 0 || option_offset + 4 + len > body_len) {
+      break;
+    }
+    if (code == pcapng_option_tsresol && len >= 1) {
+      capture_interface.timestamp_resolution = body_ptr[option_offset + 4];
+    }
+    option_offset += 4 + ((len + 3) & ~3u);
+  }
+  interfaces_.push_back(capture_interface);
+}
+
+timespec PcapRecordReader::ToTimespec(const uint64_t timestamp, const uint8_t resolution) {
+  uint64_t nanoseconds = 0;
+  if (resolution & 0x80) {
+    const int shift = resolution & 0x7f;
+    nanoseconds = static_cast<uint64_t>(static_cast<long double>(timestamp) * 1e9L /
+                                        static_cast<long double>(uint64_t(1) << (shift & 63)));
+  } else {
+    nanoseconds = timestamp;
+    for (int i = resolution; i < 9; ++i) {
+      nanoseconds *= 10;
+    }
+    for (int i = 9; i < resolution; ++i) {
+      nanoseconds /= 10;
+    }
+  }
+  timespec capture_time;
+  capture_time.tv_sec = static_cast<time_t>(nanoseconds / 1000000000);
+  capture_time.tv_nsec = static_cast<long>(nanoseconds % 1000000000);
+  return capture_time;
+}
+
+ReturnCode PcapRecordReader::ReadNextRecord(PcapRecord& record) {
+  if (!in_stream_.is_open() && mapped_file_.GetData() == nullptr) {
+    IEX_LOG("The class has not opened a file yet, call Open first.");
+    return ReturnCode::ClassNotInitialized;
+  }
+
+  if (!is_pcapng_) {
+    uint8_t record_header_buffer[pcap_record_header_len];
+    const uint8_t* record_header = ReadBytes(sizeof(record_header_buffer), record_header_buffer);
+    if (record_header == nullptr) {
+      return ReturnCode::EndOfStream;
+    }
+    const uint32_t captured_len = GetUInt32(record_header, 8);
+    if (captured_len > max_block_len) {
+      return ReturnCode::FailedParsingPacket;
+    }
+    const timespec capture_time = {
+        static_cast<time_t>(GetUInt32(record_header, 0)),
+        static_cast<long>(GetUInt32(record_header, 4) *
+                          (nanosecond_timestamps_ ? 1 : 1000))};
+    const uint8_t* data_ptr = ReadBytes(captured_len, nullptr);
+    if (data_ptr == nullptr) {
+      return ReturnCode::EndOfStream;
+    }
+    record.offset = offset_;
+    record.data = data_ptr;
+    record.len = captured_len;
+    record.capture_time = capture_time;
+    record.link_type = interfaces_[0].link_type;
+    offset_ += pcap_record_header_len + captured_len;
+    return ReturnCode::Success;
+  }
+
+  while (true) {
+    uint8_t block_header_buffer[pcapng_block_header_len];
+    const uint8_t* block_header = ReadBytes(sizeof(block_header_buffer), block_header_buffer);
+    if (block_header == nullptr) {
+      return ReturnCode::EndOfStream;
+    }
+    // The section header block type reads the same in either byte order.
+    const uint32_t block_type = GetUInt32(block_header, 0);
+    size_t body_read = 0;
+    if (block_type == pcapng_section_header_block) {
+      // Its byte order magic sets the byte order of the section, its own length included.
+      uint8_t byte_order_buffer[4];
+      const uint8_t* byte_order_ptr = ReadBytes(sizeof(byte_order_buffer), byte_order_buffer);
+      if (byte_order_ptr == nullptr) {
+        return ReturnCode::EndOfStream;
+      }
+      swapped_ = GetNumeric<uint32_t>(byte_order_ptr, 0) != pcapng_byte_order_magic;
+      body_read = sizeof(byte_order_buffer);
+    }
+    const uint32_t block_len = GetUInt32(block_header, 4);
+    if (block_len < pcapng_block_header_len + 4 + body_read || block_len > max_block_len) {
+      return ReturnCode::FailedParsingPacket;
+    }
+    // The rest of the body, followed by the repeated block length.
+    const size_t body_len = block_len - pcapng_block_header_len - 4;
+    const uint8_t* body_ptr = ReadBytes(body_len + 4 - body_read, nullptr);
+    if (body_ptr == nullptr) {
+      return ReturnCode::EndOfStream;
+    }
+    const uint64_t block_offset = offset_;
+    offset_ += block_len;
+
+    if (block_type == pcapng_section_header_block) {
+      interfaces_.clear();
+    } else if (block_type == pcapng_interface_block) {
+      AddInterface(body_ptr, body_len);
+    } else if (block_type == pcapng_enhanced_packet_block && body_len >= 20) {
+      const uint32_t interface_id = GetUInt32(body_ptr, 0);
+      const uint32_t captured_len = GetUInt32(body_ptr, 12);
+      if (interface_id >= interfaces_.size() || 20 + captured_len > body_len) {
+        return ReturnCode::FailedParsingPacket;
+      }
+      const uint64_t timestamp =
+          (static_cast<uint64_t>(GetUInt32(body_ptr, 4)) << 32) | GetUInt32(body_ptr, 8);
+      const CaptureInterface& capture_interface = interfaces_[interface_id];
+      record.offset = block_offset;
+      record.data = body_ptr + 20;
+      record.len = captured_len;
+      record.capture_time = ToTimespec(timestamp, capture_interface.timestamp_resolution);
+      record.link_type = capture_interface.link_type;
+      return ReturnCode::Success;
+    } else if (block_type == pcapng_simple_packet_block && body_len >= 4 &&
+               !interfaces_.empty()) {
+      const uint32_t captured_len =
+          std::min<uint32_t>(GetUInt32(body_ptr, 0), body_len - 4);
+      record.offset = block_offset;
+      record.data = body_ptr + 4;
+      record.len = captured_len;
+      record.capture_time = timespec();
+      record.link_type = interfaces_[0].link_type;
+      return ReturnCode::Success;
+    }
+  }
+}
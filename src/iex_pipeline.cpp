@@ -0,0 +1,328 @@
+#include "iex_pipeline.h"
+
+#include <algorithm>
+#include <new>
+#include <thread>
+
+#include "iex_thread_utils.h"
+
+namespace {
+/// \brief Construct a message in place, passing the type to the structs that cover several.
+template <typename Message>
+inline Message* ConstructMessage(void* storage_ptr, const MessageType type, std::true_type) {
+  return new (storage_ptr) Message(type);
+}
+
+template <typename Message>
+inline Message* ConstructMessage(void* storage_ptr, const MessageType, std::false_type) {
+  return new (storage_ptr) Message();
+}
+}  // namespace
+
+ReturnCode MessageSlot::Decode(const uint8_t* msg_data_ptr) {
+  const auto type = static_cast<MessageType>(*msg_data_ptr);
+  switch (type) {
+    case MessageType::QuoteUpdate:
+      return DecodeAs<QuoteUpdateMessage>(msg_data_ptr, type);
+    case MessageType::PriceLevelUpdateBuy:
+    case MessageType::PriceLevelUpdateSell:
+      return DecodeAs<PriceLevelUpdateMessage>(msg_data_ptr, type);
+    case MessageType::TradeReport:
+    case MessageType::TradeBreak:
+      return DecodeAs<TradeReportMessage>(msg_data_ptr, type);
+    case MessageType::TradingStatus:
+      return DecodeAs<TradingStatusMessage>(msg_data_ptr, type);
+    case MessageType::OperationalHaltStatus:
+      return DecodeAs<OperationalHaltStatusMessage>(msg_data_ptr, type);
+    case MessageType::ShortSalePriceTestStatus:
+      return DecodeAs<ShortSalePriceTestStatusMessage>(msg_data_ptr, type);
+    case MessageType::SecurityEvent:
+      return DecodeAs<SecurityEventMessage>(msg_data_ptr, type);
+    case MessageType::AuctionInformation:
+      return DecodeAs<AuctionInformationMessage>(msg_data_ptr, type);
+    case MessageType::OfficialPrice:
+      return DecodeAs<OfficialPriceMessage>(msg_data_ptr, type);
+    case MessageType::SecurityDirectory:
+      return DecodeAs<SecurityDirectoryMessage>(msg_data_ptr, type);
+    case MessageType::SystemEvent:
+      return DecodeAs<SystemEventMessage>(msg_data_ptr, type);
+    case MessageType::AddOrder:
+      return DecodeAs<AddOrderMessage>(msg_data_ptr, type);
+    case MessageType::OrderModify:
+      return DecodeAs<OrderModifyMessage>(msg_data_ptr, type);
+    case MessageType::OrderDelete:
+      return DecodeAs<OrderDeleteMessage>(msg_data_ptr, type);
+    case MessageType::OrderExecuted:
+      return DecodeAs<OrderExecutedMessage>(msg_data_ptr, type);
+    case MessageType::ClearBook:
+      return DecodeAs<ClearBookMessage>(msg_data_ptr, type);
+    default:
+      IEX_LOG("Unknown message type " << PRINTHEX(*msg_data_ptr));
+      return ReturnCode::UnknownMessageType;
+  }
+}
+
+template <typename Message>
+ReturnCode MessageSlot::DecodeAs(const uint8_t* msg_data_ptr, const MessageType type) {
+  if (type_ != static_cast<int>(type)) {
+    Reset();
+    msg_ptr_ = ConstructMessage<Message>(&storage_, type,
+                                         std::is_constructible<Message, MessageType>());
+    type_ = static_cast<int>(type);
+  }
+  Message& msg = *static_cast<Message*>(msg_ptr_);
+  return msg.Message::Decode(msg_data_ptr) ? ReturnCode::Success
+                                            : ReturnCode::FailedDecodingPacket;
+}
+
+void MessageSlot::Reset() {
+  if (msg_ptr_) {
+    msg_ptr_->~IEXMessageBase();
+    msg_ptr_ = nullptr;
+  }
+  type_ = -1;
+}
+
+PipelinedDecoder::PipelinedDecoder(const PipelineConfig& config)
+    : config_(config),
+      packet_ring_(config.ring_capacity),
+      message_ring_(config.ring_capacity),
+      free_packet_ring_(config.ring_capacity),
+      free_message_ring_(config.ring_capacity) {
+  config_.packet_batch_size = std::max<size_t>(config_.packet_batch_size, 1);
+  config_.message_batch_size = std::max<size_t>(config_.message_batch_size, 1);
+
+  // As many batches as a ring holds, so handing a batch back never waits.
+  packet_batches_.resize(packet_ring_.Capacity());
+  for (auto& batch : packet_batches_) {
+    batch.records.resize(config_.packet_batch_size);
+  }
+  message_batches_.resize(message_ring_.Capacity());
+  for (auto& batch : message_batches_) {
+    batch.slots.reset(new MessageSlot[config_.message_batch_size]);
+  }
+}
+
+bool PipelinedDecoder::OpenFileForDecoding(const std::string& filename) {
+  // The first packet is not consumed here, the decode stage handles it like any other packet.
+  if (!reader_.Open(filename, true)) {
+    return false;
+  }
+  read_done_ = false;
+  decode_done_ = false;
+  stop_ = false;
+  error_ = static_cast<int>(ReturnCode::Success);
+  have_first_header_ = false;
+  message_count_ = 0;
+
+  // Take back the batches a stopped run left in the rings, and hand them all to the producers.
+  size_t index = 0;
+  while (packet_ring_.TryPop(index) || free_packet_ring_.TryPop(index)) {
+  }
+  while (message_ring_.TryPop(index) || free_message_ring_.TryPop(index)) {
+  }
+  for (index = 0; index < packet_batches_.size(); ++index) {
+    free_packet_ring_.TryPush(size_t(index));
+  }
+  for (index = 0; index < message_batches_.size(); ++index) {
+    free_message_ring_.TryPush(size_t(index));
+  }
+  return true;
+}
+
+ReturnCode PipelinedDecoder::Run() {
+  std::thread read_thread(&PipelinedDecoder::ReadStage, this);
+  std::thread decode_thread(&PipelinedDecoder::DecodeStage, this);
+  std::thread consume_thread(&PipelinedDecoder::ConsumeStage, this);
+  read_thread.join();
+  decode_thread.join();
+  consume_thread.join();
+
+  auto ret_code = static_cast<ReturnCode>(error_.load());
+  if (ret_code == ReturnCode::Success && !have_first_header_) {
+    IEX_LOG("The file did not contain any IEX packets.");
+    return ReturnCode::FailedParsingPacket;
+  }
+  return ret_code;
+}
+
+template <typename T>
+bool PipelinedDecoder::PushBlocking(SPSCRing<T>& ring, T&& item) {
+  while (!ring.TryPush(std::move(item))) {
+    if (stop_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    WaitForOtherThread();
+  }
+  return true;
+}
+
+template <typename T>
+bool PipelinedDecoder::PopBlocking(SPSCRing<T>& ring, T& item) {
+  while (!ring.TryPop(item)) {
+    if (stop_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    WaitForOtherThread();
+  }
+  return true;
+}
+
+void PipelinedDecoder::Fail(const ReturnCode code) {
+  int expected = static_cast<int>(ReturnCode::Success);
+  error_.compare_exchange_strong(expected, static_cast<int>(code));
+  stop_ = true;
+}
+
+void PipelinedDecoder::ReadStage() {
+  PinCurrentThreadToCore(config_.reader_core);
+
+  size_t index = 0;
+  while (!stop_.load(std::memory_order_relaxed) && PopBlocking(free_packet_ring_, index)) {
+    // The records point into the mapped file, only their location is stored in the batch.
+    PacketBatch& batch = packet_batches_[index];
+    batch.size = 0;
+    auto ret_code = ReturnCode::Success;
+    while (batch.size < batch.records.size() &&
+           (ret_code = reader_.ReadNextRecord(batch.records[batch.size])) == ReturnCode::Success) {
+      ++batch.size;
+    }
+    if (batch.size > 0 && !PushBlocking(packet_ring_, std::move(index))) {
+      break;
+    }
+    if (ret_code == ReturnCode::EndOfStream) {
+      break;
+    }
+    if (ret_code != ReturnCode::Success) {
+      Fail(ret_code);
+      break;
+    }
+  }
+  read_done_.store(true, std::memory_order_release);
+}
+
+ReturnCode PipelinedDecoder::DecodeRecord(const PcapRecord& record, size_t& message_batch) {
+  const uint8_t* payload_ptr = nullptr;
+  size_t payload_len = 0;
+  if (!IEXDecoder::FindUdpPayload(record.data, record.len, record.link_type, payload_ptr,
+                                  payload_len)) {
+    IEX_LOG("Couldn't find a UDP payload for IEX message data.");
+    return ReturnCode::FailedParsingPacket;
+  }
+  if (payload_len < IEXDecoder::first_block_start) {
+    IEX_LOG("Payload of " << payload_len << " bytes is shorter than the IEX-TP header.");
+    return ReturnCode::FailedParsingPacket;
+  }
+
+  IEXTPHeader header;
+  if (!header.Decode(payload_ptr)) {
+    IEX_LOG("Header decode failed.");
+    return ReturnCode::FailedDecodingPacket;
+  }
+  if (!have_first_header_) {
+    first_header_ = header;
+    have_first_header_ = true;
+  }
+
+  // Heartbeat packets carry no messages.
+  if (header.payload_len == 0) {
+    return ReturnCode::Success;
+  }
+
+  size_t block_offset = IEXDecoder::first_block_start;
+  const uint8_t* msg_data_ptr = nullptr;
+  size_t msg_len = 0;
+  while (block_offset < payload_len) {
+    if (!IEXDecoder::GetNextBlock(payload_ptr, payload_len, block_offset, msg_data_ptr,
+                                  msg_len) ||
+        msg_len == 0) {
+      IEX_LOG("Block of " << msg_len << " bytes runs past the end of a packet of " << payload_len
+                          << " bytes.");
+      return ReturnCode::FailedParsingPacket;
+    }
+
+    MessageBatch& batch = message_batches_[message_batch];
+    auto ret_code = batch.slots[batch.size].Decode(msg_data_ptr);
+    if (ret_code != ReturnCode::Success) {
+      return ret_code;
+    }
+    if (++batch.size == config_.message_batch_size) {
+      // Only fails once stopped, the decode stage then exits.
+      if (!PushBlocking(message_ring_, std::move(message_batch)) ||
+          !PopBlocking(free_message_ring_, message_batch)) {
+        return ReturnCode::Success;
+      }
+      message_batches_[message_batch].size = 0;
+    }
+  }
+  return ReturnCode::Success;
+}
+
+void PipelinedDecoder::DecodeStage() {
+  PinCurrentThreadToCore(config_.decoder_core);
+
+  size_t message_batch = 0;
+  if (PopBlocking(free_message_ring_, message_batch)) {
+    message_batches_[message_batch].size = 0;
+  }
+  size_t packet_batch = 0;
+  while (!stop_.load(std::memory_order_relaxed)) {
+    if (!packet_ring_.TryPop(packet_batch)) {
+      // Check the done flag before the second pop, so a final batch pushed just before the flag
+      // was set is not missed.
+      if (read_done_.load(std::memory_order_acquire)) {
+        if (!packet_ring_.TryPop(packet_batch)) {
+          break;
+        }
+      } else {
+        WaitForOtherThread();
+        continue;
+      }
+    }
+
+    const PacketBatch& batch = packet_batches_[packet_batch];
+    auto ret_code = ReturnCode::Success;
+    for (size_t i = 0; i < batch.size && ret_code == ReturnCode::Success; ++i) {
+      ret_code = DecodeRecord(batch.records[i], message_batch);
+    }
+    PushBlocking(free_packet_ring_, std::move(packet_batch));
+    if (ret_code != ReturnCode::Success) {
+      Fail(ret_code);
+      break;
+    }
+  }
+
+  // Once stopped, the batch being filled may already have been handed on.
+  if (!stop_.load(std::memory_order_relaxed) && message_batches_[message_batch].size > 0) {
+    PushBlocking(message_ring_, std::move(message_batch));
+  }
+  decode_done_.store(true, std::memory_order_release);
+}
+
+void PipelinedDecoder::ConsumeStage() {
+  PinCurrentThreadToCore(config_.consumer_core);
+
+  size_t index = 0;
+  while (!stop_.load(std::memory_order_relaxed)) {
+    if (!message_ring_.TryPop(index)) {
+      if (decode_done_.load(std::memory_order_acquire)) {
+        if (!message_ring_.TryPop(index)) {
+          break;
+        }
+      } else {
+        WaitForOtherThread();
+        continue;
+      }
+    }
+
+    const MessageBatch& batch = message_batches_[index];
+    for (size_t i = 0; i < batch.size; ++i) {
+      const IEXMessageBase& msg = batch.slots[i].Get();
+      for (const auto& consumer : consumers_) {
+        consumer(msg);
+      }
+    }
+    message_count_ += batch.size;
+    PushBlocking(free_message_ring_, std::move(index));
+  }
+}
@@ -0,0 +1,342 @@
+#include "iex_predicate.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+constexpr int64_t ns_per_second = 1000000000;
+constexpr int64_t ns_per_day = 86400 * ns_per_second;
+
+/// \brief Days since 1970-01-01 of a date in the proleptic Gregorian calendar.
+int64_t DaysFromCivil(int64_t year, const int month, const int day) {
+  year -= month <= 2;
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const int64_t year_of_era = year - era * 400;
+  const int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+/// \brief The year of a day counted since 1970-01-01.
+int64_t YearFromDays(int64_t days) {
+  days += 719468;
+  const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  const int64_t day_of_era = days - era * 146097;
+  const int64_t year_of_era =
+      (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  const int64_t day_of_year =
+      day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const int64_t month_index = (5 * day_of_year + 2) / 153;
+  return year_of_era + era * 400 + (month_index >= 10 ? 1 : 0);
+}
+
+/// \brief The n-th Sunday (1 based) on or after the first of a month, in days since 1970-01-01.
+int64_t NthSunday(const int64_t year, const int month, const int n) {
+  const int64_t first = DaysFromCivil(year, month, 1);
+  // 1970-01-01 was a Thursday, with Sunday as zero.
+  const int64_t weekday = (first % 7 + 7 + 4) % 7;
+  return first + (7 - weekday) % 7 + 7 * (n - 1);
+}
+
+/// \brief True if midnight of a local day is in daylight saving time, which in the US runs from
+///        2am on the second Sunday of March to 2am on the first Sunday of November.
+bool IsEasternDaylightTime(const int64_t local_days) {
+  const int64_t year = YearFromDays(local_days);
+  return local_days > NthSunday(year, 3, 2) && local_days <= NthSunday(year, 11, 1);
+}
+
+int64_t FloorDiv(const int64_t value, const int64_t divisor) {
+  return value / divisor - (value % divisor < 0 ? 1 : 0);
+}
+
+/// \brief Split an expression into words, operators, parentheses and commas.
+std::vector<std::string> Tokenize(const std::string& expression) {
+  std::vector<std::string> tokens;
+  size_t pos = 0;
+  while (pos < expression.size()) {
+    const char c = expression[pos];
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      ++pos;
+    } else if (c == '(' || c == ')' || c == ',') {
+      tokens.push_back(std::string(1, c));
+      ++pos;
+    } else if (c == '<' || c == '>' || c == '=' || c == '!') {
+      const size_t len = pos + 1 < expression.size() && expression[pos + 1] == '=' ? 2 : 1;
+      tokens.push_back(expression.substr(pos, len));
+      pos += len;
+    } else {
+      const size_t end = expression.find_first_of(" \t\n()<>=!,", pos);
+      tokens.push_back(expression.substr(pos, end - pos));
+      pos = end == std::string::npos ? expression.size() : end;
+    }
+  }
+  return tokens;
+}
+
+std::string ToLower(std::string str) {
+  std::transform(str.begin(), str.end(), str.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return str;
+}
+
+bool ParseComparison(const std::string& token, Comparison& comparison) {
+  const char* const symbols[] = {"<", "<=", "=", "!=", ">=", ">"};
+  for (int i = 0; i < 6; ++i) {
+    if (token == symbols[i]) {
+      comparison = static_cast<Comparison>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParseField(const std::string& name, MessageField& field) {
+  const char* const names[] = {"price", "size", "bid_price", "bid_size", "ask_price", "ask_size"};
+  for (int i = 0; i < 6; ++i) {
+    if (name == names[i]) {
+      field = static_cast<MessageField>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+/// \brief Parse a time, either HH:MM[:SS[.fff]] as nanoseconds since midnight, or nanoseconds.
+///        Hours run up to 23, and 24:00 stands for the end of the day.
+bool ParseTime(const std::string& str, int64_t& time, bool& time_of_day) {
+  time_of_day = str.find(':') != std::string::npos;
+  char* end_ptr = nullptr;
+  if (!time_of_day) {
+    time = std::strtoll(str.c_str(), &end_ptr, 10);
+    return !str.empty() && *end_ptr == '\0';
+  }
+  const long hours = std::strtol(str.c_str(), &end_ptr, 10);
+  if (*end_ptr != ':') {
+    return false;
+  }
+  const long minutes = std::strtol(end_ptr + 1, &end_ptr, 10);
+  double seconds = 0;
+  if (*end_ptr == ':') {
+    seconds = std::strtod(end_ptr + 1, &end_ptr);
+  }
+  if (*end_ptr != '\0' || hours < 0 || hours > 24 || minutes < 0 || minutes > 59 || seconds < 0 ||
+      seconds >= 60 || (hours == 24 && (minutes > 0 || seconds > 0))) {
+    return false;
+  }
+  time = (hours * 3600 + minutes * 60) * ns_per_second +
+         static_cast<int64_t>(seconds * ns_per_second + 0.5);
+  return true;
+}
+
+template <typename T>
+bool GetField(const T& msg, const MessageField field, double& value) {
+  switch (field) {
+    case MessageField::Price:
+      value = msg.price;
+      return true;
+    case MessageField::Size:
+      value = msg.size;
+      return true;
+    default:
+      return false;
+  }
+}
+
+template <>
+bool GetField(const OfficialPriceMessage& msg, const MessageField field, double& value) {
+  value = msg.price;
+  return field == MessageField::Price;
+}
+
+template <>
+bool GetField(const QuoteUpdateMessage& msg, const MessageField field, double& value) {
+  switch (field) {
+    case MessageField::BidPrice:
+      value = msg.bid_price;
+      return true;
+    case MessageField::BidSize:
+      value = msg.bid_size;
+      return true;
+    case MessageField::AskPrice:
+      value = msg.ask_price;
+      return true;
+    case MessageField::AskSize:
+      value = msg.ask_size;
+      return true;
+    default:
+      return false;
+  }
+}
+}  // namespace
+
+bool GetFieldValue(const IEXMessageBase& msg, const MessageField field, double& value) {
+  switch (msg.GetMessageType()) {
+    case MessageType::QuoteUpdate:
+      return GetField(static_cast<const QuoteUpdateMessage&>(msg), field, value);
+    case MessageType::TradeReport:
+    case MessageType::TradeBreak:
+      return GetField(static_cast<const TradeReportMessage&>(msg), field, value);
+    case MessageType::OfficialPrice:
+      return GetField(static_cast<const OfficialPriceMessage&>(msg), field, value);
+    case MessageType::PriceLevelUpdateBuy:
+    case MessageType::PriceLevelUpdateSell:
+      return GetField(static_cast<const PriceLevelUpdateMessage&>(msg), field, value);
+    default:
+      return false;
+  }
+}
+
+bool FieldCondition::Matches(const IEXMessageBase& msg) const {
+  double field_value = 0;
+  if (!GetFieldValue(msg, field, field_value)) {
+    return false;
+  }
+  switch (comparison) {
+    case Comparison::Less:
+      return field_value < value;
+    case Comparison::LessEqual:
+      return field_value <= value;
+    case Comparison::Equal:
+      return field_value == value;
+    case Comparison::NotEqual:
+      return field_value != value;
+    case Comparison::GreaterEqual:
+      return field_value >= value;
+    case Comparison::Greater:
+      return field_value > value;
+  }
+  return false;
+}
+
+bool ParseMessageType(const std::string& name, MessageType& message_type) {
+  const std::pair<const char*, MessageType> types[] = {
+      {"SystemEvent", MessageType::SystemEvent},
+      {"SecurityDirectory", MessageType::SecurityDirectory},
+      {"SecurityEvent", MessageType::SecurityEvent},
+      {"TradingStatus", MessageType::TradingStatus},
+      {"OperationalHaltStatus", MessageType::OperationalHaltStatus},
+      {"ShortSalePriceTestStatus", MessageType::ShortSalePriceTestStatus},
+      {"QuoteUpdate", MessageType::QuoteUpdate},
+      {"TradeReport", MessageType::TradeReport},
+      {"OfficialPrice", MessageType::OfficialPrice},
+      {"TradeBreak", MessageType::TradeBreak},
+      {"AuctionInformation", MessageType::AuctionInformation},
+      {"PriceLevelUpdateBuy", MessageType::PriceLevelUpdateBuy},
+      {"PriceLevelUpdateSell", MessageType::PriceLevelUpdateSell},
+      {"AddOrder", MessageType::AddOrder},
+      {"OrderModify", MessageType::OrderModify},
+      {"OrderDelete", MessageType::OrderDelete},
+      {"OrderExecuted", MessageType::OrderExecuted},
+      {"ClearBook", MessageType::ClearBook}};
+  const std::string lower_name = ToLower(name);
+  for (const auto& type : types) {
+    if (lower_name == ToLower(type.first)) {
+      message_type = type.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+int64_t GetEasternMidnight(const int64_t timestamp) {
+  constexpr int64_t est_offset = 5 * 3600 * ns_per_second;
+  constexpr int64_t edt_offset = 4 * 3600 * ns_per_second;
+  int64_t local_days = FloorDiv(timestamp - est_offset, ns_per_day);
+  if (IsEasternDaylightTime(local_days)) {
+    local_days = FloorDiv(timestamp - edt_offset, ns_per_day);
+  }
+  const int64_t offset = IsEasternDaylightTime(local_days) ? edt_offset : est_offset;
+  return local_days * ns_per_day + offset;
+}
+
+bool MessageQuery::Parse(const std::string& expression) {
+  *this = MessageQuery();
+  const std::vector<std::string> tokens = Tokenize(expression);
+  size_t pos = 0;
+  auto next = [&]() { return pos < tokens.size() ? tokens[pos++] : std::string(); };
+
+  // Parse "=VALUE" or "in (VALUE,...)".
+  auto parse_values = [&](std::vector<std::string>& values) {
+    const std::string token = next();
+    if (token == "=") {
+      values.push_back(next());
+      return !values.back().empty();
+    }
+    if (ToLower(token) != "in" || next() != "(") {
+      return false;
+    }
+    while (true) {
+      values.push_back(next());
+      const std::string separator = next();
+      if (separator == ")") {
+        return true;
+      }
+      if (separator != ",") {
+        return false;
+      }
+    }
+  };
+
+  while (pos < tokens.size()) {
+    const std::string name = ToLower(next());
+    if (name == "and") {
+      continue;
+    }
+    bool success = true;
+    if (name == "type") {
+      std::vector<std::string> values;
+      success = parse_values(values);
+      for (size_t i = 0; success && i < values.size(); ++i) {
+        MessageType message_type;
+        success = ParseMessageType(values[i], message_type);
+        types_.push_back(message_type);
+      }
+    } else if (name == "symbol") {
+      success = parse_values(symbols_);
+    } else if (name == "time") {
+      std::string range = next();
+      if (range == "=") {
+        range = next();
+      }
+      const size_t dash = range.find('-', 1);
+      bool start_time_of_day = false;
+      success = dash != std::string::npos &&
+                ParseTime(range.substr(0, dash), start_time_, start_time_of_day) &&
+                ParseTime(range.substr(dash + 1), end_time_, time_of_day_) &&
+                start_time_of_day == time_of_day_ && start_time_ <= end_time_;
+    } else {
+      FieldCondition condition;
+      char* end_ptr = nullptr;
+      success = ParseField(name, condition.field) && ParseComparison(next(), condition.comparison);
+      if (success) {
+        const std::string number = next();
+        condition.value = std::strtod(number.c_str(), &end_ptr);
+        success = !number.empty() && *end_ptr == '\0';
+      }
+      conditions_.push_back(condition);
+    }
+    if (!success) {
+      IEX_LOG("Invalid query term '" << name << "' in: " << expression);
+      *this = MessageQuery();
+      return false;
+    }
+  }
+  return true;
+}
+
+MessageFilter MessageQuery::GetFilter(const int64_t reference_time) const {
+  MessageFilter filter;
+  if (!types_.empty()) {
+    filter.SetTypes(types_);
+  }
+  filter.SetSymbols(symbols_);
+  filter.start_time = start_time_;
+  filter.end_time = end_time_;
+  if (time_of_day_) {
+    const int64_t midnight = GetEasternMidnight(reference_time);
+    filter.start_time += midnight;
+    filter.end_time += midnight;
+  }
+  return filter;
+}
@@ -0,0 +1,13 @@
+#include "iex_protocol.h"
+
+std::string GetProtocolName(const uint16_t protocol_id) {
+  switch (static_cast<ProtocolId>(protocol_id)) {
+    case ProtocolId::TOPS:
+      return "TOPS 1.6";
+    case ProtocolId::DEEP:
+      return "DEEP 1.0";
+    case ProtocolId::DEEP_PLUS:
+      return "DEEP+ 1.0";
+  }
+  return "Unknown";
+}
@@ -0,0 +1,409 @@
+// Python extension module "iex_pcap", wrapping the decoder.
+//
+//   import iex_pcap
+//   tables = iex_pcap.decode("20180127_IEXTP1_TOPS1.6.pcap", types=["TradeReport"])
+//   prices = tables["TradeReport"]["price"]  # numpy.ndarray of float64, not copied
+//
+//   for msg in iex_pcap.Decoder(filename, symbols=["AAPL"]):
+//     print(msg["type"], msg["timestamp"])
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "iex_decoder.h"
+#include "iex_message_table.h"
+#include "iex_predicate.h"
+
+namespace {
+
+/// \brief Buffer protocol format of a field type, in native byte order and sizes, which memoryview
+///        can index. The columns are little endian, as on the hosts supported.
+const char* GetFormat(const FieldSpec& field) {
+  switch (field.type) {
+    case FieldType::UInt8:
+      return "B";
+    case FieldType::UInt32:
+      return "I";
+    case FieldType::Int64:
+      return "q";
+    case FieldType::UInt64:
+      return "Q";
+    case FieldType::Price:
+      return "d";
+    case FieldType::Bytes:
+      return field.size == 4 ? "4s" : "8s";
+  }
+  return "B";
+}
+
+/// \brief A column moved out of a MessageTable, exported read only through the buffer protocol.
+///        NumPy arrays made from it keep it alive, and share its memory.
+struct ColumnObject {
+  PyObject_HEAD
+  std::vector<uint8_t>* data;
+  const char* format;
+  Py_ssize_t num_rows;
+  Py_ssize_t item_size;
+};
+
+void ColumnDealloc(ColumnObject* self) {
+  delete self->data;
+  Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+int ColumnGetBuffer(ColumnObject* self, Py_buffer* view, int flags) {
+  if (flags & PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "Column is read only.");
+    view->obj = nullptr;
+    return -1;
+  }
+  view->obj = reinterpret_cast<PyObject*>(self);
+  Py_INCREF(self);
+  view->buf = self->data->data();
+  view->len = self->num_rows * self->item_size;
+  view->readonly = 1;
+  view->itemsize = self->item_size;
+  view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(self->format) : nullptr;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) ? &self->num_rows : nullptr;
+  view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &view->itemsize : nullptr;
+  view->suboffsets = nullptr;
+  view->internal = nullptr;
+  return 0;
+}
+
+Py_ssize_t ColumnLength(ColumnObject* self) { return self->num_rows; }
+
+PyBufferProcs column_buffer_procs = {reinterpret_cast<getbufferproc>(ColumnGetBuffer), nullptr};
+
+PySequenceMethods column_sequence_methods = {reinterpret_cast<lenfunc>(ColumnLength)};
+
+PyTypeObject column_type = {PyVarObject_HEAD_INIT(nullptr, 0) "iex_pcap.Column"};
+
+/// \brief Wrap a column, as a NumPy array if NumPy is installed.
+///
+/// \return A new reference, or nullptr with the Python error set.
+PyObject* MakeColumn(const FieldSpec& field, std::vector<uint8_t>&& data, PyObject* numpy) {
+  ColumnObject* column = PyObject_New(ColumnObject, &column_type);
+  if (!column) {
+    return nullptr;
+  }
+  column->num_rows = static_cast<Py_ssize_t>(data.size() / field.size);
+  column->item_size = field.size;
+  column->format = GetFormat(field);
+  column->data = new std::vector<uint8_t>(std::move(data));
+  if (!numpy) {
+    return reinterpret_cast<PyObject*>(column);
+  }
+  PyObject* array = PyObject_CallMethod(numpy, "asarray", "O", column);
+  Py_DECREF(column);
+  return array;
+}
+
+/// \brief Build a decoder filter from the optional keyword arguments of decode and Decoder.
+///
+/// \return True if succeeds, false with the Python error set.
+bool ParseFilter(PyObject* types, PyObject* symbols, PyObject* start_time, PyObject* end_time,
+                 MessageFilter& filter) {
+  if (types && types != Py_None) {
+    PyObject* type_list = PySequence_Fast(types, "types must be a sequence of type names.");
+    if (!type_list) {
+      return false;
+    }
+    std::vector<MessageType> message_types;
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(type_list); ++i) {
+      const char* name = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(type_list, i));
+      MessageType message_type;
+      if (!name || !ParseMessageType(name, message_type)) {
+        if (name) {
+          PyErr_Format(PyExc_ValueError, "Unknown message type '%s'.", name);
+        }
+        Py_DECREF(type_list);
+        return false;
+      }
+      message_types.push_back(message_type);
+    }
+    Py_DECREF(type_list);
+    filter.SetTypes(message_types);
+  }
+  if (symbols && symbols != Py_None) {
+    PyObject* symbol_list = PySequence_Fast(symbols, "symbols must be a sequence of strings.");
+    if (!symbol_list) {
+      return false;
+    }
+    std::vector<std::string> symbol_names;
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(symbol_list); ++i) {
+      const char* name = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(symbol_list, i));
+      if (!name) {
+        Py_DECREF(symbol_list);
+        return false;
+      }
+      symbol_names.push_back(name);
+    }
+    Py_DECREF(symbol_list);
+    filter.SetSymbols(symbol_names);
+  }
+  if (start_time && start_time != Py_None) {
+    filter.start_time = PyLong_AsLongLong(start_time);
+  }
+  if (end_time && end_time != Py_None) {
+    filter.end_time = PyLong_AsLongLong(end_time);
+  }
+  return !PyErr_Occurred();
+}
+
+/// \brief Convert a field of a raw message to a Python object.
+PyObject* GetFieldObject(const FieldSpec& field, const uint8_t* msg_data_ptr) {
+  switch (field.type) {
+    case FieldType::UInt8:
+      return PyLong_FromUnsignedLong(msg_data_ptr[field.offset]);
+    case FieldType::UInt32:
+      return PyLong_FromUnsignedLong(GetNumeric<uint32_t>(msg_data_ptr, field.offset));
+    case FieldType::Int64:
+      return PyLong_FromLongLong(GetNumeric<int64_t>(msg_data_ptr, field.offset));
+    case FieldType::UInt64:
+      return PyLong_FromUnsignedLongLong(GetNumeric<uint64_t>(msg_data_ptr, field.offset));
+    case FieldType::Price:
+      return PyFloat_FromDouble(GetPrice(msg_data_ptr, field.offset));
+    case FieldType::Bytes: {
+      const std::string value = GetString(msg_data_ptr, field.offset, field.size);
+      return PyUnicode_FromStringAndSize(value.data(), value.size());
+    }
+  }
+  Py_RETURN_NONE;
+}
+
+/// \brief Set a dictionary item, taking the reference to the value.
+///
+/// \return True if succeeds, false with the Python error set.
+bool SetItem(PyObject* dict, const char* key, PyObject* value) {
+  if (!value) {
+    return false;
+  }
+  const int ret = PyDict_SetItemString(dict, key, value);
+  Py_DECREF(value);
+  return ret == 0;
+}
+
+/// \brief Raise a Python error for a decoder return code.
+PyObject* SetDecoderError(const ReturnCode ret_code, const std::string& filename) {
+  if (ret_code == ReturnCode::ClassNotInitialized) {
+    PyErr_Format(PyExc_IOError, "Cannot open '%s' for decoding.", filename.c_str());
+  } else {
+    PyErr_Format(PyExc_RuntimeError, "Decoding '%s' failed: %s", filename.c_str(),
+                 ReturnCodeToString(ret_code).c_str());
+  }
+  return nullptr;
+}
+
+const char* filter_doc =
+    "types: message type names, e.g. [\"TradeReport\", \"QuoteUpdate\"].\n"
+    "symbols: symbols, e.g. [\"AAPL\"]. Messages without a symbol no longer match.\n"
+    "start_time, end_time: inclusive timestamp range, nanoseconds since POSIX time UTC.\n"
+    "The filter is applied to the raw messages, so others are never decoded.";
+
+/// \brief iex_pcap.decode(filename, types=None, symbols=None, start_time=None, end_time=None)
+PyObject* Decode(PyObject*, PyObject* args, PyObject* kwargs) {
+  static const char* keywords[] = {"filename", "types", "symbols", "start_time", "end_time",
+                                   nullptr};
+  const char* filename = nullptr;
+  PyObject* types = nullptr;
+  PyObject* symbols = nullptr;
+  PyObject* start_time = nullptr;
+  PyObject* end_time = nullptr;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|OOOO", const_cast<char**>(keywords),
+                                   &filename, &types, &symbols, &start_time, &end_time)) {
+    return nullptr;
+  }
+  MessageFilter filter;
+  if (!ParseFilter(types, symbols, start_time, end_time, filter)) {
+    return nullptr;
+  }
+
+  // The tables are filled without the GIL, so other Python threads run meanwhile.
+  MessageTables tables;
+  ReturnCode ret_code;
+  Py_BEGIN_ALLOW_THREADS
+  ret_code = tables.AddFile(filename, filter);
+  Py_END_ALLOW_THREADS
+  if (ret_code != ReturnCode::Success) {
+    return SetDecoderError(ret_code, filename);
+  }
+
+  PyObject* numpy = PyImport_ImportModule("numpy");
+  if (!numpy) {
+    // Without NumPy the columns are returned as is. Numeric columns can be indexed through
+    // memoryview, symbol columns read as bytes.
+    PyErr_Clear();
+  }
+  PyObject* result = PyDict_New();
+  bool success = result != nullptr;
+  for (auto& table : tables.GetTables()) {
+    if (!success) {
+      break;
+    }
+    const MessageSchema& schema = table.GetSchema();
+    PyObject* columns = PyDict_New();
+    success = SetItem(result, schema.name, columns);
+    for (size_t i = 0; success && i < schema.fields.size(); ++i) {
+      success = SetItem(columns, schema.fields[i].name,
+                        MakeColumn(schema.fields[i], table.TakeColumn(i), numpy));
+    }
+  }
+  Py_XDECREF(numpy);
+  if (!success) {
+    Py_XDECREF(result);
+    return nullptr;
+  }
+  return result;
+}
+
+/// \brief A streaming decoder, yielding one dictionary per message.
+struct DecoderObject {
+  PyObject_HEAD
+  IEXDecoder* decoder;
+  std::string* filename;
+};
+
+void DecoderDealloc(DecoderObject* self) {
+  delete self->decoder;
+  delete self->filename;
+  Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+int DecoderInit(DecoderObject* self, PyObject* args, PyObject* kwargs) {
+  static const char* keywords[] = {"filename", "types", "symbols", "start_time", "end_time",
+                                   nullptr};
+  const char* filename = nullptr;
+  PyObject* types = nullptr;
+  PyObject* symbols = nullptr;
+  PyObject* start_time = nullptr;
+  PyObject* end_time = nullptr;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|OOOO", const_cast<char**>(keywords),
+                                   &filename, &types, &symbols, &start_time, &end_time)) {
+    return -1;
+  }
+  MessageFilter filter;
+  if (!ParseFilter(types, symbols, start_time, end_time, filter)) {
+    return -1;
+  }
+  delete self->decoder;
+  delete self->filename;
+  self->decoder = new IEXDecoder();
+  self->filename = new std::string(filename);
+  if (!self->decoder->OpenFileForDecoding(filename)) {
+    SetDecoderError(ReturnCode::ClassNotInitialized, filename);
+    return -1;
+  }
+  self->decoder->SetFilter(filter);
+  return 0;
+}
+
+PyObject* DecoderIter(PyObject* self) {
+  Py_INCREF(self);
+  return self;
+}
+
+PyObject* DecoderNext(DecoderObject* self) {
+  if (!self->decoder) {
+    PyErr_SetString(PyExc_RuntimeError, "Decoder is not initialized.");
+    return nullptr;
+  }
+  const uint8_t* msg_data_ptr = nullptr;
+  size_t msg_len = 0;
+  const MessageSchema* schema = nullptr;
+  do {
+    const ReturnCode ret_code = self->decoder->GetNextMessageData(msg_data_ptr, msg_len);
+    if (ret_code == ReturnCode::EndOfStream) {
+      // Returning nullptr without an error set ends the iteration.
+      return nullptr;
+    }
+    if (ret_code != ReturnCode::Success) {
+      return SetDecoderError(ret_code, *self->filename);
+    }
+    // Types without a schema, and truncated messages, are skipped as in decode().
+    schema = GetMessageSchema(static_cast<MessageType>(*msg_data_ptr));
+  } while (!schema || msg_len < schema->min_len);
+
+  PyObject* msg = PyDict_New();
+  bool success = msg && SetItem(msg, "type", PyUnicode_FromString(schema->name));
+  for (size_t i = 0; success && i < schema->fields.size(); ++i) {
+    success = SetItem(msg, schema->fields[i].name, GetFieldObject(schema->fields[i], msg_data_ptr));
+  }
+  if (!success) {
+    Py_XDECREF(msg);
+    return nullptr;
+  }
+  return msg;
+}
+
+PyObject* DecoderGetCaptureTime(DecoderObject* self, void*) {
+  return PyLong_FromLongLong(self->decoder ? self->decoder->GetLastCaptureTime() : 0);
+}
+
+PyGetSetDef decoder_getset[] = {
+    {const_cast<char*>("capture_time"), reinterpret_cast<getter>(DecoderGetCaptureTime), nullptr,
+     const_cast<char*>("Capture time of the packet of the last message, nanoseconds since POSIX "
+                       "time UTC."),
+     nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+PyTypeObject decoder_type = {PyVarObject_HEAD_INIT(nullptr, 0) "iex_pcap.Decoder"};
+
+PyMethodDef module_methods[] = {
+    {"decode", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(Decode)),
+     METH_VARARGS | METH_KEYWORDS,
+     "decode(filename, types=None, symbols=None, start_time=None, end_time=None)\n\n"
+     "Decode a pcap file into columns: a dict of message type name to a dict of field name to a\n"
+     "numpy array, one element per message. The arrays share the memory of the decoder output.\n"
+     "Prices are float64 dollars, symbols fixed length bytes padded with spaces. Filters as for\n"
+     "Decoder."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef module_def = {PyModuleDef_HEAD_INIT, "iex_pcap",
+                          "Decoding of IEX TOPS and DEEP pcap files.", -1, module_methods};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_iex_pcap() {
+  column_type.tp_basicsize = sizeof(ColumnObject);
+  column_type.tp_flags = Py_TPFLAGS_DEFAULT;
+  column_type.tp_doc = "A read only column of decoded messages, see the buffer protocol.";
+  column_type.tp_dealloc = reinterpret_cast<destructor>(ColumnDealloc);
+  column_type.tp_as_buffer = &column_buffer_procs;
+  column_type.tp_as_sequence = &column_sequence_methods;
+
+  static const std::string decoder_doc =
+      std::string(
+          "Decoder(filename, types=None, symbols=None, start_time=None, end_time=None)\n\n"
+          "Iterate over the messages of a pcap file, one dict of field name to value each, with\n"
+          "the type name under \"type\".\n\n") +
+      filter_doc;
+  decoder_type.tp_basicsize = sizeof(DecoderObject);
+  decoder_type.tp_flags = Py_TPFLAGS_DEFAULT;
+  decoder_type.tp_doc = decoder_doc.c_str();
+  decoder_type.tp_new = PyType_GenericNew;
+  decoder_type.tp_init = reinterpret_cast<initproc>(DecoderInit);
+  decoder_type.tp_dealloc = reinterpret_cast<destructor>(DecoderDealloc);
+  decoder_type.tp_iter = DecoderIter;
+  decoder_type.tp_iternext = reinterpret_cast<iternextfunc>(DecoderNext);
+  decoder_type.tp_getset = decoder_getset;
+
+  if (PyType_Ready(&column_type) < 0 || PyType_Ready(&decoder_type) < 0) {
+    return nullptr;
+  }
+  PyObject* module = PyModule_Create(&module_def);
+  if (!module) {
+    return nullptr;
+  }
+  Py_INCREF(&column_type);
+  Py_INCREF(&decoder_type);
+  PyModule_AddObject(module, "Column", reinterpret_cast<PyObject*>(&column_type));
+  PyModule_AddObject(module, "Decoder", reinterpret_cast<PyObject*>(&decoder_type));
+  return module;
+}
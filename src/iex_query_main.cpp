@@ -0,0 +1,90 @@
+#include "iex_batch.h"
+#include "iex_catalog.h"
+#include "iex_decoder.h"
+#include "iex_message_writer.h"
+#include "iex_predicate.h"
+
+#include <iostream>
+#include <string>
+
+namespace {
+/// \brief Decode the messages of one file matching the query and write them.
+///
+/// \param catalog  If not null, its time index is used to skip to the start of the time range.
+ReturnCode QueryFile(const std::string& filename, const MessageQuery& query,
+                     const DatasetCatalog* catalog, MessageWriter& writer) {
+  IEXDecoder decoder;
+  if (!decoder.OpenFileForDecoding(filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+  // Times of day refer to the trading day of the file.
+  const MessageFilter filter = query.GetFilter(decoder.GetFirstHeader().send_time);
+  decoder.SetFilter(filter);
+  auto ret_code = ReturnCode::Success;
+  if (catalog != nullptr &&
+      (ret_code = catalog->SeekToTime(decoder, filter.start_time)) != ReturnCode::Success) {
+    return ret_code;
+  }
+
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  while ((ret_code = decoder.GetNextMessage(msg_ptr)) == ReturnCode::Success) {
+    if (query.Matches(*msg_ptr) &&
+        !writer.Write(*msg_ptr, decoder.GetLastDecodedHeader(), decoder.GetLastCaptureTime())) {
+      return ReturnCode::FailedDecodingPacket;
+    }
+  }
+  return ret_code == ReturnCode::EndOfStream ? ReturnCode::Success : ret_code;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  // An optional catalog of the files, see iex_catalog, comes first.
+  int arg = 1;
+  DatasetCatalog catalog;
+  const bool use_catalog = argc > 2 && std::string(argv[1]) == "--catalog";
+  if (use_catalog) {
+    if (!catalog.Load(argv[2])) {
+      std::cerr << "Failed to load catalog '" << argv[2] << "'." << std::endl;
+      return 1;
+    }
+    arg = 3;
+  }
+  if (argc < arg + 3) {
+    std::cout << "Usage: iex_query [--catalog <catalog>] <output|-> <expression> "
+                 "<pcap_file_directory_or_pattern>...\n"
+                 "  The output format follows the extension: .pcap, .store, otherwise CSV.\n"
+                 "  With a catalog, files start decoding near the start of the time range.\n"
+                 "  Example: iex_query - 'type=TradeReport symbol in (AAPL,AMD) "
+                 "time 09:30-10:00 price>100' data/"
+              << std::endl;
+    return 1;
+  }
+
+  MessageQuery query;
+  if (!query.Parse(argv[arg + 1])) {
+    return 1;
+  }
+  auto writer_ptr = OpenMessageWriter(argv[arg]);
+  if (!writer_ptr) {
+    return 1;
+  }
+
+  // Status goes to standard error, standard output may carry the results.
+  for (int i = arg + 2; i < argc; ++i) {
+    for (const auto& filename : ListPcapFiles(argv[i])) {
+      const auto ret_code =
+          QueryFile(filename, query, use_catalog ? &catalog : nullptr, *writer_ptr);
+      if (ret_code != ReturnCode::Success) {
+        std::cerr << "Failed to query '" << filename << "': " << ReturnCodeToString(ret_code)
+                  << std::endl;
+        return 1;
+      }
+    }
+  }
+  if (!writer_ptr->Close()) {
+    std::cerr << "Failed to write '" << argv[arg] << "'." << std::endl;
+    return 1;
+  }
+  std::cerr << "Wrote " << writer_ptr->GetMessageCount() << " messages." << std::endl;
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include "iex_replay.h"
+
+#include <cstring>
+
+namespace {
+/// \brief Whether price a is better than price b on a side of the book.
+inline bool IsBetter(const double a, const double b, const bool is_buy) {
+  return is_buy ? a > b : a < b;
+}
+}  // namespace
+
+constexpr uint32_t ReplayState::npos;
+constexpr size_t ReplayState::buy_side;
+constexpr size_t ReplayState::sell_side;
+
+ReplayState::ReplayState(const ReplayConfig& config)
+    : config_(config),
+      symbol_table_(config.max_symbols),
+      tops_(config.max_symbols),
+      levels_(2 * config.max_symbols * config.max_book_levels, PriceLevel{0, 0}),
+      level_counts_(2 * config.max_symbols, 0) {
+  timers_.reserve(config.max_timers);
+}
+
+bool ReplayState::ScheduleTimer(const int64_t time, const uint64_t timer_id) {
+  if (timers_.size() >= config_.max_timers) {
+    return false;
+  }
+  timers_.push_back(Timer{time, timer_sequence_++, timer_id});
+  std::push_heap(timers_.begin(), timers_.end(), TimerLater());
+  return true;
+}
+
+ReplayState::Timer ReplayState::PopTimer() {
+  std::pop_heap(timers_.begin(), timers_.end(), TimerLater());
+  const Timer timer = timers_.back();
+  timers_.pop_back();
+  AdvanceTime(timer.time);
+  return timer;
+}
+
+uint32_t ReplayState::GetSymbolId(const uint8_t* msg_data_ptr, const size_t msg_len) {
+  uint64_t packed_symbol = 0;
+  if (!GetPackedSymbol(msg_data_ptr, msg_len, packed_symbol)) {
+    return npos;
+  }
+  const uint32_t id = symbol_table_.Find(packed_symbol);
+  if (id != npos) {
+    return id;
+  }
+  // The table is sized for max_symbols, adding up to that many never allocates.
+  if (symbol_table_.GetSize() >= config_.max_symbols) {
+    ++num_dropped_symbols_;
+    return npos;
+  }
+  return symbol_table_.GetOrAdd(packed_symbol);
+}
+
+void ReplayState::ApplyQuoteUpdate(const uint32_t id, const QuoteUpdateMessage& msg) {
+  TopOfBook& top = tops_[id];
+  top.timestamp = static_cast<int64_t>(msg.timestamp);
+  top.bid_price = msg.bid_price;
+  top.bid_size = static_cast<uint32_t>(msg.bid_size);
+  top.ask_price = msg.ask_price;
+  top.ask_size = static_cast<uint32_t>(msg.ask_size);
+}
+
+void ReplayState::ApplyTradeReport(const uint32_t id, const TradeReportMessage& msg) {
+  TopOfBook& top = tops_[id];
+  top.timestamp = static_cast<int64_t>(msg.timestamp);
+  top.last_trade_price = msg.price;
+  top.last_trade_size = static_cast<uint32_t>(msg.size);
+}
+
+void ReplayState::ApplyPriceLevelUpdate(const uint32_t id, const PriceLevelUpdateMessage& msg) {
+  const bool is_buy = msg.GetMessageType() == MessageType::PriceLevelUpdateBuy;
+  const size_t book = 2 * id + (is_buy ? buy_side : sell_side);
+  const size_t max_levels = config_.max_book_levels;
+  PriceLevel* levels = &levels_[book * max_levels];
+  size_t& num_levels = level_counts_[book];
+
+  // Levels are sorted best first and updates are mostly near the top, so scan from there.
+  size_t i = 0;
+  while (i < num_levels && IsBetter(levels[i].price, msg.price, is_buy)) {
+    ++i;
+  }
+  const bool exists = i < num_levels && levels[i].price == msg.price;
+  if (msg.size == 0) {
+    if (exists) {
+      std::memmove(&levels[i], &levels[i + 1], (num_levels - i - 1) * sizeof(PriceLevel));
+      --num_levels;
+    }
+  } else if (exists) {
+    levels[i].size = static_cast<uint32_t>(msg.size);
+  } else if (i < max_levels) {
+    if (num_levels == max_levels) {
+      --num_levels;
+      ++num_dropped_levels_;
+    }
+    std::memmove(&levels[i + 1], &levels[i], (num_levels - i) * sizeof(PriceLevel));
+    levels[i] = PriceLevel{msg.price, static_cast<uint32_t>(msg.size)};
+    ++num_levels;
+  } else {
+    ++num_dropped_levels_;
+  }
+
+  TopOfBook& top = tops_[id];
+  top.timestamp = static_cast<int64_t>(msg.timestamp);
+  if (is_buy) {
+    top.bid_price = num_levels > 0 ? levels[0].price : 0;
+    top.bid_size = num_levels > 0 ? levels[0].size : 0;
+  } else {
+    top.ask_price = num_levels > 0 ? levels[0].price : 0;
+    top.ask_size = num_levels > 0 ? levels[0].size : 0;
+  }
+}
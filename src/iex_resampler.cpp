@@ -0,0 +1,246 @@
+#include "iex_resampler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+/// \brief Identifies grid files, and their format version.
+constexpr char grid_magic[8] = {'I', 'E', 'X', 'G', 'R', 'D', '0', '1'};
+
+struct GridHeader {
+  char magic[sizeof(grid_magic)];
+  int64_t start_time;
+  int64_t interval;
+  uint64_t num_rows;
+  uint64_t num_buckets;
+};
+
+/// \brief Write an array as a NumPy .npy file, version 1.0, in host (little endian) byte order.
+///
+/// \param descr  NumPy type string, e.g. "<f8".
+/// \param shape  Python tuple of the dimensions, e.g. "(3, 5)" or "(3,)".
+bool WriteNpy(const std::string& filename, const std::string& descr, const std::string& shape,
+              const void* data_ptr, const size_t len) {
+  std::ofstream out_stream(filename, std::ios::binary);
+  if (!out_stream) {
+    IEX_LOG("Cannot open " << filename << " for writing.");
+    return false;
+  }
+  constexpr size_t preamble_len = 10;
+  std::string header = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': " + shape +
+                       ", }";
+  // The data starts 64 byte aligned, the header is padded with spaces and ends in a newline.
+  header.append(63 - (preamble_len + header.size()) % 64, ' ');
+  header.push_back('\n');
+  const uint16_t header_len = static_cast<uint16_t>(header.size());
+  out_stream.write("\x93NUMPY\x01\x00", 8);
+  out_stream.write(reinterpret_cast<const char*>(&header_len), sizeof(header_len));
+  out_stream.write(header.data(), header.size());
+  out_stream.write(static_cast<const char*>(data_ptr), len);
+  return static_cast<bool>(out_stream);
+}
+
+template <typename T>
+void WriteColumn(std::ofstream& out_stream, const std::vector<T>& column) {
+  out_stream.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(T));
+}
+}  // namespace
+
+GridResampler::GridResampler(const GridConfig& config)
+    : config_(config), all_symbols_(config.symbols.empty()) {
+  if (config_.interval > 0 && config_.end_time > config_.start_time) {
+    num_buckets_ = static_cast<size_t>((config_.end_time - config_.start_time - 1) /
+                                       config_.interval) + 1;
+  }
+  for (const auto& symbol : config_.symbols) {
+    if (symbol_table_.Find(PackSymbol(symbol)) == SymbolTable::npos) {
+      AddRow(PackSymbol(symbol));
+    }
+  }
+}
+
+uint32_t GridResampler::GetRow(const uint64_t packed_symbol) {
+  const uint32_t row = symbol_table_.Find(packed_symbol);
+  return row != SymbolTable::npos || !all_symbols_ ? row : AddRow(packed_symbol);
+}
+
+uint32_t GridResampler::AddRow(const uint64_t packed_symbol) {
+  const uint32_t row = symbol_table_.GetOrAdd(packed_symbol);
+  bid_price_.push_back(0);
+  bid_size_.push_back(0);
+  ask_price_.push_back(0);
+  ask_size_.push_back(0);
+  last_price_.push_back(0);
+  filled_until_.push_back(0);
+
+  // Append a row to every matrix.
+  const size_t size = symbol_table_.GetSize() * num_buckets_;
+  bid_prices_.resize(size, 0);
+  ask_prices_.resize(size, 0);
+  bid_sizes_.resize(size, 0);
+  ask_sizes_.resize(size, 0);
+  last_prices_.resize(size, 0);
+  volumes_.resize(size, 0);
+  notionals_.resize(size, 0);
+  trade_counts_.resize(size, 0);
+  return row;
+}
+
+void GridResampler::FillUntil(const uint32_t row, const size_t end_bucket) {
+  const size_t begin_bucket = filled_until_[row];
+  if (end_bucket <= begin_bucket) {
+    return;
+  }
+  const size_t begin = row * num_buckets_ + begin_bucket;
+  const size_t end = row * num_buckets_ + end_bucket;
+  std::fill(bid_prices_.begin() + begin, bid_prices_.begin() + end, bid_price_[row]);
+  std::fill(bid_sizes_.begin() + begin, bid_sizes_.begin() + end, bid_size_[row]);
+  std::fill(ask_prices_.begin() + begin, ask_prices_.begin() + end, ask_price_[row]);
+  std::fill(ask_sizes_.begin() + begin, ask_sizes_.begin() + end, ask_size_[row]);
+  std::fill(last_prices_.begin() + begin, last_prices_.begin() + end, last_price_[row]);
+  filled_until_[row] = end_bucket;
+}
+
+void GridResampler::OnQuote(const uint32_t row, const int64_t timestamp, const double bid_price,
+                            const uint32_t bid_size, const double ask_price,
+                            const uint32_t ask_size) {
+  // The buckets that ended before this quote hold the previous one.
+  FillUntil(row, GetBucket(timestamp));
+  bid_price_[row] = bid_price;
+  bid_size_[row] = bid_size;
+  ask_price_[row] = ask_price;
+  ask_size_[row] = ask_size;
+}
+
+void GridResampler::OnTrade(const uint32_t row, const int64_t timestamp, const double price,
+                            const uint32_t size) {
+  const size_t bucket = GetBucket(timestamp);
+  FillUntil(row, bucket);
+  last_price_[row] = price;
+  if (timestamp >= config_.start_time && bucket < num_buckets_) {
+    const size_t index = row * num_buckets_ + bucket;
+    volumes_[index] += size;
+    notionals_[index] += price * size;
+    ++trade_counts_[index];
+  }
+}
+
+void GridResampler::OnMessage(const IEXMessageBase& msg) {
+  switch (msg.GetMessageType()) {
+    case MessageType::QuoteUpdate: {
+      const auto& quote_msg = static_cast<const QuoteUpdateMessage&>(msg);
+      const uint32_t row = GetRow(PackSymbol(quote_msg.symbol));
+      if (row != SymbolTable::npos) {
+        OnQuote(row, quote_msg.timestamp, quote_msg.bid_price,
+                static_cast<uint32_t>(quote_msg.bid_size), quote_msg.ask_price,
+                static_cast<uint32_t>(quote_msg.ask_size));
+      }
+      break;
+    }
+    case MessageType::TradeReport: {
+      const auto& trade_msg = static_cast<const TradeReportMessage&>(msg);
+      const uint32_t row = GetRow(PackSymbol(trade_msg.symbol));
+      if (row != SymbolTable::npos) {
+        OnTrade(row, trade_msg.timestamp, trade_msg.price, static_cast<uint32_t>(trade_msg.size));
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void GridResampler::Finish() {
+  for (uint32_t row = 0; row < symbol_table_.GetSize(); ++row) {
+    FillUntil(row, num_buckets_);
+  }
+}
+
+ReturnCode GridResampler::AddFile(const std::string& filename) {
+  IEXDecoder decoder;
+  if (!decoder.OpenFileForDecoding(filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+  // Messages before the grid still set the state it starts with, so only the end is filtered.
+  MessageFilter filter;
+  filter.SetTypes({MessageType::QuoteUpdate, MessageType::TradeReport});
+  filter.SetSymbols(config_.symbols);
+  filter.end_time = config_.end_time;
+  decoder.SetFilter(filter);
+
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  auto ret_code = ReturnCode::Success;
+  while ((ret_code = decoder.GetNextMessage(msg_ptr)) == ReturnCode::Success) {
+    OnMessage(*msg_ptr);
+  }
+  Finish();
+  return ret_code == ReturnCode::EndOfStream ? ReturnCode::Success : ret_code;
+}
+
+bool GridResampler::Save(const std::string& filename) const {
+  std::ofstream out_stream(filename, std::ios::binary);
+  if (!out_stream) {
+    IEX_LOG("Cannot open " << filename << " for writing.");
+    return false;
+  }
+  GridHeader header;
+  std::memcpy(header.magic, grid_magic, sizeof(header.magic));
+  header.start_time = config_.start_time;
+  header.interval = config_.interval;
+  header.num_rows = GetNumRows();
+  header.num_buckets = num_buckets_;
+  out_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (uint32_t row = 0; row < GetNumRows(); ++row) {
+    const uint64_t packed_symbol = symbol_table_.GetPacked(row);
+    out_stream.write(reinterpret_cast<const char*>(&packed_symbol), sizeof(packed_symbol));
+  }
+  // Eight byte columns first, so every column is aligned to its element size.
+  WriteColumn(out_stream, bid_prices_);
+  WriteColumn(out_stream, ask_prices_);
+  WriteColumn(out_stream, last_prices_);
+  WriteColumn(out_stream, notionals_);
+  WriteColumn(out_stream, volumes_);
+  WriteColumn(out_stream, bid_sizes_);
+  WriteColumn(out_stream, ask_sizes_);
+  WriteColumn(out_stream, trade_counts_);
+  return static_cast<bool>(out_stream);
+}
+
+bool GridResampler::SaveNpy(const std::string& prefix) const {
+  const size_t num_rows = GetNumRows();
+  const std::string shape =
+      "(" + std::to_string(num_rows) + ", " + std::to_string(num_buckets_) + ")";
+  const size_t len = num_rows * num_buckets_;
+
+  // Symbols as fixed width byte strings, NumPy strips the trailing NULs.
+  std::vector<char> symbols(num_rows * symbol_field_len, '\0');
+  for (uint32_t row = 0; row < num_rows; ++row) {
+    const std::string symbol = symbol_table_.GetSymbol(row);
+    std::memcpy(&symbols[row * symbol_field_len], symbol.data(), symbol.size());
+  }
+  std::vector<int64_t> bucket_starts(num_buckets_);
+  for (size_t bucket = 0; bucket < num_buckets_; ++bucket) {
+    bucket_starts[bucket] = GetBucketStart(bucket);
+  }
+
+  return WriteNpy(prefix + "symbols.npy", "|S" + std::to_string(symbol_field_len),
+                  "(" + std::to_string(num_rows) + ",)", symbols.data(), symbols.size()) &&
+         WriteNpy(prefix + "bucket_start.npy", "<i8", "(" + std::to_string(num_buckets_) + ",)",
+                  bucket_starts.data(), num_buckets_ * sizeof(int64_t)) &&
+         WriteNpy(prefix + "bid_price.npy", "<f8", shape, bid_prices_.data(),
+                  len * sizeof(double)) &&
+         WriteNpy(prefix + "bid_size.npy", "<u4", shape, bid_sizes_.data(),
+                  len * sizeof(uint32_t)) &&
+         WriteNpy(prefix + "ask_price.npy", "<f8", shape, ask_prices_.data(),
+                  len * sizeof(double)) &&
+         WriteNpy(prefix + "ask_size.npy", "<u4", shape, ask_sizes_.data(),
+                  len * sizeof(uint32_t)) &&
+         WriteNpy(prefix + "last_price.npy", "<f8", shape, last_prices_.data(),
+                  len * sizeof(double)) &&
+         WriteNpy(prefix + "volume.npy", "<u8", shape, volumes_.data(), len * sizeof(uint64_t)) &&
+         WriteNpy(prefix + "notional.npy", "<f8", shape, notionals_.data(),
+                  len * sizeof(double)) &&
+         WriteNpy(prefix + "trade_count.npy", "<u4", shape, trade_counts_.data(),
+                  len * sizeof(uint32_t));
+}
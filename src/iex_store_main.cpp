@@ -0,0 +1,33 @@
+#include "iex_batch.h"
+#include "iex_symbol_store.h"
+
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cout << "Usage: iex_store <output_store> <pcap_file_directory_or_pattern>..." << std::endl;
+    return 1;
+  }
+
+  SymbolStoreWriter writer;
+  for (int i = 2; i < argc; ++i) {
+    for (const auto& filename : ListPcapFiles(argv[i])) {
+      std::cout << "Adding '" << filename << "'." << std::endl;
+      const auto ret_code = writer.AddFile(filename);
+      if (ret_code != ReturnCode::Success) {
+        std::cout << "Failed to read '" << filename << "': " << ReturnCodeToString(ret_code)
+                  << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  if (!writer.Write(argv[1])) {
+    std::cout << "Failed to write '" << argv[1] << "'." << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote " << writer.GetMessageCount() << " messages to '" << argv[1] << "'."
+            << std::endl;
+  return 0;
+}
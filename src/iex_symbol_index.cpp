@@ -0,0 +1,285 @@
+#include "iex_symbol_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "iex_batch.h"
+
+namespace {
+/// \brief Identifies symbol index files, and their format version.
+constexpr char index_magic[8] = {'I', 'E', 'X', 'S', 'Y', 'M', '0', '1'};
+
+template <typename T>
+void WriteValue(std::ostream& out_stream, const T& value) {
+  out_stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool ReadValue(std::istream& in_stream, T& value) {
+  in_stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+  return static_cast<bool>(in_stream);
+}
+
+/// \brief Bytes between the read position and the end of a stream.
+uint64_t GetRemainingSize(std::istream& in_stream) {
+  const std::streampos pos = in_stream.tellg();
+  in_stream.seekg(0, std::ios::end);
+  const std::streampos end = in_stream.tellg();
+  in_stream.seekg(pos);
+  return (pos < 0 || end < pos) ? 0 : static_cast<uint64_t>(end - pos);
+}
+
+/// \brief Read one LEB128 varint, advancing offset. Returns false if the data ends early.
+bool ReadVarint(const std::vector<uint8_t>& data, size_t& offset, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; offset < data.size() && shift < 64; shift += 7) {
+    const uint8_t byte = data[offset++];
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+void SymbolPacketIndex::AddRecord(RecordList& record_list, const uint64_t record_offset) {
+  if (record_list.num_records > 0 && record_list.last_offset == record_offset) {
+    return;
+  }
+  uint64_t delta = record_list.num_records > 0 ? record_offset - record_list.last_offset
+                                               : record_offset;
+  while (delta >= 0x80) {
+    record_list.data.push_back(static_cast<uint8_t>(delta | 0x80));
+    delta >>= 7;
+  }
+  record_list.data.push_back(static_cast<uint8_t>(delta));
+  record_list.last_offset = record_offset;
+  ++record_list.num_records;
+}
+
+ReturnCode SymbolPacketIndex::Build(const std::string& pcap_filename) {
+  record_lists_.clear();
+  num_packets_ = 0;
+  file_size_ = ::GetFileSize(pcap_filename);
+
+  PcapRecordReader reader;
+  if (!reader.Open(pcap_filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+
+  // Consecutive messages are often of the same symbol, so remember the last list used.
+  uint64_t last_symbol = 0;
+  RecordList* last_list = nullptr;
+  PcapRecord record;
+  auto ret_code = ReturnCode::Success;
+  while ((ret_code = reader.ReadNextRecord(record)) == ReturnCode::Success) {
+    ++num_packets_;
+    pcpp::RawPacket raw_packet(record.data, static_cast<int>(record.len), record.capture_time,
+                               false, record.link_type);
+    pcpp::Packet packet(&raw_packet);
+    const uint8_t* payload_ptr = nullptr;
+    size_t payload_len = 0;
+    ret_code = IEXDecoder::ExtractPayload(packet, payload_ptr, payload_len);
+    if (ret_code != ReturnCode::Success) {
+      return ret_code;
+    }
+
+    size_t block_offset = IEXDecoder::first_block_start;
+    const uint8_t* msg_data_ptr = nullptr;
+    size_t msg_len = 0;
+    while (IEXDecoder::GetNextBlock(payload_ptr, payload_len, block_offset, msg_data_ptr,
+                                    msg_len)) {
+      uint64_t packed_symbol = 0;
+      if (!GetPackedSymbol(msg_data_ptr, msg_len, packed_symbol)) {
+        continue;
+      }
+      if (!last_list || packed_symbol != last_symbol) {
+        last_symbol = packed_symbol;
+        last_list = &record_lists_[packed_symbol];
+      }
+      AddRecord(*last_list, record.offset);
+    }
+  }
+  return ret_code == ReturnCode::EndOfStream ? ReturnCode::Success : ret_code;
+}
+
+std::vector<uint64_t> SymbolPacketIndex::GetRecordOffsets(const std::string& symbol) const {
+  std::vector<uint64_t> record_offsets;
+  const auto it = record_lists_.find(PackSymbol(symbol));
+  if (it == record_lists_.end()) {
+    return record_offsets;
+  }
+  record_offsets.reserve(it->second.num_records);
+  size_t data_offset = 0;
+  uint64_t delta = 0;
+  uint64_t record_offset = 0;
+  while (ReadVarint(it->second.data, data_offset, delta)) {
+    record_offset += delta;
+    record_offsets.push_back(record_offset);
+  }
+  return record_offsets;
+}
+
+std::vector<std::string> SymbolPacketIndex::GetSymbols() const {
+  std::vector<std::string> symbols;
+  symbols.reserve(record_lists_.size());
+  for (const auto& record_list : record_lists_) {
+    symbols.push_back(GetString(reinterpret_cast<const uint8_t*>(&record_list.first), 0,
+                                symbol_field_len));
+  }
+  std::sort(symbols.begin(), symbols.end());
+  return symbols;
+}
+
+uint64_t SymbolPacketIndex::GetEncodedSize() const {
+  uint64_t encoded_size = 0;
+  for (const auto& record_list : record_lists_) {
+    encoded_size += record_list.second.data.size();
+  }
+  return encoded_size;
+}
+
+bool SymbolPacketIndex::Save(const std::string& filename) const {
+  std::ofstream out_stream(filename, std::ios::binary);
+  if (!out_stream) {
+    IEX_LOG("Cannot open " << filename << " for writing.");
+    return false;
+  }
+  out_stream.write(index_magic, sizeof(index_magic));
+  WriteValue(out_stream, file_size_);
+  WriteValue(out_stream, num_packets_);
+  WriteValue<uint64_t>(out_stream, record_lists_.size());
+  for (const auto& record_list : record_lists_) {
+    WriteValue(out_stream, record_list.first);
+    WriteValue(out_stream, record_list.second.last_offset);
+    WriteValue(out_stream, record_list.second.num_records);
+    WriteValue<uint64_t>(out_stream, record_list.second.data.size());
+    out_stream.write(reinterpret_cast<const char*>(record_list.second.data.data()),
+                     record_list.second.data.size());
+  }
+  return static_cast<bool>(out_stream);
+}
+
+bool SymbolPacketIndex::Load(const std::string& filename) {
+  std::ifstream in_stream(filename, std::ios::binary);
+  char magic[sizeof(index_magic)];
+  in_stream.read(magic, sizeof(magic));
+  if (!in_stream || std::memcmp(magic, index_magic, sizeof(magic)) != 0) {
+    IEX_LOG(filename << " is not a symbol index file.");
+    return false;
+  }
+
+  uint64_t file_size = 0;
+  uint64_t num_packets = 0;
+  uint64_t num_lists = 0;
+  // Every list has four 8 byte fields, and every record a varint of 1 to 10 bytes, so sizes read
+  // from a corrupt file are rejected before allocating for them.
+  bool success = ReadValue(in_stream, file_size) && ReadValue(in_stream, num_packets) &&
+                 ReadValue(in_stream, num_lists) &&
+                 num_lists <= GetRemainingSize(in_stream) / (4 * sizeof(uint64_t));
+  std::unordered_map<uint64_t, RecordList> record_lists;
+  for (uint64_t i = 0; success && i < num_lists; ++i) {
+    uint64_t packed_symbol = 0;
+    uint64_t data_size = 0;
+    RecordList record_list;
+    success = ReadValue(in_stream, packed_symbol) &&
+              ReadValue(in_stream, record_list.last_offset) &&
+              ReadValue(in_stream, record_list.num_records) && ReadValue(in_stream, data_size) &&
+              record_list.num_records <= data_size && data_size <= GetRemainingSize(in_stream) &&
+              data_size <= 10 * record_list.num_records;
+    if (success) {
+      record_list.data.resize(data_size);
+      in_stream.read(reinterpret_cast<char*>(record_list.data.data()), data_size);
+      success = static_cast<bool>(in_stream);
+      record_lists[packed_symbol] = std::move(record_list);
+    }
+  }
+  if (!success) {
+    IEX_LOG("Failed to read symbol index " << filename << ".");
+    return false;
+  }
+  file_size_ = file_size;
+  num_packets_ = num_packets;
+  record_lists_ = std::move(record_lists);
+  return true;
+}
+
+ReturnCode SymbolExtractor::Open(const std::string& pcap_filename,
+                                 const SymbolPacketIndex& index, const std::string& symbol) {
+  if (::GetFileSize(pcap_filename) != index.GetFileSize()) {
+    IEX_LOG("The symbol index does not match " << pcap_filename << ", rebuild it.");
+    return ReturnCode::ClassNotInitialized;
+  }
+  if (!reader_.Open(pcap_filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+  record_offsets_ = index.GetRecordOffsets(symbol);
+  next_record_ = 0;
+  packed_symbol_ = PackSymbol(symbol);
+  payload_ptr_ = nullptr;
+
+  // Read up to the first packet, so pcapng interface descriptions are known before seeking.
+  PcapRecord record;
+  const auto ret_code = reader_.IsPcapng() ? reader_.ReadNextRecord(record) : ReturnCode::Success;
+  return ret_code == ReturnCode::EndOfStream ? ReturnCode::Success : ret_code;
+}
+
+ReturnCode SymbolExtractor::ParseNextPacket() {
+  if (next_record_ >= record_offsets_.size()) {
+    return ReturnCode::EndOfStream;
+  }
+  PcapRecord record;
+  if (!reader_.Seek(record_offsets_[next_record_++])) {
+    return ReturnCode::FailedParsingPacket;
+  }
+  auto ret_code = reader_.ReadNextRecord(record);
+  if (ret_code != ReturnCode::Success) {
+    return ret_code;
+  }
+  last_capture_time_ =
+      static_cast<int64_t>(record.capture_time.tv_sec) * 1000000000 + record.capture_time.tv_nsec;
+
+  // The packet does not own the record data, so the payload stays valid until the next read.
+  pcpp::RawPacket raw_packet(record.data, static_cast<int>(record.len), record.capture_time, false,
+                             record.link_type);
+  pcpp::Packet packet(&raw_packet);
+  ret_code = IEXDecoder::ExtractPayload(packet, payload_ptr_, payload_len_);
+  if (ret_code != ReturnCode::Success) {
+    return ret_code;
+  }
+  block_offset_ = IEXDecoder::first_block_start;
+  return ReturnCode::Success;
+}
+
+ReturnCode SymbolExtractor::GetNextMessage(std::unique_ptr<IEXMessageBase>& msg_ptr) {
+  const uint8_t* msg_data_ptr = nullptr;
+  size_t msg_len = 0;
+  while (true) {
+    if (!payload_ptr_ ||
+        !IEXDecoder::GetNextBlock(payload_ptr_, payload_len_, block_offset_, msg_data_ptr,
+                                  msg_len)) {
+      auto ret_code = ParseNextPacket();
+      if (ret_code != ReturnCode::Success) {
+        return ret_code;
+      }
+      continue;
+    }
+    uint64_t packed_symbol = 0;
+    if (!GetPackedSymbol(msg_data_ptr, msg_len, packed_symbol) ||
+        packed_symbol != packed_symbol_) {
+      continue;
+    }
+
+    msg_ptr = IEXMessageFactory(msg_data_ptr);
+    if (!msg_ptr) {
+      IEX_LOG("Unknown message type " << PRINTHEX(*msg_data_ptr));
+      return ReturnCode::UnknownMessageType;
+    }
+    if (!msg_ptr->Decode(msg_data_ptr)) {
+      return ReturnCode::FailedDecodingPacket;
+    }
+    return ReturnCode::Success;
+  }
+}
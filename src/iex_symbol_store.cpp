@@ -0,0 +1,222 @@
+#include "iex_symbol_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "iex_pcap_reader.h"
+
+namespace {
+/// \brief Identifies symbol store files, and their format version.
+constexpr char store_magic[8] = {'I', 'E', 'X', 'S', 'T', 'O', '0', '1'};
+
+/// \brief The file header, followed by the directory and then the message blocks.
+struct SymbolStoreHeader {
+  char magic[sizeof(store_magic)];
+  uint64_t num_entries;
+  uint64_t num_messages;
+  uint64_t directory_offset;
+};
+
+/// \brief Offset of the timestamp, the same in every message type.
+constexpr size_t timestamp_offset = 2;
+}  // namespace
+
+ReturnCode SymbolSpanDecoder::GetNextMessage(std::unique_ptr<IEXMessageBase>& msg_ptr) {
+  const uint8_t* msg_data_ptr = nullptr;
+  size_t msg_len = 0;
+  if (!IEXDecoder::GetNextBlock(span_.data, span_.len, block_offset_, msg_data_ptr, msg_len)) {
+    return ReturnCode::EndOfStream;
+  }
+  msg_ptr = IEXMessageFactory(msg_data_ptr);
+  if (!msg_ptr) {
+    IEX_LOG("Unknown message type " << PRINTHEX(*msg_data_ptr));
+    return ReturnCode::UnknownMessageType;
+  }
+  if (!msg_ptr->Decode(msg_data_ptr)) {
+    return ReturnCode::FailedDecodingPacket;
+  }
+  return ReturnCode::Success;
+}
+
+void SymbolStoreWriter::AddMessage(const uint8_t* msg_data_ptr, const size_t msg_len) {
+  if (msg_len < timestamp_offset + sizeof(int64_t) || msg_len > UINT16_MAX) {
+    return;
+  }
+  uint64_t packed_symbol = PackSymbol("");
+  GetPackedSymbol(msg_data_ptr, msg_len, packed_symbol);
+
+  SymbolMessages& messages = symbols_[packed_symbol];
+  MessageRef ref;
+  ref.timestamp = GetNumeric<int64_t>(msg_data_ptr, timestamp_offset);
+  ref.block_offset = messages.blocks.size();
+  messages.refs.push_back(ref);
+  messages.blocks.resize(ref.block_offset + 2 + msg_len);
+  PutNumeric<uint16_t>(messages.blocks.data(), ref.block_offset, msg_len);
+  std::memcpy(&messages.blocks[ref.block_offset + 2], msg_data_ptr, msg_len);
+  ++num_messages_;
+}
+
+ReturnCode SymbolStoreWriter::AddFile(const std::string& pcap_filename) {
+  PcapRecordReader reader;
+  if (!reader.Open(pcap_filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+
+  // The messages are copied in wire format, decoding is left to the readers.
+  PcapRecord record;
+  auto ret_code = ReturnCode::Success;
+  while ((ret_code = reader.ReadNextRecord(record)) == ReturnCode::Success) {
+    pcpp::RawPacket raw_packet(record.data, static_cast<int>(record.len), record.capture_time,
+                               false, record.link_type);
+    pcpp::Packet packet(&raw_packet);
+    const uint8_t* payload_ptr = nullptr;
+    size_t payload_len = 0;
+    ret_code = IEXDecoder::ExtractPayload(packet, payload_ptr, payload_len);
+    if (ret_code != ReturnCode::Success) {
+      return ret_code;
+    }
+    size_t block_offset = IEXDecoder::first_block_start;
+    const uint8_t* msg_data_ptr = nullptr;
+    size_t msg_len = 0;
+    while (IEXDecoder::GetNextBlock(payload_ptr, payload_len, block_offset, msg_data_ptr,
+                                    msg_len)) {
+      AddMessage(msg_data_ptr, msg_len);
+    }
+  }
+  return ret_code == ReturnCode::EndOfStream ? ReturnCode::Success : ret_code;
+}
+
+bool SymbolStoreWriter::Write(const std::string& filename) const {
+  std::ofstream out_stream(filename, std::ios::binary);
+  if (!out_stream) {
+    IEX_LOG("Cannot open " << filename << " for writing.");
+    return false;
+  }
+
+  // Sort the directory by symbol, which for the space padded wire format is a byte comparison.
+  std::vector<SymbolStoreEntry> entries;
+  std::vector<const SymbolMessages*> symbol_messages;
+  for (const auto& symbol : symbols_) {
+    SymbolStoreEntry entry;
+    std::memcpy(entry.symbol, &symbol.first, sizeof(entry.symbol));
+    entries.push_back(entry);
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const SymbolStoreEntry& lhs, const SymbolStoreEntry& rhs) {
+              return std::memcmp(lhs.symbol, rhs.symbol, sizeof(lhs.symbol)) < 0;
+            });
+
+  // The input is almost sorted (a few inversions within a day), stable keeps the feed order.
+  std::vector<std::vector<MessageRef>> sorted_refs(entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const SymbolMessages& messages =
+        symbols_.at(GetNumeric<uint64_t>(reinterpret_cast<const uint8_t*>(entries[i].symbol), 0));
+    symbol_messages.push_back(&messages);
+    sorted_refs[i] = messages.refs;
+    std::stable_sort(sorted_refs[i].begin(), sorted_refs[i].end(),
+                     [](const MessageRef& lhs, const MessageRef& rhs) {
+                       return lhs.timestamp < rhs.timestamp;
+                     });
+  }
+
+  SymbolStoreHeader header;
+  std::memcpy(header.magic, store_magic, sizeof(header.magic));
+  header.num_entries = entries.size();
+  header.num_messages = num_messages_;
+  header.directory_offset = sizeof(header);
+  uint64_t data_offset = header.directory_offset + entries.size() * sizeof(SymbolStoreEntry);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    entries[i].data_offset = data_offset;
+    entries[i].data_len = symbol_messages[i]->blocks.size();
+    entries[i].num_messages = sorted_refs[i].size();
+    entries[i].first_timestamp = sorted_refs[i].front().timestamp;
+    entries[i].last_timestamp = sorted_refs[i].back().timestamp;
+    data_offset += entries[i].data_len;
+  }
+  out_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out_stream.write(reinterpret_cast<const char*>(entries.data()),
+                   entries.size() * sizeof(SymbolStoreEntry));
+
+  std::vector<uint8_t> sorted_blocks;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const std::vector<uint8_t>& blocks = symbol_messages[i]->blocks;
+    sorted_blocks.clear();
+    for (const auto& ref : sorted_refs[i]) {
+      const uint8_t* block_ptr = &blocks[ref.block_offset];
+      sorted_blocks.insert(sorted_blocks.end(), block_ptr,
+                           block_ptr + 2 + IEXDecoder::GetBlockSize(block_ptr));
+    }
+    out_stream.write(reinterpret_cast<const char*>(sorted_blocks.data()), sorted_blocks.size());
+  }
+  return static_cast<bool>(out_stream);
+}
+
+bool SymbolStoreReader::Open(const std::string& filename) {
+  Close();
+  if (!file_.Open(filename)) {
+    return false;
+  }
+  // Offsets and lengths are compared with what is left of the file, so they cannot wrap around.
+  const uint64_t file_size = file_.GetSize();
+  const auto* header = reinterpret_cast<const SymbolStoreHeader*>(file_.GetData());
+  if (file_size < sizeof(SymbolStoreHeader) ||
+      std::memcmp(header->magic, store_magic, sizeof(store_magic)) != 0 ||
+      header->directory_offset > file_size ||
+      header->num_entries > (file_size - header->directory_offset) / sizeof(SymbolStoreEntry)) {
+    IEX_LOG(filename << " is not a symbol store file.");
+    Close();
+    return false;
+  }
+  entries_ =
+      reinterpret_cast<const SymbolStoreEntry*>(file_.GetData() + header->directory_offset);
+  num_entries_ = header->num_entries;
+  for (size_t i = 0; i < num_entries_; ++i) {
+    if (entries_[i].data_offset > file_size ||
+        entries_[i].data_len > file_size - entries_[i].data_offset) {
+      IEX_LOG(filename << " is truncated.");
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void SymbolStoreReader::Close() {
+  file_.Close();
+  entries_ = nullptr;
+  num_entries_ = 0;
+}
+
+SymbolSpan SymbolStoreReader::GetSymbol(const std::string& symbol) const {
+  SymbolStoreEntry key;
+  PutString(reinterpret_cast<uint8_t*>(key.symbol), 0, symbol_field_len, symbol);
+  const SymbolStoreEntry* entries_end = entries_ + num_entries_;
+  const SymbolStoreEntry* entry_ptr = std::lower_bound(
+      entries_, entries_end, key, [](const SymbolStoreEntry& lhs, const SymbolStoreEntry& rhs) {
+        return std::memcmp(lhs.symbol, rhs.symbol, sizeof(lhs.symbol)) < 0;
+      });
+
+  SymbolSpan span;
+  if (entry_ptr == entries_end ||
+      std::memcmp(entry_ptr->symbol, key.symbol, sizeof(key.symbol)) != 0) {
+    return span;
+  }
+  span.data = file_.GetData() + entry_ptr->data_offset;
+  span.len = entry_ptr->data_len;
+  span.num_messages = entry_ptr->num_messages;
+  span.first_timestamp = entry_ptr->first_timestamp;
+  span.last_timestamp = entry_ptr->last_timestamp;
+  file_.WillNeed(span.data, span.len);
+  return span;
+}
+
+std::vector<std::string> SymbolStoreReader::GetSymbols() const {
+  std::vector<std::string> symbols;
+  symbols.reserve(num_entries_);
+  for (size_t i = 0; i < num_entries_; ++i) {
+    symbols.push_back(
+        GetString(reinterpret_cast<const uint8_t*>(entries_[i].symbol), 0, symbol_field_len));
+  }
+  return symbols;
+}
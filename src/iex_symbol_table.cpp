@@ -0,0 +1,44 @@
+#include "iex_symbol_table.h"
+
+constexpr uint32_t SymbolTable::npos;
+
+SymbolTable::SymbolTable(const size_t expected_symbols) {
+  Rehash(expected_symbols);
+  symbols_.reserve(expected_symbols);
+}
+
+std::string SymbolTable::GetSymbol(const uint32_t id) const {
+  return GetString(reinterpret_cast<const uint8_t*>(&symbols_[id]), 0, symbol_field_len);
+}
+
+uint32_t SymbolTable::Add(const size_t slot, const uint64_t packed_symbol) {
+  const uint32_t id = static_cast<uint32_t>(symbols_.size());
+  symbols_.push_back(packed_symbol);
+  keys_[slot] = packed_symbol;
+  ids_[slot] = id;
+  if (2 * symbols_.size() > keys_.size()) {
+    Rehash(symbols_.size() * 2);
+  }
+  return id;
+}
+
+void SymbolTable::Rehash(const size_t min_symbols) {
+  size_t num_slots = 16;
+  int shift = 60;
+  while (num_slots < 2 * min_symbols) {
+    num_slots *= 2;
+    --shift;
+  }
+  keys_.assign(num_slots, 0);
+  ids_.assign(num_slots, 0);
+  mask_ = num_slots - 1;
+  shift_ = shift;
+  for (uint32_t id = 0; id < symbols_.size(); ++id) {
+    size_t slot = GetSlot(symbols_[id]);
+    while (keys_[slot] != 0) {
+      slot = (slot + 1) & mask_;
+    }
+    keys_[slot] = symbols_[id];
+    ids_[slot] = id;
+  }
+}
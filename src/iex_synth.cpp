@@ -0,0 +1,57 @@
+#include "iex_synthetic.h"
+
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cout << "Usage: iex_synth <output_pcap> <tops|deep> [num_messages] [num_symbols] "
+                 "[price_level_churn] [seed]"
+              << std::endl;
+    return 1;
+  }
+
+  SyntheticConfig config;
+  const std::string protocol(argv[2]);
+  if (protocol == "tops") {
+    config.protocol = ProtocolId::TOPS;
+  } else if (protocol == "deep") {
+    config.protocol = ProtocolId::DEEP;
+  } else {
+    std::cout << "Unknown protocol '" << protocol << "', expected tops or deep." << std::endl;
+    return 1;
+  }
+
+  try {
+    if (argc > 3) {
+      config.num_messages = std::stoull(argv[3]);
+    }
+    if (argc > 4) {
+      config.num_symbols = std::stoull(argv[4]);
+    }
+    if (argc > 5) {
+      config.price_level_churn = std::stod(argv[5]);
+    }
+    if (argc > 6) {
+      config.seed = std::stoull(argv[6]);
+    }
+  } catch (...) {
+    std::cout << "Invalid numeric argument." << std::endl;
+    return 1;
+  }
+
+  if (config.num_symbols == 0) {
+    std::cout << "At least one symbol is required." << std::endl;
+    return 1;
+  }
+
+  SyntheticFeedGenerator generator(config);
+  if (!generator.WriteToFile(argv[1])) {
+    std::cout << "Failed to write '" << argv[1] << "'." << std::endl;
+    return 1;
+  }
+
+  std::cout << "Wrote " << generator.GetMessageCount() << " messages in "
+            << generator.GetPacketCount() << " packets to '" << argv[1] << "'." << std::endl;
+  return 0;
+}
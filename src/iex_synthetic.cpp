@@ -0,0 +1,348 @@
+#include "iex_synthetic.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "iex_packet_builder.h"
+
+namespace {
+/// \brief One cent, in the 1/10000 of a dollar units of IEX prices.
+constexpr int64_t tick = 100;
+
+/// \brief Packs messages into packets with an IEXTPPacketBuilder, and sends them with realistic
+///        send and capture times.
+class IEXTPStreamWriter {
+ public:
+  IEXTPStreamWriter(const SyntheticConfig& config, IEXTPPcapWriter& writer, std::mt19937_64& rng)
+      : writer_(writer),
+        rng_(rng),
+        builder_(static_cast<uint16_t>(config.protocol), config.channel_id, config.session_id,
+                 config.max_payload_len) {}
+
+  /// \brief Append a message, sending the current packet first if it would not fit.
+  bool AddMessage(const IEXMessageBase& msg) {
+    if (!builder_.AddMessage(msg)) {
+      if (!Flush() || !builder_.AddMessage(msg)) {
+        return false;
+      }
+    }
+    last_timestamp_ = std::max<int64_t>(last_timestamp_, msg.timestamp);
+    return true;
+  }
+
+  /// \brief Send the current packet. Without any messages this sends a heartbeat.
+  bool Flush() {
+    // Send a few microseconds after the last message, capture some time after that.
+    std::uniform_int_distribution<int64_t> send_delay(500, 5000);
+    std::uniform_int_distribution<int64_t> wire_delay(5000, 50000);
+    const int64_t send_time = last_timestamp_ + send_delay(rng_);
+    const int64_t capture_time = send_time + wire_delay(rng_);
+
+    const size_t payload_len = builder_.Finish(send_time);
+    if (!writer_.WritePacket(builder_.GetData(), payload_len, capture_time)) {
+      return false;
+    }
+    builder_.StartNextPacket();
+    last_timestamp_ = send_time;
+    return true;
+  }
+
+  inline void SetTime(const int64_t timestamp) { last_timestamp_ = timestamp; }
+
+  inline uint64_t GetPacketCount() const { return writer_.GetPacketCount(); }
+
+ private:
+  IEXTPPcapWriter& writer_;
+  std::mt19937_64& rng_;
+  IEXTPPacketBuilder builder_;
+  int64_t last_timestamp_ = 0;
+};
+
+/// \brief A short, unique, upper case ticker for a symbol index.
+std::string MakeSymbol(size_t idx) {
+  std::string symbol;
+  idx += 26 * 26 * 26;
+  while (idx > 0) {
+    symbol.insert(symbol.begin(), static_cast<char>('A' + idx % 26));
+    idx /= 26;
+  }
+  return symbol;
+}
+}  // namespace
+
+SyntheticFeedGenerator::SyntheticFeedGenerator(const SyntheticConfig& config)
+    : config_(config), rng_(config.seed) {
+  std::uniform_int_distribution<int64_t> initial_price(5, 500);
+  for (size_t i = 0; i < config_.num_symbols; ++i) {
+    SymbolState state;
+    state.symbol = MakeSymbol(i);
+    state.mid_price = initial_price(rng_) * 10000;
+    symbols_.push_back(state);
+  }
+}
+
+int SyntheticFeedGenerator::RandomSize() {
+  std::geometric_distribution<int> round_lots(0.3);
+  return 100 * (1 + round_lots(rng_));
+}
+
+void SyntheticFeedGenerator::MoveMidPrice(SymbolState& state) {
+  std::uniform_int_distribution<int> step(-2, 2);
+  state.mid_price = std::max<int64_t>(state.mid_price + step(rng_) * tick, 10 * tick);
+}
+
+const IEXMessageBase& SyntheticFeedGenerator::GenerateQuote(SymbolState& state,
+                                                            const int64_t timestamp) {
+  MoveMidPrice(state);
+  std::uniform_int_distribution<int> half_spread(1, 3);
+  QuoteUpdateMessage& msg = quote_;
+  msg.flags = 0;
+  msg.timestamp = timestamp;
+  msg.symbol = state.symbol;
+  msg.bid_size = RandomSize();
+  msg.bid_price = (state.mid_price - half_spread(rng_) * tick) / 10000.0;
+  msg.ask_size = RandomSize();
+  msg.ask_price = (state.mid_price + half_spread(rng_) * tick) / 10000.0;
+  return msg;
+}
+
+const IEXMessageBase& SyntheticFeedGenerator::GenerateTrade(SymbolState& state,
+                                                            const int64_t timestamp) {
+  std::uniform_int_distribution<int> offset(-1, 1);
+  TradeReportMessage& msg = trade_;
+  msg.flags = 0;
+  msg.timestamp = timestamp;
+  msg.symbol = state.symbol;
+  msg.size = RandomSize();
+  msg.price = (state.mid_price + offset(rng_) * tick) / 10000.0;
+  msg.trade_id = next_trade_id_++;
+  return msg;
+}
+
+const IEXMessageBase& SyntheticFeedGenerator::GenerateAuction(SymbolState& state,
+                                                              const int64_t timestamp) {
+  std::bernoulli_distribution is_buy(0.5);
+  const double reference_price = state.mid_price / 10000.0;
+  AuctionInformationMessage& msg = auction_;
+  msg.auction_type = AuctionInformationMessage::AuctionType::ClosingAuction;
+  msg.timestamp = timestamp;
+  msg.symbol = state.symbol;
+  msg.paired_shares = RandomSize() * 10;
+  msg.reference_price = reference_price;
+  msg.indicative_clearing_price = reference_price;
+  msg.imbalance_shares = RandomSize();
+  msg.imbalance_side = is_buy(rng_) ? AuctionInformationMessage::ImbalanceSide::BuySideImbalance
+                                    : AuctionInformationMessage::ImbalanceSide::SellSideImbalance;
+  msg.extension_number = 0;
+  msg.scheduled_auction_time =
+      static_cast<int>((config_.start_time + config_.session_duration) / 1000000000);
+  msg.auction_book_clearing_price = reference_price;
+  msg.collar_reference_price = reference_price;
+  msg.lower_auction_collar = reference_price * 0.9;
+  msg.upper_auction_collar = reference_price * 1.1;
+  return msg;
+}
+
+const IEXMessageBase& SyntheticFeedGenerator::GeneratePriceLevelUpdate(SymbolState& state,
+                                                                       const int64_t timestamp) {
+  std::bernoulli_distribution is_buy(0.5);
+  std::bernoulli_distribution is_churn(config_.price_level_churn);
+  // WriteToFile checks there is at least one level, cap the count so doubling it fits an int.
+  std::uniform_int_distribution<int> distance(
+      1, static_cast<int>(std::min<size_t>(config_.max_price_levels, 1 << 20)) * 2);
+
+  const bool buy_side = is_buy(rng_);
+  auto& levels = buy_side ? state.bids : state.asks;
+  // Only used on a side with levels, the bound just must not wrap around on an empty one.
+  std::uniform_int_distribution<size_t> pick(0, levels.empty() ? 0 : levels.size() - 1);
+  int64_t price = 0;
+  int size = 0;
+  if (levels.empty() || is_churn(rng_)) {
+    // Add a level when there is room (and always to an empty book), otherwise remove one.
+    std::bernoulli_distribution add_level(0.5);
+    if (levels.empty() || (levels.size() < config_.max_price_levels && add_level(rng_))) {
+      MoveMidPrice(state);
+      const int64_t offset = distance(rng_) * tick;
+      price = buy_side ? state.mid_price - offset : state.mid_price + offset;
+      size = RandomSize();
+      auto it = std::find_if(levels.begin(), levels.end(),
+                             [price](const std::pair<int64_t, int>& level) {
+                               return level.first == price;
+                             });
+      if (it == levels.end()) {
+        levels.emplace_back(price, size);
+      } else {
+        it->second = size;
+      }
+    } else {
+      const size_t idx = pick(rng_);
+      price = levels[idx].first;
+      levels.erase(levels.begin() + idx);
+    }
+  } else {
+    auto& level = levels[pick(rng_)];
+    level.second = RandomSize();
+    price = level.first;
+    size = level.second;
+  }
+
+  PriceLevelUpdateMessage& msg = buy_side ? buy_level_update_ : sell_level_update_;
+  // Each update is its own event, so the event processing complete flag is always set.
+  msg.flags = 1;
+  msg.timestamp = timestamp;
+  msg.symbol = state.symbol;
+  msg.size = size;
+  msg.price = price / 10000.0;
+  return msg;
+}
+
+const IEXMessageBase& SyntheticFeedGenerator::GenerateBodyMessage(const int64_t timestamp) {
+  // Activity is concentrated in a few popular symbols, as in the real feed.
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const double u = uniform(rng_);
+  auto& state = symbols_[static_cast<size_t>(u * u * u * symbols_.size()) % symbols_.size()];
+
+  const double msg_kind = uniform(rng_);
+  if (config_.protocol == ProtocolId::DEEP) {
+    if (msg_kind < 0.90) {
+      return GeneratePriceLevelUpdate(state, timestamp);
+    } else if (msg_kind < 0.99) {
+      return GenerateTrade(state, timestamp);
+    }
+    return GenerateAuction(state, timestamp);
+  }
+  if (msg_kind < 0.85) {
+    return GenerateQuote(state, timestamp);
+  } else if (msg_kind < 0.99) {
+    return GenerateTrade(state, timestamp);
+  }
+  return GenerateAuction(state, timestamp);
+}
+
+bool SyntheticFeedGenerator::WriteToFile(const std::string& filename) {
+  messages_written_ = 0;
+  packets_written_ = 0;
+  if (symbols_.empty()) {
+    IEX_LOG("The synthetic feed needs at least one symbol.");
+    return false;
+  }
+  if (config_.protocol == ProtocolId::DEEP && config_.max_price_levels == 0) {
+    IEX_LOG("A synthetic DEEP feed needs at least one price level per side.");
+    return false;
+  }
+  if (!(config_.price_level_churn >= 0 && config_.price_level_churn <= 1)) {
+    IEX_LOG("The price level churn must be a probability, within [0, 1].");
+    return false;
+  }
+
+  IEXTPPcapWriter writer;
+  if (!writer.Open(filename)) {
+    return false;
+  }
+  IEXTPStreamWriter stream(config_, writer, rng_);
+  int64_t timestamp = config_.start_time;
+  auto add_message = [&](const IEXMessageBase& msg) {
+    ++messages_written_;
+    return stream.AddMessage(msg);
+  };
+
+  // Like the real files, start with a packet containing only the header.
+  stream.SetTime(timestamp);
+  bool success = stream.Flush();
+
+  // Start of day.
+  SystemEventMessage system_event;
+  system_event.timestamp = timestamp;
+  system_event.system_event = SystemEventMessage::Code::StartOfMessage;
+  success = success && add_message(system_event);
+  system_event.system_event = SystemEventMessage::Code::StartOfSystemHours;
+  success = success && add_message(system_event);
+  for (const auto& state : symbols_) {
+    SecurityDirectoryMessage directory;
+    directory.flags = 0x80;
+    directory.timestamp = ++timestamp;
+    directory.symbol = state.symbol;
+    directory.round_lot_size = 100;
+    directory.adjusted_POC_price = state.mid_price / 10000.0;
+    directory.LULD_tier = SecurityDirectoryMessage::LULDTier::Tier1NMSStock;
+    success = success && add_message(directory);
+
+    TradingStatusMessage trading_status;
+    trading_status.trading_status = TradingStatusMessage::Status::Trading;
+    trading_status.timestamp = ++timestamp;
+    trading_status.symbol = state.symbol;
+    trading_status.reason = "";
+    success = success && add_message(trading_status);
+  }
+  system_event.timestamp = ++timestamp;
+  system_event.system_event = SystemEventMessage::Code::StartOfRegularMarketHours;
+  success = success && add_message(system_event);
+  const bool is_deep = config_.protocol == ProtocolId::DEEP;
+  SecurityEventMessage security_event(MessageType::SecurityEvent);
+  for (size_t i = 0; is_deep && i < symbols_.size(); ++i) {
+    security_event.security_event =
+        SecurityEventMessage::SecurityMessageType::OpeningProcessComplete;
+    security_event.timestamp = ++timestamp;
+    security_event.symbol = symbols_[i].symbol;
+    success = success && add_message(security_event);
+  }
+  success = success && stream.Flush();
+
+  // The trading day. Messages arrive in bursts (events) of a few messages each, every event is
+  // sent in its own packet unless it does not fit.
+  const uint64_t num_end_of_day = (is_deep ? 2 : 1) * symbols_.size() + 3;
+  const uint64_t num_body = config_.num_messages > messages_written_ + num_end_of_day
+                                ? config_.num_messages - messages_written_ - num_end_of_day
+                                : 0;
+  const double mean_gap =
+      static_cast<double>(config_.session_duration) / std::max<uint64_t>(num_body, 1);
+  std::geometric_distribution<int> event_size(0.5);
+  std::exponential_distribution<double> event_gap(1.0);
+  std::uniform_int_distribution<int64_t> intra_event_gap(1, 50);
+  uint64_t num_written = 0;
+  while (success && num_written < num_body) {
+    const uint64_t num_in_event = std::min<uint64_t>(1 + event_size(rng_), num_body - num_written);
+    timestamp += static_cast<int64_t>(event_gap(rng_) * mean_gap * num_in_event) + 1;
+    for (uint64_t i = 0; i < num_in_event && success; ++i) {
+      timestamp += intra_event_gap(rng_);
+      success = add_message(GenerateBodyMessage(timestamp));
+    }
+    num_written += num_in_event;
+    success = success && stream.Flush();
+  }
+
+  // End of day.
+  for (const auto& state : symbols_) {
+    OfficialPriceMessage official_price;
+    official_price.price_type = OfficialPriceMessage::PriceType::ClosingPrice;
+    official_price.timestamp = ++timestamp;
+    official_price.symbol = state.symbol;
+    official_price.price = state.mid_price / 10000.0;
+    success = success && add_message(official_price);
+    if (is_deep) {
+      security_event.security_event =
+          SecurityEventMessage::SecurityMessageType::ClosingProcessComplete;
+      security_event.timestamp = ++timestamp;
+      security_event.symbol = state.symbol;
+      success = success && add_message(security_event);
+    }
+  }
+  for (auto code : {SystemEventMessage::Code::EndOfRegularMarketHours,
+                    SystemEventMessage::Code::EndOfSystemHours,
+                    SystemEventMessage::Code::EndOfMessages}) {
+    system_event.timestamp = ++timestamp;
+    system_event.system_event = code;
+    success = success && add_message(system_event);
+  }
+  success = success && stream.Flush();
+
+  // A final heartbeat, carrying the next sequence number and the total stream length.
+  success = success && stream.Flush();
+
+  packets_written_ = stream.GetPacketCount();
+  writer.Close();
+  if (!success) {
+    IEX_LOG("Failed writing to " << filename << ".");
+  }
+  return success;
+}
@@ -0,0 +1,276 @@
+#include "iex_volume_profile.h"
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include "iex_mapped_file.h"
+#include "iex_work_stealing_pool.h"
+
+namespace {
+/// \brief Identifies volume profile files, and their format version.
+constexpr char profile_magic[8] = {'I', 'E', 'X', 'V', 'A', 'P', '0', '1'};
+
+/// \brief The file header, followed by the symbol directory, then num_entries volumes and
+///        num_entries resting depths.
+struct VolumeProfileHeader {
+  char magic[sizeof(profile_magic)];
+  int64_t tick_size;
+  uint64_t num_symbols;
+  uint64_t num_entries;
+};
+
+/// \brief One symbol in the directory. Its ticks are first_tick, first_tick + 1, ... and their
+///        values start at entry_offset in both arrays.
+struct VolumeProfileEntry {
+  uint64_t packed_symbol;
+  int64_t first_tick;
+  uint64_t entry_offset;
+  uint64_t num_ticks;
+};
+
+/// \brief Count the shares resting at every level of one side of a book up to end_time.
+void CloseBookSide(const TickLadder<uint32_t>& sizes, const TickLadder<int64_t>& times,
+                   const int64_t end_time, TickLadder<double>& resting_depth) {
+  for (int64_t tick = sizes.GetFirstTick(); tick < sizes.GetEndTick(); ++tick) {
+    const uint32_t size = sizes.Get(tick);
+    if (size > 0) {
+      resting_depth.At(tick) += size * ((end_time - times.Get(tick)) * 1e-9);
+    }
+  }
+}
+}  // namespace
+
+SymbolProfile& VolumeProfile::GetOrAddProfile(const uint64_t packed_symbol) {
+  const uint32_t id = symbol_table_.GetOrAdd(packed_symbol);
+  if (id >= profiles_.size()) {
+    profiles_.resize(id + 1);
+  }
+  return profiles_[id];
+}
+
+void VolumeProfile::OnPriceLevelUpdate(const PriceLevelUpdateMessage& msg) {
+  SymbolProfile& profile = GetOrAddProfile(PackSymbol(msg.symbol));
+  const bool is_buy = msg.GetMessageType() == MessageType::PriceLevelUpdateBuy;
+  const int64_t tick = GetTick(msg.price);
+  TickLadder<uint32_t>& sizes = is_buy ? profile.bid_sizes : profile.ask_sizes;
+  if (sizes.GetSpanWith(tick) > config_.max_ticks ||
+      profile.resting_depth.GetSpanWith(tick) > config_.max_ticks) {
+    ++num_dropped_messages_;
+    return;
+  }
+  uint32_t& size = sizes.At(tick);
+  int64_t& time = (is_buy ? profile.bid_times : profile.ask_times).At(tick);
+  const int64_t timestamp = static_cast<int64_t>(msg.timestamp);
+  // Touched even at zero, so every level in the books stays within the span checked above.
+  profile.resting_depth.At(tick) += size * ((timestamp - time) * 1e-9);
+  size = static_cast<uint32_t>(msg.size);
+  time = timestamp;
+}
+
+void VolumeProfile::OnMessage(const IEXMessageBase& msg) {
+  // Without a valid tick size nothing can be binned, AddFile reports it.
+  if (config_.tick_size <= 0) {
+    return;
+  }
+  switch (msg.GetMessageType()) {
+    case MessageType::TradeReport: {
+      const auto& trade_msg = static_cast<const TradeReportMessage&>(msg);
+      TickLadder<uint64_t>& volume = GetOrAddProfile(PackSymbol(trade_msg.symbol)).volume;
+      const int64_t tick = GetTick(trade_msg.price);
+      if (volume.GetSpanWith(tick) > config_.max_ticks) {
+        ++num_dropped_messages_;
+        break;
+      }
+      volume.At(tick) += static_cast<uint64_t>(trade_msg.size);
+      break;
+    }
+    case MessageType::PriceLevelUpdateBuy:
+    case MessageType::PriceLevelUpdateSell:
+      OnPriceLevelUpdate(static_cast<const PriceLevelUpdateMessage&>(msg));
+      break;
+    default:
+      break;
+  }
+}
+
+void VolumeProfile::CloseSession(const int64_t end_time) {
+  for (auto& profile : profiles_) {
+    CloseBookSide(profile.bid_sizes, profile.bid_times, end_time, profile.resting_depth);
+    CloseBookSide(profile.ask_sizes, profile.ask_times, end_time, profile.resting_depth);
+    profile.bid_sizes.Assign(0, {});
+    profile.ask_sizes.Assign(0, {});
+    profile.bid_times.Assign(0, {});
+    profile.ask_times.Assign(0, {});
+  }
+}
+
+ReturnCode VolumeProfile::AddFile(const std::string& filename) {
+  if (config_.tick_size <= 0) {
+    IEX_LOG("The tick size must be positive, got " << config_.tick_size << ".");
+    return ReturnCode::ClassNotInitialized;
+  }
+  IEXDecoder decoder;
+  if (!decoder.OpenFileForDecoding(filename)) {
+    return ReturnCode::ClassNotInitialized;
+  }
+  MessageFilter filter;
+  filter.SetTypes({MessageType::TradeReport, MessageType::PriceLevelUpdateBuy,
+                   MessageType::PriceLevelUpdateSell});
+  decoder.SetFilter(filter);
+
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  auto ret_code = ReturnCode::Success;
+  int64_t last_timestamp = 0;
+  while ((ret_code = decoder.GetNextMessage(msg_ptr)) == ReturnCode::Success) {
+    OnMessage(*msg_ptr);
+    last_timestamp = std::max(last_timestamp, static_cast<int64_t>(msg_ptr->timestamp));
+  }
+  CloseSession(last_timestamp);
+  return ret_code == ReturnCode::EndOfStream ? ReturnCode::Success : ret_code;
+}
+
+bool VolumeProfile::AddFiles(const std::vector<std::string>& filenames) {
+  if (filenames.empty()) {
+    return true;
+  }
+  std::vector<std::unique_ptr<VolumeProfile>> parts(filenames.size());
+  std::vector<ReturnCode> ret_codes(filenames.size(), ReturnCode::Success);
+  WorkStealingPool pool(config_.num_threads);
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    pool.Submit([this, i, &filenames, &parts, &ret_codes]() {
+      parts[i].reset(new VolumeProfile(config_));
+      ret_codes[i] = parts[i]->AddFile(filenames[i]);
+    });
+  }
+  pool.Wait();
+
+  bool success = true;
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    if (ret_codes[i] != ReturnCode::Success) {
+      IEX_LOG("Failed to read " << filenames[i] << ": " << ReturnCodeToString(ret_codes[i]));
+      parts[i].reset(new VolumeProfile(config_));
+      success = false;
+    }
+  }
+
+  // Merge pairwise, halving the number of profiles every round.
+  for (size_t stride = 1; stride < parts.size(); stride *= 2) {
+    for (size_t i = 0; i + stride < parts.size(); i += 2 * stride) {
+      pool.Submit([i, stride, &parts]() {
+        parts[i]->Merge(*parts[i + stride]);
+        parts[i + stride].reset();
+      });
+    }
+    pool.Wait();
+  }
+  Merge(*parts[0]);
+  return success;
+}
+
+void VolumeProfile::Merge(const VolumeProfile& other) {
+  if (other.config_.tick_size != config_.tick_size) {
+    IEX_LOG("Cannot merge profiles with tick sizes " << config_.tick_size << " and "
+                                                     << other.config_.tick_size);
+    return;
+  }
+  for (uint32_t id = 0; id < other.profiles_.size(); ++id) {
+    SymbolProfile& profile = GetOrAddProfile(other.symbol_table_.GetPacked(id));
+    profile.volume.Add(other.profiles_[id].volume);
+    profile.resting_depth.Add(other.profiles_[id].resting_depth);
+  }
+  num_dropped_messages_ += other.num_dropped_messages_;
+}
+
+bool VolumeProfile::Save(const std::string& filename) const {
+  std::vector<VolumeProfileEntry> entries(profiles_.size());
+  uint64_t num_entries = 0;
+  for (uint32_t id = 0; id < profiles_.size(); ++id) {
+    int64_t first_volume = 0, end_volume = 0, first_depth = 0, end_depth = 0;
+    profiles_[id].volume.GetUsedRange(first_volume, end_volume);
+    profiles_[id].resting_depth.GetUsedRange(first_depth, end_depth);
+    int64_t first_tick = first_volume < end_volume ? first_volume : first_depth;
+    int64_t end_tick = first_volume < end_volume ? end_volume : end_depth;
+    if (first_volume < end_volume && first_depth < end_depth) {
+      first_tick = std::min(first_volume, first_depth);
+      end_tick = std::max(end_volume, end_depth);
+    }
+    entries[id].packed_symbol = symbol_table_.GetPacked(id);
+    entries[id].first_tick = first_tick;
+    entries[id].entry_offset = num_entries;
+    entries[id].num_ticks = static_cast<uint64_t>(end_tick - first_tick);
+    num_entries += entries[id].num_ticks;
+  }
+
+  std::ofstream out_stream(filename, std::ios::binary);
+  if (!out_stream) {
+    IEX_LOG("Cannot open " << filename << " for writing.");
+    return false;
+  }
+  VolumeProfileHeader header;
+  std::memcpy(header.magic, profile_magic, sizeof(header.magic));
+  header.tick_size = config_.tick_size;
+  header.num_symbols = entries.size();
+  header.num_entries = num_entries;
+  out_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out_stream.write(reinterpret_cast<const char*>(entries.data()),
+                   entries.size() * sizeof(VolumeProfileEntry));
+
+  std::vector<uint64_t> volumes;
+  std::vector<double> depths;
+  volumes.reserve(num_entries);
+  depths.reserve(num_entries);
+  for (uint32_t id = 0; id < profiles_.size(); ++id) {
+    const int64_t end_tick = entries[id].first_tick + static_cast<int64_t>(entries[id].num_ticks);
+    for (int64_t tick = entries[id].first_tick; tick < end_tick; ++tick) {
+      volumes.push_back(profiles_[id].volume.Get(tick));
+      depths.push_back(profiles_[id].resting_depth.Get(tick));
+    }
+  }
+  out_stream.write(reinterpret_cast<const char*>(volumes.data()),
+                   volumes.size() * sizeof(uint64_t));
+  out_stream.write(reinterpret_cast<const char*>(depths.data()), depths.size() * sizeof(double));
+  return static_cast<bool>(out_stream);
+}
+
+bool VolumeProfile::Load(const std::string& filename) {
+  MappedFile file;
+  if (!file.Open(filename)) {
+    return false;
+  }
+  const auto* header = reinterpret_cast<const VolumeProfileHeader*>(file.GetData());
+  if (file.GetSize() < sizeof(VolumeProfileHeader) ||
+      std::memcmp(header->magic, profile_magic, sizeof(profile_magic)) != 0 ||
+      header->tick_size <= 0 ||
+      sizeof(VolumeProfileHeader) + header->num_symbols * sizeof(VolumeProfileEntry) +
+              header->num_entries * (sizeof(uint64_t) + sizeof(double)) >
+          file.GetSize()) {
+    IEX_LOG(filename << " is not a volume profile file.");
+    return false;
+  }
+  const auto* entries =
+      reinterpret_cast<const VolumeProfileEntry*>(file.GetData() + sizeof(VolumeProfileHeader));
+  const auto* volumes = reinterpret_cast<const uint64_t*>(entries + header->num_symbols);
+  const auto* depths = reinterpret_cast<const double*>(volumes + header->num_entries);
+  for (size_t i = 0; i < header->num_symbols; ++i) {
+    if (entries[i].entry_offset + entries[i].num_ticks > header->num_entries) {
+      IEX_LOG(filename << " is corrupt.");
+      return false;
+    }
+  }
+
+  config_.tick_size = header->tick_size;
+  symbol_table_ = SymbolTable(header->num_symbols);
+  profiles_.clear();
+  for (size_t i = 0; i < header->num_symbols; ++i) {
+    const VolumeProfileEntry& entry = entries[i];
+    SymbolProfile& profile = GetOrAddProfile(entry.packed_symbol);
+    const uint64_t* volume_ptr = volumes + entry.entry_offset;
+    const double* depth_ptr = depths + entry.entry_offset;
+    profile.volume.Assign(entry.first_tick,
+                          std::vector<uint64_t>(volume_ptr, volume_ptr + entry.num_ticks));
+    profile.resting_depth.Assign(entry.first_tick,
+                                 std::vector<double>(depth_ptr, depth_ptr + entry.num_ticks));
+  }
+  return true;
+}
@@ -0,0 +1,121 @@
+#include "iex_work_stealing_pool.h"
+
+#include <algorithm>
+
+namespace {
+/// \brief Index of the pool worker running on this thread, or -1 for outside threads.
+thread_local int current_worker_idx = -1;
+thread_local const WorkStealingPool* current_pool = nullptr;
+}  // namespace
+
+WorkStealingPool::WorkStealingPool(size_t num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    queues_.emplace_back(new WorkerQueue());
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  Wait();
+  {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    stop_ = true;
+  }
+  work_available_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkStealingPool::Submit(Task task) {
+  // Tasks spawned from a worker stay local to that worker, others are spread round robin.
+  size_t queue_idx;
+  if (current_pool == this) {
+    queue_idx = current_worker_idx;
+  } else {
+    queue_idx = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+  }
+
+  pending_.fetch_add(1, std::memory_order_acq_rel);
+  {
+    std::lock_guard<std::mutex> lock(queues_[queue_idx]->mutex);
+    queues_[queue_idx]->tasks.push_back(std::move(task));
+  }
+  {
+    // Taking the idle lock ensures a worker about to sleep cannot miss this notification.
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+  }
+  work_available_.notify_one();
+}
+
+void WorkStealingPool::Wait() {
+  std::unique_lock<std::mutex> lock(idle_mutex_);
+  all_done_.wait(lock, [this] { return pending_.load(std::memory_order_acquire) == 0; });
+}
+
+bool WorkStealingPool::TryGetTask(const size_t worker_idx, Task& task) {
+  {
+    auto& own_queue = *queues_[worker_idx];
+    std::lock_guard<std::mutex> lock(own_queue.mutex);
+    if (!own_queue.tasks.empty()) {
+      task = std::move(own_queue.tasks.back());
+      own_queue.tasks.pop_back();
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues_.size(); ++i) {
+    auto& victim_queue = *queues_[(worker_idx + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(victim_queue.mutex);
+    if (!victim_queue.tasks.empty()) {
+      task = std::move(victim_queue.tasks.front());
+      victim_queue.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::WorkerLoop(const size_t worker_idx) {
+  current_worker_idx = static_cast<int>(worker_idx);
+  current_pool = this;
+
+  Task task;
+  while (true) {
+    if (TryGetTask(worker_idx, task)) {
+      task();
+      task = nullptr;
+      if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        all_done_.notify_all();
+      }
+      continue;
+    }
+
+    // Nothing to run or steal. Sleep until a task is submitted, re-checking under the lock so a
+    // submission between the failed steal and the wait is not lost.
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    if (stop_) {
+      break;
+    }
+    work_available_.wait(lock, [this] {
+      if (stop_) {
+        return true;
+      }
+      for (const auto& queue : queues_) {
+        std::lock_guard<std::mutex> queue_lock(queue->mutex);
+        if (!queue->tasks.empty()) {
+          return true;
+        }
+      }
+      return false;
+    });
+    if (stop_) {
+      break;
+    }
+  }
+}
@@ -1,11 +1,46 @@
 #include <iostream>
+#include <iterator>
 #include "gtest/gtest.h"
 
+#include "iex_auction.h"
+#include "iex_batch.h"
+#include "iex_broadcast.h"
+#include "iex_catalog.h"
+#include "iex_decode_cache.h"
 #include "iex_decoder.h"
+#include "iex_histogram.h"
+#include "iex_latency.h"
+#include "iex_merged_decoder.h"
+#include "iex_message_table.h"
+#include "iex_microstructure.h"
 #include "iex_messages.h"
+#include "iex_order_book.h"
+#include "iex_packet_builder.h"
+#include "iex_pcap_c.h"
+#include "iex_pcap_reader.h"
+#include "iex_pipeline.h"
+#include "iex_predicate.h"
+#include "iex_protocol.h"
+#include "iex_replay.h"
+#include "iex_resampler.h"
+#include "iex_symbol_index.h"
+#include "iex_symbol_store.h"
+#include "iex_synthetic.h"
+#include "iex_volume_profile.h"
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -172,7 +207,7 @@ TEST_F(DecoderTest, TradeReportTest) {
   EXPECT_EQ(report_msg->flags, 192);
   EXPECT_EQ(report_msg->size, 100);
   EXPECT_EQ(report_msg->price, 99.97);
-  EXPECT_EQ(report_msg->trade_id, 967187);
+  EXPECT_EQ(report_msg->trade_id, 967187u);
 }
 
 TEST_F(DecoderTest, OfficialPriceTest) {
@@ -256,6 +291,1670 @@ TEST_F(DecoderTest, SecurityEventTest) {
             SecurityEventMessage::SecurityMessageType::OpeningProcessComplete);
 }
 
+// The pipelined decoder must deliver exactly the same stream as the single threaded decoder.
+TEST(PipelinedDecoderTest, MatchesSequentialDecoder) {
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(deep_pcap_filepath));
+  std::vector<std::pair<MessageType, uint64_t>> expected;
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    expected.emplace_back(msg_ptr->GetMessageType(), msg_ptr->timestamp);
+  }
+
+  // Use small batches and rings so that the stages have to wait on each other.
+  PipelineConfig config;
+  config.ring_capacity = 4;
+  config.packet_batch_size = 16;
+  config.message_batch_size = 32;
+  PipelinedDecoder pipeline(config);
+  ASSERT_TRUE(pipeline.OpenFileForDecoding(deep_pcap_filepath));
+  std::vector<std::pair<MessageType, uint64_t>> actual;
+  pipeline.AddConsumer([&actual](const IEXMessageBase& msg) {
+    actual.emplace_back(msg.GetMessageType(), msg.timestamp);
+  });
+  ASSERT_EQ(pipeline.Run(), ReturnCode::Success);
+
+  EXPECT_EQ(pipeline.GetMessageCount(), 105068);
+  EXPECT_EQ(pipeline.GetFirstHeader().send_time, decoder.GetFirstHeader().send_time);
+  EXPECT_TRUE(actual == expected);
+
+  // A block whose length runs past the end of its packet is rejected.
+  SystemEventMessage system_event;
+  system_event.timestamp = 1517058000000000000;
+  system_event.system_event = SystemEventMessage::Code::StartOfMessage;
+  IEXTPPacketBuilder builder(static_cast<uint16_t>(ProtocolId::TOPS), 1, 1, 1500, 1, 0);
+  ASSERT_TRUE(builder.AddMessage(system_event));
+  builder.Finish(system_event.timestamp);
+  std::vector<uint8_t> payload(builder.GetData(), builder.GetData() + builder.GetLength());
+  payload[IEXDecoder::first_block_start] = 0xff;
+  const std::string filename = "pipeline_overrun_test.tmp";
+  IEXTPPcapWriter writer;
+  ASSERT_TRUE(writer.Open(filename));
+  ASSERT_TRUE(writer.WritePacket(payload.data(), payload.size(), system_event.timestamp));
+  writer.Close();
+  PipelinedDecoder overrun_pipeline(config);
+  ASSERT_TRUE(overrun_pipeline.OpenFileForDecoding(filename));
+  EXPECT_EQ(overrun_pipeline.Run(), ReturnCode::FailedParsingPacket);
+  EXPECT_EQ(overrun_pipeline.GetMessageCount(), 0);
+  std::remove(filename.c_str());
+}
+
+// Every broadcast consumer must see exactly the stream of the single threaded decoder.
+TEST(BroadcastDecoderTest, AllConsumersSeeFullStream) {
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  std::vector<std::pair<MessageType, uint64_t>> expected;
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    expected.emplace_back(msg_ptr->GetMessageType(), msg_ptr->timestamp);
+  }
+  ASSERT_EQ(expected.size(), 99871);
+
+  // A publish batch size of 0 publishes every message.
+  for (const size_t publish_batch_size : {8, 0}) {
+    BroadcastConfig config;
+    config.ring_capacity = 64;
+    config.publish_batch_size = publish_batch_size;
+    BroadcastDecoder broadcast(config);
+    ASSERT_TRUE(broadcast.OpenFileForDecoding(tops_pcap_filepath));
+
+    constexpr int num_consumers = 3;
+    std::vector<std::vector<std::pair<MessageType, uint64_t>>> actual(num_consumers);
+    for (int i = 0; i < num_consumers; ++i) {
+      broadcast.AddConsumer([i, &actual](const IEXMessageBase& msg) {
+        actual[i].emplace_back(msg.GetMessageType(), msg.timestamp);
+      });
+    }
+    ASSERT_EQ(broadcast.Run(), ReturnCode::Success);
+
+    EXPECT_EQ(broadcast.GetMessageCount(), expected.size());
+    for (int i = 0; i < num_consumers; ++i) {
+      EXPECT_TRUE(actual[i] == expected);
+    }
+  }
+}
+
+// Split both data files into several chunks and check no message is lost or duplicated.
+TEST(BatchProcessorTest, ChunkedRunCoversAllMessages) {
+  const std::string data_dir =
+      tops_pcap_filepath.substr(0, tops_pcap_filepath.size() - tops_pcap_filename.size());
+  const auto filenames = ListPcapFiles(data_dir + "20180127_IEXTP1_*.pcap");
+  ASSERT_EQ(filenames, std::vector<std::string>({deep_pcap_filepath, tops_pcap_filepath}));
+
+  BatchConfig config;
+  config.num_threads = 3;
+  config.chunk_size_bytes = 2 << 20;
+  BatchProcessor<uint64_t> batch(config);
+
+  uint64_t total_messages = 0;
+  size_t num_chunks = 0;
+  batch.SetMergeHook([&](const FileChunk&, uint64_t&& num_messages) {
+    total_messages += num_messages;
+    ++num_chunks;
+  });
+  BatchProgress last_progress;
+  batch.SetProgressHook([&](const BatchProgress& progress) { last_progress = progress; });
+
+  ASSERT_TRUE(batch.Run(filenames, [](const FileChunk&, IEXDecoder& decoder) {
+    uint64_t num_messages = 0;
+    std::unique_ptr<IEXMessageBase> msg_ptr;
+    while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+      ++num_messages;
+    }
+    return num_messages;
+  }));
+
+  EXPECT_EQ(total_messages, 99871 + 105068);
+  EXPECT_GT(num_chunks, 2);
+  EXPECT_EQ(last_progress.files_done, 2);
+  EXPECT_EQ(last_progress.chunks_done, last_progress.chunks_total);
+  EXPECT_EQ(last_progress.bytes_done, last_progress.bytes_total);
+
+  // A job that throws fails its chunk without taking down the run.
+  total_messages = 0;
+  num_chunks = 0;
+  EXPECT_FALSE(batch.Run(filenames, [](const FileChunk& chunk, IEXDecoder&) -> uint64_t {
+    if (chunk.chunk_index == 1) {
+      throw std::runtime_error("job failed");
+    }
+    return 1;
+  }));
+  EXPECT_EQ(last_progress.chunks_failed, 2);
+  EXPECT_EQ(num_chunks, last_progress.chunks_total - 2);
+  EXPECT_EQ(last_progress.files_done, 2);
+}
+
+// Merge TOPS and DEEP into one stream and check it is ordered and complete.
+// Note: The files themselves contain a few timestamp inversions. The merge keeps the order of each
+// source, so only consecutive messages from different sources are guaranteed to be ordered.
+TEST(MergedDecoderTest, MergesInTimestampOrder) {
+  const std::vector<std::string> filenames = {tops_pcap_filepath, deep_pcap_filepath};
+  std::vector<uint64_t> expected_checksums;
+  for (const auto& filename : filenames) {
+    IEXDecoder decoder;
+    ASSERT_TRUE(decoder.OpenFileForDecoding(filename));
+    uint64_t checksum = 0;
+    std::unique_ptr<IEXMessageBase> msg_ptr;
+    while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+      checksum = checksum * 31 + msg_ptr->timestamp;
+    }
+    expected_checksums.push_back(checksum);
+  }
+
+  MergedDecoder merged(64, 4);
+  ASSERT_TRUE(merged.OpenFilesForDecoding(filenames));
+  ASSERT_EQ(merged.NumSources(), 2);
+  EXPECT_EQ(merged.GetFirstHeader(1).protocol_id, 32772);
+
+  std::vector<uint64_t> counts(merged.NumSources(), 0);
+  std::vector<uint64_t> checksums(merged.NumSources(), 0);
+  uint64_t last_timestamp = 0;
+  size_t last_source_id = 0;
+  uint64_t cross_source_inversions = 0;
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  size_t source_id = 0;
+  auto ret_code = merged.GetNextMessage(msg_ptr, source_id);
+  for (; ret_code == ReturnCode::Success; ret_code = merged.GetNextMessage(msg_ptr, source_id)) {
+    ASSERT_LT(source_id, counts.size());
+    ++counts[source_id];
+    checksums[source_id] = checksums[source_id] * 31 + msg_ptr->timestamp;
+    if (source_id != last_source_id && msg_ptr->timestamp < last_timestamp) {
+      ++cross_source_inversions;
+    }
+    last_timestamp = msg_ptr->timestamp;
+    last_source_id = source_id;
+  }
+  EXPECT_EQ(ret_code, ReturnCode::EndOfStream);
+  EXPECT_EQ(counts[0], 99871);
+  EXPECT_EQ(counts[1], 105068);
+  EXPECT_TRUE(checksums == expected_checksums);
+  EXPECT_EQ(cross_source_inversions, 0);
+}
+
+TEST(SyntheticFeedTest, GeneratedFileDecodes) {
+  SyntheticConfig config;
+  config.protocol = ProtocolId::DEEP;
+  config.num_messages = 20000;
+  config.num_symbols = 50;
+  const std::string filename = "synthetic_feed_test.pcap";
+
+  SyntheticFeedGenerator generator(config);
+  ASSERT_TRUE(generator.WriteToFile(filename));
+  EXPECT_EQ(generator.GetMessageCount(), config.num_messages);
+
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(filename));
+  EXPECT_EQ(decoder.GetFirstHeader().protocol_id, static_cast<uint16_t>(ProtocolId::DEEP));
+  EXPECT_EQ(decoder.GetFirstHeader().first_msg_sq_num, 1);
+
+  uint64_t count = 0;
+  uint64_t price_level_updates = 0;
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  auto ret_code = decoder.GetNextMessage(msg_ptr);
+  for (; ret_code == ReturnCode::Success; ret_code = decoder.GetNextMessage(msg_ptr)) {
+    ++count;
+    if (msg_ptr->GetMessageType() == MessageType::PriceLevelUpdateBuy ||
+        msg_ptr->GetMessageType() == MessageType::PriceLevelUpdateSell) {
+      ++price_level_updates;
+    }
+  }
+  EXPECT_EQ(ret_code, ReturnCode::EndOfStream);
+  EXPECT_EQ(count, config.num_messages);
+  EXPECT_GT(price_level_updates, count / 2);
+
+  config.max_price_levels = 0;
+  SyntheticFeedGenerator no_levels_generator(config);
+  EXPECT_FALSE(no_levels_generator.WriteToFile(filename));
+  config.max_price_levels = 10;
+  config.price_level_churn = 1.5;
+  SyntheticFeedGenerator bad_churn_generator(config);
+  EXPECT_FALSE(bad_churn_generator.WriteToFile(filename));
+  std::remove(filename.c_str());
+}
+
+// Decode every message of both files, encode it again through the packet builder and check the
+// rebuilt packets are byte for byte identical to the originals.
+TEST(EncoderTest, RoundTripReproducesPackets) {
+  for (const auto& filename : {tops_pcap_filepath, deep_pcap_filepath}) {
+    IEXDecoder decoder;
+    ASSERT_TRUE(decoder.OpenFileForReading(filename));
+
+    std::unique_ptr<IEXTPPacketBuilder> builder;
+    uint64_t num_packets = 0;
+    uint64_t num_messages = 0;
+    pcpp::RawPacket raw_packet;
+    while (decoder.ReadNextPacket(raw_packet) == ReturnCode::Success) {
+      pcpp::Packet packet(&raw_packet);
+      const uint8_t* payload_ptr = nullptr;
+      size_t payload_len = 0;
+      ASSERT_EQ(IEXDecoder::ExtractPayload(packet, payload_ptr, payload_len), ReturnCode::Success);
+      IEXTPHeader header;
+      ASSERT_TRUE(header.Decode(payload_ptr));
+      if (!builder) {
+        builder.reset(new IEXTPPacketBuilder(header.protocol_id, header.channel_id,
+                                             header.session_id, 1500, header.first_msg_sq_num,
+                                             header.stream_offset));
+      }
+
+      size_t block_offset = IEXDecoder::first_block_start;
+      while (block_offset < payload_len) {
+        const uint8_t* msg_data_ptr = IEXDecoder::GetBlockData(payload_ptr + block_offset);
+        auto msg_ptr = IEXMessageFactory(msg_data_ptr);
+        ASSERT_TRUE(msg_ptr);
+        ASSERT_TRUE(msg_ptr->Decode(msg_data_ptr));
+        ASSERT_TRUE(builder->AddMessage(*msg_ptr));
+        block_offset += IEXDecoder::GetBlockSize(payload_ptr + block_offset) + 2;
+        ++num_messages;
+      }
+
+      ASSERT_EQ(builder->Finish(header.send_time), payload_len);
+      ASSERT_EQ(std::memcmp(builder->GetData(), payload_ptr, payload_len), 0)
+          << "Packet " << num_packets << " of " << filename << " differs.";
+      builder->StartNextPacket();
+      ++num_packets;
+    }
+    EXPECT_GT(num_messages, 99000);
+  }
+
+  // Packets are capped to what fits a UDP datagram, and the writer rejects larger payloads.
+  SystemEventMessage system_event;
+  system_event.timestamp = 1517058000000000000;
+  system_event.system_event = SystemEventMessage::Code::StartOfMessage;
+  IEXTPPacketBuilder large_builder(static_cast<uint16_t>(ProtocolId::TOPS), 1, 1, 1 << 20, 1, 0);
+  while (large_builder.AddMessage(system_event)) {
+  }
+  EXPECT_LE(large_builder.Finish(system_event.timestamp), IEXTPPcapWriter::max_payload_len);
+  const std::string filename = "encoder_large_test.tmp";
+  IEXTPPcapWriter writer;
+  ASSERT_TRUE(writer.Open(filename));
+  EXPECT_TRUE(writer.WritePacket(large_builder.GetData(), large_builder.GetLength(),
+                                 system_event.timestamp));
+  const std::vector<uint8_t> too_large(IEXTPPcapWriter::max_payload_len + 1, 0);
+  EXPECT_FALSE(writer.WritePacket(too_large.data(), too_large.size(), system_event.timestamp));
+  EXPECT_EQ(writer.GetPacketCount(), 1);
+  writer.Close();
+  std::remove(filename.c_str());
+}
+
+TEST(DecoderStatsTest, CountsMatchDecodedStream) {
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  uint64_t hook_calls = 0;
+  decoder.SetStatsHook([&hook_calls](const DecoderStats&) { ++hook_calls; }, 1000);
+
+  std::vector<uint64_t> counts(256, 0);
+  uint64_t num_messages = 0;
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    ++counts[static_cast<uint8_t>(msg_ptr->GetMessageType())];
+    ++num_messages;
+  }
+
+  const DecoderStats stats = decoder.GetStats();
+#ifdef IEX_ENABLE_STATS
+  EXPECT_EQ(stats.GetMessageCount(), num_messages);
+  EXPECT_EQ(stats.blocks, num_messages);
+  EXPECT_EQ(stats.packets, decoder.GetPacketIndex());
+  EXPECT_GT(stats.heartbeats, 0);
+  for (size_t i = 0; i < counts.size(); ++i) {
+    EXPECT_EQ(stats.messages_by_type[i], counts[i]);
+  }
+  EXPECT_GT(stats.GetTotalCycles(), 0);
+  // The first packet was read before the hook was set.
+  EXPECT_EQ(hook_calls, (stats.packets - 1) / 1000);
+
+  decoder.ResetStats();
+  EXPECT_EQ(decoder.GetStats().packets, 0);
+#else
+  EXPECT_EQ(stats.GetMessageCount(), 0);
+  EXPECT_EQ(hook_calls, 0);
+#endif
+}
+
+TEST(LatencyHistogramTest, PercentilesAndMerge) {
+  LatencyHistogram low;
+  LatencyHistogram high;
+  for (int64_t value = 1; value <= 1000000; ++value) {
+    (value <= 500000 ? low : high).Record(value);
+  }
+  high.Record(-5);
+
+  LatencyHistogram merged;
+  ASSERT_TRUE(merged.Merge(low));
+  ASSERT_TRUE(merged.Merge(high));
+  EXPECT_EQ(merged.GetCount(), 1000000);
+  EXPECT_EQ(merged.GetNegativeCount(), 1);
+  EXPECT_EQ(merged.GetMin(), 1);
+  EXPECT_EQ(merged.GetMax(), 1000000);
+  EXPECT_DOUBLE_EQ(merged.GetMean(), 500000.5);
+  for (const double percentile : {1.0, 50.0, 90.0, 99.0, 99.9}) {
+    const double expected = percentile * 10000;
+    EXPECT_NEAR(merged.GetValueAtPercentile(percentile), expected, expected / 128);
+  }
+  EXPECT_EQ(merged.GetValueAtPercentile(100.0), 1000000);
+
+  // Small values are exact.
+  LatencyHistogram small;
+  small.Record(3);
+  EXPECT_EQ(small.GetValueAtPercentile(50.0), 3);
+
+  LatencyHistogram other_precision(3);
+  EXPECT_FALSE(merged.Merge(other_precision));
+}
+
+TEST(LatencyRecorderTest, RecordsEveryPacketAndMessage) {
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  LatencyRecorder recorder;
+  uint64_t num_messages = 0;
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    recorder.Record(decoder, *msg_ptr);
+    ++num_messages;
+  }
+
+  const auto* quotes = recorder.GetInternalLatency(MessageType::QuoteUpdate);
+  ASSERT_TRUE(quotes != nullptr);
+  EXPECT_EQ(quotes->GetCount() + quotes->GetNegativeCount(), 41959);
+  EXPECT_TRUE(recorder.GetInternalLatency(MessageType::PriceLevelUpdateBuy) == nullptr);
+
+  uint64_t num_recorded = 0;
+  for (int i = 0; i < 256; ++i) {
+    const auto* histogram = recorder.GetInternalLatency(static_cast<MessageType>(i));
+    num_recorded += histogram ? histogram->GetCount() + histogram->GetNegativeCount() : 0;
+  }
+  EXPECT_EQ(num_recorded, num_messages);
+
+  // Every packet with messages is recorded once, and merging adds up.
+  const auto& publication = recorder.GetPublicationLatency();
+  const auto& wire = recorder.GetWireLatency();
+  EXPECT_EQ(publication.GetCount() + publication.GetNegativeCount(),
+            wire.GetCount() + wire.GetNegativeCount());
+  EXPECT_GT(publication.GetCount(), 0);
+  LatencyRecorder merged;
+  merged.Merge(recorder);
+  merged.Merge(recorder);
+  EXPECT_EQ(merged.GetPublicationLatency().GetCount(), 2 * publication.GetCount());
+}
+
+// Build a catalog over both files, and check a query returns the packets of all matching messages.
+TEST(DatasetCatalogTest, QueryCoversMatchingMessages) {
+  CatalogConfig config;
+  config.num_threads = 2;
+  config.index_interval_packets = 1024;
+  DatasetCatalog catalog(config);
+  ASSERT_TRUE(catalog.Build(std::vector<std::string>{tops_pcap_filepath, deep_pcap_filepath}));
+  ASSERT_EQ(catalog.GetEntries().size(), 2);
+  const auto& tops_entry = catalog.GetEntries()[0];
+  const auto& deep_entry = catalog.GetEntries()[1];
+  EXPECT_EQ(tops_entry.protocol_id, 32771);
+  EXPECT_EQ(deep_entry.protocol_id, 32772);
+  EXPECT_EQ(tops_entry.num_messages, 99871);
+  EXPECT_EQ(deep_entry.num_messages, 105068);
+  EXPECT_EQ(tops_entry.num_packets, 57719);
+  EXPECT_EQ(tops_entry.messages_by_type[static_cast<uint8_t>(MessageType::QuoteUpdate)], 41959);
+  EXPECT_TRUE(tops_entry.symbols.MayContain("AUO"));
+  EXPECT_TRUE(deep_entry.symbols.MayContain("ZIEXT"));
+
+  const std::string catalog_filename = "test_catalog.tmp";
+  ASSERT_TRUE(catalog.Save(catalog_filename));
+  DatasetCatalog loaded;
+  ASSERT_TRUE(loaded.Load(catalog_filename));
+
+  // A corrupt time index size, that of the last entry, is rejected rather than allocated.
+  {
+    std::fstream corrupt_stream(catalog_filename,
+                                std::ios::binary | std::ios::in | std::ios::out);
+    corrupt_stream.seekp(-static_cast<std::streamoff>(
+                             deep_entry.time_index.size() *
+                                 sizeof(CatalogEntry::TimeIndexEntry) +
+                             sizeof(uint64_t)),
+                         std::ios::end);
+    const uint64_t index_size = uint64_t(1) << 60;
+    corrupt_stream.write(reinterpret_cast<const char*>(&index_size), sizeof(index_size));
+  }
+  DatasetCatalog corrupt;
+  EXPECT_FALSE(corrupt.Load(catalog_filename));
+  std::remove(catalog_filename.c_str());
+  ASSERT_EQ(loaded.GetEntries().size(), 2);
+  EXPECT_EQ(loaded.GetEntries()[1].messages_by_type, deep_entry.messages_by_type);
+  EXPECT_TRUE(loaded.GetEntries()[0].symbols.MayContain("AUO"));
+
+  CatalogQuery query;
+  query.symbol = "AUO";
+  query.start_time = 1517065649985331707 - 60000000000;
+  query.end_time = 1517065649985331707 + 60000000000;
+  query.protocol_id = static_cast<uint16_t>(ProtocolId::TOPS);
+  const auto chunks = loaded.Query(query);
+  ASSERT_FALSE(chunks.empty());
+
+  auto count_matches = [&query](IEXDecoder& decoder) {
+    uint64_t num_matches = 0;
+    std::unique_ptr<IEXMessageBase> msg_ptr;
+    while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+      auto quote_msg = dynamic_cast<QuoteUpdateMessage*>(msg_ptr.get());
+      num_matches += quote_msg && quote_msg->symbol == query.symbol &&
+                     static_cast<int64_t>(quote_msg->timestamp) >= query.start_time &&
+                     static_cast<int64_t>(quote_msg->timestamp) <= query.end_time;
+    }
+    return num_matches;
+  };
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  const uint64_t expected_matches = count_matches(decoder);
+  EXPECT_GT(expected_matches, 0);
+
+  uint64_t num_matches = 0;
+  uint64_t num_packets = 0;
+  for (const auto& chunk : chunks) {
+    EXPECT_EQ(chunk.filename, tops_pcap_filepath);
+    IEXDecoder chunk_decoder;
+    ASSERT_EQ(OpenChunkForDecoding(chunk, chunk_decoder), ReturnCode::Success);
+    num_matches += count_matches(chunk_decoder);
+    num_packets += chunk_decoder.GetPacketIndex() - chunk.first_packet;
+  }
+  EXPECT_EQ(num_matches, expected_matches);
+  EXPECT_LT(num_packets, tops_entry.num_packets);
+}
+
+// The record reader sees the same packets as the pcpp reader, and can seek back to any of them.
+TEST(PcapRecordReaderTest, MatchesDecoderPackets) {
+  for (const auto& filename : {tops_pcap_filepath, deep_pcap_filepath}) {
+    IEXDecoder decoder;
+    ASSERT_TRUE(decoder.OpenFileForReading(filename));
+    PcapRecordReader reader;
+    ASSERT_TRUE(reader.Open(filename));
+
+    pcpp::RawPacket raw_packet;
+    PcapRecord record;
+    std::vector<uint64_t> record_offsets;
+    while (decoder.ReadNextPacket(raw_packet) == ReturnCode::Success) {
+      ASSERT_EQ(reader.ReadNextRecord(record), ReturnCode::Success);
+      ASSERT_EQ(record.len, static_cast<uint32_t>(raw_packet.getRawDataLen()));
+      ASSERT_EQ(std::memcmp(record.data, raw_packet.getRawData(), record.len), 0);
+      ASSERT_EQ(record.capture_time.tv_sec, raw_packet.getPacketTimeStamp().tv_sec);
+      ASSERT_EQ(record.capture_time.tv_nsec, raw_packet.getPacketTimeStamp().tv_nsec);
+      record_offsets.push_back(record.offset);
+    }
+    EXPECT_EQ(reader.ReadNextRecord(record), ReturnCode::EndOfStream);
+    EXPECT_EQ(record_offsets.size(), decoder.GetPacketIndex());
+
+    const size_t middle = record_offsets.size() / 2;
+    ASSERT_TRUE(reader.Seek(record_offsets[middle]));
+    ASSERT_EQ(reader.ReadNextRecord(record), ReturnCode::Success);
+    EXPECT_EQ(record.offset, record_offsets[middle]);
+    ASSERT_EQ(reader.ReadNextRecord(record), ReturnCode::Success);
+    EXPECT_EQ(record.offset, record_offsets[middle + 1]);
+  }
+}
+
+// Pcap and pcapng files written on a host of the other byte order decode as the original.
+TEST(PcapRecordReaderTest, ReadsSwappedByteOrder) {
+  std::vector<uint8_t> pcap_data;
+  std::vector<uint8_t> pcapng_data;
+  const auto put16 = [](std::vector<uint8_t>& data, const uint16_t value) {
+    const uint16_t swapped = __builtin_bswap16(value);
+    data.insert(data.end(), reinterpret_cast<const uint8_t*>(&swapped),
+                reinterpret_cast<const uint8_t*>(&swapped) + sizeof(swapped));
+  };
+  const auto put32 = [](std::vector<uint8_t>& data, const uint32_t value) {
+    const uint32_t swapped = __builtin_bswap32(value);
+    data.insert(data.end(), reinterpret_cast<const uint8_t*>(&swapped),
+                reinterpret_cast<const uint8_t*>(&swapped) + sizeof(swapped));
+  };
+  // Nanosecond pcap: magic, version, time zone, sigfigs, snap length and link type.
+  put32(pcap_data, 0xa1b23c4d);
+  put16(pcap_data, 2);
+  put16(pcap_data, 4);
+  for (const uint32_t field : {0u, 0u, 65535u, 1u}) {
+    put32(pcap_data, field);
+  }
+  // Pcapng: a section header, and an Ethernet interface with nanosecond timestamps.
+  for (const uint32_t field : {0x0A0D0D0Au, 28u, 0x1A2B3C4Du, 0x00010000u, 0xffffffffu,
+                               0xffffffffu, 28u}) {
+    put32(pcapng_data, field);
+  }
+  put32(pcapng_data, 1);
+  put32(pcapng_data, 32);
+  put16(pcapng_data, 1);
+  put16(pcapng_data, 0);
+  put32(pcapng_data, 65535);
+  put16(pcapng_data, 9);
+  put16(pcapng_data, 1);
+  pcapng_data.insert(pcapng_data.end(), {9, 0, 0, 0});
+  put32(pcapng_data, 0);
+  put32(pcapng_data, 32);
+
+  PcapRecordReader reader;
+  ASSERT_TRUE(reader.Open(tops_pcap_filepath));
+  PcapRecord record;
+  while (reader.ReadNextRecord(record) == ReturnCode::Success) {
+    const uint64_t capture_time = static_cast<uint64_t>(record.capture_time.tv_sec) * 1000000000 +
+                                  record.capture_time.tv_nsec;
+    put32(pcap_data, static_cast<uint32_t>(record.capture_time.tv_sec));
+    put32(pcap_data, static_cast<uint32_t>(record.capture_time.tv_nsec));
+    put32(pcap_data, record.len);
+    put32(pcap_data, record.len);
+    pcap_data.insert(pcap_data.end(), record.data, record.data + record.len);
+
+    const uint32_t padded_len = (record.len + 3) & ~3u;
+    put32(pcapng_data, 6);
+    put32(pcapng_data, 32 + padded_len);
+    put32(pcapng_data, 0);
+    put32(pcapng_data, static_cast<uint32_t>(capture_time >> 32));
+    put32(pcapng_data, static_cast<uint32_t>(capture_time));
+    put32(pcapng_data, record.len);
+    put32(pcapng_data, record.len);
+    pcapng_data.insert(pcapng_data.end(), record.data, record.data + record.len);
+    pcapng_data.resize(pcapng_data.size() + padded_len - record.len);
+    put32(pcapng_data, 32 + padded_len);
+  }
+
+  const std::string swapped_filename = "test_swapped.tmp";
+  for (const auto* data : {&pcap_data, &pcapng_data}) {
+    {
+      std::ofstream out_stream(swapped_filename, std::ios::binary);
+      out_stream.write(reinterpret_cast<const char*>(data->data()), data->size());
+    }
+    IEXDecoder decoder;
+    IEXDecoder swapped_decoder;
+    ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+    ASSERT_TRUE(swapped_decoder.OpenFileForDecoding(swapped_filename));
+    std::unique_ptr<IEXMessageBase> msg_ptr;
+    std::unique_ptr<IEXMessageBase> swapped_msg_ptr;
+    size_t num_messages = 0;
+    while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+      ASSERT_EQ(swapped_decoder.GetNextMessage(swapped_msg_ptr), ReturnCode::Success);
+      ASSERT_EQ(swapped_msg_ptr->GetMessageType(), msg_ptr->GetMessageType());
+      ASSERT_EQ(swapped_msg_ptr->timestamp, msg_ptr->timestamp);
+      ASSERT_EQ(swapped_decoder.GetLastCaptureTime(), decoder.GetLastCaptureTime());
+      ++num_messages;
+    }
+    EXPECT_EQ(swapped_decoder.GetNextMessage(swapped_msg_ptr), ReturnCode::EndOfStream);
+    EXPECT_EQ(num_messages, 99871);
+  }
+  std::remove(swapped_filename.c_str());
+}
+
+// Extracting a symbol through the index yields exactly the messages a full decode finds for it.
+TEST(SymbolIndexTest, ExtractionMatchesFullDecode) {
+  SymbolPacketIndex index;
+  ASSERT_EQ(index.Build(deep_pcap_filepath), ReturnCode::Success);
+  const std::string index_filename = SymbolPacketIndex::GetIndexFilename("test_deep.tmp");
+  ASSERT_TRUE(index.Save(index_filename));
+  SymbolPacketIndex loaded;
+  ASSERT_TRUE(loaded.Load(index_filename));
+
+  // Record counts and data sizes beyond the bytes in the file are rejected.
+  for (const uint64_t list_field_offset : {16, 24}) {
+    ASSERT_TRUE(index.Save(index_filename));
+    std::fstream index_stream(index_filename, std::ios::binary | std::ios::in | std::ios::out);
+    const uint64_t corrupt_value = 1ull << 60;
+    index_stream.seekp(32 + list_field_offset);
+    index_stream.write(reinterpret_cast<const char*>(&corrupt_value), sizeof(corrupt_value));
+    index_stream.close();
+    SymbolPacketIndex corrupt;
+    EXPECT_FALSE(corrupt.Load(index_filename));
+  }
+  std::remove(index_filename.c_str());
+  EXPECT_EQ(loaded.GetPacketCount(), index.GetPacketCount());
+  EXPECT_EQ(loaded.GetSymbols(), index.GetSymbols());
+
+  const std::string symbol = "ZIEXT";
+  const uint64_t packed_symbol = PackSymbol(symbol);
+  std::vector<uint64_t> expected_timestamps;
+  std::vector<uint64_t> expected_packets;  // Packet indices, the index lists record offsets.
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(deep_pcap_filepath));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  uint8_t msg_data[IEXMessageBase::max_encoded_len];
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    uint64_t msg_symbol = 0;
+    const size_t msg_len = msg_ptr->Encode(msg_data);
+    if (GetPackedSymbol(msg_data, msg_len, msg_symbol) && msg_symbol == packed_symbol) {
+      expected_timestamps.push_back(msg_ptr->timestamp);
+      if (expected_packets.empty() || expected_packets.back() != decoder.GetPacketIndex() - 1) {
+        expected_packets.push_back(decoder.GetPacketIndex() - 1);
+      }
+    }
+  }
+  ASSERT_FALSE(expected_timestamps.empty());
+  const auto record_offsets = loaded.GetRecordOffsets(symbol);
+  EXPECT_EQ(record_offsets.size(), expected_packets.size());
+  EXPECT_TRUE(std::is_sorted(record_offsets.begin(), record_offsets.end()));
+  EXPECT_TRUE(loaded.GetRecordOffsets("NOTASYMB").empty());
+
+  SymbolExtractor extractor;
+  ASSERT_EQ(extractor.Open(deep_pcap_filepath, loaded, symbol), ReturnCode::Success);
+  std::vector<uint64_t> timestamps;
+  ReturnCode ret_code;
+  while ((ret_code = extractor.GetNextMessage(msg_ptr)) == ReturnCode::Success) {
+    timestamps.push_back(msg_ptr->timestamp);
+  }
+  EXPECT_EQ(ret_code, ReturnCode::EndOfStream);
+  EXPECT_EQ(timestamps, expected_timestamps);
+
+  SymbolExtractor mismatched;
+  EXPECT_EQ(mismatched.Open(tops_pcap_filepath, loaded, symbol), ReturnCode::ClassNotInitialized);
+}
+
+// The store holds every message once, with each symbol's messages in stable timestamp order.
+TEST(SymbolStoreTest, SpansMatchSortedStream) {
+  SymbolStoreWriter writer;
+  ASSERT_EQ(writer.AddFile(deep_pcap_filepath), ReturnCode::Success);
+  EXPECT_EQ(writer.GetMessageCount(), 105068);
+  const std::string store_filename = "test_store.tmp";
+  ASSERT_TRUE(writer.Write(store_filename));
+  SymbolStoreReader reader;
+  ASSERT_TRUE(reader.Open(store_filename));
+
+  // A directory size, or an entry end, that wraps around 2^64 is rejected. The header holds the
+  // magic, the entry and message counts and the directory offset.
+  const std::string corrupt_filename = "test_store_corrupt.tmp";
+  ASSERT_TRUE(writer.Write(corrupt_filename));
+  {
+    std::fstream store_stream(corrupt_filename, std::ios::binary | std::ios::in | std::ios::out);
+    uint64_t directory_offset = 0;
+    store_stream.seekg(24);
+    store_stream.read(reinterpret_cast<char*>(&directory_offset), sizeof(directory_offset));
+    const uint64_t wrapping_len = ~uint64_t(0);
+    store_stream.seekp(directory_offset + 16);
+    store_stream.write(reinterpret_cast<const char*>(&wrapping_len), sizeof(wrapping_len));
+  }
+  SymbolStoreReader corrupt_reader;
+  EXPECT_FALSE(corrupt_reader.Open(corrupt_filename));
+  ASSERT_TRUE(writer.Write(corrupt_filename));
+  {
+    std::fstream store_stream(corrupt_filename, std::ios::binary | std::ios::in | std::ios::out);
+    const uint64_t wrapping_entries = 1ull << 60;
+    store_stream.seekp(8);
+    store_stream.write(reinterpret_cast<const char*>(&wrapping_entries), sizeof(wrapping_entries));
+  }
+  EXPECT_FALSE(corrupt_reader.Open(corrupt_filename));
+  std::remove(corrupt_filename.c_str());
+  std::remove(store_filename.c_str());
+
+  uint64_t num_messages = 0;
+  for (size_t i = 0; i < reader.GetEntryCount(); ++i) {
+    num_messages += reader.GetEntries()[i].num_messages;
+  }
+  EXPECT_EQ(num_messages, 105068);
+  const auto symbols = reader.GetSymbols();
+  EXPECT_TRUE(std::is_sorted(symbols.begin(), symbols.end()));
+  EXPECT_EQ(symbols.front(), "");
+  EXPECT_TRUE(reader.GetSymbol("NOTASYMB").IsEmpty());
+
+  const std::string symbol = "ZIEXT";
+  const uint64_t packed_symbol = PackSymbol(symbol);
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(deep_pcap_filepath));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  uint8_t msg_data[IEXMessageBase::max_encoded_len];
+  std::vector<std::pair<uint64_t, MessageType>> expected;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    uint64_t msg_symbol = 0;
+    const size_t msg_len = msg_ptr->Encode(msg_data);
+    if (GetPackedSymbol(msg_data, msg_len, msg_symbol) && msg_symbol == packed_symbol) {
+      expected.emplace_back(msg_ptr->timestamp, msg_ptr->GetMessageType());
+    }
+  }
+  typedef std::pair<uint64_t, MessageType> TimedType;
+  std::stable_sort(
+      expected.begin(), expected.end(),
+      [](const TimedType& lhs, const TimedType& rhs) { return lhs.first < rhs.first; });
+
+  const SymbolSpan span = reader.GetSymbol(symbol);
+  EXPECT_EQ(span.num_messages, expected.size());
+  EXPECT_EQ(static_cast<uint64_t>(span.first_timestamp), expected.front().first);
+  SymbolSpanDecoder span_decoder(span);
+  std::vector<TimedType> decoded;
+  while (span_decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    decoded.emplace_back(msg_ptr->timestamp, msg_ptr->GetMessageType());
+  }
+  EXPECT_TRUE(decoded == expected);
+}
+
+// A miss decodes and caches the file, a hit returns the same messages, and the budget evicts the
+// least recently used file.
+TEST(DecodeCacheTest, HitMatchesDecoderAndEvicts) {
+  const std::string cache_dir = "test_cache.tmp";
+  mkdir(cache_dir.c_str(), 0755);
+  DecodeCacheConfig config;
+  config.directory = cache_dir;
+  DecodeCache cache(config);
+
+  DecodedColumns columns;
+  ASSERT_EQ(cache.Open(tops_pcap_filepath, columns), ReturnCode::Success);
+  ASSERT_EQ(cache.Open(tops_pcap_filepath, columns), ReturnCode::Success);
+  EXPECT_EQ(cache.GetMissCount(), 1);
+  EXPECT_EQ(cache.GetHitCount(), 1);
+  ASSERT_EQ(columns.GetMessageCount(), 99871);
+
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  std::unique_ptr<IEXMessageBase> cached_msg_ptr;
+  size_t msg_index = 0;
+  uint8_t msg_data[IEXMessageBase::max_encoded_len];
+  uint8_t cached_msg_data[IEXMessageBase::max_encoded_len];
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    ASSERT_EQ(columns.GetNextMessage(cached_msg_ptr), ReturnCode::Success);
+    ASSERT_EQ(columns.GetTimestamps()[msg_index], static_cast<int64_t>(msg_ptr->timestamp));
+    ASSERT_EQ(columns.GetTypes()[msg_index], static_cast<uint8_t>(msg_ptr->GetMessageType()));
+    ASSERT_EQ(columns.GetLastCaptureTime(), decoder.GetLastCaptureTime());
+    const size_t msg_len = msg_ptr->Encode(msg_data);
+    ASSERT_EQ(cached_msg_ptr->Encode(cached_msg_data), msg_len);
+    ASSERT_EQ(std::memcmp(msg_data, cached_msg_data, msg_len), 0);
+    // Trade fields come straight from the table columns: flags, timestamp, symbol, size, price.
+    if (const auto trade_msg = dynamic_cast<TradeReportMessage*>(msg_ptr.get())) {
+      const MappedTable* table = columns.GetTable(MessageType::TradeReport);
+      const uint32_t row = columns.GetRows()[msg_index];
+      ASSERT_TRUE(table != nullptr);
+      ASSERT_LT(row, table->GetNumRows());
+      uint32_t size = 0;
+      double price = 0;
+      std::memcpy(&size, table->GetColumn(3) + row * sizeof(size), sizeof(size));
+      std::memcpy(&price, table->GetColumn(4) + row * sizeof(price), sizeof(price));
+      ASSERT_EQ(size, static_cast<uint32_t>(trade_msg->size));
+      ASSERT_EQ(price, trade_msg->price);
+    }
+    ++msg_index;
+  }
+  EXPECT_EQ(columns.GetNextMessage(cached_msg_ptr), ReturnCode::EndOfStream);
+
+  // Filtered raw data, as from the decoder.
+  ASSERT_EQ(cache.Open(tops_pcap_filepath, columns), ReturnCode::Success);
+  MessageFilter filter;
+  filter.SetTypes({MessageType::TradeReport});
+  columns.SetFilter(filter);
+  const uint8_t* msg_data_ptr = nullptr;
+  size_t msg_len = 0;
+  size_t num_trades = 0;
+  while (columns.GetNextMessageData(msg_data_ptr, msg_len) == ReturnCode::Success) {
+    ASSERT_EQ(msg_data_ptr[0], static_cast<uint8_t>(MessageType::TradeReport));
+    ++num_trades;
+  }
+  EXPECT_EQ(num_trades, columns.GetTable(MessageType::TradeReport)->GetNumRows());
+  EXPECT_GT(num_trades, 0);
+
+  // Room for one file only: adding DEEP evicts TOPS.
+  DecodeCacheConfig small_config = config;
+  small_config.max_bytes = cache.GetSize() + 1;
+  DecodeCache small_cache(small_config);
+  ASSERT_EQ(small_cache.Open(deep_pcap_filepath, columns), ReturnCode::Success);
+  EXPECT_EQ(columns.GetMessageCount(), 105068);
+  ASSERT_EQ(small_cache.Open(tops_pcap_filepath, columns), ReturnCode::Success);
+  EXPECT_EQ(small_cache.GetMissCount(), 2);
+  EXPECT_LE(small_cache.GetSize(), small_config.max_bytes);
+
+  small_config.max_bytes = 0;
+  DecodeCache(small_config).Evict();
+  EXPECT_EQ(cache.GetSize(), 0);
+  rmdir(cache_dir.c_str());
+}
+
+// Pushing a query into the decoder returns exactly the messages a full decode filtered after the
+// fact would, and times of day are in New York time.
+TEST(MessageQueryTest, PushdownMatchesFullDecode) {
+  EXPECT_EQ(GetEasternMidnight(1517065649985331707), 1517029200000000000);
+  EXPECT_EQ(GetEasternMidnight(1530532800000000000), 1530504000000000000);
+
+  MessageQuery query;
+  EXPECT_FALSE(query.Parse("type=NoSuchType"));
+  EXPECT_FALSE(query.Parse("time 10:00-09:30"));
+  EXPECT_FALSE(query.Parse("time 23:00-24:30"));
+  EXPECT_TRUE(query.Parse("time 23:00-24:00"));
+  ASSERT_TRUE(query.Parse("type in (QuoteUpdate,TradeReport) symbol in (AUO, ZIEXT) "
+                          "time 10:00-11:00 bid_size>=100"));
+  const int64_t start_time = 1517065200000000000;
+  const int64_t end_time = start_time + 3600000000000;
+
+  std::vector<int64_t> expected;
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    const auto quote_msg = dynamic_cast<QuoteUpdateMessage*>(msg_ptr.get());
+    const int64_t timestamp = msg_ptr->timestamp;
+    if (quote_msg && (quote_msg->symbol == "AUO" || quote_msg->symbol == "ZIEXT") &&
+        timestamp >= start_time && timestamp <= end_time && quote_msg->bid_size >= 100) {
+      expected.push_back(timestamp);
+    }
+  }
+  ASSERT_FALSE(expected.empty());
+
+  std::vector<int64_t> queried;
+  IEXDecoder filtered_decoder;
+  ASSERT_TRUE(filtered_decoder.OpenFileForDecoding(tops_pcap_filepath));
+  const MessageFilter filter = query.GetFilter(filtered_decoder.GetFirstHeader().send_time);
+  EXPECT_EQ(filter.start_time, start_time);
+  filtered_decoder.SetFilter(filter);
+  while (filtered_decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    if (query.Matches(*msg_ptr)) {
+      queried.push_back(msg_ptr->timestamp);
+    }
+  }
+  EXPECT_TRUE(queried == expected);
+
+  // With the time index of a catalog, decoding starts near the start time with the same result.
+  CatalogConfig catalog_config;
+  catalog_config.index_interval_packets = 256;
+  DatasetCatalog catalog(catalog_config);
+  ASSERT_TRUE(catalog.Build(std::vector<std::string>{tops_pcap_filepath}));
+  ASSERT_TRUE(filtered_decoder.OpenFileForDecoding(tops_pcap_filepath));
+  filtered_decoder.SetFilter(filter);
+  ASSERT_EQ(catalog.SeekToTime(filtered_decoder, filter.start_time), ReturnCode::Success);
+  EXPECT_GT(filtered_decoder.GetPacketIndex(), 256);
+  queried.clear();
+  while (filtered_decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    if (query.Matches(*msg_ptr)) {
+      queried.push_back(msg_ptr->timestamp);
+    }
+  }
+  EXPECT_TRUE(queried == expected);
+
+  // Opening a file clears the filter.
+  ASSERT_TRUE(filtered_decoder.OpenFileForDecoding(tops_pcap_filepath));
+  size_t num_messages = 0;
+  while (filtered_decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    ++num_messages;
+  }
+  EXPECT_EQ(num_messages, 99871);
+}
+
+// Totals match the decoded stream, and the statistics of the busiest symbol match a plain
+// computation over its quotes.
+TEST(MicrostructureStatsTest, MatchesPlainComputation) {
+  MicrostructureStats stats;
+  ASSERT_EQ(stats.AddFile(tops_pcap_filepath), ReturnCode::Success);
+  const std::vector<SymbolSummary> summaries = stats.GetSummary();
+  ASSERT_FALSE(summaries.empty());
+
+  uint64_t quote_updates = 0;
+  uint64_t trade_count = 0;
+  const SymbolSummary* busiest = &summaries[0];
+  for (const auto& summary : summaries) {
+    quote_updates += summary.quote_updates;
+    trade_count += summary.trade_count;
+    EXPECT_GE(summary.locked_crossed_fraction, 0);
+    EXPECT_LE(summary.locked_crossed_fraction, 1);
+    if (summary.quote_updates > busiest->quote_updates) {
+      busiest = &summary;
+    }
+  }
+  EXPECT_EQ(quote_updates, 41959);
+
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  uint64_t decoded_trades = 0;
+  uint64_t volume = 0;
+  int64_t last_timestamp = 0;
+  double bid = 0, ask = 0, quote_time = 0;
+  double spread_time = 0, quoted_time = 0;
+  int64_t sample_index = -1;
+  double sampled_mid = 0, sum_squared_returns = 0;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    last_timestamp = msg_ptr->timestamp;
+    const auto trade_msg = dynamic_cast<TradeReportMessage*>(msg_ptr.get());
+    if (trade_msg && trade_msg->GetMessageType() == MessageType::TradeReport) {
+      ++decoded_trades;
+      volume += trade_msg->symbol == busiest->symbol ? trade_msg->size : 0;
+    }
+    const auto quote_msg = dynamic_cast<QuoteUpdateMessage*>(msg_ptr.get());
+    if (!quote_msg || quote_msg->symbol != busiest->symbol) {
+      continue;
+    }
+    if (bid > 0 && ask > 0) {
+      spread_time += (ask - bid) * (last_timestamp - quote_time);
+      quoted_time += last_timestamp - quote_time;
+      if (last_timestamp / 1000000000 != sample_index) {
+        if (sampled_mid > 0) {
+          sum_squared_returns += std::pow(std::log((bid + ask) / 2 / sampled_mid), 2);
+        }
+        sampled_mid = (bid + ask) / 2;
+        sample_index = last_timestamp / 1000000000;
+      }
+    }
+    bid = quote_msg->bid_price;
+    ask = quote_msg->ask_price;
+    quote_time = last_timestamp;
+  }
+  if (bid > 0 && ask > 0) {
+    spread_time += (ask - bid) * (last_timestamp - quote_time);
+    quoted_time += last_timestamp - quote_time;
+    if (last_timestamp / 1000000000 != sample_index) {
+      sum_squared_returns += std::pow(std::log((bid + ask) / 2 / sampled_mid), 2);
+    }
+  }
+  EXPECT_EQ(trade_count, decoded_trades);
+  EXPECT_EQ(busiest->volume, volume);
+  ASSERT_GT(quoted_time, 0);
+  EXPECT_NEAR(busiest->time_weighted_spread, spread_time / quoted_time, 1e-9);
+  EXPECT_NEAR(busiest->realized_volatility, std::sqrt(sum_squared_returns), 1e-9);
+}
+
+// Every auction update lands in the series, and the outcomes hold the last update of each auction
+// joined with the official prices it set. ZXIET opens and closes out of a halt auction.
+TEST(AuctionTrackerTest, OutcomesJoinOfficialPrices) {
+  AuctionTracker tracker;
+  ASSERT_EQ(tracker.AddFile(tops_pcap_filepath), ReturnCode::Success);
+  const AuctionSeries& series = tracker.GetSeries();
+  EXPECT_EQ(series.GetSize(), 6020);
+  EXPECT_EQ(series.upper_auction_collars.size(), series.GetSize());
+
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  AuctionInformationMessage last_opening;
+  double opening_price = 0;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    const auto auction_msg = dynamic_cast<AuctionInformationMessage*>(msg_ptr.get());
+    if (auction_msg && auction_msg->symbol == "ZIEXT" &&
+        auction_msg->auction_type == AuctionInformationMessage::AuctionType::OpeningAuction) {
+      last_opening = *auction_msg;
+    }
+    const auto price_msg = dynamic_cast<OfficialPriceMessage*>(msg_ptr.get());
+    if (price_msg && price_msg->symbol == "ZIEXT" &&
+        price_msg->price_type == OfficialPriceMessage::PriceType::OpeningPrice) {
+      opening_price = price_msg->price;
+    }
+  }
+
+  const std::vector<AuctionOutcome> outcomes = tracker.GetOutcomes();
+  const uint32_t symbol_id = tracker.GetSymbolTable().Find(PackSymbol("ZIEXT"));
+  ASSERT_NE(symbol_id, SymbolTable::npos);
+  int num_checked = 0;
+  for (const auto& outcome : outcomes) {
+    if (outcome.symbol_id != symbol_id) {
+      continue;
+    }
+    if (outcome.auction_type == AuctionInformationMessage::AuctionType::OpeningAuction) {
+      EXPECT_EQ(outcome.num_updates, 120);
+      EXPECT_EQ(outcome.last_timestamp, static_cast<int64_t>(last_opening.timestamp));
+      EXPECT_EQ(outcome.paired_shares, static_cast<uint32_t>(last_opening.paired_shares));
+      EXPECT_EQ(outcome.indicative_clearing_price, last_opening.indicative_clearing_price);
+      EXPECT_EQ(outcome.official_opening_price, opening_price);
+      ++num_checked;
+    } else if (outcome.auction_type == AuctionInformationMessage::AuctionType::ClosingAuction) {
+      EXPECT_EQ(outcome.num_updates, 600);
+      EXPECT_FALSE(std::isnan(outcome.official_closing_price));
+      ++num_checked;
+    }
+  }
+  EXPECT_EQ(num_checked, 2);
+
+  const uint32_t halted_id = tracker.GetSymbolTable().Find(PackSymbol("ZXIET"));
+  const auto halted = std::find_if(outcomes.begin(), outcomes.end(), [&](const AuctionOutcome& o) {
+    return o.symbol_id == halted_id &&
+           o.auction_type == AuctionInformationMessage::AuctionType::HaltAuction;
+  });
+  ASSERT_NE(halted, outcomes.end());
+  EXPECT_FALSE(std::isnan(halted->official_opening_price));
+  EXPECT_FALSE(std::isnan(halted->official_closing_price));
+
+  // The column file holds a header, the symbols and eleven columns of one element per update.
+  const std::string columns_filename = "auction_columns.tmp";
+  ASSERT_TRUE(tracker.WriteSeriesColumns(columns_filename));
+  std::ifstream in_stream(columns_filename, std::ios::binary);
+  std::vector<char> columns((std::istreambuf_iterator<char>(in_stream)),
+                            std::istreambuf_iterator<char>());
+  in_stream.close();
+  std::remove(columns_filename.c_str());
+  const size_t num_symbols = tracker.GetSymbolTable().GetSize();
+  const size_t columns_start = 24 + 8 * num_symbols;
+  ASSERT_EQ(columns.size(), columns_start + series.GetSize() * (6 * 8 + 3 * 4 + 2));
+  EXPECT_EQ(std::string(columns.data(), 8), "IEXAUC01");
+  EXPECT_EQ(GetNumeric<int64_t>(reinterpret_cast<const uint8_t*>(columns.data()),
+                                static_cast<int>(columns_start + 8 * (series.GetSize() - 1))),
+            series.timestamps.back());
+
+  // Updates of an unknown auction type are skipped.
+  AuctionInformationMessage unknown_auction = last_opening;
+  unknown_auction.auction_type = static_cast<AuctionInformationMessage::AuctionType>('X');
+  tracker.OnMessage(unknown_auction);
+  EXPECT_EQ(tracker.GetNumUnknownAuctions(), 1);
+  EXPECT_EQ(tracker.GetSeries().GetSize(), 6020);
+}
+
+TEST(VolumeProfileTest, MatchesTradesAndMerges) {
+  VolumeProfileConfig config;
+  config.tick_size = 0;
+  VolumeProfile no_tick_profile(config);
+  EXPECT_EQ(no_tick_profile.AddFile(deep_pcap_filepath), ReturnCode::ClassNotInitialized);
+  EXPECT_FALSE(no_tick_profile.AddFiles({deep_pcap_filepath}));
+
+  config.tick_size = 1;
+  VolumeProfile profile(config);
+  ASSERT_EQ(profile.AddFile(deep_pcap_filepath), ReturnCode::Success);
+
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(deep_pcap_filepath));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  std::map<std::string, uint64_t> volumes;
+  uint64_t ziext_volume_at_price = 0;
+  double ziext_price = 0;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    const auto trade_msg = dynamic_cast<TradeReportMessage*>(msg_ptr.get());
+    if (trade_msg && trade_msg->GetMessageType() == MessageType::TradeReport) {
+      volumes[trade_msg->symbol] += trade_msg->size;
+      if (trade_msg->symbol == "ZIEXT" && (ziext_price == 0 || trade_msg->price == ziext_price)) {
+        ziext_price = trade_msg->price;
+        ziext_volume_at_price += trade_msg->size;
+      }
+    }
+  }
+  ASSERT_FALSE(volumes.empty());
+  const SymbolTable& symbol_table = profile.GetSymbolTable();
+  for (const auto& entry : volumes) {
+    const uint32_t id = symbol_table.Find(PackSymbol(entry.first));
+    ASSERT_NE(id, SymbolTable::npos);
+    const auto& values = profile.GetProfile(id).volume.GetValues();
+    EXPECT_EQ(std::accumulate(values.begin(), values.end(), uint64_t(0)), entry.second);
+  }
+  const uint32_t ziext_id = symbol_table.Find(PackSymbol("ZIEXT"));
+  ASSERT_NE(ziext_id, SymbolTable::npos);
+  const SymbolProfile& ziext = profile.GetProfile(ziext_id);
+  EXPECT_EQ(ziext.volume.Get(profile.GetTick(ziext_price)), ziext_volume_at_price);
+  const auto& depths = ziext.resting_depth.GetValues();
+  EXPECT_GT(std::accumulate(depths.begin(), depths.end(), 0.0), 0);
+
+  // Two sessions add up.
+  VolumeProfile merged(config);
+  ASSERT_TRUE(merged.AddFiles({deep_pcap_filepath, deep_pcap_filepath}));
+  const uint32_t merged_id = merged.GetSymbolTable().Find(PackSymbol("ZIEXT"));
+  ASSERT_NE(merged_id, SymbolTable::npos);
+  EXPECT_EQ(merged.GetProfile(merged_id).volume.Get(profile.GetTick(ziext_price)),
+            2 * ziext_volume_at_price);
+
+  const std::string profile_filename = "test_profile.tmp";
+  ASSERT_TRUE(profile.Save(profile_filename));
+  VolumeProfile loaded;
+  ASSERT_TRUE(loaded.Load(profile_filename));
+  std::remove(profile_filename.c_str());
+  ASSERT_EQ(loaded.GetSymbolTable().GetSize(), symbol_table.GetSize());
+  for (uint32_t id = 0; id < symbol_table.GetSize(); ++id) {
+    const SymbolProfile& original = profile.GetProfile(id);
+    const SymbolProfile& copy = loaded.GetProfile(id);
+    EXPECT_EQ(loaded.GetSymbolTable().GetPacked(id), symbol_table.GetPacked(id));
+    for (int64_t tick = original.volume.GetFirstTick(); tick < original.volume.GetEndTick();
+         ++tick) {
+      EXPECT_EQ(copy.volume.Get(tick), original.volume.Get(tick));
+    }
+    for (int64_t tick = original.resting_depth.GetFirstTick();
+         tick < original.resting_depth.GetEndTick(); ++tick) {
+      EXPECT_EQ(copy.resting_depth.Get(tick), original.resting_depth.Get(tick));
+    }
+  }
+}
+
+/// \brief Records what a replay strategy sees, as a running hash and a few counters.
+struct RecordingStrategy : public ReplayStrategy {
+  void Record(const ReplayState& state, const uint64_t value) {
+    EXPECT_GE(state.GetTime(), last_time);
+    last_time = state.GetTime();
+    hash = (hash ^ value ^ static_cast<uint64_t>(state.GetTime())) * 0x100000001b3ull;
+  }
+
+  void OnPriceLevelUpdate(ReplayState& state, const uint32_t id,
+                          const PriceLevelUpdateMessage& msg) {
+    Record(state, id);
+    if (start_time == 0) {
+      start_time = next_timer = state.GetTime();
+    }
+    if (state.GetTime() >= next_timer) {
+      ASSERT_TRUE(state.ScheduleTimer(next_timer + timer_interval, num_scheduled++));
+      next_timer += timer_interval;
+    }
+    ++num_updates;
+    (void)msg;
+  }
+
+  void OnTradeReport(ReplayState& state, const uint32_t id, const TradeReportMessage& msg) {
+    Record(state, id);
+    EXPECT_EQ(state.GetTopOfBook(id).last_trade_price, msg.price);
+  }
+
+  void OnTimer(ReplayState& state, const uint64_t timer_id) {
+    Record(state, timer_id);
+    EXPECT_GE(state.GetTime(), start_time + static_cast<int64_t>(timer_id + 1) * timer_interval);
+    EXPECT_EQ(timer_id, num_fired++);
+  }
+
+  int64_t timer_interval = 60000000000;
+  int64_t start_time = 0;
+  int64_t next_timer = 0;
+  int64_t last_time = 0;
+  uint64_t hash = 0xcbf29ce484222325ull;
+  uint64_t num_updates = 0;
+  uint64_t num_scheduled = 0;
+  uint64_t num_fired = 0;
+};
+
+TEST(ReplayEngineTest, BooksTimersAndDeterminism) {
+  ReplayConfig config;
+  config.max_book_levels = 256;
+  RecordingStrategy strategy;
+  ReplayEngine<RecordingStrategy> engine(strategy, config);
+  ASSERT_EQ(engine.Run(deep_pcap_filepath), ReturnCode::Success);
+  const ReplayState& state = engine.GetState();
+  EXPECT_GT(strategy.num_updates, 0);
+  EXPECT_GT(strategy.num_fired, 0);
+  EXPECT_EQ(strategy.num_fired + state.GetNumPendingTimers(), strategy.num_scheduled);
+  EXPECT_EQ(state.GetNumDroppedLevels(), 0);
+
+  // Compare the books with ones built from the plain decoder.
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(deep_pcap_filepath));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  std::map<std::string, std::map<double, int>> bids, asks;
+  uint64_t num_messages = 0;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    ++num_messages;
+    const auto update_msg = dynamic_cast<PriceLevelUpdateMessage*>(msg_ptr.get());
+    if (update_msg) {
+      auto& side = update_msg->GetMessageType() == MessageType::PriceLevelUpdateBuy
+                       ? bids[update_msg->symbol]
+                       : asks[update_msg->symbol];
+      if (update_msg->size == 0) {
+        side.erase(update_msg->price);
+      } else {
+        side[update_msg->price] = update_msg->size;
+      }
+    }
+  }
+  EXPECT_EQ(engine.GetNumEvents(), num_messages + strategy.num_fired);
+  ASSERT_FALSE(bids.empty());
+  for (const auto& entry : bids) {
+    const uint32_t id = state.FindSymbol(entry.first);
+    ASSERT_NE(id, ReplayState::npos);
+    const BookLevels levels = state.GetBids(id);
+    ASSERT_EQ(levels.size(), entry.second.size());
+    size_t i = 0;
+    for (auto it = entry.second.rbegin(); it != entry.second.rend(); ++it, ++i) {
+      EXPECT_EQ(levels[i].price, it->first);
+      EXPECT_EQ(levels[i].size, static_cast<uint32_t>(it->second));
+    }
+    EXPECT_EQ(state.GetTopOfBook(id).bid_price, levels.empty() ? 0 : levels[0].price);
+  }
+  for (const auto& entry : asks) {
+    const uint32_t id = state.FindSymbol(entry.first);
+    ASSERT_NE(id, ReplayState::npos);
+    const BookLevels levels = state.GetAsks(id);
+    ASSERT_EQ(levels.size(), entry.second.size());
+    size_t i = 0;
+    for (auto it = entry.second.begin(); it != entry.second.end(); ++it, ++i) {
+      EXPECT_EQ(levels[i].price, it->first);
+    }
+  }
+
+  // A second run sees exactly the same events.
+  RecordingStrategy second_strategy;
+  ReplayEngine<RecordingStrategy> second_engine(second_strategy, config);
+  ASSERT_EQ(second_engine.Run(deep_pcap_filepath), ReturnCode::Success);
+  EXPECT_EQ(second_strategy.hash, strategy.hash);
+  EXPECT_EQ(second_engine.GetNumEvents(), engine.GetNumEvents());
+}
+
+TEST(GridResamplerTest, MatchesPlainResampling) {
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  std::vector<QuoteUpdateMessage> quotes;
+  std::vector<TradeReportMessage> trades;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    const auto quote_msg = dynamic_cast<QuoteUpdateMessage*>(msg_ptr.get());
+    if (quote_msg && quote_msg->symbol == "AWP") {
+      quotes.push_back(*quote_msg);
+    }
+    const auto trade_msg = dynamic_cast<TradeReportMessage*>(msg_ptr.get());
+    if (trade_msg && trade_msg->symbol == "AWP" &&
+        trade_msg->GetMessageType() == MessageType::TradeReport) {
+      trades.push_back(*trade_msg);
+    }
+  }
+  ASSERT_FALSE(quotes.empty());
+  ASSERT_FALSE(trades.empty());
+
+  // A one second grid starting after the first quotes, so it starts forward filled.
+  GridConfig config;
+  config.start_time = static_cast<int64_t>(quotes[quotes.size() / 4].timestamp);
+  config.end_time = config.start_time + 1800000000000;
+  config.interval = 1000000000;
+  config.symbols = {"AWP", "B"};
+  GridResampler grid(config);
+  ASSERT_EQ(grid.AddFile(tops_pcap_filepath), ReturnCode::Success);
+  ASSERT_EQ(grid.GetNumRows(), 2);
+  ASSERT_EQ(grid.GetNumBuckets(), 1800);
+  const uint32_t row = grid.FindRow("AWP");
+  ASSERT_EQ(row, 0);
+
+  uint64_t total_volume = 0;
+  for (size_t bucket = 0; bucket < grid.GetNumBuckets(); ++bucket) {
+    const int64_t begin = grid.GetBucketStart(bucket);
+    const int64_t end = begin + config.interval;
+    double bid_price = 0, ask_price = 0, last_price = 0;
+    uint64_t volume = 0;
+    for (const auto& quote : quotes) {
+      if (static_cast<int64_t>(quote.timestamp) < end) {
+        bid_price = quote.bid_price;
+        ask_price = quote.ask_price;
+      }
+    }
+    for (const auto& trade : trades) {
+      const int64_t timestamp = static_cast<int64_t>(trade.timestamp);
+      if (timestamp < end) {
+        last_price = trade.price;
+      }
+      if (timestamp >= begin && timestamp < end) {
+        volume += trade.size;
+      }
+    }
+    const size_t index = row * grid.GetNumBuckets() + bucket;
+    EXPECT_EQ(grid.GetBidPrices()[index], bid_price);
+    EXPECT_EQ(grid.GetAskPrices()[index], ask_price);
+    EXPECT_EQ(grid.GetLastPrices()[index], last_price);
+    EXPECT_EQ(grid.GetVolumes()[index], volume);
+    total_volume += volume;
+  }
+  EXPECT_GT(total_volume, 0);
+
+  // The .npy export holds the same matrix after a 64 byte aligned header.
+  const std::string prefix = "test_grid_";
+  ASSERT_TRUE(grid.SaveNpy(prefix));
+  std::ifstream in_stream(prefix + "volume.npy", std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(in_stream)),
+                       std::istreambuf_iterator<char>());
+  ASSERT_GT(contents.size(), 10);
+  EXPECT_EQ(contents.compare(0, 6, "\x93NUMPY"), 0);
+  const size_t data_offset = 10 + static_cast<uint8_t>(contents[8]) +
+                             256 * static_cast<uint8_t>(contents[9]);
+  EXPECT_EQ(data_offset % 64, 0);
+  EXPECT_NE(contents.find("'shape': (2, 1800)"), std::string::npos);
+  ASSERT_EQ(contents.size(), data_offset + grid.GetVolumes().size() * sizeof(uint64_t));
+  EXPECT_EQ(std::memcmp(&contents[data_offset], grid.GetVolumes().data(),
+                        grid.GetVolumes().size() * sizeof(uint64_t)),
+            0);
+  for (const char* name : {"symbols", "bucket_start", "bid_price", "bid_size", "ask_price",
+                           "ask_size", "last_price", "volume", "notional", "trade_count"}) {
+    std::remove((prefix + name + ".npy").c_str());
+  }
+}
+
+TEST(MessageTablesTest, ColumnsMatchDecodedMessages) {
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  std::vector<TradeReportMessage> trades;
+  std::map<MessageType, size_t> counts;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    ++counts[msg_ptr->GetMessageType()];
+    const auto trade_msg = dynamic_cast<TradeReportMessage*>(msg_ptr.get());
+    if (trade_msg && trade_msg->GetMessageType() == MessageType::TradeReport) {
+      trades.push_back(*trade_msg);
+    }
+  }
+  ASSERT_FALSE(trades.empty());
+
+  MessageTables tables;
+  ASSERT_EQ(tables.AddFile(tops_pcap_filepath), ReturnCode::Success);
+  for (const auto& count : counts) {
+    const MessageTable* table = tables.GetTable(count.first);
+    ASSERT_NE(table, nullptr);
+    EXPECT_EQ(table->GetNumRows(), count.second);
+  }
+
+  // Every column of the trades holds the fields of the decoded messages, in stream order.
+  const MessageTable* table = tables.GetTable(MessageType::TradeReport);
+  ASSERT_NE(table, nullptr);
+  const MessageSchema& schema = table->GetSchema();
+  ASSERT_EQ(schema.fields.size(), 6);
+  const auto timestamps = reinterpret_cast<const int64_t*>(table->GetColumn(1).data());
+  const auto symbols = reinterpret_cast<const char*>(table->GetColumn(2).data());
+  const auto sizes = reinterpret_cast<const uint32_t*>(table->GetColumn(3).data());
+  const auto prices = reinterpret_cast<const double*>(table->GetColumn(4).data());
+  const auto trade_ids = reinterpret_cast<const uint64_t*>(table->GetColumn(5).data());
+  for (size_t i = 0; i < trades.size(); ++i) {
+    EXPECT_EQ(table->GetColumn(0)[i], trades[i].flags);
+    EXPECT_EQ(timestamps[i], static_cast<int64_t>(trades[i].timestamp));
+    std::string symbol(symbols + 8 * i, 8);
+    symbol.erase(symbol.find_last_not_of(' ') + 1);
+    EXPECT_EQ(symbol, trades[i].symbol);
+    EXPECT_EQ(sizes[i], static_cast<uint32_t>(trades[i].size));
+    EXPECT_EQ(prices[i], trades[i].price);
+    EXPECT_EQ(trade_ids[i], trades[i].trade_id);
+  }
+
+  // A filter pushed down into the decoder leaves only the tables of its types.
+  MessageFilter filter;
+  filter.SetTypes({MessageType::TradeReport});
+  MessageTables filtered;
+  ASSERT_EQ(filtered.AddFile(tops_pcap_filepath, filter), ReturnCode::Success);
+  ASSERT_EQ(filtered.GetTables().size(), 1);
+  EXPECT_EQ(filtered.GetTables()[0].GetNumRows(), trades.size());
+  EXPECT_EQ(filtered.GetTable(MessageType::QuoteUpdate), nullptr);
+}
+
+TEST(CApiTest, BatchesMatchDecodedMessages) {
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  std::vector<QuoteUpdateMessage> quotes;
+  size_t num_msgs = 0;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    ++num_msgs;
+    const auto quote_msg = dynamic_cast<QuoteUpdateMessage*>(msg_ptr.get());
+    if (quote_msg && quote_msg->symbol == "AWP") {
+      quotes.push_back(*quote_msg);
+    }
+  }
+  ASSERT_FALSE(quotes.empty());
+
+  iex_decoder_t* c_decoder = nullptr;
+  EXPECT_EQ(iex_open("no_such_file.pcap", &c_decoder), IEX_ERROR_OPEN_FAILED);
+  EXPECT_EQ(c_decoder, nullptr);
+
+  // Records, in batches smaller than the stream.
+  ASSERT_EQ(iex_open(tops_pcap_filepath.c_str(), &c_decoder), IEX_OK);
+  std::vector<iex_record_t> records(1000);
+  size_t num_records = 0;
+  size_t num_decoded = 0;
+  iex_status_t status = IEX_OK;
+  while (status == IEX_OK) {
+    status = iex_decode_records(c_decoder, records.data(), records.size(), &num_decoded);
+    for (size_t i = 0; i < num_decoded; ++i) {
+      ASSERT_EQ(records[i].unsupported, 0);
+    }
+    num_records += num_decoded;
+  }
+  EXPECT_EQ(status, IEX_END_OF_STREAM);
+  EXPECT_EQ(num_records, num_msgs);
+  iex_close(c_decoder);
+
+  // Columns of the quotes of one symbol, with the filter pushed down.
+  ASSERT_EQ(iex_open(tops_pcap_filepath.c_str(), &c_decoder), IEX_OK);
+  const uint8_t types[] = {IEX_QUOTE_UPDATE};
+  const char* symbols[] = {"AWP"};
+  ASSERT_EQ(iex_set_types(c_decoder, types, 1), IEX_OK);
+  ASSERT_EQ(iex_set_symbols(c_decoder, symbols, 1), IEX_OK);
+  const size_t capacity = quotes.size() + 1;
+  std::vector<int64_t> timestamps(capacity);
+  std::vector<double> bid_prices(capacity), ask_prices(capacity);
+  std::vector<uint32_t> bid_sizes(capacity), ask_sizes(capacity);
+  std::vector<char> symbol_column(8 * capacity);
+  iex_columns_t columns = {};
+  columns.timestamp = timestamps.data();
+  columns.price = bid_prices.data();
+  columns.price2 = ask_prices.data();
+  columns.size = bid_sizes.data();
+  columns.size2 = ask_sizes.data();
+  columns.symbol = symbol_column.data();
+  EXPECT_EQ(iex_decode_columns(c_decoder, &columns, capacity, &num_decoded), IEX_END_OF_STREAM);
+  ASSERT_EQ(num_decoded, quotes.size());
+  for (size_t i = 0; i < quotes.size(); ++i) {
+    EXPECT_EQ(timestamps[i], static_cast<int64_t>(quotes[i].timestamp));
+    EXPECT_EQ(bid_prices[i], quotes[i].bid_price);
+    EXPECT_EQ(ask_prices[i], quotes[i].ask_price);
+    EXPECT_EQ(bid_sizes[i], static_cast<uint32_t>(quotes[i].bid_size));
+    EXPECT_EQ(ask_sizes[i], static_cast<uint32_t>(quotes[i].ask_size));
+    EXPECT_EQ(std::string(&symbol_column[8 * i], 8), "AWP     ");
+  }
+  EXPECT_EQ(iex_decode_columns(c_decoder, nullptr, capacity, &num_decoded),
+            IEX_ERROR_INVALID_ARGUMENT);
+  iex_close(c_decoder);
+
+  // DEEP+ order messages are returned, flagged as unsupported.
+  AddOrderMessage add_order;
+  add_order.timestamp = 1517058000000000001;
+  add_order.side = AddOrderMessage::Side::Buy;
+  add_order.symbol = "ZIEXT";
+  add_order.order_id = 1;
+  add_order.size = 100;
+  add_order.price = 10.00;
+  const std::string deep_plus_filename = "test_c_api_deep_plus.tmp";
+  IEXTPPcapWriter writer;
+  ASSERT_TRUE(writer.Open(deep_plus_filename));
+  IEXTPPacketBuilder builder(static_cast<uint16_t>(ProtocolId::DEEP_PLUS), 1, 1, 1500, 1, 0);
+  ASSERT_TRUE(builder.AddMessage(add_order));
+  builder.Finish(add_order.timestamp);
+  ASSERT_TRUE(writer.WritePacket(builder.GetData(), builder.GetLength(), add_order.timestamp));
+  writer.Close();
+  ASSERT_EQ(iex_open(deep_plus_filename.c_str(), &c_decoder), IEX_OK);
+  EXPECT_EQ(iex_decode_records(c_decoder, records.data(), records.size(), &num_decoded),
+            IEX_END_OF_STREAM);
+  ASSERT_EQ(num_decoded, 1);
+  EXPECT_EQ(records[0].type, IEX_ADD_ORDER);
+  EXPECT_EQ(records[0].unsupported, 1);
+  EXPECT_EQ(records[0].timestamp, static_cast<int64_t>(add_order.timestamp));
+  EXPECT_EQ(records[0].price, 0);
+  iex_close(c_decoder);
+  std::remove(deep_plus_filename.c_str());
+}
+
+// Collects the type and timestamp of every message, and the quotes, from a ProtocolDecoder.
+struct ProtocolTestHandler {
+  void operator()(const QuoteUpdateMessage& msg) {
+    quotes.push_back(msg);
+    (*this)(static_cast<const IEXMessageBase&>(msg));
+  }
+  void operator()(const IEXMessageBase& msg) {
+    stream.emplace_back(msg.GetMessageType(), msg.timestamp);
+  }
+  std::vector<std::pair<MessageType, uint64_t>> stream;
+  std::vector<QuoteUpdateMessage> quotes;
+};
+
+TEST(ProtocolDecoderTest, MatchesGenericDecoder) {
+  for (const auto& filepath : {tops_pcap_filepath, deep_pcap_filepath}) {
+    IEXDecoder decoder;
+    ASSERT_TRUE(decoder.OpenFileForDecoding(filepath));
+    std::unique_ptr<IEXMessageBase> msg_ptr;
+    ProtocolTestHandler expected;
+    while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+      const auto quote_msg = dynamic_cast<QuoteUpdateMessage*>(msg_ptr.get());
+      if (quote_msg) {
+        expected(*quote_msg);
+      } else {
+        expected(*msg_ptr);
+      }
+    }
+    ProtocolTestHandler handler;
+    ASSERT_EQ(DecodeProtocolFile(filepath, handler), ReturnCode::Success);
+    EXPECT_EQ(handler.stream, expected.stream);
+    ASSERT_EQ(handler.quotes.size(), expected.quotes.size());
+    for (size_t i = 0; i < expected.quotes.size(); ++i) {
+      EXPECT_EQ(handler.quotes[i].symbol, expected.quotes[i].symbol);
+      EXPECT_EQ(handler.quotes[i].bid_price, expected.quotes[i].bid_price);
+      EXPECT_EQ(handler.quotes[i].ask_size, expected.quotes[i].ask_size);
+    }
+  }
+  EXPECT_EQ(GetProtocolName(static_cast<uint16_t>(ProtocolId::TOPS)), "TOPS 1.6");
+  EXPECT_EQ(GetProtocolName(0x8002), "Unknown");
+
+  // The DEEP policy does not carry quote updates, so it rejects a TOPS stream.
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(tops_pcap_filepath));
+  ProtocolDecoder<Deep10Protocol> deep_decoder;
+  ProtocolTestHandler handler;
+  EXPECT_EQ(deep_decoder.Run(decoder, handler), ReturnCode::UnknownMessageType);
+  EXPECT_TRUE(handler.quotes.empty());
+}
+
+TEST(OrderBookTest, DeepPlusFileBuildsBook) {
+  // Write a DEEP+ file of order messages, one per packet.
+  std::vector<std::unique_ptr<IEXMessageBase>> messages;
+  uint64_t timestamp = 1517058000000000000;
+  auto add = [&](const AddOrderMessage::Side side, const std::string& symbol,
+                 const uint64_t order_id, const int size, const double price) {
+    AddOrderMessage* msg = new AddOrderMessage();
+    msg->timestamp = ++timestamp;
+    msg->side = side;
+    msg->symbol = symbol;
+    msg->order_id = order_id;
+    msg->size = size;
+    msg->price = price;
+    messages.emplace_back(msg);
+  };
+  add(AddOrderMessage::Side::Buy, "ZIEXT", 1, 100, 10.00);
+  add(AddOrderMessage::Side::Buy, "ZIEXT", 2, 200, 10.00);
+  add(AddOrderMessage::Side::Buy, "ZIEXT", 3, 300, 9.99);
+  add(AddOrderMessage::Side::Sell, "ZIEXT", 4, 400, 10.01);
+  add(AddOrderMessage::Side::Sell, "ZIEXT", 5, 500, 10.02);
+  add(AddOrderMessage::Side::Buy, "ZXIET", 6, 600, 20.00);
+  // Order 1 keeps its priority, order 4 moves to 10.02 behind order 5.
+  OrderModifyMessage* modify = new OrderModifyMessage();
+  modify->timestamp = ++timestamp;
+  modify->flags = OrderModifyMessage::maintain_priority_flag;
+  modify->symbol = "ZIEXT";
+  modify->order_id = 1;
+  modify->size = 50;
+  modify->price = 10.00;
+  messages.emplace_back(modify);
+  modify = new OrderModifyMessage(*modify);
+  modify->timestamp = ++timestamp;
+  modify->flags = 0;
+  modify->order_id = 4;
+  modify->size = 400;
+  modify->price = 10.02;
+  messages.emplace_back(modify);
+  OrderExecutedMessage* executed = new OrderExecutedMessage();
+  executed->timestamp = ++timestamp;
+  executed->flags = 0;
+  executed->symbol = "ZIEXT";
+  executed->order_id = 2;
+  executed->size = 150;
+  executed->price = 10.00;
+  executed->trade_id = 7;
+  messages.emplace_back(executed);
+  OrderDeleteMessage* deleted = new OrderDeleteMessage();
+  deleted->timestamp = ++timestamp;
+  deleted->symbol = "ZIEXT";
+  deleted->order_id = 3;
+  messages.emplace_back(deleted);
+  deleted = new OrderDeleteMessage(*deleted);
+  deleted->timestamp = ++timestamp;
+  deleted->order_id = 42;
+  messages.emplace_back(deleted);
+  ClearBookMessage* clear_book = new ClearBookMessage();
+  clear_book->timestamp = ++timestamp;
+  clear_book->symbol = "ZXIET";
+  messages.emplace_back(clear_book);
+
+  const std::string filename = "test_deep_plus.tmp";
+  IEXTPPcapWriter writer;
+  ASSERT_TRUE(writer.Open(filename));
+  IEXTPPacketBuilder builder(static_cast<uint16_t>(ProtocolId::DEEP_PLUS), 1, 1, 1500, 1, 0);
+  for (const auto& msg : messages) {
+    ASSERT_TRUE(builder.AddMessage(*msg));
+    builder.Finish(msg->timestamp);
+    ASSERT_TRUE(writer.WritePacket(builder.GetData(), builder.GetLength(), msg->timestamp));
+    builder.StartNextPacket();
+  }
+  writer.Close();
+
+  // The factory decodes every message back.
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(filename));
+  std::unique_ptr<IEXMessageBase> msg_ptr;
+  size_t num_messages = 0;
+  while (decoder.GetNextMessage(msg_ptr) == ReturnCode::Success) {
+    ASSERT_LT(num_messages, messages.size());
+    EXPECT_EQ(msg_ptr->GetMessageType(), messages[num_messages]->GetMessageType());
+    EXPECT_EQ(msg_ptr->timestamp, messages[num_messages]->timestamp);
+    ++num_messages;
+  }
+  EXPECT_EQ(num_messages, messages.size());
+
+  OrderBook book(4, 4);
+  ASSERT_EQ(DecodeProtocolFile(filename, book), ReturnCode::Success);
+  std::remove(filename.c_str());
+
+  const uint32_t symbol_id = book.GetSymbols().Find(PackSymbol("ZIEXT"));
+  ASSERT_NE(symbol_id, SymbolTable::npos);
+  EXPECT_EQ(book.GetNumOrders(), 4);
+  EXPECT_EQ(book.GetNumUnmatched(), 1);
+
+  ASSERT_EQ(book.GetNumLevels(symbol_id, OrderBook::Side::Buy), 1);
+  const OrderBook::PriceLevel* bid = book.GetBestLevel(symbol_id, OrderBook::Side::Buy);
+  ASSERT_NE(bid, nullptr);
+  EXPECT_EQ(bid->price, 100000);
+  EXPECT_EQ(bid->size, 100);
+  std::vector<std::pair<uint64_t, uint32_t>> orders;
+  book.ForEachOrder(*bid, [&orders](const uint64_t order_id, const uint32_t size) {
+    orders.emplace_back(order_id, size);
+  });
+  EXPECT_EQ(orders, (std::vector<std::pair<uint64_t, uint32_t>>{{1, 50}, {2, 50}}));
+
+  ASSERT_EQ(book.GetNumLevels(symbol_id, OrderBook::Side::Sell), 1);
+  const OrderBook::PriceLevel& ask = book.GetLevel(symbol_id, OrderBook::Side::Sell, 0);
+  EXPECT_EQ(ask.price, 100200);
+  EXPECT_EQ(ask.size, 900);
+  orders.clear();
+  book.ForEachOrder(ask, [&orders](const uint64_t order_id, const uint32_t size) {
+    orders.emplace_back(order_id, size);
+  });
+  EXPECT_EQ(orders, (std::vector<std::pair<uint64_t, uint32_t>>{{5, 500}, {4, 400}}));
+
+  const uint32_t cleared_id = book.GetSymbols().Find(PackSymbol("ZXIET"));
+  ASSERT_NE(cleared_id, SymbolTable::npos);
+  EXPECT_EQ(book.GetBestLevel(cleared_id, OrderBook::Side::Buy), nullptr);
+
+  // Many orders grow the pools and the hash, and deleting them all leaves empty books.
+  for (uint64_t order_id = 100; order_id < 10100; ++order_id) {
+    ASSERT_TRUE(book.AddOrder(order_id, symbol_id, OrderBook::Side::Buy,
+                              90000 + static_cast<int64_t>(order_id % 37), 100));
+  }
+  EXPECT_EQ(book.GetNumLevels(symbol_id, OrderBook::Side::Buy), 38);
+  EXPECT_EQ(book.GetLevel(symbol_id, OrderBook::Side::Buy, 1).price, 90036);
+  for (uint64_t order_id = 100; order_id < 10100; ++order_id) {
+    ASSERT_TRUE(book.DeleteOrder(order_id));
+  }
+  EXPECT_FALSE(book.DeleteOrder(100));
+  book.ClearBook(symbol_id);
+  EXPECT_EQ(book.GetNumOrders(), 0);
+  EXPECT_EQ(book.GetNumLevels(symbol_id, OrderBook::Side::Buy), 0);
+}
+
+// Dispatches every message of a file through both the table and the switch of a ProtocolDecoder.
+template <typename Protocol>
+void ExpectSameDispatch(const std::string& filepath) {
+  IEXDecoder decoder;
+  ASSERT_TRUE(decoder.OpenFileForDecoding(filepath));
+  ProtocolDecoder<Protocol> table_decoder;
+  ProtocolDecoder<Protocol> switch_decoder;
+  ProtocolTestHandler table_handler;
+  ProtocolTestHandler switch_handler;
+  const uint8_t* msg_data_ptr = nullptr;
+  size_t msg_len = 0;
+  while (decoder.GetNextMessageData(msg_data_ptr, msg_len) == ReturnCode::Success) {
+    ASSERT_EQ(table_decoder.Dispatch(msg_data_ptr, table_handler),
+              switch_decoder.DispatchSwitch(msg_data_ptr, switch_handler));
+  }
+  EXPECT_GT(table_handler.stream.size(), 0);
+  EXPECT_EQ(table_handler.stream, switch_handler.stream);
+  ASSERT_EQ(table_handler.quotes.size(), switch_handler.quotes.size());
+  for (size_t i = 0; i < switch_handler.quotes.size(); ++i) {
+    EXPECT_EQ(table_handler.quotes[i].bid_size, switch_handler.quotes[i].bid_size);
+    EXPECT_EQ(table_handler.quotes[i].ask_price, switch_handler.quotes[i].ask_price);
+  }
+}
+
+TEST(ProtocolDecoderTest, DispatchTableMatchesSwitch) {
+  ExpectSameDispatch<Tops16Protocol>(tops_pcap_filepath);
+  ExpectSameDispatch<Deep10Protocol>(deep_pcap_filepath);
+
+  // Unknown type bytes, and types of other protocols, are rejected as by the switch.
+  uint8_t msg_data[IEXMessageBase::max_encoded_len] = {};
+  ProtocolDecoder<Tops16Protocol> protocol_decoder;
+  ProtocolTestHandler handler;
+  for (const uint8_t type : {0x00, 0x38, 0x61, 0xff}) {
+    msg_data[0] = type;
+    EXPECT_EQ(protocol_decoder.Dispatch(msg_data, handler), ReturnCode::UnknownMessageType);
+    EXPECT_EQ(protocol_decoder.DispatchSwitch(msg_data, handler), ReturnCode::UnknownMessageType);
+  }
+  EXPECT_TRUE(handler.stream.empty());
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();